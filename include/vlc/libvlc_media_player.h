@@ -393,10 +393,13 @@ typedef void (*libvlc_video_cleanup_cb)(void *opaque);
  *   cropping and/or picture re-orientation, must be performed by the CPU
  *   instead of the GPU.
  * - Memory copying is required between LibVLC reference picture buffers and
- *   application buffers (between lock and unlock callbacks).
+ *   application buffers (between lock and unlock callbacks), unless the
+ *   picture buffers are allocated by the application, see
+ *   libvlc_video_set_pool_callbacks().
  *
  * \param mp the media player
- * \param lock callback to lock video memory (must not be NULL)
+ * \param lock callback to lock video memory (must not be NULL, unless
+ *             libvlc_video_set_pool_callbacks() is used)
  * \param unlock callback to unlock video memory (or NULL if not needed)
  * \param display callback to display video (or NULL if not needed)
  * \param opaque private pointer for the three callbacks (as first parameter)
@@ -409,6 +412,61 @@ void libvlc_video_set_callbacks( libvlc_media_player_t *mp,
                                  libvlc_video_display_cb display,
                                  void *opaque );
 
+/**
+ * Callback prototype to allocate a picture buffer of the video output pool.
+ *
+ * When the video output starts, the alloc callback is invoked once for each
+ * picture buffer of the pool. Video decoders and filters then render
+ * directly into those buffers, so that no copy is needed to deliver the
+ * pictures to the application. The pixel planes must follow the pitches and
+ * lines configured with libvlc_video_set_format() or the
+ * @ref libvlc_video_format_cb callback, and be aligned on 32-bytes
+ * boundaries.
+ *
+ * \param opaque private pointer as passed to libvlc_video_set_callbacks() [IN]
+ * \param planes start address of the pixel planes (LibVLC allocates the array
+ *             of void pointers, this callback must initialize the array) [OUT]
+ * \return a private pointer for the unlock, display and release callbacks to
+ *         identify the picture buffer, or NULL on error
+ */
+typedef void *(*libvlc_video_alloc_cb)(void *opaque, void **planes);
+
+/**
+ * Callback prototype to release a picture buffer of the video output pool.
+ *
+ * When the video output stops, every picture buffer allocated with the
+ * @ref libvlc_video_alloc_cb callback is returned to the application through
+ * the release callback, before the @ref libvlc_video_cleanup_cb callback
+ * is invoked.
+ *
+ * \param opaque private pointer as passed to libvlc_video_set_callbacks() [IN]
+ * \param picture private pointer returned from the @ref libvlc_video_alloc_cb
+ *                callback [IN]
+ */
+typedef void (*libvlc_video_release_cb)(void *opaque, void *picture);
+
+/**
+ * Set callbacks to allocate the video output picture buffers in application
+ * memory. This only works in combination with libvlc_video_set_callbacks().
+ *
+ * The lock callback is not used if the pool callbacks are set (and may then
+ * be NULL). The unlock and display callbacks receive the pointer returned by
+ * the alloc callback. The picture buffer is not reused, hence it can be
+ * read, until the display callback returns.
+ *
+ * This avoids the copy between LibVLC picture buffers and application
+ * buffers on every frame.
+ *
+ * \param mp the media player
+ * \param alloc callback to allocate a picture buffer (or NULL to disable)
+ * \param release callback to release a picture buffer (or NULL if not needed)
+ * \version LibVLC 3.0.0 or later
+ */
+LIBVLC_API
+void libvlc_video_set_pool_callbacks( libvlc_media_player_t *mp,
+                                      libvlc_video_alloc_cb alloc,
+                                      libvlc_video_release_cb release );
+
 /**
  * Set decoded video chroma and dimensions.
  * This only works in combination with libvlc_video_set_callbacks(),
@@ -288,6 +288,19 @@ enum demux_query_e
      * arg1= bool */
     DEMUX_SET_RECORD_STATE,
 
+    /** Enables or disables keyframe-only demuxing (trick play).
+     *
+     * With a positive stride, only the video keyframes should be output,
+     * each one at least the stride (in microseconds) after the previous one,
+     * and the other elementary streams can be skipped. A null stride resumes
+     * normal demuxing of all the streams from the current position.
+     *
+     * The control is only used when DEMUX_CAN_CONTROL_PACE returned true.
+     * Can fail if the demuxer has no keyframe index.
+     *
+     * arg1= int64_t */
+    DEMUX_SET_KEYFRAME_STRIDE,
+
     /* II. Specific access_demux queries */
 
     /* DEMUX_CAN_CONTROL_RATE is called only if DEMUX_CAN_CONTROL_PACE has
@@ -421,6 +421,8 @@ struct input_stats_t
     /* Decoders */
     int64_t i_decoded_audio;
     int64_t i_decoded_video;
+    int64_t i_decoder_blocks;   /**< blocks handed over to decoder threads */
+    int64_t i_decoder_wakeups;  /**< decoder thread wake-ups to decode */
 
     /* Vout */
     int64_t i_displayed_pictures;
@@ -139,6 +139,35 @@ typedef struct
  */
 VLC_API picture_t * picture_NewFromResource( const video_format_t *, const picture_resource_t * ) VLC_USED;
 
+/**
+ * Creates a picture sharing the pixels of another picture.
+ *
+ * The new picture points to the area of the source picture starting at the
+ * given offset, and holds a reference to the source picture until it is
+ * released. No pixels are copied: neither picture shall be modified while
+ * the view exists.
+ *
+ * This is only supported for chromas with a known memory layout.
+ *
+ * \param src source picture
+ * \param fmt format of the view (the chroma must match the source)
+ * \param x horizontal offset of the view in the source (in pixels)
+ * \param y vertical offset of the view in the source (in pixels)
+ * \return the new picture, or NULL on error
+ */
+VLC_API picture_t *picture_NewView( picture_t *src, const video_format_t *fmt,
+                                    unsigned x, unsigned y ) VLC_USED;
+
+/**
+ * Creates a read-only reference of a whole picture.
+ *
+ * \see picture_NewView()
+ */
+static inline picture_t *picture_Clone( picture_t *src )
+{
+    return picture_NewView( src, &src->format, 0, 0 );
+}
+
 /**
  * This function will increase the picture reference count.
  * It will not have any effect on picture obtained from vout
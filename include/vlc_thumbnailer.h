@@ -0,0 +1,117 @@
+/*****************************************************************************
+ * vlc_thumbnailer.h: Fast thumbnail extraction
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_THUMBNAILER_H
+#define VLC_THUMBNAILER_H 1
+
+#include <vlc_input_item.h>
+#include <vlc_picture.h>
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/**
+ * \defgroup thumbnailer Thumbnailer
+ * \ingroup input
+ * Extracts pictures from a media without an input thread nor a video output.
+ *
+ * The thumbnailer opens the media with its own demuxer and decodes the first
+ * video track only. Each request seeks to the keyframe preceding the wanted
+ * time and decodes that single frame. The demuxer, the decoder, the scaler
+ * and the encoder are kept across requests.
+ *
+ * A thumbnailer is not thread-safe: use one per thread.
+ * @{
+ */
+
+typedef struct vlc_thumbnailer_t vlc_thumbnailer_t;
+
+/**
+ * Opens a media for thumbnailing.
+ *
+ * \param p_obj parent object
+ * \param p_item input item of the media (its options are applied)
+ * \return a thumbnailer, or NULL if the media has no decodable video track
+ */
+VLC_API vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t *p_obj,
+                                                   input_item_t *p_item ) VLC_USED;
+#define vlc_thumbnailer_Create(a, b) vlc_thumbnailer_Create(VLC_OBJECT(a), b)
+
+VLC_API void vlc_thumbnailer_Delete( vlc_thumbnailer_t * );
+
+/**
+ * \return the media length in microseconds, 0 if unknown
+ */
+VLC_API mtime_t vlc_thumbnailer_GetLength( vlc_thumbnailer_t * );
+
+/**
+ * Gets the picture of the keyframe preceding a time.
+ *
+ * p_fmt selects the output: a zero chroma keeps the decoder chroma, and a
+ * zero dimension is deduced from the other one with the aspect ratio kept
+ * (both zero keep the original size). On success, it is set to the format
+ * of the returned picture.
+ *
+ * \param i_time time in microseconds
+ * \param p_fmt output format, NULL to get the decoded picture as is
+ * \return a picture to release with picture_Release(), or NULL on error
+ */
+VLC_API picture_t *vlc_thumbnailer_GetPicture( vlc_thumbnailer_t *,
+                                               mtime_t i_time,
+                                               video_format_t *p_fmt ) VLC_USED;
+
+/**
+ * Gets the keyframe preceding a time, encoded as an image.
+ *
+ * \param i_codec image codec (VLC_CODEC_PNG, VLC_CODEC_JPEG...)
+ * \param i_width width of the image, 0 to deduce it from the height
+ * \param i_height height of the image, 0 to deduce it from the width
+ * \return the image data, or NULL on error
+ */
+VLC_API block_t *vlc_thumbnailer_GetImage( vlc_thumbnailer_t *, mtime_t i_time,
+                                           vlc_fourcc_t i_codec,
+                                           unsigned i_width,
+                                           unsigned i_height ) VLC_USED;
+
+/**
+ * Gets the pictures of a storyboard in a single pass.
+ *
+ * The times are visited in increasing order whatever their order in
+ * pi_times, and times falling on the same keyframe share the same picture.
+ * pp_pictures[i] is set to the picture for pi_times[i], or NULL if it could
+ * not be extracted.
+ *
+ * \param p_fmt output format, as for vlc_thumbnailer_GetPicture()
+ * \return the number of pictures extracted
+ */
+VLC_API unsigned vlc_thumbnailer_GetStoryboard( vlc_thumbnailer_t *,
+                                                const mtime_t *pi_times,
+                                                unsigned i_count,
+                                                video_format_t *p_fmt,
+                                                picture_t **pp_pictures );
+
+/** @} */
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif
@@ -29,28 +29,63 @@
 
 #include <vlc_common.h>
 #include <vlc_access.h>
+#include <vlc_interrupt.h>
 #include <vlc_keystore.h>
 #include <vlc_plugin.h>
 #include <vlc_url.h>
 
+#include "message.h"
 #include "connmgr.h"
 #include "resource.h"
 #include "file.h"
 #include "live.h"
+#include "readahead.h"
+
+/* Data before this offset is read from the initial response, and after it
+ * from the read-ahead (if enabled). */
+#define READAHEAD_START (256 << 10)
 
 struct access_sys_t
 {
     struct vlc_http_mgr *manager;
     struct vlc_http_resource *resource;
+    struct vlc_http_readahead *readahead;
+    uint64_t offset;
 };
 
 static block_t *FileRead(access_t *access, bool *restrict eof)
 {
     access_sys_t *sys = access->p_sys;
+    block_t *b;
 
-    block_t *b = vlc_http_file_read(sys->resource);
+    if (sys->readahead != NULL && sys->offset >= READAHEAD_START)
+    {
+        b = vlc_http_readahead_read(sys->readahead);
+        if (b != vlc_http_error)
+            goto out;
+        if (vlc_killed())
+            return NULL;
+
+        /* Fall back to sequential reading */
+        msg_Warn(access, "read-ahead failure, disabled");
+        vlc_http_readahead_destroy(sys->readahead);
+        sys->readahead = NULL;
+        if (vlc_http_file_seek(sys->resource, sys->offset))
+        {
+            b = NULL;
+            goto out;
+        }
+    }
+
+    b = vlc_http_file_read(sys->resource);
+    if (b != NULL && sys->readahead != NULL
+     && sys->offset + b->i_buffer > READAHEAD_START)
+        b->i_buffer = READAHEAD_START - sys->offset;
+out:
     if (b == NULL)
         *eof = true;
+    else
+        sys->offset += b->i_buffer;
     return b;
 }
 
@@ -58,8 +93,16 @@ static int FileSeek(access_t *access, uint64_t pos)
 {
     access_sys_t *sys = access->p_sys;
 
-    if (vlc_http_file_seek(sys->resource, pos))
-        return VLC_EGENERIC;
+    if (sys->readahead != NULL && pos >= READAHEAD_START)
+        vlc_http_readahead_seek(sys->readahead, pos);
+    else
+    {
+        if (vlc_http_file_seek(sys->resource, pos))
+            return VLC_EGENERIC;
+        if (sys->readahead != NULL)
+            vlc_http_readahead_seek(sys->readahead, READAHEAD_START);
+    }
+    sys->offset = pos;
     return VLC_SUCCESS;
 }
 
@@ -166,6 +209,8 @@ static int Open(vlc_object_t *obj)
 
     sys->manager = NULL;
     sys->resource = NULL;
+    sys->readahead = NULL;
+    sys->offset = 0;
 
     void *jar = NULL;
     if (var_InheritBool(obj, "http-forward-cookies"))
@@ -255,6 +300,15 @@ static int Open(vlc_object_t *obj)
     }
     else
     {
+        unsigned max = var_InheritInteger(obj, "http-readahead");
+
+        if (max > 0 && vlc_http_file_can_seek(sys->resource)
+         && vlc_http_file_get_size(sys->resource) != UINTMAX_MAX
+         && vlc_http_file_get_size(sys->resource) > READAHEAD_START)
+            sys->readahead = vlc_http_readahead_create(obj, sys->resource,
+                                                       h2c, READAHEAD_START,
+                                                       max);
+
         access->pf_block = FileRead;
         access->pf_seek = FileSeek;
         access->pf_control = FileControl;
@@ -279,6 +333,8 @@ static void Close(vlc_object_t *obj)
     access_t *access = (access_t *)obj;
     access_sys_t *sys = access->p_sys;
 
+    if (sys->readahead != NULL)
+        vlc_http_readahead_destroy(sys->readahead);
     vlc_http_res_destroy(sys->resource);
     vlc_http_mgr_destroy(sys->manager);
     free(sys);
@@ -296,6 +352,11 @@ vlc_module_begin()
     add_bool("http2", false, N_("Force HTTP/2"),
              N_("Force HTTP version 2.0 over TCP."), true)
 
+    add_integer_with_range("http-readahead", 0, 0, 8,
+                           N_("Parallel read-ahead"),
+                           N_("Maximum number of concurrent range requests to "
+                              "read ahead seekable files with (0 disables)."),
+                           true)
     add_bool("http-continuous", false, N_("Continuous stream"),
              N_("Keep reading a resource that keeps being updated."), true)
         change_safe()
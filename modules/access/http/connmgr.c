@@ -28,6 +28,7 @@
 #include <vlc_tls.h>
 #include <vlc_interrupt.h>
 #include <vlc_url.h>
+#include <vlc_strings.h>
 #include "transport.h"
 #include "conn.h"
 #include "connmgr.h"
@@ -62,6 +63,7 @@ struct vlc_https_connecting
     const char *host;
     unsigned port;
     bool *http2;
+    const char *proxy;
     vlc_sem_t done;
 };
 
@@ -70,13 +72,9 @@ static void *vlc_https_connect_thread(void *data)
     struct vlc_https_connecting *c = data;
     vlc_tls_t *tls;
 
-    char *proxy = vlc_http_proxy_find(c->host, c->port, true);
-    if (proxy != NULL)
-    {
+    if (c->proxy != NULL)
         tls = vlc_https_connect_proxy(c->creds, c->host, c->port, c->http2,
-                                      proxy);
-        free(proxy);
-    }
+                                      c->proxy);
     else
         tls = vlc_https_connect(c->creds, c->host, c->port, c->http2);
     vlc_sem_post(&c->done);
@@ -86,7 +84,8 @@ static void *vlc_https_connect_thread(void *data)
 /** Interruptible vlc_https_connect() */
 static vlc_tls_t *vlc_https_connect_i11e(vlc_tls_creds_t *creds,
                                          const char *host, unsigned port,
-                                         bool *restrict http_two)
+                                         bool *restrict http_two,
+                                         const char *proxy)
 {
     struct vlc_https_connecting c;
     vlc_thread_t th;
@@ -95,6 +94,7 @@ static vlc_tls_t *vlc_https_connect_i11e(vlc_tls_creds_t *creds,
     c.host = host;
     c.port = port;
     c.http2 = http_two;
+    c.proxy = proxy;
     vlc_sem_init(&c.done, 0);
 
     if (vlc_clone(&th, vlc_https_connect_thread, &c,
@@ -119,7 +119,7 @@ struct vlc_http_connecting
     vlc_object_t *obj;
     const char *host;
     unsigned port;
-    bool *proxy;
+    const char *proxy;
     vlc_sem_t done;
 };
 
@@ -128,13 +128,11 @@ static void *vlc_http_connect_thread(void *data)
     struct vlc_http_connecting *c = data;
     vlc_tls_t *tls;
 
-    char *proxy = vlc_http_proxy_find(c->host, c->port, false);
-    if (proxy != NULL)
+    if (c->proxy != NULL)
     {
         vlc_url_t url;
 
-        vlc_UrlParse(&url, proxy);
-        free(proxy);
+        vlc_UrlParse(&url, c->proxy);
 
         if (url.psz_host != NULL)
             tls = vlc_http_connect(c->obj, url.psz_host, url.i_port);
@@ -146,7 +144,6 @@ static void *vlc_http_connect_thread(void *data)
     else
         tls = vlc_http_connect(c->obj, c->host, c->port);
 
-    *(c->proxy) = proxy != NULL;
     vlc_sem_post(&c->done);
     return tls;
 }
@@ -154,7 +151,7 @@ static void *vlc_http_connect_thread(void *data)
 /** Interruptible vlc_http_connect() */
 static vlc_tls_t *vlc_http_connect_i11e(vlc_object_t *obj,
                                         const char *host, unsigned port,
-                                        bool *restrict proxy)
+                                        const char *proxy)
 {
     struct vlc_http_connecting c;
     vlc_thread_t th;
@@ -181,54 +178,382 @@ static vlc_tls_t *vlc_http_connect_i11e(vlc_object_t *obj,
 }
 
 
+/*
+ * Connections are pooled per LibVLC instance, so that they can be reused
+ * by all HTTP connection managers, i.e. by all inputs. HTTP/1.x connections
+ * are used by one manager at a time, while HTTP/2 connections are shared.
+ * Connections are keyed by server and by proxy, since the proxy depends on
+ * the configuration and the network at the time of the connection.
+ */
+#define VLC_HTTP_POOL_IDLE_MAX  8 /* idle connections per instance */
+#define VLC_HTTP_POOL_IDLE_TIME (15 * CLOCK_FREQ)
+
+struct vlc_http_pool_entry
+{
+    struct vlc_http_pool_entry *next;
+    struct vlc_http_conn *conn;
+    char *host;
+    unsigned port;
+    bool secure;
+    char *proxy; /**< proxy URL, or NULL if direct */
+    bool multiplex; /**< HTTP/2 connection (can have several users) */
+    bool failed; /**< must not be reused */
+    unsigned users;
+    mtime_t idle_since;
+};
+
+struct vlc_http_pool
+{
+    struct vlc_http_pool *next;
+    libvlc_int_t *libvlc;
+    unsigned refs;
+    vlc_mutex_t lock;
+    vlc_tls_creds_t *creds;
+    struct vlc_http_pool_entry *entries;
+};
+
+static vlc_mutex_t pools_lock = VLC_STATIC_MUTEX;
+static struct vlc_http_pool *pools = NULL;
+
+static struct vlc_http_pool *vlc_http_pool_get(vlc_object_t *obj)
+{
+    libvlc_int_t *libvlc = obj->obj.libvlc;
+    struct vlc_http_pool *pool;
+
+    vlc_mutex_lock(&pools_lock);
+    for (pool = pools; pool != NULL; pool = pool->next)
+        if (pool->libvlc == libvlc)
+            break;
+
+    if (pool == NULL)
+    {
+        pool = malloc(sizeof (*pool));
+        if (likely(pool != NULL))
+        {
+            pool->libvlc = libvlc;
+            pool->refs = 0;
+            vlc_mutex_init(&pool->lock);
+            pool->creds = NULL;
+            pool->entries = NULL;
+            pool->next = pools;
+            pools = pool;
+        }
+    }
+
+    if (likely(pool != NULL))
+        pool->refs++;
+    vlc_mutex_unlock(&pools_lock);
+    return pool;
+}
+
+static void vlc_http_pool_put(struct vlc_http_pool *pool)
+{
+    vlc_mutex_lock(&pools_lock);
+    assert(pool->refs > 0);
+    if (--pool->refs > 0)
+    {
+        vlc_mutex_unlock(&pools_lock);
+        return;
+    }
+
+    struct vlc_http_pool **pp = &pools;
+    while (*pp != pool)
+        pp = &(*pp)->next;
+    *pp = pool->next;
+    vlc_mutex_unlock(&pools_lock);
+
+    /* No managers left: connections are not used anymore */
+    for (struct vlc_http_pool_entry *e = pool->entries, *next; e != NULL;
+         e = next)
+    {
+        assert(e->users == 0);
+        next = e->next;
+        vlc_http_conn_release(e->conn);
+        free(e->proxy);
+        free(e->host);
+        free(e);
+    }
+    if (pool->creds != NULL)
+        vlc_tls_Delete(pool->creds);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+/**
+ * Releases failed connections and idle connections in excess or kept for
+ * too long. Connections are released after the pool lock.
+ */
+static struct vlc_http_pool_entry *
+vlc_http_pool_prune(struct vlc_http_pool *pool)
+{
+    struct vlc_http_pool_entry *dead = NULL;
+    mtime_t now = mdate();
+    unsigned idle = 0;
+
+    /* Entries are kept most recently used first */
+    for (struct vlc_http_pool_entry **pp = &pool->entries; *pp != NULL;)
+    {
+        struct vlc_http_pool_entry *e = *pp;
+
+        if (e->users == 0
+         && (e->failed || ++idle > VLC_HTTP_POOL_IDLE_MAX
+          || now - e->idle_since > VLC_HTTP_POOL_IDLE_TIME))
+        {
+            *pp = e->next;
+            e->next = dead;
+            dead = e;
+        }
+        else
+            pp = &e->next;
+    }
+    return dead;
+}
+
+static void vlc_http_pool_release(struct vlc_http_pool_entry *dead)
+{
+    while (dead != NULL)
+    {
+        struct vlc_http_pool_entry *next = dead->next;
+
+        vlc_http_conn_release(dead->conn);
+        free(dead->proxy);
+        free(dead->host);
+        free(dead);
+        dead = next;
+    }
+}
+
+static bool vlc_http_pool_match_server(const struct vlc_http_pool_entry *e,
+                                       bool secure, const char *host,
+                                       unsigned port)
+{
+    return e->secure == secure && e->port == port
+        && !vlc_ascii_strcasecmp(e->host, host);
+}
+
+static bool vlc_http_pool_match(const struct vlc_http_pool_entry *e,
+                                bool secure, const char *host, unsigned port,
+                                const char *proxy)
+{
+    if (!vlc_http_pool_match_server(e, secure, host, port))
+        return false;
+    if (e->proxy == NULL || proxy == NULL)
+        return e->proxy == proxy;
+    return !strcmp(e->proxy, proxy);
+}
+
+/**
+ * Takes a connection to a given server through a given proxy from the pool.
+ */
+static struct vlc_http_pool_entry *
+vlc_http_pool_take(struct vlc_http_pool *pool, bool secure, const char *host,
+                   unsigned port, const char *proxy)
+{
+    struct vlc_http_pool_entry *e, **pp;
+
+    vlc_mutex_lock(&pool->lock);
+    struct vlc_http_pool_entry *dead = vlc_http_pool_prune(pool);
+
+    for (pp = &pool->entries; (e = *pp) != NULL; pp = &e->next)
+        if (!e->failed && (e->multiplex || e->users == 0)
+         && vlc_http_pool_match(e, secure, host, port, proxy))
+        {   /* Move to front */
+            *pp = e->next;
+            e->next = pool->entries;
+            pool->entries = e;
+            e->users++;
+            break;
+        }
+    vlc_mutex_unlock(&pool->lock);
+
+    vlc_http_pool_release(dead);
+    return e;
+}
+
+/**
+ * Adds a new connection to the pool, used by the caller.
+ */
+static struct vlc_http_pool_entry *
+vlc_http_pool_add(struct vlc_http_pool *pool, struct vlc_http_conn *conn,
+                  bool secure, const char *host, unsigned port,
+                  const char *proxy, bool multiplex)
+{
+    struct vlc_http_pool_entry *e = malloc(sizeof (*e));
+    if (unlikely(e == NULL))
+        goto error;
+
+    e->host = strdup(host);
+    e->proxy = (proxy != NULL) ? strdup(proxy) : NULL;
+    if (unlikely(e->host == NULL || (proxy != NULL && e->proxy == NULL)))
+    {
+        free(e->proxy);
+        free(e->host);
+        free(e);
+        goto error;
+    }
+    e->conn = conn;
+    e->port = port;
+    e->secure = secure;
+    e->multiplex = multiplex;
+    e->failed = false;
+    e->users = 1;
+
+    vlc_mutex_lock(&pool->lock);
+    e->next = pool->entries;
+    pool->entries = e;
+    vlc_mutex_unlock(&pool->lock);
+    return e;
+error:
+    vlc_http_conn_release(conn);
+    return NULL;
+}
+
+/**
+ * Gives a connection back to the pool.
+ *
+ * @param failed whether the connection failed, and must not be reused
+ */
+static void vlc_http_pool_give(struct vlc_http_pool *pool,
+                               struct vlc_http_pool_entry *e, bool failed)
+{
+    vlc_mutex_lock(&pool->lock);
+    assert(e->users > 0);
+    e->users--;
+    e->failed |= failed;
+    e->idle_since = mdate();
+
+    struct vlc_http_pool_entry *dead = vlc_http_pool_prune(pool);
+    vlc_mutex_unlock(&pool->lock);
+
+    vlc_http_pool_release(dead);
+}
+
+static vlc_tls_creds_t *vlc_http_pool_creds(struct vlc_http_pool *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    vlc_tls_creds_t *creds = pool->creds;
+    vlc_mutex_unlock(&pool->lock);
+
+    if (creds != NULL)
+        return creds;
+
+    /* Load x509 credentials (outside the lock: this is slow). The
+     * credentials are shared by the instance, so they are not bound to the
+     * object of any given manager. */
+    creds = vlc_tls_ClientCreate(VLC_OBJECT(pool->libvlc));
+    if (creds == NULL)
+        return NULL;
+
+    vlc_mutex_lock(&pool->lock);
+    if (pool->creds == NULL)
+        pool->creds = creds;
+    else
+    {
+        vlc_tls_Delete(creds);
+        creds = pool->creds;
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return creds;
+}
+
 struct vlc_http_mgr
 {
     vlc_object_t *obj;
-    vlc_tls_creds_t *creds;
+    struct vlc_http_pool *pool;
     struct vlc_http_cookie_jar_t *jar;
-    struct vlc_http_conn *conn;
+    struct vlc_http_pool_entry *conn;
     bool use_h2c;
 };
 
-static struct vlc_http_conn *vlc_http_mgr_find(struct vlc_http_mgr *mgr,
-                                               const char *host, unsigned port)
+/**
+ * Finds the proxy to a server. The lookup can be slow, so the proxy of the
+ * current connection is kept while the server does not change.
+ *
+ * @param proxyp storage for the proxy URL to free, NULL if direct [OUT]
+ * @return 0 on success, -1 on memory error
+ */
+static int vlc_http_mgr_proxy(struct vlc_http_mgr *mgr, bool secure,
+                              const char *host, unsigned port, char **proxyp)
+{
+    struct vlc_http_pool_entry *e = mgr->conn;
+
+    if (e == NULL || !vlc_http_pool_match_server(e, secure, host, port))
+    {
+        *proxyp = vlc_http_proxy_find(host, port, secure);
+        return 0;
+    }
+
+    *proxyp = NULL;
+    if (e->proxy != NULL)
+    {
+        *proxyp = strdup(e->proxy);
+        if (unlikely(*proxyp == NULL))
+            return -1;
+    }
+    return 0;
+}
+
+static struct vlc_http_pool_entry *vlc_http_mgr_find(struct vlc_http_mgr *mgr,
+                                                     bool secure,
+                                                     const char *host,
+                                                     unsigned port,
+                                                     const char *proxy)
 {
-    (void) host; (void) port;
-    return mgr->conn;
+    struct vlc_http_pool_entry *e = mgr->conn;
+
+    if (e != NULL)
+    {
+        if (vlc_http_pool_match(e, secure, host, port, proxy))
+            return e;
+
+        /* Other server: give the current connection back to the pool */
+        vlc_http_pool_give(mgr->pool, e, false);
+        mgr->conn = NULL;
+    }
+
+    e = vlc_http_pool_take(mgr->pool, secure, host, port, proxy);
+    if (e != NULL)
+        msg_Dbg(mgr->obj, "reusing %s connection to %s port %u",
+                e->multiplex ? "HTTP/2" : "HTTP/1", host, port);
+    mgr->conn = e;
+    return e;
 }
 
 static void vlc_http_mgr_release(struct vlc_http_mgr *mgr,
-                                 struct vlc_http_conn *conn)
+                                 struct vlc_http_pool_entry *conn)
 {
     assert(mgr->conn == conn);
     mgr->conn = NULL;
 
-    vlc_http_conn_release(conn);
+    vlc_http_pool_give(mgr->pool, conn, true);
 }
 
 static
-struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr,
+struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr, bool secure,
                                         const char *host, unsigned port,
+                                        const char *proxy,
                                         const struct vlc_http_msg *req)
 {
-    struct vlc_http_conn *conn = vlc_http_mgr_find(mgr, host, port);
-    if (conn == NULL)
-        return NULL;
+    struct vlc_http_pool_entry *conn;
 
-    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
-    if (stream != NULL)
+    /* Try the connections to the server until one works */
+    while ((conn = vlc_http_mgr_find(mgr, secure, host, port, proxy)) != NULL)
     {
-        struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
-        if (m != NULL)
-            return m;
-
-        /* NOTE: If the request were not idempotent, we would not know if it
-         * was processed by the other end. Thus POST is not used/supported so
-         * far, and CONNECT is treated as if it were idempotent (which works
-         * fine here). */
+        struct vlc_http_stream *stream = vlc_http_stream_open(conn->conn, req);
+        if (stream != NULL)
+        {
+            struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
+            if (m != NULL)
+                return m;
+
+            /* NOTE: If the request were not idempotent, we would not know if
+             * it was processed by the other end. Thus POST is not
+             * used/supported so far, and CONNECT is treated as if it were
+             * idempotent (which works fine here). */
+        }
+        /* Get rid of closing or reset connection */
+        vlc_http_mgr_release(mgr, conn);
     }
-    /* Get rid of closing or reset connection */
-    vlc_http_mgr_release(mgr, conn);
     return NULL;
 }
 
@@ -236,25 +561,24 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
                                               const char *host, unsigned port,
                                               const struct vlc_http_msg *req)
 {
-    if (mgr->creds == NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTP to HTTPS not implemented */
-
-    if (mgr->creds == NULL)
-    {   /* First TLS connection: load x509 credentials */
-        mgr->creds = vlc_tls_ClientCreate(mgr->obj);
-        if (mgr->creds == NULL)
-            return NULL;
-    }
+    vlc_tls_creds_t *creds = vlc_http_pool_creds(mgr->pool);
+    if (creds == NULL)
+        return NULL;
+
+    char *proxy;
+    if (vlc_http_mgr_proxy(mgr, true, host, port, &proxy))
+        return NULL;
 
     /* TODO? non-idempotent request support */
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, true, host, port,
+                                                   proxy, req);
     if (resp != NULL)
-        return resp; /* existing connection reused */
+        goto out; /* existing connection reused */
 
     bool http2 = true;
-    vlc_tls_t *tls = vlc_https_connect_i11e(mgr->creds, host, port, &http2);
+    vlc_tls_t *tls = vlc_https_connect_i11e(creds, host, port, &http2, proxy);
     if (tls == NULL)
-        return NULL;
+        goto out;
 
     struct vlc_http_conn *conn;
 
@@ -273,46 +597,59 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
     if (unlikely(conn == NULL))
     {
         vlc_tls_Close(tls);
-        return NULL;
+        goto out;
     }
 
-    mgr->conn = conn;
-
-    return vlc_http_mgr_reuse(mgr, host, port, req);
+    assert(mgr->conn == NULL);
+    mgr->conn = vlc_http_pool_add(mgr->pool, conn, true, host, port, proxy,
+                                  http2);
+    if (likely(mgr->conn != NULL))
+        resp = vlc_http_mgr_reuse(mgr, true, host, port, proxy, req);
+out:
+    free(proxy);
+    return resp;
 }
 
 static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
                                              const char *host, unsigned port,
                                              const struct vlc_http_msg *req)
 {
-    if (mgr->creds != NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTPS to HTTP not implemented */
+    char *proxy;
+    if (vlc_http_mgr_proxy(mgr, false, host, port, &proxy))
+        return NULL;
 
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, false, host, port,
+                                                   proxy, req);
     if (resp != NULL)
-        return resp;
+        goto out;
 
-    bool proxy;
-    vlc_tls_t *tls = vlc_http_connect_i11e(mgr->obj, host, port, &proxy);
+    /* The connection can outlive the manager: bind it to the instance */
+    vlc_tls_t *tls = vlc_http_connect_i11e(VLC_OBJECT(mgr->pool->libvlc),
+                                           host, port, proxy);
     if (tls == NULL)
-        return NULL;
+        goto out;
 
     struct vlc_http_conn *conn;
 
     if (mgr->use_h2c)
         conn = vlc_h2_conn_create(tls);
     else
-        conn = vlc_h1_conn_create(tls, proxy);
+        conn = vlc_h1_conn_create(tls, proxy != NULL);
 
     if (unlikely(conn == NULL))
     {
         vlc_tls_Close(tls);
-        return NULL;
+        goto out;
     }
 
-    mgr->conn = conn;
-
-    return vlc_http_mgr_reuse(mgr, host, port, req);
+    assert(mgr->conn == NULL);
+    mgr->conn = vlc_http_pool_add(mgr->pool, conn, false, host, port, proxy,
+                                  mgr->use_h2c);
+    if (likely(mgr->conn != NULL))
+        resp = vlc_http_mgr_reuse(mgr, false, host, port, proxy, req);
+out:
+    free(proxy);
+    return resp;
 }
 
 struct vlc_http_msg *vlc_http_mgr_request(struct vlc_http_mgr *mgr, bool https,
@@ -335,8 +672,14 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
     if (unlikely(mgr == NULL))
         return NULL;
 
+    mgr->pool = vlc_http_pool_get(obj);
+    if (unlikely(mgr->pool == NULL))
+    {
+        free(mgr);
+        return NULL;
+    }
+
     mgr->obj = obj;
-    mgr->creds = NULL;
     mgr->jar = jar;
     mgr->conn = NULL;
     mgr->use_h2c = h2c;
@@ -346,8 +689,7 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
 void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr)
 {
     if (mgr->conn != NULL)
-        vlc_http_mgr_release(mgr, mgr->conn);
-    if (mgr->creds != NULL)
-        vlc_tls_Delete(mgr->creds);
+        vlc_http_pool_give(mgr->pool, mgr->conn, false);
+    vlc_http_pool_put(mgr->pool);
     free(mgr);
 }
@@ -0,0 +1,325 @@
+/*****************************************************************************
+ * connmgr_test.c: HTTP connection manager tests
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_network.h>
+#include "transport.h"
+#include "conn.h"
+#include "connmgr.h"
+#include "message.h"
+
+static libvlc_int_t libvlc;
+static struct vlc_object_t obj;
+
+static const char *proxy_url = NULL;
+static char connect_host[64];
+static unsigned connect_port;
+static bool connect_proxy;
+static unsigned connections = 0;
+static unsigned releases = 0;
+
+struct test_conn
+{
+    struct vlc_http_conn conn;
+    struct vlc_http_stream stream;
+    bool broken;
+    unsigned streams;
+};
+
+static struct test_conn *conns[16];
+
+static struct test_conn *conn_from_stream(struct vlc_http_stream *s)
+{
+    return (void *)(((char *)s) - offsetof(struct test_conn, stream));
+}
+
+/* Mock streams and connections */
+
+static struct vlc_http_msg *stream_read_headers(struct vlc_http_stream *s)
+{
+    struct vlc_http_msg *m = vlc_http_resp_create(200);
+
+    assert(m != NULL);
+    vlc_http_msg_attach(m, s);
+    return m;
+}
+
+static block_t *stream_read(struct vlc_http_stream *s)
+{
+    (void) s;
+    return NULL;
+}
+
+static void stream_close(struct vlc_http_stream *s, bool abort)
+{
+    struct test_conn *c = conn_from_stream(s);
+
+    assert(c->streams > 0);
+    c->streams--;
+    (void) abort;
+}
+
+static const struct vlc_http_stream_cbs stream_callbacks =
+{
+    stream_read_headers,
+    stream_read,
+    stream_close,
+};
+
+static struct vlc_http_stream *conn_stream_open(struct vlc_http_conn *conn,
+                                                const struct vlc_http_msg *m)
+{
+    struct test_conn *c = (struct test_conn *)conn;
+
+    (void) m;
+    if (c->broken)
+        return NULL;
+    c->streams++;
+    return &c->stream;
+}
+
+static void conn_release(struct vlc_http_conn *conn)
+{
+    struct test_conn *c = (struct test_conn *)conn;
+
+    assert(c->streams == 0);
+    for (unsigned i = 0; i < ARRAY_SIZE(conns); i++)
+        if (conns[i] == c)
+            conns[i] = NULL;
+    free(c);
+    releases++;
+}
+
+static const struct vlc_http_conn_cbs conn_callbacks =
+{
+    conn_stream_open,
+    conn_release,
+};
+
+static struct vlc_http_conn *conn_create(struct vlc_tls *tls)
+{
+    struct test_conn *c = malloc(sizeof (*c));
+    assert(c != NULL);
+
+    c->conn.cbs = &conn_callbacks;
+    c->conn.tls = tls;
+    c->stream.cbs = &stream_callbacks;
+    c->broken = false;
+    c->streams = 0;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(conns); i++)
+        if (conns[i] == NULL)
+        {
+            conns[i] = c;
+            break;
+        }
+    connections++;
+    return &c->conn;
+}
+
+struct vlc_http_conn *vlc_h1_conn_create(struct vlc_tls *tls, bool proxy)
+{
+    connect_proxy = proxy;
+    return conn_create(tls);
+}
+
+struct vlc_http_conn *vlc_h2_conn_create(struct vlc_tls *tls)
+{
+    return conn_create(tls);
+}
+
+/* Mock transport */
+
+static char dummy_tls;
+
+struct vlc_tls *vlc_http_connect(vlc_object_t *o, const char *name,
+                                 unsigned port)
+{
+    assert(o == VLC_OBJECT(&libvlc));
+    strlcpy(connect_host, name, sizeof (connect_host));
+    connect_port = port;
+    return (struct vlc_tls *)&dummy_tls;
+}
+
+struct vlc_tls *vlc_https_connect(struct vlc_tls_creds *creds,
+                                  const char *name, unsigned port,
+                                  bool *restrict two)
+{
+    (void) creds; (void) name; (void) port; (void) two;
+    assert(!"unexpected HTTPS connection");
+    return NULL;
+}
+
+struct vlc_tls *vlc_https_connect_proxy(struct vlc_tls_creds *creds,
+                                        const char *name, unsigned port,
+                                        bool *restrict two, const char *proxy)
+{
+    (void) creds; (void) name; (void) port; (void) two; (void) proxy;
+    assert(!"unexpected HTTPS connection");
+    return NULL;
+}
+
+char *vlc_getProxyUrl(const char *url)
+{
+    (void) url;
+    return (proxy_url != NULL) ? strdup(proxy_url) : NULL;
+}
+
+static struct vlc_http_msg *request(struct vlc_http_mgr *mgr, const char *host)
+{
+    struct vlc_http_msg *req = vlc_http_req_create("GET", "http", host, "/");
+    assert(req != NULL);
+
+    struct vlc_http_msg *resp = vlc_http_mgr_request(mgr, false, host, 0, req);
+    vlc_http_msg_destroy(req);
+    return resp;
+}
+
+static void request_ok(struct vlc_http_mgr *mgr, const char *host)
+{
+    struct vlc_http_msg *m = request(mgr, host);
+
+    assert(m != NULL);
+    assert(vlc_http_msg_get_status(m) == 200);
+    vlc_http_msg_destroy(m);
+}
+
+int main(void)
+{
+    struct vlc_http_mgr *a, *b, *c;
+
+    libvlc.obj.libvlc = &libvlc;
+    libvlc.obj.flags = OBJECT_FLAGS_QUIET;
+    obj.obj.libvlc = &libvlc;
+    obj.obj.flags = OBJECT_FLAGS_QUIET;
+
+    /* Connection kept by the manager across requests */
+    a = vlc_http_mgr_create(&obj, NULL, false);
+    assert(a != NULL);
+    request_ok(a, "www.example.com");
+    assert(connections == 1);
+    assert(!strcmp(connect_host, "www.example.com"));
+    assert(connect_port == 0);
+    assert(!connect_proxy);
+    request_ok(a, "www.example.com");
+    assert(connections == 1);
+
+    /* HTTP/1 connection used by one manager at a time */
+    b = vlc_http_mgr_create(&obj, NULL, false);
+    assert(b != NULL);
+    request_ok(b, "www.example.com");
+    assert(connections == 2);
+
+    /* Idle connection reused by another manager */
+    vlc_http_mgr_destroy(a);
+    assert(releases == 0);
+    a = vlc_http_mgr_create(&obj, NULL, false);
+    assert(a != NULL);
+    request_ok(a, "www.example.com");
+    assert(connections == 2);
+
+    /* Other server: the connection is given back to the pool */
+    request_ok(a, "www.example.org");
+    assert(connections == 3);
+    assert(!strcmp(connect_host, "www.example.org"));
+    request_ok(b, "www.example.org");
+    assert(connections == 4);
+    request_ok(b, "www.example.com");
+    assert(connections == 4);
+
+    /* Direct connections are not reused through a proxy... */
+    proxy_url = "http://proxy.example.com:3128";
+    c = vlc_http_mgr_create(&obj, NULL, false);
+    assert(c != NULL);
+    request_ok(c, "www.example.com");
+    assert(connections == 5);
+    assert(!strcmp(connect_host, "proxy.example.com"));
+    assert(connect_port == 3128);
+    assert(connect_proxy);
+
+    /* ...nor through another proxy... */
+    vlc_http_mgr_destroy(c);
+    proxy_url = "http://proxy.example.net:8080";
+    c = vlc_http_mgr_create(&obj, NULL, false);
+    assert(c != NULL);
+    request_ok(c, "www.example.com");
+    assert(connections == 6);
+    assert(!strcmp(connect_host, "proxy.example.net"));
+    assert(connect_port == 8080);
+    vlc_http_mgr_destroy(c);
+
+    /* ...and proxied connections are not reused directly */
+    proxy_url = NULL;
+    c = vlc_http_mgr_create(&obj, NULL, false);
+    assert(c != NULL);
+    request_ok(c, "www.example.com");
+    assert(connections == 6);
+    assert(!strcmp(connect_host, "proxy.example.net"));
+
+    /* Failed connections are dropped, then a new one is opened */
+    vlc_http_mgr_destroy(c);
+    for (unsigned i = 0; i < ARRAY_SIZE(conns); i++)
+        if (conns[i] != NULL)
+            conns[i]->broken = true;
+    unsigned released = releases;
+    c = vlc_http_mgr_create(&obj, NULL, false);
+    assert(c != NULL);
+    request_ok(c, "www.example.com");
+    assert(connections == 7);
+    assert(releases > released);
+    vlc_http_mgr_destroy(c);
+    vlc_http_mgr_destroy(b);
+    vlc_http_mgr_destroy(a);
+    assert(releases == connections);
+
+    /* HTTP/2 connections are shared */
+    a = vlc_http_mgr_create(&obj, NULL, true);
+    b = vlc_http_mgr_create(&obj, NULL, true);
+    assert(a != NULL && b != NULL);
+    request_ok(a, "www.example.com");
+    request_ok(b, "www.example.com");
+    assert(connections == 8);
+
+    struct vlc_http_msg *m1 = request(a, "www.example.com");
+    struct vlc_http_msg *m2 = request(b, "www.example.com");
+    assert(m1 != NULL && m2 != NULL);
+    assert(connections == 8);
+    vlc_http_msg_destroy(m2);
+    vlc_http_msg_destroy(m1);
+
+    /* All connections are released with the last manager */
+    vlc_http_mgr_destroy(a);
+    assert(releases == connections - 1);
+    vlc_http_mgr_destroy(b);
+    assert(releases == connections);
+    return 0;
+}
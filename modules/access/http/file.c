@@ -43,6 +43,7 @@ struct vlc_http_file
 {
     struct vlc_http_resource resource;
     uintmax_t offset;
+    uintmax_t end; /**< end of the requested range, or UINTMAX_MAX */
 };
 
 static int vlc_http_file_req(const struct vlc_http_resource *res,
@@ -69,6 +70,15 @@ static int vlc_http_file_req(const struct vlc_http_resource *res,
         }
     }
 
+    if (file->end != UINTMAX_MAX)
+    {
+        assert(*offset < file->end);
+        if (vlc_http_msg_add_header(req, "Range", "bytes=%ju-%ju", *offset,
+                                    file->end - 1))
+            return -1;
+        return 0;
+    }
+
     if (vlc_http_msg_add_header(req, "Range", "bytes=%ju-", *offset)
      && *offset != 0)
         return -1;
@@ -126,6 +136,7 @@ struct vlc_http_resource *vlc_http_file_create(struct vlc_http_mgr *mgr,
     }
 
     file->offset = 0;
+    file->end = UINTMAX_MAX;
     return &file->resource;
 }
 
@@ -229,6 +240,16 @@ int vlc_http_file_seek(struct vlc_http_resource *res, uintmax_t offset)
     return 0;
 }
 
+int vlc_http_file_seek_range(struct vlc_http_resource *res, uintmax_t offset,
+                             uintmax_t length)
+{
+    struct vlc_http_file *file = (struct vlc_http_file *)res;
+
+    assert(length > 0);
+    file->end = offset + length;
+    return vlc_http_file_seek(res, offset);
+}
+
 block_t *vlc_http_file_read(struct vlc_http_resource *res)
 {
     struct vlc_http_file *file = (struct vlc_http_file *)res;
@@ -72,6 +72,21 @@ bool vlc_http_file_can_seek(struct vlc_http_resource *);
  */
 int vlc_http_file_seek(struct vlc_http_resource *, uintmax_t offset);
 
+/**
+ * Sets the read offset and length.
+ *
+ * Same as vlc_http_file_seek(), but only the given number of bytes are
+ * requested, so that the connection can be reused once they are read.
+ * Later requests on the same file are limited to the same range.
+ *
+ * @param offset byte offset of next read
+ * @param length number of bytes to request (non-zero)
+ * @retval 0 if seek succeeded
+ * @retval -1 if seek failed
+ */
+int vlc_http_file_seek_range(struct vlc_http_resource *, uintmax_t offset,
+                             uintmax_t length);
+
 /**
  * Reads data.
  *
@@ -243,5 +243,70 @@ int main(void)
     vlc_http_msg_destroy(m);
     conn_destroy();
 
+    /* Test HTTP/1.1 keep-alive */
+    conn_create();
+    s = stream_open();
+    assert(s != NULL);
+    conn_send("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n");
+    m = vlc_http_msg_get_initial(s);
+    assert(m != NULL);
+
+    conn_send("First");
+    b = vlc_http_msg_read(m);
+    assert(b != NULL);
+    assert(b->i_buffer == 5);
+    assert(!memcmp(b->p_buffer, "First", 5));
+    block_Release(b);
+    b = vlc_http_msg_read(m);
+    assert(b == NULL);
+    vlc_http_msg_destroy(m);
+
+    s = stream_open(); /* same connection */
+    assert(s != NULL);
+    conn_send("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+    m = vlc_http_msg_get_initial(s);
+    assert(m != NULL);
+
+    conn_send("6\r\nSecond\r\n0\r\n\r\n");
+    b = vlc_http_msg_read(m);
+    assert(b != NULL);
+    assert(b->i_buffer == 6);
+    assert(!memcmp(b->p_buffer, "Second", 6));
+    block_Release(b);
+    b = vlc_http_msg_read(m);
+    assert(b == NULL);
+    vlc_http_msg_destroy(m);
+
+    s = stream_open(); /* still the same connection */
+    assert(s != NULL);
+    conn_send("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nThird");
+    m = vlc_http_msg_get_initial(s);
+    assert(m != NULL);
+    vlc_http_msg_destroy(m); /* closed before the end */
+
+    s = stream_open();
+    assert(s == NULL);
+    conn_destroy();
+
+    /* Test HTTP/1.1 without keep-alive */
+    conn_create();
+    s = stream_open();
+    assert(s != NULL);
+    conn_send("HTTP/1.1 200 OK\r\nContent-Length: 3\r\n"
+              "Connection: close\r\n\r\nEnd");
+    m = vlc_http_msg_get_initial(s);
+    assert(m != NULL);
+    b = vlc_http_msg_read(m);
+    assert(b != NULL);
+    assert(b->i_buffer == 3);
+    block_Release(b);
+    b = vlc_http_msg_read(m);
+    assert(b == NULL);
+    vlc_http_msg_destroy(m);
+
+    s = stream_open();
+    assert(s == NULL);
+    conn_destroy();
+
     return 0;
 }
@@ -418,6 +418,11 @@ static struct vlc_http_stream *vlc_h2_stream_open(struct vlc_http_conn *c,
 
     vlc_h2_output_send(conn->out, f);
 
+    unsigned weight = vlc_http_msg_get_weight(msg);
+    if (weight != 0)
+        vlc_h2_output_send(conn->out,
+                           vlc_h2_frame_priority(s->id, 0, weight));
+
     s->older = conn->streams;
     if (s->older != NULL)
         s->older->newer = s;
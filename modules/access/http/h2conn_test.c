@@ -40,6 +40,9 @@
 
 static struct vlc_http_conn *conn;
 static int external_fd;
+static uint_fast32_t frame_id; /* last expected frame */
+static uint8_t frame_payload[16];
+static size_t frame_len;
 
 static void conn_send(struct vlc_h2_frame *f)
 {
@@ -79,7 +82,10 @@ static void conn_expect(uint_fast8_t wanted)
 
             val = recv(external_fd, buf, len, MSG_WAITALL);
             assert(val == (ssize_t)len);
+            memcpy(frame_payload, buf, __MIN(len, sizeof (frame_payload)));
         }
+        frame_id = GetDWBE(hdr + 5) & 0x7fffffff;
+        frame_len = len;
     }
     while (got != wanted);
 }
@@ -116,17 +122,23 @@ static void conn_destroy(void)
     vlc_close(external_fd);
 }
 
-static struct vlc_http_stream *stream_open(void)
+static struct vlc_http_stream *stream_open_weight(unsigned weight)
 {
     struct vlc_http_msg *m = vlc_http_req_create("GET", "https",
                                                  "www.example.com", "/");
     assert(m != NULL);
+    vlc_http_msg_set_weight(m, weight);
 
     struct vlc_http_stream *s = vlc_http_stream_open(conn, m);
     vlc_http_msg_destroy(m);
     return s;
 }
 
+static struct vlc_http_stream *stream_open(void)
+{
+    return stream_open_weight(0);
+}
+
 static void stream_reply(uint_fast32_t id, bool nodata)
 {
     struct vlc_http_msg *m = vlc_http_resp_create(200);
@@ -253,6 +265,33 @@ int main(void)
     /* Test nonexistent stream reset */
     conn_send(vlc_h2_frame_rst_stream(sid + 100, VLC_H2_REFUSED_STREAM));
 
+    /* Test stream priority */
+    sid += 2;
+    s = stream_open_weight(32);
+    assert(s != NULL);
+    conn_expect(HEADERS);
+    assert(frame_id == sid);
+    conn_expect(PRIORITY);
+    assert(frame_id == sid);
+    assert(frame_len == 5);
+    assert(GetDWBE(frame_payload) == 0); /* non-exclusive, on the root */
+    assert(frame_payload[4] == 31);
+    stream_reply(sid, true);
+    m = vlc_http_msg_get_initial(s);
+    assert(m != NULL);
+    vlc_http_msg_destroy(m);
+    conn_expect(RST_STREAM);
+
+    sid += 2;
+    s = stream_open_weight(256);
+    assert(s != NULL);
+    conn_expect(HEADERS);
+    conn_expect(PRIORITY);
+    assert(frame_id == sid);
+    assert(frame_payload[4] == 255);
+    vlc_http_stream_close(s, false);
+    conn_expect(RST_STREAM);
+
     /* Test multiple streams in non-LIFO order */
     sid += 2;
     s = stream_open();
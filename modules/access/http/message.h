@@ -187,6 +187,23 @@ const char *vlc_http_msg_get_header(const struct vlc_http_msg *,
  */
 int vlc_http_msg_get_status(const struct vlc_http_msg *m);
 
+/**
+ * Gets request weight.
+ *
+ * @return HTTP/2 stream weight (1-256), or 0 if unspecified
+ */
+unsigned vlc_http_msg_get_weight(const struct vlc_http_msg *m);
+
+/**
+ * Sets request weight.
+ *
+ * Sets the relative weight of the stream carrying the request, with respect
+ * to the other streams of an HTTP/2 connection. This is ignored by HTTP/1.x.
+ *
+ * @param weight HTTP/2 stream weight (1-256), or 0 for the default
+ */
+void vlc_http_msg_set_weight(struct vlc_http_msg *m, unsigned weight);
+
 /**
  * Gets request method.
  *
@@ -0,0 +1,510 @@
+/*****************************************************************************
+ * readahead.c: HTTP parallel read-ahead
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_interrupt.h>
+#include "message.h"
+#include "connmgr.h"
+#include "resource.h"
+#include "file.h"
+#include "readahead.h"
+
+#pragma GCC visibility push(default)
+
+#define RA_WINDOW_MIN  (256 << 10)
+#define RA_WINDOW_MAX  (16 << 20)
+#define RA_WINDOW_INIT (512 << 10)
+/* Period over which the throughput is measured */
+#define RA_RATE_PERIOD CLOCK_FREQ
+
+/** Window of the file, requested as one range */
+struct vlc_http_range
+{
+    struct vlc_http_range *next;
+    uintmax_t start;
+    uintmax_t end;
+    block_t *head; /**< received data not read yet */
+    block_t **tailp;
+    uintmax_t received;
+    bool done; /**< not fetched anymore, owned by the list of ranges */
+    bool failed;
+    bool cancelled; /**< removed from the list, freed by the worker */
+};
+
+struct vlc_http_readahead_worker
+{
+    struct vlc_http_readahead *ra;
+    struct vlc_http_mgr *manager;
+    struct vlc_http_resource *file;
+    struct vlc_http_range *range; /**< range being fetched */
+    vlc_interrupt_t *interrupt; /**< interruption context for the range */
+    vlc_thread_t thread;
+};
+
+struct vlc_http_readahead
+{
+    vlc_object_t *obj;
+    uintmax_t size;
+    uintmax_t offset; /**< read offset */
+    uintmax_t next; /**< start of the next range to request */
+
+    vlc_mutex_t lock;
+    vlc_cond_t wait_data; /**< signaled when a range progresses */
+    vlc_cond_t wait_worker; /**< signaled when a range can be requested */
+    struct vlc_http_range *ranges; /**< ranges from the read offset */
+    struct vlc_http_range **tailp;
+    bool closing;
+
+    /* Adaptation */
+    unsigned parallel; /**< concurrent requests allowed */
+    unsigned active; /**< concurrent requests */
+    size_t window;
+    uint64_t rate; /**< best measured throughput (bytes per second) */
+    uint64_t bytes; /**< bytes received over the measurement period */
+    mtime_t busy; /**< time spent with at least one active request */
+    mtime_t busy_since;
+
+    unsigned workerc;
+    struct vlc_http_readahead_worker workerv[];
+};
+
+static void vlc_http_range_free(struct vlc_http_range *r)
+{
+    block_ChainRelease(r->head);
+    free(r);
+}
+
+/**
+ * Drops all ranges. Called with the lock held.
+ *
+ * A range is owned by its worker until it is done, and by the list of ranges
+ * afterwards. Ranges still being fetched are left to their worker.
+ */
+static void vlc_http_readahead_cancel(struct vlc_http_readahead *ra)
+{
+    for (unsigned i = 0; i < ra->workerc; i++)
+    {
+        struct vlc_http_readahead_worker *w = &ra->workerv[i];
+
+        if (w->range != NULL)
+        {   /* Interrupt the request in progress */
+            w->range->cancelled = true;
+            if (w->interrupt != NULL)
+                vlc_interrupt_kill(w->interrupt);
+        }
+    }
+
+    for (struct vlc_http_range *r = ra->ranges, *next; r != NULL; r = next)
+    {
+        next = r->next;
+        if (r->done)
+            vlc_http_range_free(r);
+    }
+    ra->ranges = NULL;
+    ra->tailp = &ra->ranges;
+}
+
+/**
+ * Updates the number of concurrent requests and the size of the windows
+ * from the measured throughput. Called with the lock held, whenever a range
+ * is done.
+ */
+static void vlc_http_readahead_adapt(struct vlc_http_readahead *ra,
+                                     unsigned max)
+{
+    mtime_t busy = ra->busy;
+    if (ra->active > 0)
+        busy += mdate() - ra->busy_since;
+    if (busy < RA_RATE_PERIOD)
+        return;
+
+    uint64_t rate = ra->bytes * CLOCK_FREQ / busy;
+
+    ra->bytes = 0;
+    ra->busy = 0;
+    if (ra->active > 0)
+        ra->busy_since = mdate();
+
+    if (rate > ra->rate + ra->rate / 8)
+    {   /* Throughput improved: try one more connection */
+        ra->rate = rate;
+        if (ra->parallel < max)
+            ra->parallel++;
+    }
+    else if (rate < ra->rate - ra->rate / 4)
+    {   /* Throughput dropped: back off */
+        ra->rate = rate;
+        if (ra->parallel > 1)
+            ra->parallel--;
+    }
+
+    /* Aim for ranges lasting about one second each */
+    uint64_t window = rate / ra->parallel;
+    if (window < RA_WINDOW_MIN)
+        window = RA_WINDOW_MIN;
+    if (window > RA_WINDOW_MAX)
+        window = RA_WINDOW_MAX;
+    ra->window = window & ~(uint64_t)0xffff;
+
+    msg_Dbg(ra->obj, "read-ahead: %"PRIu64" kB/s, %u request(s) of %zu kB",
+            rate >> 10, ra->parallel, ra->window >> 10);
+}
+
+static bool vlc_http_readahead_can_request(const struct vlc_http_readahead *ra)
+{
+    return ra->next < ra->size && ra->active < ra->parallel
+        && ra->next - ra->offset < 2 * ra->parallel * ra->window;
+}
+
+/**
+ * Fetches a range. Called without the lock.
+ * @return true if the whole range was received
+ */
+static bool vlc_http_readahead_fetch(struct vlc_http_readahead_worker *w,
+                                     struct vlc_http_range *r)
+{
+    struct vlc_http_readahead *ra = w->ra;
+    const uintmax_t length = r->end - r->start;
+    uintmax_t received = 0;
+
+    if (vlc_http_file_seek_range(w->file, r->start, length)
+     || vlc_http_res_get_status(w->file) != 206)
+        return false;
+
+    while (received < length)
+    {
+        block_t *block = vlc_http_res_read(w->file);
+        if (block == NULL || block == vlc_http_error)
+            break;
+
+        if (block->i_buffer > length - received)
+            block->i_buffer = length - received;
+        received += block->i_buffer;
+
+        vlc_mutex_lock(&ra->lock);
+        if (r->cancelled)
+        {
+            vlc_mutex_unlock(&ra->lock);
+            block_Release(block);
+            break;
+        }
+        *(r->tailp) = block;
+        r->tailp = &block->p_next;
+        r->received = received;
+        ra->bytes += block->i_buffer;
+        vlc_cond_signal(&ra->wait_data);
+        vlc_mutex_unlock(&ra->lock);
+    }
+    return received == length;
+}
+
+static void *vlc_http_readahead_thread(void *data)
+{
+    struct vlc_http_readahead_worker *w = data;
+    struct vlc_http_readahead *ra = w->ra;
+    const unsigned max = ra->workerc;
+
+    vlc_mutex_lock(&ra->lock);
+    for (;;)
+    {
+        while (!ra->closing && !vlc_http_readahead_can_request(ra))
+            vlc_cond_wait(&ra->wait_worker, &ra->lock);
+        if (ra->closing)
+            break;
+
+        vlc_interrupt_t *ctx = vlc_interrupt_create();
+        struct vlc_http_range *r = malloc(sizeof (*r));
+        if (unlikely(ctx == NULL || r == NULL))
+        {
+            free(r);
+            if (ctx != NULL)
+                vlc_interrupt_destroy(ctx);
+            break;
+        }
+
+        r->next = NULL;
+        r->start = ra->next;
+        r->end = r->start + ra->window;
+        if (r->end > ra->size)
+            r->end = ra->size;
+        r->head = NULL;
+        r->tailp = &r->head;
+        r->received = 0;
+        r->done = r->failed = r->cancelled = false;
+
+        *(ra->tailp) = r;
+        ra->tailp = &r->next;
+        ra->next = r->end;
+
+        if (ra->active++ == 0)
+            ra->busy_since = mdate();
+        w->range = r;
+        w->interrupt = ctx;
+        vlc_mutex_unlock(&ra->lock);
+
+        vlc_interrupt_set(ctx);
+        bool ok = vlc_http_readahead_fetch(w, r);
+        vlc_interrupt_set(NULL);
+
+        /* Hand the range over to the list, or free it if it was dropped */
+        vlc_mutex_lock(&ra->lock);
+        w->range = NULL;
+        w->interrupt = NULL;
+        if (--ra->active == 0)
+            ra->busy += mdate() - ra->busy_since;
+        if (r->cancelled)
+            vlc_http_range_free(r);
+        else
+        {
+            r->done = true;
+            r->failed = !ok;
+            vlc_cond_signal(&ra->wait_data);
+            vlc_http_readahead_adapt(ra, max);
+        }
+        /* Another worker may be allowed to request a range now */
+        vlc_cond_signal(&ra->wait_worker);
+        vlc_mutex_unlock(&ra->lock);
+        vlc_interrupt_destroy(ctx);
+        vlc_mutex_lock(&ra->lock);
+    }
+    vlc_mutex_unlock(&ra->lock);
+    return NULL;
+}
+
+static void vlc_http_readahead_wake(void *data)
+{
+    struct vlc_http_readahead *ra = data;
+
+    vlc_mutex_lock(&ra->lock);
+    vlc_cond_broadcast(&ra->wait_data);
+    vlc_mutex_unlock(&ra->lock);
+}
+
+block_t *vlc_http_readahead_read(struct vlc_http_readahead *ra)
+{
+    block_t *block;
+
+    vlc_interrupt_register(vlc_http_readahead_wake, ra);
+    vlc_mutex_lock(&ra->lock);
+    for (;;)
+    {
+        if (ra->offset >= ra->size)
+        {
+            block = NULL; /* end of file */
+            break;
+        }
+
+        struct vlc_http_range *r = ra->ranges;
+        if (r != NULL)
+        {
+            assert(r->start <= ra->offset && ra->offset <= r->end);
+
+            if (r->head != NULL)
+            {
+                block = r->head;
+                r->head = block->p_next;
+                if (r->head == NULL)
+                    r->tailp = &r->head;
+                block->p_next = NULL;
+                ra->offset += block->i_buffer;
+                vlc_cond_signal(&ra->wait_worker);
+                break;
+            }
+
+            if (r->done)
+            {
+                if (r->failed)
+                {
+                    block = vlc_http_error;
+                    break;
+                }
+                ra->ranges = r->next;
+                if (ra->ranges == NULL)
+                    ra->tailp = &ra->ranges;
+                vlc_http_range_free(r);
+                continue;
+            }
+        }
+
+        if (vlc_killed())
+        {
+            block = vlc_http_error;
+            break;
+        }
+        vlc_cond_wait(&ra->wait_data, &ra->lock);
+    }
+    vlc_mutex_unlock(&ra->lock);
+    vlc_interrupt_unregister();
+    return block;
+}
+
+void vlc_http_readahead_seek(struct vlc_http_readahead *ra, uintmax_t offset)
+{
+    vlc_mutex_lock(&ra->lock);
+    /* Keep the ranges if the offset is within the first one */
+    struct vlc_http_range *r = ra->ranges;
+    if (r == NULL || offset < ra->offset || offset >= r->start + r->received)
+    {
+        vlc_http_readahead_cancel(ra);
+        ra->offset = ra->next = offset;
+    }
+    else
+    {   /* Skip already received data */
+        while (ra->offset < offset)
+        {
+            block_t *block = r->head;
+            size_t skip = offset - ra->offset;
+
+            if (block->i_buffer > skip)
+            {
+                block->p_buffer += skip;
+                block->i_buffer -= skip;
+                ra->offset = offset;
+                break;
+            }
+            ra->offset += block->i_buffer;
+            r->head = block->p_next;
+            if (r->head == NULL)
+                r->tailp = &r->head;
+            block_Release(block);
+        }
+    }
+    vlc_cond_broadcast(&ra->wait_worker);
+    vlc_mutex_unlock(&ra->lock);
+}
+
+struct vlc_http_readahead *vlc_http_readahead_create(vlc_object_t *obj,
+                                        struct vlc_http_resource *file,
+                                        bool h2c, uintmax_t offset,
+                                        unsigned max)
+{
+    uintmax_t size = vlc_http_file_get_size(file);
+    if (size == UINTMAX_MAX || max == 0)
+        return NULL;
+
+    struct vlc_http_readahead *ra =
+        malloc(sizeof (*ra) + max * sizeof (ra->workerv[0]));
+    if (unlikely(ra == NULL))
+        return NULL;
+
+    char *url;
+    if (asprintf(&url, "http%s://%s%s", file->secure ? "s" : "",
+                 file->authority, file->path) == -1)
+    {
+        free(ra);
+        return NULL;
+    }
+
+    ra->obj = obj;
+    ra->size = size;
+    ra->offset = ra->next = offset;
+    vlc_mutex_init(&ra->lock);
+    vlc_cond_init(&ra->wait_data);
+    vlc_cond_init(&ra->wait_worker);
+    ra->ranges = NULL;
+    ra->tailp = &ra->ranges;
+    ra->closing = false;
+    ra->parallel = (max < 2) ? max : 2;
+    ra->active = 0;
+    ra->window = RA_WINDOW_INIT;
+    ra->rate = 0;
+    ra->bytes = 0;
+    ra->busy = 0;
+    ra->workerc = 0;
+
+    /* Each worker has its own connections (from the shared pool) */
+    for (unsigned i = 0; i < max; i++)
+    {
+        struct vlc_http_readahead_worker *w = &ra->workerv[ra->workerc];
+
+        w->ra = ra;
+        w->range = NULL;
+        w->interrupt = NULL;
+        w->manager = vlc_http_mgr_create(obj,
+                                vlc_http_mgr_get_jar(file->manager), h2c);
+        if (unlikely(w->manager == NULL))
+            break;
+
+        w->file = vlc_http_file_create(w->manager, url, file->agent,
+                                       file->referrer);
+        if (unlikely(w->file == NULL))
+        {
+            vlc_http_mgr_destroy(w->manager);
+            break;
+        }
+        if (file->username != NULL)
+            vlc_http_res_set_login(w->file, file->username, file->password);
+
+        if (vlc_clone(&w->thread, vlc_http_readahead_thread, w,
+                      VLC_THREAD_PRIORITY_INPUT))
+        {
+            vlc_http_file_destroy(w->file);
+            vlc_http_mgr_destroy(w->manager);
+            break;
+        }
+        ra->workerc++;
+    }
+    free(url);
+
+    if (ra->workerc == 0)
+    {
+        vlc_cond_destroy(&ra->wait_worker);
+        vlc_cond_destroy(&ra->wait_data);
+        vlc_mutex_destroy(&ra->lock);
+        free(ra);
+        return NULL;
+    }
+    return ra;
+}
+
+void vlc_http_readahead_destroy(struct vlc_http_readahead *ra)
+{
+    vlc_mutex_lock(&ra->lock);
+    ra->closing = true;
+    vlc_http_readahead_cancel(ra);
+    vlc_cond_broadcast(&ra->wait_worker);
+    vlc_mutex_unlock(&ra->lock);
+
+    for (unsigned i = 0; i < ra->workerc; i++)
+    {
+        struct vlc_http_readahead_worker *w = &ra->workerv[i];
+
+        vlc_join(w->thread, NULL);
+        vlc_http_file_destroy(w->file);
+        vlc_http_mgr_destroy(w->manager);
+    }
+
+    assert(ra->ranges == NULL);
+    vlc_cond_destroy(&ra->wait_worker);
+    vlc_cond_destroy(&ra->wait_data);
+    vlc_mutex_destroy(&ra->lock);
+    free(ra);
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************
+ * readahead.h: HTTP parallel read-ahead declarations
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdint.h>
+
+/**
+ * \defgroup http_readahead Read-ahead
+ * Parallel read-ahead of HTTP files
+ * \ingroup http_file
+ *
+ * Reads the next windows of a seekable HTTP file with several concurrent
+ * range requests, and delivers the data in order. The number of concurrent
+ * requests and the size of the windows adapt to the measured throughput.
+ * @{
+ */
+
+struct vlc_http_readahead;
+struct vlc_http_resource;
+struct block_t;
+
+/**
+ * Starts reading ahead.
+ *
+ * @param obj parent VLC object
+ * @param file HTTP file to read ahead (its size must be known)
+ * @param h2c Favor unencrypted HTTP/2 over HTTP/1.1
+ * @param offset byte offset to start reading from
+ * @param max maximum number of concurrent requests
+ *
+ * @return a read-ahead object, or NULL on error
+ */
+struct vlc_http_readahead *vlc_http_readahead_create(vlc_object_t *obj,
+                                        struct vlc_http_resource *file,
+                                        bool h2c, uintmax_t offset,
+                                        unsigned max);
+
+/**
+ * Reads data.
+ *
+ * Waits for the data at the current offset, and updates the offset.
+ *
+ * @return a data block, NULL at the end of the file, or vlc_http_error if
+ * a request failed or if the calling thread was killed.
+ */
+struct block_t *vlc_http_readahead_read(struct vlc_http_readahead *);
+
+/**
+ * Sets the read offset.
+ *
+ * Outstanding requests are cancelled, and reading ahead restarts from the
+ * new offset.
+ */
+void vlc_http_readahead_seek(struct vlc_http_readahead *, uintmax_t offset);
+
+/**
+ * Stops reading ahead.
+ */
+void vlc_http_readahead_destroy(struct vlc_http_readahead *);
+
+/** @} */
@@ -0,0 +1,264 @@
+/*****************************************************************************
+ * readahead_test.c: HTTP parallel read-ahead tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_block.h>
+#include <vlc_interrupt.h>
+#include "message.h"
+#include "connmgr.h"
+#include "resource.h"
+#include "file.h"
+#include "readahead.h"
+
+#define FILE_SIZE (3 << 20)
+
+static struct vlc_object_t obj;
+static int error_loc;
+void *const vlc_http_error = &error_loc;
+
+static mtime_t read_delay = 0;
+static atomic_uint requests = ATOMIC_VAR_INIT(0);
+static atomic_uint files = ATOMIC_VAR_INIT(0);
+
+static uint8_t byte_at(uintmax_t offset)
+{
+    return offset % 251;
+}
+
+/* Mock resources: each file serves a range of a virtual file */
+
+struct test_file
+{
+    struct vlc_http_resource res;
+    uintmax_t offset;
+    uintmax_t end;
+};
+
+struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *o,
+                                         struct vlc_http_cookie_jar_t *jar,
+                                         bool h2c)
+{
+    (void) o; (void) jar; (void) h2c;
+    return malloc(1);
+}
+
+void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr)
+{
+    free(mgr);
+}
+
+struct vlc_http_cookie_jar_t *vlc_http_mgr_get_jar(struct vlc_http_mgr *mgr)
+{
+    (void) mgr;
+    return NULL;
+}
+
+struct vlc_http_resource *vlc_http_file_create(struct vlc_http_mgr *mgr,
+                                               const char *uri,
+                                               const char *ua,
+                                               const char *ref)
+{
+    struct test_file *f = calloc(1, sizeof (*f));
+    assert(f != NULL);
+
+    assert(!strcmp(uri, "http://www.example.com/file"));
+    (void) ua; (void) ref;
+    f->res.manager = mgr;
+    f->res.authority = (char *)"www.example.com";
+    f->res.path = (char *)"/file";
+    atomic_fetch_add(&files, 1);
+    return &f->res;
+}
+
+void vlc_http_file_destroy(struct vlc_http_resource *res)
+{
+    atomic_fetch_sub(&files, 1);
+    free(res);
+}
+
+uintmax_t vlc_http_file_get_size(struct vlc_http_resource *res)
+{
+    (void) res;
+    return FILE_SIZE;
+}
+
+int vlc_http_file_seek_range(struct vlc_http_resource *res, uintmax_t offset,
+                             uintmax_t length)
+{
+    struct test_file *f = (struct test_file *)res;
+
+    assert(offset + length <= FILE_SIZE);
+    f->offset = offset;
+    f->end = offset + length;
+    atomic_fetch_add(&requests, 1);
+    return 0;
+}
+
+int vlc_http_res_get_status(struct vlc_http_resource *res)
+{
+    (void) res;
+    return 206;
+}
+
+int vlc_http_res_set_login(struct vlc_http_resource *res,
+                           const char *username, const char *password)
+{
+    (void) res; (void) username; (void) password;
+    return 0;
+}
+
+block_t *vlc_http_res_read(struct vlc_http_resource *res)
+{
+    struct test_file *f = (struct test_file *)res;
+
+    if (read_delay > 0)
+        msleep(read_delay);
+    if (vlc_killed())
+        return vlc_http_error;
+    if (f->offset >= f->end)
+        return NULL;
+
+    size_t len = f->end - f->offset;
+    if (len > 16384)
+        len = 16384;
+
+    block_t *block = block_Alloc(len);
+    assert(block != NULL);
+    for (size_t i = 0; i < len; i++)
+        block->p_buffer[i] = byte_at(f->offset + i);
+    f->offset += len;
+    return block;
+}
+
+static void check_block(block_t *block, uintmax_t offset)
+{
+    assert(block != NULL && block != vlc_http_error);
+    assert(block->i_buffer > 0);
+    for (size_t i = 0; i < block->i_buffer; i++)
+        assert(block->p_buffer[i] == byte_at(offset + i));
+}
+
+/** Reads until the end of the file, from a given offset. */
+static void read_all(struct vlc_http_readahead *ra, uintmax_t offset)
+{
+    block_t *block;
+
+    while ((block = vlc_http_readahead_read(ra)) != NULL)
+    {
+        check_block(block, offset);
+        offset += block->i_buffer;
+        block_Release(block);
+    }
+    assert(offset == FILE_SIZE);
+}
+
+int main(void)
+{
+    struct vlc_http_resource *file;
+    struct vlc_http_readahead *ra;
+    block_t *block;
+
+    obj.obj.flags = OBJECT_FLAGS_QUIET;
+
+    file = vlc_http_file_create(NULL, "http://www.example.com/file",
+                                NULL, NULL);
+    assert(file != NULL);
+
+    /* No workers */
+    assert(vlc_http_readahead_create(&obj, file, false, 0, 0) == NULL);
+
+    /* Sequential read */
+    ra = vlc_http_readahead_create(&obj, file, false, 0, 4);
+    assert(ra != NULL);
+    read_all(ra, 0);
+    assert(vlc_http_readahead_read(ra) == NULL);
+    vlc_http_readahead_destroy(ra);
+    assert(atomic_load(&requests) > 0);
+
+    /* Read from an offset */
+    ra = vlc_http_readahead_create(&obj, file, false, FILE_SIZE - 12345, 2);
+    assert(ra != NULL);
+    read_all(ra, FILE_SIZE - 12345);
+    vlc_http_readahead_destroy(ra);
+
+    /* Seeks within and outside of the received data */
+    ra = vlc_http_readahead_create(&obj, file, false, 0, 3);
+    assert(ra != NULL);
+    block = vlc_http_readahead_read(ra);
+    check_block(block, 0);
+    block_Release(block);
+    vlc_http_readahead_seek(ra, 1000);
+    block = vlc_http_readahead_read(ra);
+    check_block(block, 1000);
+    block_Release(block);
+    vlc_http_readahead_seek(ra, FILE_SIZE / 2 + 1);
+    read_all(ra, FILE_SIZE / 2 + 1);
+    vlc_http_readahead_seek(ra, 7);
+    read_all(ra, 7);
+    vlc_http_readahead_destroy(ra);
+
+    /* Seeks and destruction while ranges are being fetched and completed */
+    read_delay = 100;
+    for (unsigned i = 0; i < 200; i++)
+    {
+        uintmax_t offset = ((uintmax_t)i * 104729) % FILE_SIZE;
+
+        ra = vlc_http_readahead_create(&obj, file, false, offset, 4);
+        assert(ra != NULL);
+
+        for (unsigned j = 0; j < i % 8; j++)
+        {
+            block = vlc_http_readahead_read(ra);
+            check_block(block, offset);
+            block_Release(block);
+
+            offset = (offset * 31 + 4099) % FILE_SIZE;
+            vlc_http_readahead_seek(ra, offset);
+        }
+        vlc_http_readahead_destroy(ra);
+    }
+
+    /* Ranges completed while the reader is waiting for them */
+    read_delay = 0;
+    for (unsigned i = 0; i < 100; i++)
+    {
+        ra = vlc_http_readahead_create(&obj, file, false, 0, 4);
+        assert(ra != NULL);
+        read_all(ra, 0);
+        vlc_http_readahead_destroy(ra);
+    }
+
+    vlc_http_file_destroy(file);
+    assert(atomic_load(&files) == 0);
+    return 0;
+}
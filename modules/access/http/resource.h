@@ -56,6 +56,7 @@ struct vlc_http_resource
     char *password;
     char *agent;
     char *referrer;
+    unsigned weight; /**< HTTP/2 stream weight, or 0 for the default */
 };
 
 int vlc_http_res_init(struct vlc_http_resource *,
@@ -43,6 +43,8 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_charset.h>
+#include <vlc_httpd.h>
+#include <vlc_memstream.h>
 
 #include <gcrypt.h>
 #include <vlc_gcrypt.h>
@@ -57,6 +59,9 @@
 
 #define MAX_RENAME_RETRIES        10
 
+/* largest piece of a segment handed to the HTTP server at once */
+#define HTTPD_CHUNK_SIZE          65536
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -105,6 +110,12 @@ static void Close( vlc_object_t * );
 #define INTITIAL_SEG_TEXT N_("Number of first segment")
 #define INITIAL_SEG_LONGTEXT N_("The number of the first segment generated")
 
+#define HTTPD_TEXT N_("Serve segments over HTTP")
+#define HTTPD_LONGTEXT N_("Keep the segments and the index in memory and "\
+                          "serve them with the built-in HTTP server, instead "\
+                          "of writing them to files. The segment path and the "\
+                          "index are then URL paths on the server.")
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -135,6 +146,8 @@ vlc_module_begin ()
                 KEYFILE_TEXT, KEYFILE_LONGTEXT, true )
     add_loadfile( SOUT_CFG_PREFIX "key-loadfile", NULL,
                 KEYLOADFILE_TEXT, KEYLOADFILE_LONGTEXT, true )
+    add_bool( SOUT_CFG_PREFIX "httpd", false,
+              HTTPD_TEXT, HTTPD_LONGTEXT, true )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -156,6 +169,7 @@ static const char *const ppsz_sout_options[] = {
     "key-loadfile",
     "generate-iv",
     "initial-segment-number",
+    "httpd",
     NULL
 };
 
@@ -172,6 +186,14 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+
+    /* segment kept in memory, data is protected by the owner lock */
+    sout_access_out_sys_t *p_owner;
+    httpd_url_t *p_url;
+    uint8_t *p_data;
+    size_t i_data;
+    size_t i_size;
+    bool b_complete;
 } output_segment_t;
 
 struct sout_access_out_sys_t
@@ -200,12 +222,26 @@ struct sout_access_out_sys_t
     bool b_caching;
     bool b_generate_iv;
     bool b_segment_has_data;
+    bool b_segment_open;
     uint8_t aes_ivs[16];
     gcry_cipher_hd_t aes_ctx;
     char *key_uri;
     uint8_t stuffing_bytes[16];
     ssize_t stuffing_size;
     vlc_array_t *segments_t;
+
+    /* fragmented MP4 initialization segment */
+    block_t *p_init;
+    char *psz_initPath;
+    char *psz_initUri;
+
+    /* serving from memory */
+    httpd_host_t *p_httpd_host;
+    httpd_file_t *p_httpd_index;
+    httpd_file_t *p_httpd_init;
+    vlc_mutex_t lock;
+    char *psz_index;
+    size_t i_index;
 };
 
 static int LoadCryptFile( sout_access_out_t *p_access);
@@ -213,6 +249,53 @@ static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static int IndexFill( httpd_file_sys_t *, httpd_file_t *, uint8_t *, uint8_t **, int * );
+
+/*****************************************************************************
+ * OpenHttpd: start serving the index from memory
+ *****************************************************************************/
+static int OpenHttpd( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
+{
+    if( p_access->psz_path[0] != '/' ||
+        ( p_sys->psz_indexPath && p_sys->psz_indexPath[0] != '/' ) )
+    {
+        msg_Err( p_access, "segment and index paths must be URL paths" );
+        return VLC_EGENERIC;
+    }
+
+    /* segments leave the memory when they leave the index */
+    if( p_sys->i_numsegs == 0 )
+    {
+        msg_Err( p_access, "number of segments is needed to serve from memory" );
+        return VLC_EGENERIC;
+    }
+
+    p_sys->p_httpd_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+    if( p_sys->p_httpd_host == NULL )
+    {
+        msg_Err( p_access, "cannot start HTTP server" );
+        return VLC_EGENERIC;
+    }
+
+    if( p_sys->psz_indexPath )
+    {
+        p_sys->p_httpd_index = httpd_FileNew( p_sys->p_httpd_host,
+                                              p_sys->psz_indexPath,
+                                              "application/vnd.apple.mpegurl",
+                                              NULL, NULL, IndexFill,
+                                              (httpd_file_sys_t *)p_sys );
+        if( p_sys->p_httpd_index == NULL )
+        {
+            httpd_HostDelete( p_sys->p_httpd_host );
+            p_sys->p_httpd_host = NULL;
+            return VLC_EGENERIC;
+        }
+    }
+
+    msg_Dbg( p_access, "serving segments %s from memory", p_access->psz_path );
+    return VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -251,8 +334,12 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_caching = var_GetBool( p_access, SOUT_CFG_PREFIX "caching") ;
     p_sys->b_generate_iv = var_GetBool( p_access, SOUT_CFG_PREFIX "generate-iv") ;
     p_sys->b_segment_has_data = false;
+    p_sys->b_segment_open = false;
 
     p_sys->segments_t = vlc_array_new();
+    vlc_mutex_init( &p_sys->lock );
+
+    bool b_httpd = var_GetBool( p_access, SOUT_CFG_PREFIX "httpd" );
 
     p_sys->stuffing_size = 0;
     p_sys->i_opendts = VLC_TS_INVALID;
@@ -267,11 +354,13 @@ static int Open( vlc_object_t *p_this )
         free( psz_idx );
         if ( !psz_tmp )
         {
+            vlc_array_destroy( p_sys->segments_t );
+            vlc_mutex_destroy( &p_sys->lock );
             free( p_sys );
             return VLC_ENOMEM;
         }
         p_sys->psz_indexPath = psz_tmp;
-        if( p_sys->i_initial_segment != 1 )
+        if( p_sys->i_initial_segment != 1 && !b_httpd )
             vlc_unlink( p_sys->psz_indexPath );
     }
 
@@ -281,16 +370,25 @@ static int Open( vlc_object_t *p_this )
 
     p_access->p_sys = p_sys;
 
-    if( p_sys->psz_keyfile && ( LoadCryptFile( p_access ) < 0 ) )
+    if( b_httpd && OpenHttpd( p_access, p_sys ) )
     {
+        vlc_array_destroy( p_sys->segments_t );
+        vlc_mutex_destroy( &p_sys->lock );
         free( p_sys->psz_indexUrl );
         free( p_sys->psz_indexPath );
         free( p_sys );
-        msg_Err( p_access, "Encryption init failed" );
         return VLC_EGENERIC;
     }
-    else if( !p_sys->psz_keyfile && ( CryptSetup( p_access, NULL ) < 0 ) )
+
+    if( ( p_sys->psz_keyfile && ( LoadCryptFile( p_access ) < 0 ) ) ||
+        ( !p_sys->psz_keyfile && ( CryptSetup( p_access, NULL ) < 0 ) ) )
     {
+        if( p_sys->p_httpd_index )
+            httpd_FileDelete( p_sys->p_httpd_index );
+        if( p_sys->p_httpd_host )
+            httpd_HostDelete( p_sys->p_httpd_host );
+        vlc_array_destroy( p_sys->segments_t );
+        vlc_mutex_destroy( &p_sys->lock );
         free( p_sys->psz_indexUrl );
         free( p_sys->psz_indexPath );
         free( p_sys );
@@ -506,8 +604,40 @@ static char *formatSegmentPath( char *psz_path, uint32_t i_seg )
     return psz_result;
 }
 
+/*****************************************************************************
+ * formatInitPath: create initialization segment path name, with "init" in
+ * place of the segment number
+ *****************************************************************************/
+static char *formatInitPath( char *psz_path )
+{
+    char *psz_result;
+
+    if ( ! ( psz_result  = vlc_strftime( psz_path ) ) )
+        return NULL;
+
+    char *psz_firstNumSign = psz_result + strcspn( psz_result, SEG_NUMBER_PLACEHOLDER );
+    char *psz_newResult;
+    int ret;
+
+    if ( *psz_firstNumSign )
+    {
+        int i_cnt = strspn( psz_firstNumSign, SEG_NUMBER_PLACEHOLDER );
+
+        *psz_firstNumSign = '\0';
+        ret = asprintf( &psz_newResult, "%sinit%s", psz_result, psz_firstNumSign + i_cnt );
+    }
+    else
+        ret = asprintf( &psz_newResult, "%s.init", psz_result );
+
+    free( psz_result );
+    return ret < 0 ? NULL : psz_newResult;
+}
+
 static void destroySegment( output_segment_t *segment )
 {
+    if( segment->p_url )
+        httpd_UrlDelete( segment->p_url );
+    free( segment->p_data );
     free( segment->psz_filename );
     free( segment->psz_duration );
     free( segment->psz_uri );
@@ -557,6 +687,109 @@ static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_first
     return duration >= (first->f_seglength + (float)(p_sys->i_numsegs * p_sys->i_seglen));
 }
 
+/************************************************************************
+ * formatIndex: print the index of segments i_firstseg to p_sys->i_segment
+ ************************************************************************/
+static int formatIndex( sout_access_out_sys_t *p_sys, struct vlc_memstream *ms,
+                        uint32_t i_firstseg, unsigned i_index_offset, bool b_isend )
+{
+    if ( vlc_memstream_open( ms ) )
+        return -1;
+
+    vlc_memstream_printf( ms, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:%d\n#EXT-X-ALLOW-CACHE:%s"
+                          "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
+                          p_sys->psz_initUri ? 6 : 3,
+                          p_sys->b_caching ? "YES" : "NO",
+                          p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
+                          i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
+                          );
+
+    if ( p_sys->psz_initUri )
+        vlc_memstream_printf( ms, "#EXT-X-MAP:URI=\"%s\"\n", p_sys->psz_initUri );
+
+    const char *psz_current_uri = NULL;
+
+    for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+    {
+        //scale to i_index_offset..numsegs + i_index_offset
+        uint32_t index = i - i_firstseg + i_index_offset;
+
+        output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, index );
+        if( p_sys->key_uri &&
+            ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
+          )
+        {
+            psz_current_uri = segment->psz_key_uri;
+            if( p_sys->b_generate_iv )
+            {
+                unsigned long long iv_hi = segment->aes_ivs[0];
+                unsigned long long iv_lo = segment->aes_ivs[8];
+                for( unsigned short i = 1; i < 8; i++ )
+                {
+                    iv_hi <<= 8;
+                    iv_hi |= segment->aes_ivs[i] & 0xff;
+                    iv_lo <<= 8;
+                    iv_lo |= segment->aes_ivs[8+i] & 0xff;
+                }
+                vlc_memstream_printf( ms, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
+                                      segment->psz_key_uri, iv_hi, iv_lo );
+
+            } else {
+                vlc_memstream_printf( ms, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
+            }
+        }
+
+        vlc_memstream_printf( ms, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri );
+    }
+
+    if ( b_isend )
+        vlc_memstream_puts( ms, STR_ENDLIST );
+
+    return vlc_memstream_close( ms );
+}
+
+/************************************************************************
+ * writeIndex: replace the index file
+ ************************************************************************/
+static int writeIndex( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys,
+                       const char *psz_index, size_t i_index )
+{
+    int val;
+    FILE *fp;
+    char *psz_idxTmp;
+    if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
+        return -1;
+
+    fp = vlc_fopen( psz_idxTmp, "wt");
+    if ( !fp )
+    {
+        msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
+        free( psz_idxTmp );
+        return -1;
+    }
+
+    if ( fwrite( psz_index, 1, i_index, fp ) != i_index )
+    {
+        free( psz_idxTmp );
+        fclose( fp );
+        return -1;
+    }
+    fclose( fp );
+
+    val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+
+    if ( val < 0 )
+    {
+        vlc_unlink( psz_idxTmp );
+        msg_Err( p_access, "Error moving LiveHttp index file" );
+    }
+    else
+        msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+
+    free( psz_idxTmp );
+    return 0;
+}
+
 /************************************************************************
  * updateIndexAndDel: If necessary, update index file & delete old segments
  ************************************************************************/
@@ -581,112 +814,31 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
     // First update index
     if ( p_sys->psz_indexPath )
     {
-        int val;
-        FILE *fp;
-        char *psz_idxTmp;
-        if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
-            return -1;
+        struct vlc_memstream ms;
 
-        fp = vlc_fopen( psz_idxTmp, "wt");
-        if ( !fp )
-        {
-            msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
-            free( psz_idxTmp );
+        if ( formatIndex( p_sys, &ms, i_firstseg, i_index_offset, b_isend ) )
             return -1;
-        }
 
-        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:3\n#EXT-X-ALLOW-CACHE:%s"
-                          "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
-                          p_sys->b_caching ? "YES" : "NO",
-                          p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
-                          i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
-                          ) < 0 )
+        if ( p_sys->p_httpd_host )
         {
-            free( psz_idxTmp );
-            fclose( fp );
-            return -1;
+            vlc_mutex_lock( &p_sys->lock );
+            free( p_sys->psz_index );
+            p_sys->psz_index = ms.ptr;
+            p_sys->i_index = ms.length;
+            vlc_mutex_unlock( &p_sys->lock );
         }
-        char *psz_current_uri=NULL;
-
-
-        for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+        else if ( writeIndex( p_access, p_sys, ms.ptr, ms.length ) )
         {
-            //scale to i_index_offset..numsegs + i_index_offset
-            uint32_t index = i - i_firstseg + i_index_offset;
-
-            output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, index );
-            if( p_sys->key_uri &&
-                ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
-              )
-            {
-                int ret = 0;
-                free( psz_current_uri );
-                psz_current_uri = strdup( segment->psz_key_uri );
-                if( p_sys->b_generate_iv )
-                {
-                    unsigned long long iv_hi = segment->aes_ivs[0];
-                    unsigned long long iv_lo = segment->aes_ivs[8];
-                    for( unsigned short i = 1; i < 8; i++ )
-                    {
-                        iv_hi <<= 8;
-                        iv_hi |= segment->aes_ivs[i] & 0xff;
-                        iv_lo <<= 8;
-                        iv_lo |= segment->aes_ivs[8+i] & 0xff;
-                    }
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
-                                   segment->psz_key_uri, iv_hi, iv_lo );
-
-                } else {
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
-                }
-                if( ret < 0 )
-                {
-                    free( psz_current_uri );
-                    free( psz_idxTmp );
-                    fclose( fp );
-                    return -1;
-                }
-            }
-
-            val = fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri);
-            if ( val < 0 )
-            {
-                free( psz_current_uri );
-                free( psz_idxTmp );
-                fclose( fp );
-                return -1;
-            }
-        }
-        free( psz_current_uri );
-
-        if ( b_isend )
-        {
-            if ( fputs ( STR_ENDLIST, fp ) < 0)
-            {
-                free( psz_idxTmp );
-                fclose( fp ) ;
-                return -1;
-            }
-
-        }
-        fclose( fp );
-
-        val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
-
-        if ( val < 0 )
-        {
-            vlc_unlink( psz_idxTmp );
-            msg_Err( p_access, "Error moving LiveHttp index file" );
+            free( ms.ptr );
+            return -1;
         }
         else
-            msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
-
-        free( psz_idxTmp );
+            free( ms.ptr );
     }
 
     // Then take care of deletion
     // Try to follow pantos draft 11 section 6.2.2
-    while( p_sys->b_delsegs && p_sys->i_numsegs &&
+    while( ( p_sys->b_delsegs || p_sys->p_httpd_host ) && p_sys->i_numsegs &&
            isFirstItemRemovable( p_sys, i_firstseg, i_index_offset )
          )
     {
@@ -694,7 +846,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
          msg_Dbg( p_access, "Removing segment number %d", segment->i_segment_number );
          vlc_array_remove( p_sys->segments_t, 0 );
 
-         if ( segment->psz_filename )
+         if ( segment->psz_filename && !p_sys->p_httpd_host )
          {
              vlc_unlink( segment->psz_filename );
          }
@@ -707,12 +859,48 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
     return 0;
 }
 
+/*****************************************************************************
+ * segmentWrite: append to the current segment
+ *****************************************************************************/
+static ssize_t segmentWrite( sout_access_out_sys_t *p_sys, const uint8_t *p_buf, size_t i_buf )
+{
+    if( !p_sys->p_httpd_host )
+        return vlc_write( p_sys->i_handle, p_buf, i_buf );
+
+    output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, vlc_array_count( p_sys->segments_t ) - 1 );
+    ssize_t i_ret = i_buf;
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( segment->i_data + i_buf > segment->i_size )
+    {
+        size_t i_size = __MAX( segment->i_size * 2, segment->i_data + i_buf );
+        uint8_t *p_data = realloc( segment->p_data, i_size );
+        if( likely( p_data ) )
+        {
+            segment->p_data = p_data;
+            segment->i_size = i_size;
+        }
+        else
+        {
+            errno = ENOMEM;
+            i_ret = -1;
+        }
+    }
+    if( i_ret > 0 )
+    {
+        memcpy( &segment->p_data[segment->i_data], p_buf, i_buf );
+        segment->i_data += i_buf;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return i_ret;
+}
+
 /*****************************************************************************
  * closeCurrentSegment: Close the segment file
  *****************************************************************************/
 static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
 {
-    if ( p_sys->i_handle >= 0 )
+    if ( p_sys->b_segment_open )
     {
         output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, vlc_array_count( p_sys->segments_t ) - 1 );
 
@@ -726,7 +914,7 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
                msg_Err( p_access, "Couldn't encrypt 16 bytes: %s", gpg_strerror(err) );
             } else {
 
-            int ret = vlc_write( p_sys->i_handle, p_sys->stuffing_bytes, 16 );
+            ssize_t ret = segmentWrite( p_sys, p_sys->stuffing_bytes, 16 );
             if( ret != 16 )
                 msg_Err( p_access, "Couldn't write 16 bytes" );
             }
@@ -734,8 +922,18 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
         }
 
 
-        vlc_close( p_sys->i_handle );
-        p_sys->i_handle = -1;
+        if( p_sys->p_httpd_host )
+        {
+            vlc_mutex_lock( &p_sys->lock );
+            segment->b_complete = true;
+            vlc_mutex_unlock( &p_sys->lock );
+        }
+        else
+        {
+            vlc_close( p_sys->i_handle );
+            p_sys->i_handle = -1;
+        }
+        p_sys->b_segment_open = false;
 
         if( ! ( us_asprintf( &segment->psz_duration, "%.2f", p_sys->f_seglen ) ) )
         {
@@ -806,11 +1004,18 @@ static void Close( vlc_object_t * p_this )
         free( p_sys->key_uri );
     }
 
+    /* no more requests past this point */
+    if( p_sys->p_httpd_index )
+        httpd_FileDelete( p_sys->p_httpd_index );
+    if( p_sys->p_httpd_init )
+        httpd_FileDelete( p_sys->p_httpd_init );
+
     while( vlc_array_count( p_sys->segments_t ) > 0 )
     {
         output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, 0 );
         vlc_array_remove( p_sys->segments_t, 0 );
-        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename )
+        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename &&
+            !p_sys->p_httpd_host )
         {
             msg_Dbg( p_access, "Removing segment number %d name %s", segment->i_segment_number, segment->psz_filename );
             vlc_unlink( segment->psz_filename );
@@ -820,6 +1025,15 @@ static void Close( vlc_object_t * p_this )
     }
     vlc_array_destroy( p_sys->segments_t );
 
+    if( p_sys->p_httpd_host )
+        httpd_HostDelete( p_sys->p_httpd_host );
+    vlc_mutex_destroy( &p_sys->lock );
+
+    if( p_sys->p_init )
+        block_Release( p_sys->p_init );
+    free( p_sys->psz_initPath );
+    free( p_sys->psz_initUri );
+    free( p_sys->psz_index );
     free( p_sys->psz_indexUrl );
     free( p_sys->psz_indexPath );
     free( p_sys );
@@ -847,12 +1061,133 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * IndexFill: send the index from memory
+ *****************************************************************************/
+static int IndexFill( httpd_file_sys_t *data, httpd_file_t *file,
+                      uint8_t *psz_request, uint8_t **pp_data, int *pi_data )
+{
+    sout_access_out_sys_t *p_sys = (sout_access_out_sys_t *)data;
+    (void) file; (void) psz_request;
+
+    vlc_mutex_lock( &p_sys->lock );
+    *pp_data = p_sys->i_index ? malloc( p_sys->i_index ) : NULL;
+    *pi_data = *pp_data ? p_sys->i_index : 0;
+    if( *pp_data )
+        memcpy( *pp_data, p_sys->psz_index, p_sys->i_index );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * InitFill: send the initialization segment from memory
+ *****************************************************************************/
+static int InitFill( httpd_file_sys_t *data, httpd_file_t *file,
+                     uint8_t *psz_request, uint8_t **pp_data, int *pi_data )
+{
+    sout_access_out_sys_t *p_sys = (sout_access_out_sys_t *)data;
+    (void) file; (void) psz_request;
+
+    vlc_mutex_lock( &p_sys->lock );
+    *pp_data = malloc( p_sys->p_init->i_buffer );
+    *pi_data = *pp_data ? p_sys->p_init->i_buffer : 0;
+    if( *pp_data )
+        memcpy( *pp_data, p_sys->p_init->p_buffer, p_sys->p_init->i_buffer );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * SegmentCallback: send a segment from memory
+ *
+ * A segment that is still being written is sent with chunked transfer coding
+ * as its data comes in. The body offset is one past the position in the
+ * segment, as httpd takes a null offset as the end of the answer.
+ *****************************************************************************/
+static int SegmentCallback( httpd_callback_sys_t *data, httpd_client_t *cl,
+                            httpd_message_t *answer, const httpd_message_t *query )
+{
+    output_segment_t *segment = (output_segment_t *)data;
+    sout_access_out_sys_t *p_sys = segment->p_owner;
+
+    if( answer == NULL || query == NULL || cl == NULL )
+        return VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_sys->lock );
+
+    if( answer->i_body_offset > 0 )
+    {
+        size_t i_pos = answer->i_body_offset - 1;
+        size_t i_write = __MIN( segment->i_data - i_pos, HTTPD_CHUNK_SIZE );
+
+        if( i_write == 0 && !segment->b_complete )
+        {
+            vlc_mutex_unlock( &p_sys->lock );
+            return VLC_EGENERIC; /* wait for more data */
+        }
+
+        answer->i_proto  = HTTPD_PROTO_HTTP;
+        answer->i_version= 1;
+        answer->i_type   = HTTPD_MSG_ANSWER;
+
+        if( i_write > 0 )
+        {
+            answer->p_body = xmalloc( i_write );
+            answer->i_body = i_write;
+            memcpy( answer->p_body, &segment->p_data[i_pos], i_write );
+        }
+
+        if( segment->b_complete && i_pos + i_write == segment->i_data )
+            answer->i_body_offset = 0;
+        else
+            answer->i_body_offset += i_write;
+
+        vlc_mutex_unlock( &p_sys->lock );
+        return VLC_SUCCESS;
+    }
+
+    answer->i_proto  = HTTPD_PROTO_HTTP;
+    answer->i_version= 1;
+    answer->i_type   = HTTPD_MSG_ANSWER;
+    answer->i_status = 200;
+
+    httpd_MsgAdd( answer, "Content-Type", "%s",
+                  p_sys->p_init ? "video/mp4" : "video/MP2T" );
+
+    if( segment->b_complete )
+    {
+        httpd_MsgAdd( answer, "Content-Length", "%zu", segment->i_data );
+        if( query->i_type != HTTPD_MSG_HEAD && segment->i_data > 0 )
+        {
+            answer->p_body = xmalloc( segment->i_data );
+            answer->i_body = segment->i_data;
+            memcpy( answer->p_body, segment->p_data, segment->i_data );
+        }
+    }
+    else if( query->i_version == 0 )
+    {
+        /* no chunked transfer coding in HTTP/1.0, as if not written yet */
+        answer->i_status = 404;
+        httpd_MsgAdd( answer, "Content-Length", "0" );
+    }
+    else if( query->i_type != HTTPD_MSG_HEAD )
+    {
+        httpd_MsgAdd( answer, "Transfer-Encoding", "chunked" );
+        answer->i_body_offset = 1;
+    }
+
+    vlc_mutex_unlock( &p_sys->lock );
+    return VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * openNextFile: Open the segment file
  *****************************************************************************/
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
 {
-    int fd;
+    int fd = -1;
 
     uint32_t i_newseg = p_sys->i_segment + 1;
 
@@ -873,14 +1208,35 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
     }
 
-    fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
-                     O_TRUNC, 0666 );
-    if ( fd == -1 )
+    if ( p_sys->p_httpd_host )
     {
-        msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
-                 vlc_strerror_c(errno) );
-        destroySegment( segment );
-        return -1;
+        /* the segment can be requested from now on, and is then sent while
+         * it is being written */
+        segment->p_owner = p_sys;
+        segment->p_url = httpd_UrlNew( p_sys->p_httpd_host, segment->psz_filename,
+                                       NULL, NULL );
+        if ( segment->p_url == NULL )
+        {
+            msg_Err( p_access, "cannot serve `%s'", segment->psz_filename );
+            destroySegment( segment );
+            return -1;
+        }
+        httpd_UrlCatch( segment->p_url, HTTPD_MSG_HEAD, SegmentCallback,
+                        (httpd_callback_sys_t *)segment );
+        httpd_UrlCatch( segment->p_url, HTTPD_MSG_GET, SegmentCallback,
+                        (httpd_callback_sys_t *)segment );
+    }
+    else
+    {
+        fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
+                         O_TRUNC, 0666 );
+        if ( fd == -1 )
+        {
+            msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
+                     vlc_strerror_c(errno) );
+            destroySegment( segment );
+            return -1;
+        }
     }
 
     vlc_array_append( p_sys->segments_t, segment);
@@ -903,7 +1259,8 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
     p_sys->i_handle = fd;
     p_sys->i_segment = i_newseg;
     p_sys->b_segment_has_data = false;
-    return fd;
+    p_sys->b_segment_open = true;
+    return VLC_SUCCESS;
 }
 /*****************************************************************************
  * CheckSegmentChange: Check if segment needs to be closed and new opened
@@ -913,7 +1270,7 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     ssize_t writevalue = 0;
 
-    if( p_sys->i_handle > 0 && p_sys->b_segment_has_data &&
+    if( p_sys->b_segment_open && p_sys->b_segment_has_data &&
        (( p_buffer->i_length + p_buffer->i_dts - p_sys->i_opendts ) >= p_sys->i_seglenm ) )
     {
         writevalue = writeSegment( p_access );
@@ -926,7 +1283,7 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
         return writevalue;
     }
 
-    if ( unlikely( p_sys->i_handle < 0 ) )
+    if ( unlikely( !p_sys->b_segment_open ) )
     {
         p_sys->i_opendts = p_buffer->i_dts;
 
@@ -993,7 +1350,7 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
 
         }
 
-        ssize_t val = vlc_write( p_sys->i_handle, output->p_buffer, output->i_buffer );
+        ssize_t val = segmentWrite( p_sys, output->p_buffer, output->i_buffer );
         if ( val == -1 )
         {
            if ( errno == EINTR )
@@ -1001,9 +1358,10 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
            return -1;
         }
 
-        p_sys->f_seglen =
-            (float)(output_last_length +
-                    output->i_dts - p_sys->i_opendts) / CLOCK_FREQ;
+        if( output->i_dts > VLC_TS_INVALID )
+            p_sys->f_seglen =
+                (float)(output_last_length +
+                        output->i_dts - p_sys->i_opendts) / CLOCK_FREQ;
 
         if ( (size_t)val >= output->i_buffer )
         {
@@ -1022,6 +1380,64 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
     return i_write;
 }
 
+/*****************************************************************************
+ * setInitSegment: keep the fragmented MP4 header, referenced by the index
+ *****************************************************************************/
+static int setInitSegment( sout_access_out_t *p_access, block_t *p_init )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( !p_sys->psz_initPath )
+    {
+        char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
+        p_sys->psz_initPath = formatInitPath( p_access->psz_path );
+        p_sys->psz_initUri = formatInitPath( psz_idxFormat );
+        if( unlikely( !p_sys->psz_initPath || !p_sys->psz_initUri ) )
+        {
+            block_Release( p_init );
+            return -1;
+        }
+    }
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( p_sys->p_init )
+        block_Release( p_sys->p_init );
+    p_sys->p_init = p_init;
+    vlc_mutex_unlock( &p_sys->lock );
+
+    if( p_sys->p_httpd_host )
+    {
+        if( !p_sys->p_httpd_init )
+            p_sys->p_httpd_init = httpd_FileNew( p_sys->p_httpd_host,
+                                                 p_sys->psz_initPath, "video/mp4",
+                                                 NULL, NULL, InitFill,
+                                                 (httpd_file_sys_t *)p_sys );
+        if( !p_sys->p_httpd_init )
+        {
+            msg_Err( p_access, "cannot serve `%s'", p_sys->psz_initPath );
+            return -1;
+        }
+        return 0;
+    }
+
+    int fd = vlc_open( p_sys->psz_initPath, O_WRONLY | O_CREAT | O_LARGEFILE |
+                         O_TRUNC, 0666 );
+    if( fd == -1 )
+    {
+        msg_Err( p_access, "cannot open `%s' (%s)", p_sys->psz_initPath,
+                 vlc_strerror_c(errno) );
+        return -1;
+    }
+    ssize_t val = vlc_write( fd, p_init->p_buffer, p_init->i_buffer );
+    vlc_close( fd );
+    if( val < 0 || (size_t)val != p_init->i_buffer )
+    {
+        msg_Err( p_access, "cannot write `%s'", p_sys->psz_initPath );
+        return -1;
+    }
+    return 0;
+}
+
 /*****************************************************************************
  * Write: standard write on a file descriptor.
  *****************************************************************************/
@@ -1031,10 +1447,29 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     while( p_buffer )
     {
+        /* Fragmented MP4 header goes to its own initialization segment,
+           and fragments are then split on the moof boxes */
+        if( ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) && p_buffer->i_buffer >= 8 &&
+            !memcmp( &p_buffer->p_buffer[4], "ftyp", 4 ) )
+        {
+            block_t *p_temp = p_buffer->p_next;
+            p_buffer->p_next = NULL;
+            if( setInitSegment( p_access, p_buffer ) )
+            {
+                block_ChainRelease( p_temp );
+                return -1;
+            }
+            p_buffer = p_temp;
+            continue;
+        }
+
+        bool b_split = p_sys->p_init ? ( p_buffer->i_flags & BLOCK_FLAG_TYPE_I )
+                     : p_sys->b_splitanywhere || ( p_buffer->i_flags & BLOCK_FLAG_HEADER );
+
         /* Check if current block is already past segment-length
             and we want to write gathered blocks into segment
             and update playlist */
-        if( p_sys->ongoing_segment && ( p_sys->b_splitanywhere  || ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) ) )
+        if( p_sys->ongoing_segment && b_split )
         {
             msg_Dbg( p_access, "Moving ongoing segment to full segments-queue" );
             block_ChainLastAppend( &p_sys->full_segments_end, p_sys->ongoing_segment );
@@ -1051,6 +1486,20 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
         }
         i_write += ret;
 
+        /* Served segments get their data as soon as it is complete, for
+           the clients already reading them */
+        if( p_sys->p_httpd_host && p_sys->b_segment_open && p_sys->full_segments )
+        {
+            ret = writeSegment( p_access );
+            if( ret < 0 )
+            {
+                msg_Err( p_access, "Error in write loop");
+                block_ChainRelease( p_buffer );
+                return ret;
+            }
+            i_write += ret;
+        }
+
         block_t *p_temp = p_buffer->p_next;
         p_buffer->p_next = NULL;
         block_ChainLastAppend( &p_sys->ongoing_segment_end, p_buffer );
@@ -1752,6 +1752,13 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
     msg_rc(_("| buffers lost     :    %5"PRIi64),
             p_item->p_stats->i_lost_abuffers );
     msg_rc("|");
+    /* Decoder threads */
+    msg_rc("%s", _("+-[Decoder Threads]"));
+    msg_rc(_("| blocks queued    :    %5"PRIi64),
+            p_item->p_stats->i_decoder_blocks );
+    msg_rc(_("| wake-ups         :    %5"PRIi64),
+            p_item->p_stats->i_decoder_wakeups );
+    msg_rc("|");
     /* Sout */
     msg_rc("%s", _("+-[Streaming]"));
     msg_rc(_("| packets sent     :    %5"PRIi64),
@@ -73,6 +73,9 @@ PlaylistManager::PlaylistManager( demux_t *p_demux_,
     cached.i_length = 0;
     cached.f_position = 0.0;
     cached.i_time = VLC_TS_INVALID;
+    /* Cost of the last playlist refresh, in us and allocations */
+    var_Create(p_demux, "adaptive-refresh-time", VLC_VAR_INTEGER);
+    var_Create(p_demux, "adaptive-refresh-allocations", VLC_VAR_INTEGER);
 }
 
 PlaylistManager::~PlaylistManager   ()
@@ -82,6 +85,8 @@ PlaylistManager::~PlaylistManager   ()
     delete playlist;
     delete conManager;
     delete logic;
+    var_Destroy(p_demux, "adaptive-refresh-allocations");
+    var_Destroy(p_demux, "adaptive-refresh-time");
     vlc_cond_destroy(&waitcond);
     vlc_mutex_destroy(&lock);
     vlc_mutex_destroy(&demux.lock);
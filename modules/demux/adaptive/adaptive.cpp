@@ -75,6 +75,11 @@ static void Close   (vlc_object_t *);
 #define ADAPT_ACCESS_TEXT N_("Use regular HTTP modules")
 #define ADAPT_ACCESS_LONGTEXT N_("Connect using http access instead of custom http code")
 
+#define ADAPT_HTTP2_TEXT N_("Use HTTP/2 when available")
+#define ADAPT_HTTP2_LONGTEXT N_("Fetch over a single multiplexed HTTP/2 connection " \
+                                "per server when it is negotiated, instead of one HTTP/1.1 " \
+                                "connection per request")
+
 static const AbstractAdaptationLogic::LogicType pi_logics[] = {
                                 AbstractAdaptationLogic::Default,
                                 AbstractAdaptationLogic::Predictive,
@@ -116,6 +121,7 @@ vlc_module_begin ()
         add_integer( "adaptive-height", 0, ADAPT_HEIGHT_TEXT, ADAPT_HEIGHT_TEXT, true )
         add_integer( "adaptive-bw",     250, ADAPT_BW_TEXT,     ADAPT_BW_LONGTEXT,     false )
         add_bool   ( "adaptive-use-access", false, ADAPT_ACCESS_TEXT, ADAPT_ACCESS_LONGTEXT, true );
+        add_bool   ( "adaptive-http2", true, ADAPT_HTTP2_TEXT, ADAPT_HTTP2_LONGTEXT, true );
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -126,6 +126,7 @@ HTTPChunkSource::HTTPChunkSource(const std::string& url, AbstractConnectionManag
     prepared = false;
     eof = false;
     sourceid = id;
+    priority = AbstractConnection::PRIORITY_DEFAULT;
     if(!init(url))
         eof = true;
 }
@@ -218,6 +219,7 @@ bool HTTPChunkSource::prepare()
             return false;
     }
 
+    connection->setPriority(priority);
     if( connection->request(params.getPath(), bytesRange) != VLC_SUCCESS )
         return false;
     /* Because we don't know Chunk size at start, we need to get size
@@ -228,6 +230,11 @@ bool HTTPChunkSource::prepare()
     return true;
 }
 
+void HTTPChunkSource::setPriority(unsigned prio)
+{
+    priority = prio;
+}
+
 block_t * HTTPChunkSource::readBlock()
 {
     return read(HTTPChunkSource::CHUNK_SIZE);
@@ -450,7 +457,8 @@ HTTPChunk::HTTPChunk(const std::string &url, AbstractConnectionManager *manager,
                      const adaptive::ID &id):
     AbstractChunk(new HTTPChunkSource(url, manager, id))
 {
-
+    /* playlists and keys, which all the streams are waiting for */
+    static_cast<HTTPChunkSource *>(source)->setPriority(AbstractConnection::PRIORITY_PLAYLIST);
 }
 
 HTTPChunk::~HTTPChunk()
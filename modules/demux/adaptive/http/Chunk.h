@@ -90,6 +90,7 @@ namespace adaptive
                 virtual block_t *   readBlock       (); /* impl */
                 virtual block_t *   read            (size_t); /* impl */
                 virtual bool        hasMoreData     () const; /* impl */
+                void                setPriority     (unsigned);
 
                 static const size_t CHUNK_SIZE = 32768;
 
@@ -105,6 +106,7 @@ namespace adaptive
             private:
                 bool init(const std::string &);
                 ConnectionParams    params;
+                unsigned            priority;
         };
 
         class HTTPChunkBufferedSource : public HTTPChunkSource
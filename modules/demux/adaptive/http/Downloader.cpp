@@ -105,10 +105,14 @@ void Downloader::Run()
 
         if(!chunks.empty())
         {
+            /* Take turns between the scheduled chunks, so that they are
+               all in flight and that multiplexed streams get their share
+               of the connection, according to their priority */
             HTTPChunkBufferedSource *source = chunks.front();
+            chunks.pop_front();
             DownloadSource(source);
-            if(source->isDone())
-                chunks.pop_front();
+            if(!source->isDone())
+                chunks.push_back(source);
         }
 
         vlc_mutex_unlock(&lock);
@@ -29,6 +29,14 @@
 #include <cstdio>
 #include <sstream>
 #include <vlc_stream.h>
+#include <vlc_block.h>
+
+extern "C"
+{
+    #include "../../../access/http/resource.h"
+    #include "../../../access/http/file.h"
+    #include "../../../access/http/connmgr.h"
+}
 
 using namespace adaptive::http;
 
@@ -38,6 +46,7 @@ AbstractConnection::AbstractConnection(vlc_object_t *p_object_)
     available = true;
     bytesRead = 0;
     contentLength = 0;
+    priority = PRIORITY_DEFAULT;
 }
 
 AbstractConnection::~AbstractConnection()
@@ -59,6 +68,11 @@ size_t AbstractConnection::getContentLength() const
     return contentLength;
 }
 
+void AbstractConnection::setPriority(unsigned prio)
+{
+    priority = prio;
+}
+
 HTTPConnection::HTTPConnection(vlc_object_t *p_object_, Socket *socket_, bool persistent)
     : AbstractConnection( p_object_ )
 {
@@ -459,6 +473,147 @@ void StreamUrlConnection::setUsed( bool b )
        reset();
 }
 
+LibVLCHTTPConnection::LibVLCHTTPConnection(vlc_object_t *p_object, struct vlc_http_mgr *mgr)
+    : AbstractConnection(p_object)
+{
+    http_mgr = mgr;
+    source = NULL;
+    p_block = NULL;
+    psz_useragent = var_InheritString(p_object, "http-user-agent");
+}
+
+LibVLCHTTPConnection::~LibVLCHTTPConnection()
+{
+    reset();
+    vlc_http_mgr_destroy(http_mgr);
+    free(psz_useragent);
+}
+
+void LibVLCHTTPConnection::reset()
+{
+    if(p_block)
+        block_Release(p_block);
+    p_block = NULL;
+    if(source)
+        vlc_http_file_destroy(source);
+    source = NULL;
+    bytesRead = 0;
+    contentLength = 0;
+    bytesRange = BytesRange();
+}
+
+bool LibVLCHTTPConnection::canReuse(const ConnectionParams &) const
+{
+    /* the manager picks, or multiplexes, the actual connection */
+    return available;
+}
+
+int LibVLCHTTPConnection::request(const std::string &path, const BytesRange &range)
+{
+    reset();
+
+    /* Set new path for this query */
+    params.setPath(path);
+
+    msg_Dbg(p_object, "Retrieving %s @%zu", params.getUrl().c_str(),
+                      range.isValid() ? range.getStartByte() : 0);
+
+    std::string url = params.getUrl();
+    for(int redirects = 0; ; redirects++)
+    {
+        source = vlc_http_file_create(http_mgr, url.c_str(), psz_useragent, NULL);
+        if(!source)
+            return VLC_EGENERIC;
+        source->weight = priority;
+
+        int i_ret;
+        if(range.isValid() && range.getEndByte() > 0)
+            i_ret = vlc_http_file_seek_range(source, range.getStartByte(),
+                                             range.getEndByte() - range.getStartByte() + 1);
+        else if(range.isValid())
+            i_ret = vlc_http_file_seek(source, range.getStartByte());
+        else
+            i_ret = 0;
+
+        const int status = (i_ret == 0) ? vlc_http_file_get_status(source) : -1;
+        if(status >= 200 && status < 300)
+            break;
+
+        char *psz_redirect = (status >= 300 && status < 400 && redirects < maxRedirects)
+                           ? vlc_http_file_get_redirect(source) : NULL;
+        reset();
+        if(!psz_redirect)
+            return (status < 0) ? VLC_EGENERIC : VLC_ENOOBJ;
+        url = psz_redirect;
+        free(psz_redirect);
+    }
+
+    if(range.isValid() && range.getEndByte() > 0)
+    {
+        bytesRange = range;
+        contentLength = range.getEndByte() - range.getStartByte() + 1;
+    }
+    else
+    {
+        uintmax_t i_size = vlc_http_file_get_size(source);
+        if(i_size != (uintmax_t) -1 && i_size > range.getStartByte())
+            contentLength = i_size - range.getStartByte();
+    }
+
+    return VLC_SUCCESS;
+}
+
+ssize_t LibVLCHTTPConnection::read(void *p_buffer, size_t len)
+{
+    if( !source )
+        return VLC_EGENERIC;
+
+    if(len == 0)
+        return VLC_SUCCESS;
+
+    const size_t toRead = (contentLength) ? contentLength - bytesRead : len;
+    if (toRead == 0)
+        return VLC_SUCCESS;
+
+    if(len > toRead)
+        len = toRead;
+
+    size_t copied = 0;
+    while(copied < len)
+    {
+        if(!p_block && !(p_block = vlc_http_file_read(source)))
+            break;
+
+        size_t i_copy = __MIN(p_block->i_buffer, len - copied);
+        memcpy(&((uint8_t *)p_buffer)[copied], p_block->p_buffer, i_copy);
+        copied += i_copy;
+        p_block->p_buffer += i_copy;
+        p_block->i_buffer -= i_copy;
+        if(p_block->i_buffer == 0)
+        {
+            block_Release(p_block);
+            p_block = NULL;
+        }
+    }
+
+    bytesRead += copied;
+
+    if(copied < len || /* set EOF */
+       contentLength == bytesRead )
+    {
+        reset();
+    }
+
+    return copied;
+}
+
+void LibVLCHTTPConnection::setUsed( bool b )
+{
+    available = !b;
+    if(available)
+        reset();
+}
+
 ConnectionFactory::ConnectionFactory()
 {
 }
@@ -496,3 +651,19 @@ AbstractConnection * StreamUrlConnectionFactory::createConnection(vlc_object_t *
 {
     return new (std::nothrow) StreamUrlConnection(p_object);
 }
+
+AbstractConnection * LibVLCHTTPConnectionFactory::createConnection(vlc_object_t *p_object,
+                                                                   const ConnectionParams &params)
+{
+    if(params.getScheme() != "https" || params.getHostname().empty())
+        return ConnectionFactory::createConnection(p_object, params);
+
+    struct vlc_http_mgr *http_mgr = vlc_http_mgr_create(p_object, NULL, false);
+    if(!http_mgr)
+        return ConnectionFactory::createConnection(p_object, params);
+
+    LibVLCHTTPConnection *conn = new (std::nothrow) LibVLCHTTPConnection(p_object, http_mgr);
+    if(!conn)
+        vlc_http_mgr_destroy(http_mgr);
+    return conn;
+}
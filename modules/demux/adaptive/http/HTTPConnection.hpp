@@ -30,6 +30,9 @@
 #include <vlc_common.h>
 #include <string>
 
+struct vlc_http_mgr;
+struct vlc_http_resource;
+
 namespace adaptive
 {
     namespace http
@@ -51,6 +54,16 @@ namespace adaptive
                 virtual size_t  getContentLength() const;
                 virtual void    setUsed( bool ) = 0;
 
+                /* HTTP/2 stream weights, only meaningful on multiplexed connections */
+                enum
+                {
+                    PRIORITY_TEXT     = 8,
+                    PRIORITY_DEFAULT  = 16,
+                    PRIORITY_AUDIO    = 32,
+                    PRIORITY_PLAYLIST = 64,
+                };
+                void            setPriority (unsigned);
+
             protected:
                 vlc_object_t      *p_object;
                 ConnectionParams   params;
@@ -58,6 +71,7 @@ namespace adaptive
                 size_t             contentLength;
                 BytesRange         bytesRange;
                 size_t             bytesRead;
+                unsigned           priority;
         };
 
         class HTTPConnection : public AbstractConnection
@@ -119,6 +133,29 @@ namespace adaptive
                 stream_t *p_streamurl;
        };
 
+       class LibVLCHTTPConnection : public AbstractConnection
+       {
+            public:
+                /* the connection owns, and destroys, the manager */
+                LibVLCHTTPConnection(vlc_object_t *, struct vlc_http_mgr *);
+                virtual ~LibVLCHTTPConnection();
+
+                virtual bool    canReuse     (const ConnectionParams &) const;
+
+                virtual int     request     (const std::string& path, const BytesRange & = BytesRange());
+                virtual ssize_t read        (void *p_buffer, size_t len);
+
+                virtual void    setUsed( bool );
+
+            protected:
+                void reset();
+                struct vlc_http_mgr *http_mgr;
+                struct vlc_http_resource *source;
+                block_t *p_block; /* partially read */
+                char *psz_useragent;
+                static const int maxRedirects = 5;
+       };
+
        class ConnectionFactory
        {
            public:
@@ -132,6 +169,19 @@ namespace adaptive
            public:
                virtual AbstractConnection * createConnection(vlc_object_t *, const ConnectionParams &);
        };
+
+       /* Uses the HTTP stack of the https access for secure servers: all the
+        * requests to a server become streams of a single connection when
+        * HTTP/2 is negotiated, and that stack falls back to HTTP/1.1 by
+        * itself otherwise. Plain http keeps using our own client.
+        * Each connection gets its own manager, as a manager is not meant to
+        * be used by several threads; the actual connections are shared by
+        * the managers. */
+       class LibVLCHTTPConnectionFactory : public ConnectionFactory
+       {
+           public:
+               virtual AbstractConnection * createConnection(vlc_object_t *, const ConnectionParams &);
+       };
     }
 }
 
@@ -67,6 +67,8 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
     {
         if(var_InheritBool(p_object, "adaptive-use-access"))
             factory = new (std::nothrow) StreamUrlConnectionFactory();
+        else if(var_InheritBool(p_object, "adaptive-http2"))
+            factory = new (std::nothrow) LibVLCHTTPConnectionFactory();
         else
             factory = new (std::nothrow) ConnectionFactory();
     }
@@ -76,8 +78,8 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
     delete downloader;
-    delete factory;
     this->closeAllConnections();
+    delete factory; /* after the connections it might own the resources of */
     vlc_mutex_destroy(&lock);
 }
 
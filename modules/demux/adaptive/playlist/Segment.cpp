@@ -33,6 +33,7 @@
 #include "SegmentChunk.hpp"
 #include "../http/BytesRange.hpp"
 #include "../http/HTTPConnectionManager.h"
+#include "../http/HTTPConnection.hpp"
 #include "../http/Downloader.hpp"
 #include <cassert>
 
@@ -77,6 +78,14 @@ SegmentChunk* ISegment::toChunk(size_t index, BaseRepresentation *rep, AbstractC
         if(startByte != endByte)
             source->setBytesRange(BytesRange(startByte, endByte));
 
+        /* audio is cheap and first to underrun, subtitles can wait */
+        const unsigned format = rep->getStreamFormat();
+        if(format == StreamFormat::WEBVTT || format == StreamFormat::TTML)
+            source->setPriority(AbstractConnection::PRIORITY_TEXT);
+        else if(format == StreamFormat::PACKEDAAC ||
+                !rep->getMimeType().compare(0, 6, "audio/"))
+            source->setPriority(AbstractConnection::PRIORITY_AUDIO);
+
         SegmentChunk *chunk = new (std::nothrow) SegmentChunk(this, source, rep);
         if( chunk )
         {
@@ -171,6 +180,11 @@ Segment::Segment(ICanonicalUrl *parent) :
     classId = CLASSID_SEGMENT;
 }
 
+const std::vector<SubSegment *> & Segment::getSubSegments() const
+{
+    return subsegments;
+}
+
 void Segment::addSubSegment(SubSegment *subsegment)
 {
     if(!subsegments.empty())
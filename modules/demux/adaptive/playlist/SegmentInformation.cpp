@@ -421,6 +421,11 @@ SegmentInformation * SegmentInformation::getChildByID(const adaptive::ID &id)
     return NULL;
 }
 
+SegmentTimeline * SegmentInformation::getSegmentTimeline() const
+{
+    return mediaSegmentTemplate ? mediaSegmentTemplate->segmentTimeline.Get() : NULL;
+}
+
 void SegmentInformation::mergeWith(SegmentInformation *updated, mtime_t prunetime)
 {
     /* Support Segment List for now */
@@ -90,11 +90,12 @@ namespace adaptive
                 std::size_t getAllSegments(std::vector<ISegment *> &) const;
                 std::size_t getSegments(SegmentInfoType, std::vector<ISegment *>&) const;
                 std::vector<SegmentInformation *> childs;
-                SegmentInformation * getChildByID( const ID & );
                 SegmentInformation *parent;
                 SwitchPolicy switchpolicy;
 
             public:
+                SegmentInformation * getChildByID( const ID & );
+                SegmentTimeline * getSegmentTimeline() const; /* own template's only */
                 void appendSegmentList(SegmentList *, bool = false);
                 void setSegmentBase(SegmentBase *);
                 void setSegmentTemplate(MediaSegmentTemplate *);
@@ -29,6 +29,8 @@
 #include "Segment.h"
 #include "SegmentInformation.hpp"
 
+#include <algorithm>
+
 using namespace adaptive::playlist;
 
 SegmentList::SegmentList( SegmentInformation *parent ):
@@ -47,21 +49,47 @@ const std::vector<ISegment*>& SegmentList::getSegments() const
     return segments;
 }
 
-ISegment * SegmentList::getSegmentByNumber(uint64_t number)
+namespace
 {
-    std::vector<ISegment *>::const_iterator it = segments.begin();
-    for(it = segments.begin(); it != segments.end(); ++it)
+    struct SegmentNumberBefore
     {
-        ISegment *seg = *it;
-        if(seg->getSequenceNumber() == number)
+        bool operator()(const ISegment *seg, uint64_t number) const
         {
-            return seg;
+            return seg->getSequenceNumber() < number;
         }
-        else if (seg->getSequenceNumber() > number)
+    };
+
+    /* Segments are looked up by time through their subsegments, if any */
+    const std::vector<SubSegment *> * getTimedSubSegments(const ISegment *seg)
+    {
+        const Segment *segment = dynamic_cast<const Segment *>(seg);
+        if(!segment || segment->getSubSegments().empty())
+            return NULL;
+        return &segment->getSubSegments();
+    }
+
+    const ISegment * getFirstTimedSegment(const ISegment *seg)
+    {
+        const std::vector<SubSegment *> *list = getTimedSubSegments(seg);
+        return list ? list->front() : seg;
+    }
+
+    struct StartsAfter
+    {
+        bool operator()(stime_t time, const ISegment *seg) const
         {
-            break;
+            return time < getFirstTimedSegment(seg)->startTime.Get();
         }
-    }
+    };
+}
+
+ISegment * SegmentList::getSegmentByNumber(uint64_t number)
+{
+    /* segments are stored by increasing sequence number */
+    std::vector<ISegment *>::const_iterator it =
+            std::lower_bound(segments.begin(), segments.end(), number, SegmentNumberBefore());
+    if(it != segments.end() && (*it)->getSequenceNumber() == number)
+        return *it;
     return NULL;
 }
 
@@ -111,7 +139,7 @@ void SegmentList::pruneByPlaybackTime(mtime_t time)
 void SegmentList::pruneBySegmentNumber(uint64_t tobelownum)
 {
     std::vector<ISegment *>::iterator it = segments.begin();
-    while(it != segments.end())
+    for(; it != segments.end(); ++it)
     {
         ISegment *seg = *it;
 
@@ -121,22 +149,44 @@ void SegmentList::pruneBySegmentNumber(uint64_t tobelownum)
         if(seg->chunksuse.Get()) /* can't prune from here, still in use */
             break;
 
-        delete *it;
-        it = segments.erase(it);
+        delete seg;
     }
+    /* erase in one go, not to shift the whole list per segment */
+    segments.erase(segments.begin(), it);
 }
 
 bool SegmentList::getSegmentNumberByScaledTime(stime_t time, uint64_t *ret) const
 {
-    std::vector<ISegment *> allsubsegments;
-    std::vector<ISegment *>::const_iterator it;
-    for(it=segments.begin(); it!=segments.end(); ++it)
+    /* Same as SegmentInfoCommon::getSegmentNumberByScaledTime() over the
+       list of all subsegments, bisecting without building that list */
+    if(segments.empty())
+        return false;
+
+    const std::vector<SubSegment *> *list = getTimedSubSegments(segments.front());
+    const ISegment *second = NULL;
+    if(list && list->size() > 1)
+        second = list->at(1);
+    else if(segments.size() > 1)
+        second = getFirstTimedSegment(segments[1]);
+    if(second && second->startTime.Get() == 0)
+        return false;
+
+    std::vector<ISegment *>::const_iterator it =
+            std::upper_bound(segments.begin(), segments.end(), time, StartsAfter());
+    if(it == segments.begin())
+        return false;
+
+    const ISegment *seg = *(--it);
+    list = getTimedSubSegments(seg);
+    if(list)
     {
-        std::vector<ISegment *> list = (*it)->subSegments();
-        allsubsegments.insert( allsubsegments.end(), list.begin(), list.end() );
+        std::vector<SubSegment *>::const_iterator sit =
+                std::upper_bound(list->begin(), list->end(), time, StartsAfter());
+        seg = *(--sit); /* the first one starts before, see above */
     }
 
-    return SegmentInfoCommon::getSegmentNumberByScaledTime(allsubsegments, time, ret);
+    *ret = seg->getSequenceNumber();
+    return true;
 }
 
 bool SegmentList::getPlaybackTimeDurationBySegmentNumber(uint64_t number,
@@ -0,0 +1,124 @@
+/*****************************************************************************
+ * SegmentList_test.cpp: segment list lookup tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+
+#include "SegmentList.h"
+#include "Segment.h"
+
+#include <cassert>
+
+using namespace adaptive::playlist;
+
+static Segment * addSegment(SegmentList *list, uint64_t number, stime_t start)
+{
+    Segment *seg = new Segment(NULL);
+    seg->setSequenceNumber(number);
+    seg->startTime.Set(start);
+    seg->duration.Set(10);
+    list->addSegment(seg);
+    return seg;
+}
+
+static uint64_t lookup(const SegmentList &list, stime_t time)
+{
+    uint64_t number = UINT64_MAX;
+    bool found = list.getSegmentNumberByScaledTime(time, &number);
+    assert(found);
+    assert(number != UINT64_MAX);
+    return number;
+}
+
+int main(void)
+{
+    uint64_t number;
+
+    /* Empty list */
+    {
+        SegmentList list;
+        assert(!list.getSegmentNumberByScaledTime(0, &number));
+    }
+
+    /* Plain segments */
+    {
+        SegmentList list;
+        uint64_t numbers[100];
+        for(unsigned i = 0; i < 100; i++)
+            numbers[i] = addSegment(&list, 5 + i, 100 + i * 10)->getSequenceNumber();
+
+        assert(!list.getSegmentNumberByScaledTime(0, &number));
+        assert(!list.getSegmentNumberByScaledTime(99, &number));
+        for(unsigned i = 0; i < 100; i++)
+        {
+            assert(lookup(list, 100 + i * 10) == numbers[i]);
+            assert(lookup(list, 100 + i * 10 + 9) == numbers[i]);
+        }
+        assert(lookup(list, 1000000) == numbers[99]);
+    }
+
+    /* Segments without timing */
+    {
+        SegmentList list;
+        addSegment(&list, 0, 0);
+        addSegment(&list, 1, 0);
+        addSegment(&list, 2, 0);
+        assert(!list.getSegmentNumberByScaledTime(0, &number));
+    }
+
+    /* Segments split in subsegments */
+    {
+        SegmentList list;
+        uint64_t first = addSegment(&list, 0, 0)->getSequenceNumber();
+        Segment *seg = addSegment(&list, 1, 10);
+        for(unsigned i = 0; i < 4; i++)
+        {
+            SubSegment *sub = new SubSegment(seg, i * 100, i * 100 + 99);
+            sub->startTime.Set(10 + i * 5);
+            sub->duration.Set(5);
+            seg->addSubSegment(sub);
+        }
+        uint64_t last = addSegment(&list, 6, 30)->getSequenceNumber();
+
+        const std::vector<SubSegment *> &subs = seg->getSubSegments();
+        assert(subs.size() == 4);
+        assert(lookup(list, 0) == first);
+        assert(lookup(list, 9) == first);
+        for(unsigned i = 0; i < 4; i++)
+        {
+            assert(lookup(list, 10 + i * 5) == subs[i]->getSequenceNumber());
+            assert(lookup(list, 14 + i * 5) == subs[i]->getSequenceNumber());
+        }
+        assert(lookup(list, 30) == last);
+    }
+
+    /* Subsegments without timing */
+    {
+        SegmentList list;
+        Segment *seg = addSegment(&list, 0, 0);
+        for(unsigned i = 0; i < 2; i++)
+            seg->addSubSegment(new SubSegment(seg, i * 100, i * 100 + 99));
+        assert(!list.getSegmentNumberByScaledTime(0, &number));
+    }
+
+    return 0;
+}
@@ -43,111 +43,135 @@ SegmentTimeline::SegmentTimeline(uint64_t scale)
 
 SegmentTimeline::~SegmentTimeline()
 {
-    std::list<Element *>::iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-        delete *it;
 }
 
 void SegmentTimeline::addElement(uint64_t number, stime_t d, uint64_t r, stime_t t)
 {
-    Element *element = new (std::nothrow) Element(number, d, r, t);
-    if(element)
+    Element element(number, d, r, t);
+    if(!elements.empty() && !t)
     {
-        if(!elements.empty() && !t)
-        {
-            const Element *el = elements.back();
-            element->t = el->t + (el->d * (el->r + 1));
-        }
-        elements.push_back(element);
+        const Element &el = elements.back();
+        element.t = el.t + el.duration();
     }
+    append(element);
 }
 
-mtime_t SegmentTimeline::getMinAheadScaledTime(uint64_t number) const
+void SegmentTimeline::append(Element &element)
 {
-    stime_t totalscaledtime = 0;
-
-    std::list<Element *>::const_reverse_iterator it;
-    for(it = elements.rbegin(); it != elements.rend(); ++it)
+    if(!elements.empty())
     {
-        const Element *el = *it;
+        const Element &el = elements.back();
+        element.before = el.before + el.duration();
+    }
+    elements.push_back(element);
+}
 
-        if(number < el->number)
+namespace
+{
+    struct ElementNumberBefore
+    {
+        template<class E> bool operator()(uint64_t number, const E &el) const
         {
-            totalscaledtime += (el->d * (el->r + 1));
-            break;
+            return number < el.number;
         }
-        else if(number <= el->number + el->r)
+    };
+
+    struct ElementTimeBefore
+    {
+        template<class E> bool operator()(stime_t time, const E &el) const
         {
-            totalscaledtime += el->d * (el->number + el->r - number);
+            return time < el.t;
         }
-        else break;
-    }
+    };
+}
 
-    return totalscaledtime;
+/* returns the last element starting at or before number, or end() */
+SegmentTimeline::Elements::const_iterator SegmentTimeline::findByNumber(uint64_t number) const
+{
+    Elements::const_iterator it = std::upper_bound(elements.begin(), elements.end(),
+                                                   number, ElementNumberBefore());
+    return (it == elements.begin()) ? elements.end() : --it;
 }
 
-uint64_t SegmentTimeline::getElementNumberByScaledPlaybackTime(stime_t scaled) const
+/* returns the last element starting at or before time, or end() */
+SegmentTimeline::Elements::const_iterator SegmentTimeline::findByScaledTime(stime_t time) const
 {
-    uint64_t prevnumber = 0;
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-    {
-        const Element *el = *it;
-        if(it == elements.begin())
-        {
-            scaled -= el->t;
-            prevnumber = el->number;
-        }
+    Elements::const_iterator it = std::upper_bound(elements.begin(), elements.end(),
+                                                   time, ElementTimeBefore());
+    return (it == elements.begin()) ? elements.end() : --it;
+}
 
-        for(uint64_t repeat = 1 + el->r; repeat; repeat--)
-        {
-            if(el->d >= scaled)
-                return prevnumber;
+mtime_t SegmentTimeline::getMinAheadScaledTime(uint64_t number) const
+{
+    if(elements.empty())
+        return 0;
 
-            scaled -= el->d;
-            prevnumber++;
-        }
+    const Element &last = elements.back();
+    const stime_t total = last.before + last.duration();
 
-        /* might have been discontinuity */
-        prevnumber = el->number;
-    }
+    Elements::const_iterator it = findByNumber(number);
+    if(it == elements.end())
+        return total - elements.front().before;
+
+    const Element &el = *it;
+    if(number > el.number + el.r)
+        return total - (el.before + el.duration());
 
-    return prevnumber;
+    return total - (el.before + el.d * (stime_t)(number - el.number + 1));
 }
 
-bool SegmentTimeline::getScaledPlaybackTimeDurationBySegmentNumber(uint64_t number,
-                                                                   stime_t *time, stime_t *duration) const
+uint64_t SegmentTimeline::getElementNumberByScaledPlaybackTime(stime_t scaled) const
 {
-    stime_t totalscaledtime = 0;
-    stime_t lastduration = 0;
+    if(elements.empty())
+        return 0;
 
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-    {
-        const Element *el = *it;
+    Elements::const_iterator it = findByScaledTime(scaled);
+    if(it == elements.end())
+        return elements.front().number;
 
-        /* set start time, or from discontinuity */
-        if(it == elements.begin() || el->t)
-        {
-            totalscaledtime = el->t;
-        }
+    const Element &el = *it;
+    const uint64_t count = (el.d > 0) ? (scaled - el.t) / el.d : 0;
+    if(count <= el.r)
+        return el.number + count;
 
-        lastduration = el->d;
+    /* in a discontinuity gap, or past the end */
+    if(++it != elements.end())
+        return (*it).number;
+    return el.number + el.r;
+}
 
-        if(number <= el->number)
-            break;
+bool SegmentTimeline::getScaledPlaybackTimeDurationBySegmentNumber(uint64_t number,
+                                                                   stime_t *time, stime_t *duration) const
+{
+    *time = *duration = 0;
 
-        if(number <= el->number + el->r)
-        {
-            totalscaledtime += el->d * (number - el->number);
-            break;
-        }
+    if(elements.empty())
+        return true;
 
-        totalscaledtime += (el->d * (el->r + 1));
+    Elements::const_iterator it = findByNumber(number);
+    if(it == elements.end())
+    {
+        *time = elements.front().t;
+        *duration = elements.front().d;
+        return true;
     }
 
-    *time = totalscaledtime;
-    *duration = lastduration;
+    const Element &el = *it;
+    if(number <= el.number + el.r)
+    {
+        *time = el.t + el.d * (stime_t)(number - el.number);
+        *duration = el.d;
+    }
+    else if(++it != elements.end()) /* number missing, next element after discontinuity */
+    {
+        *time = (*it).t;
+        *duration = (*it).d;
+    }
+    else
+    {
+        *time = el.t + el.duration();
+        *duration = el.d;
+    }
     return true;
 }
 
@@ -163,15 +187,15 @@ uint64_t SegmentTimeline::maxElementNumber() const
     if(elements.empty())
         return 0;
 
-    const Element *e = elements.back();
-    return e->number + e->r;
+    const Element &e = elements.back();
+    return e.number + e.r;
 }
 
 uint64_t SegmentTimeline::minElementNumber() const
 {
     if(elements.empty())
         return 0;
-    return elements.front()->number;
+    return elements.front().number;
 }
 
 void SegmentTimeline::pruneByPlaybackTime(mtime_t time)
@@ -186,25 +210,25 @@ size_t SegmentTimeline::pruneBySequenceNumber(uint64_t number)
     size_t prunednow = 0;
     while(elements.size())
     {
-        Element *el = elements.front();
-        if(el->number >= number)
+        Element &el = elements.front();
+        if(el.number >= number)
         {
             break;
         }
-        else if(el->number + el->r >= number)
+        else if(el.number + el.r >= number)
         {
-            uint64_t count = number - el->number;
-            el->number += count;
-            el->t += count * el->d;
-            el->r -= count;
+            uint64_t count = number - el.number;
+            el.number += count;
+            el.t += count * el.d;
+            el.before += count * el.d;
+            el.r -= count;
             prunednow += count;
             break;
         }
         else
         {
-            prunednow += el->r + 1;
+            prunednow += el.r + 1;
             elements.pop_front();
-            delete el;
         }
     }
 
@@ -215,36 +239,49 @@ void SegmentTimeline::mergeWith(SegmentTimeline &other)
 {
     if(elements.empty())
     {
-        while(other.elements.size())
-        {
-            elements.push_back(other.elements.front());
-            other.elements.pop_front();
-        }
+        elements.swap(other.elements);
+        other.elements.clear();
         return;
     }
 
-    Element *last = elements.back();
-    while(other.elements.size())
+    Elements::iterator it;
+    for(it = other.elements.begin(); it != other.elements.end(); ++it)
+        merge(*it);
+    other.elements.clear();
+}
+
+/* Merges a single element of a refreshed timeline, as mergeWith() would,
+   without building that timeline. Returns whether it was appended. */
+bool SegmentTimeline::updateWith(uint64_t number, stime_t d, uint64_t r, stime_t t)
+{
+    Element element(number, d, r, t);
+    if(elements.empty())
     {
-        Element *el = other.elements.front();
-        other.elements.pop_front();
+        append(element);
+        return true;
+    }
+    return merge(element);
+}
 
-        if(last->contains(el->t)) /* Same element, but prev could have been middle of repeat */
-        {
-            const uint64_t count = (el->t - last->t) / last->d;
-            last->r = std::max(last->r, el->r + count);
-            delete el;
-        }
-        else if(el->t < last->t)
-        {
-            delete el;
-        }
-        else /* Did not exist in previous list */
-        {
-            elements.push_back(el);
-            el->number = last->number + last->r + 1;
-            last = el;
-        }
+bool SegmentTimeline::merge(Element &el)
+{
+    Element &last = elements.back();
+
+    if(last.contains(el.t)) /* Same element, but prev could have been middle of repeat */
+    {
+        const uint64_t count = (el.t - last.t) / last.d;
+        last.r = std::max(last.r, el.r + count);
+        return false;
+    }
+    else if(el.t < last.t)
+    {
+        return false;
+    }
+    else /* Did not exist in previous list */
+    {
+        el.number = last.number + last.r + 1;
+        append(el);
+        return true;
     }
 }
 
@@ -252,15 +289,15 @@ mtime_t SegmentTimeline::start() const
 {
     if(elements.empty())
         return 0;
-    return inheritTimescale().ToTime(elements.front()->t);
+    return inheritTimescale().ToTime(elements.front().t);
 }
 
 mtime_t SegmentTimeline::end() const
 {
     if(elements.empty())
         return 0;
-    const Element *last = elements.back();
-    stime_t scaled = last->t + last->d * (last->r + 1);
+    const Element &last = elements.back();
+    stime_t scaled = last.t + last.duration();
     return inheritTimescale().ToTime(scaled);
 }
 
@@ -270,9 +307,9 @@ void SegmentTimeline::debug(vlc_object_t *obj, int indent) const
     ss << std::string(indent, ' ') << "Timeline";
     msg_Dbg(obj, "%s", ss.str().c_str());
 
-    std::list<Element *>::const_iterator it;
+    Elements::const_iterator it;
     for(it = elements.begin(); it != elements.end(); ++it)
-        (*it)->debug(obj, indent + 1);
+        (*it).debug(obj, indent + 1);
 }
 
 SegmentTimeline::Element::Element(uint64_t number_, stime_t d_, uint64_t r_, stime_t t_)
@@ -281,11 +318,17 @@ SegmentTimeline::Element::Element(uint64_t number_, stime_t d_, uint64_t r_, sti
     d = d_;
     t = t_;
     r = r_;
+    before = 0;
+}
+
+stime_t SegmentTimeline::Element::duration() const
+{
+    return d * (stime_t)(r + 1);
 }
 
 bool SegmentTimeline::Element::contains(stime_t time) const
 {
-    if(time >= t && time < t + (stime_t)(r + 1) * d)
+    if(time >= t && time < t + duration())
         return true;
     return false;
 }
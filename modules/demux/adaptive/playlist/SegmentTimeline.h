@@ -26,7 +26,7 @@
 
 #include "SegmentInfoCommon.h"
 #include <vlc_common.h>
-#include <list>
+#include <deque>
 
 namespace adaptive
 {
@@ -34,8 +34,6 @@ namespace adaptive
     {
         class SegmentTimeline : public TimescaleAble
         {
-            class Element;
-
             public:
                 SegmentTimeline(TimescaleAble *);
                 SegmentTimeline(uint64_t);
@@ -50,24 +48,37 @@ namespace adaptive
                 void pruneByPlaybackTime(mtime_t);
                 size_t pruneBySequenceNumber(uint64_t);
                 void mergeWith(SegmentTimeline &);
+                bool updateWith(uint64_t, stime_t d, uint64_t r, stime_t t);
                 mtime_t start() const;
                 mtime_t end() const;
                 void debug(vlc_object_t *, int = 0) const;
 
             private:
-                std::list<Element *> elements;
-
                 class Element
                 {
                     public:
                         Element(uint64_t, stime_t, uint64_t, stime_t);
                         void debug(vlc_object_t *, int = 0) const;
                         bool contains(stime_t) const;
+                        stime_t  duration() const;
                         stime_t  t;
                         stime_t  d;
                         uint64_t r;
                         uint64_t number;
+                        /* sum of the durations of all the elements before this
+                           one, only meaningful relatively to its neighbours */
+                        stime_t  before;
                 };
+
+                /* Elements are kept in both start time and number order,
+                   so that lookups are bisections over the sequence */
+                typedef std::deque<Element> Elements;
+                Elements elements;
+
+                Elements::const_iterator findByNumber(uint64_t) const;
+                Elements::const_iterator findByScaledTime(stime_t) const;
+                void append(Element &);
+                bool merge(Element &);
         };
     }
 }
@@ -0,0 +1,229 @@
+/*****************************************************************************
+ * SegmentTimeline_test.cpp: segment timeline lookup tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+
+#include "SegmentTimeline.h"
+
+#include <cassert>
+
+using namespace adaptive::playlist;
+
+static void checkTime(const SegmentTimeline &timeline, uint64_t number,
+                      stime_t time, stime_t duration)
+{
+    stime_t t, d;
+    assert(timeline.getScaledPlaybackTimeDurationBySegmentNumber(number, &t, &d));
+    assert(t == time);
+    assert(d == duration);
+    assert(timeline.getScaledPlaybackTimeByElementNumber(number) == time);
+}
+
+/* 10, 11, 12 at 100, 110, 120, then 13 at 130 (5 long), then after a
+ * discontinuity, 14 and 15 at 200 and 220 (20 long) */
+static void fill(SegmentTimeline *timeline)
+{
+    timeline->addElement(10, 10, 2, 100);
+    timeline->addElement(13, 5);
+    timeline->addElement(14, 20, 1, 200);
+}
+
+int main(void)
+{
+    /* Empty timeline */
+    {
+        SegmentTimeline timeline(1);
+        assert(timeline.getElementNumberByScaledPlaybackTime(100) == 0);
+        assert(timeline.minElementNumber() == 0);
+        assert(timeline.maxElementNumber() == 0);
+        assert(timeline.getMinAheadScaledTime(0) == 0);
+    }
+
+    /* Elements with repeat counts */
+    {
+        SegmentTimeline timeline(1);
+        fill(&timeline);
+
+        assert(timeline.minElementNumber() == 10);
+        assert(timeline.maxElementNumber() == 15);
+        assert(timeline.start() == 100 * CLOCK_FREQ);
+        assert(timeline.end() == 240 * CLOCK_FREQ);
+
+        /* time to number, at the element and repeat boundaries */
+        assert(timeline.getElementNumberByScaledPlaybackTime(0) == 10);
+        assert(timeline.getElementNumberByScaledPlaybackTime(100) == 10);
+        assert(timeline.getElementNumberByScaledPlaybackTime(109) == 10);
+        assert(timeline.getElementNumberByScaledPlaybackTime(110) == 11);
+        assert(timeline.getElementNumberByScaledPlaybackTime(119) == 11);
+        assert(timeline.getElementNumberByScaledPlaybackTime(120) == 12);
+        assert(timeline.getElementNumberByScaledPlaybackTime(129) == 12);
+        assert(timeline.getElementNumberByScaledPlaybackTime(130) == 13);
+        assert(timeline.getElementNumberByScaledPlaybackTime(134) == 13);
+        assert(timeline.getElementNumberByScaledPlaybackTime(135) == 14); /* gap */
+        assert(timeline.getElementNumberByScaledPlaybackTime(199) == 14);
+        assert(timeline.getElementNumberByScaledPlaybackTime(200) == 14);
+        assert(timeline.getElementNumberByScaledPlaybackTime(219) == 14);
+        assert(timeline.getElementNumberByScaledPlaybackTime(220) == 15);
+        assert(timeline.getElementNumberByScaledPlaybackTime(1000) == 15);
+
+        /* number to time */
+        checkTime(timeline, 5, 100, 10);
+        checkTime(timeline, 10, 100, 10);
+        checkTime(timeline, 11, 110, 10);
+        checkTime(timeline, 12, 120, 10);
+        checkTime(timeline, 13, 130, 5);
+        checkTime(timeline, 14, 200, 20);
+        checkTime(timeline, 15, 220, 20);
+        checkTime(timeline, 16, 240, 20);
+
+        /* Duration of the segments after a number, gaps excluded */
+        assert(timeline.getMinAheadScaledTime(5) == 75);
+        assert(timeline.getMinAheadScaledTime(10) == 65);
+        assert(timeline.getMinAheadScaledTime(12) == 45);
+        assert(timeline.getMinAheadScaledTime(13) == 40);
+        assert(timeline.getMinAheadScaledTime(14) == 20);
+        assert(timeline.getMinAheadScaledTime(15) == 0);
+        assert(timeline.getMinAheadScaledTime(16) == 0);
+    }
+
+    /* Pruning from the front */
+    {
+        SegmentTimeline timeline(1);
+        fill(&timeline);
+
+        /* In the middle of a repeated element */
+        assert(timeline.pruneBySequenceNumber(11) == 1);
+        assert(timeline.minElementNumber() == 11);
+        assert(timeline.maxElementNumber() == 15);
+        assert(timeline.getElementNumberByScaledPlaybackTime(100) == 11);
+        assert(timeline.getElementNumberByScaledPlaybackTime(110) == 11);
+        assert(timeline.getElementNumberByScaledPlaybackTime(120) == 12);
+        checkTime(timeline, 11, 110, 10);
+        checkTime(timeline, 12, 120, 10);
+        assert(timeline.getMinAheadScaledTime(11) == 55);
+        assert(timeline.getMinAheadScaledTime(13) == 40);
+
+        /* Nothing to prune */
+        assert(timeline.pruneBySequenceNumber(11) == 0);
+        assert(timeline.minElementNumber() == 11);
+
+        /* Up to the start of an element */
+        assert(timeline.pruneBySequenceNumber(14) == 3);
+        assert(timeline.minElementNumber() == 14);
+        assert(timeline.getElementNumberByScaledPlaybackTime(0) == 14);
+        checkTime(timeline, 13, 200, 20);
+        checkTime(timeline, 14, 200, 20);
+        assert(timeline.getMinAheadScaledTime(14) == 20);
+
+        /* Appending after pruning: the sums stay consistent */
+        timeline.addElement(16, 10, 1);
+        assert(timeline.maxElementNumber() == 17);
+        checkTime(timeline, 16, 240, 10);
+        checkTime(timeline, 17, 250, 10);
+        assert(timeline.getElementNumberByScaledPlaybackTime(250) == 17);
+        assert(timeline.getMinAheadScaledTime(14) == 40);
+        assert(timeline.getMinAheadScaledTime(16) == 10);
+
+        /* By playback time */
+        timeline.pruneByPlaybackTime(245 * CLOCK_FREQ);
+        assert(timeline.minElementNumber() == 16);
+        assert(timeline.getMinAheadScaledTime(16) == 10);
+
+        /* Everything */
+        assert(timeline.pruneBySequenceNumber(100) == 2);
+        assert(timeline.maxElementNumber() == 0);
+    }
+
+    /* Merging a refreshed timeline */
+    {
+        SegmentTimeline timeline(1);
+        timeline.addElement(10, 10, 2, 100);
+
+        /* Starts before, overlaps and extends the repeated element, then adds
+         * a new one. The refreshed numbering does not matter. */
+        SegmentTimeline refreshed(1);
+        refreshed.addElement(0, 10, 0, 90);
+        refreshed.addElement(1, 10, 4, 110);
+        refreshed.addElement(6, 5, 1);
+        timeline.mergeWith(refreshed);
+
+        assert(timeline.minElementNumber() == 10);
+        assert(timeline.maxElementNumber() == 17);
+        assert(timeline.end() == 170 * CLOCK_FREQ);
+        assert(timeline.getElementNumberByScaledPlaybackTime(100) == 10);
+        assert(timeline.getElementNumberByScaledPlaybackTime(150) == 15);
+        assert(timeline.getElementNumberByScaledPlaybackTime(159) == 15);
+        assert(timeline.getElementNumberByScaledPlaybackTime(160) == 16);
+        assert(timeline.getElementNumberByScaledPlaybackTime(165) == 17);
+        checkTime(timeline, 15, 150, 10);
+        checkTime(timeline, 16, 160, 5);
+        checkTime(timeline, 17, 165, 5);
+        assert(timeline.getMinAheadScaledTime(10) == 60);
+        assert(timeline.getMinAheadScaledTime(15) == 10);
+
+        /* The same refresh again changes nothing */
+        SegmentTimeline same(1);
+        same.addElement(1, 10, 4, 110);
+        same.addElement(6, 5, 1);
+        timeline.mergeWith(same);
+        assert(timeline.maxElementNumber() == 17);
+        assert(timeline.getMinAheadScaledTime(10) == 60);
+
+        /* Into an empty timeline */
+        SegmentTimeline empty(1);
+        empty.mergeWith(timeline);
+        assert(empty.minElementNumber() == 10);
+        assert(empty.maxElementNumber() == 17);
+        checkTime(empty, 16, 160, 5);
+        assert(empty.getMinAheadScaledTime(10) == 60);
+    }
+
+    /* Merging a refreshed timeline element by element */
+    {
+        SegmentTimeline timeline(1);
+        assert(timeline.updateWith(10, 10, 2, 100));
+        assert(timeline.minElementNumber() == 10);
+
+        assert(!timeline.updateWith(0, 10, 0, 90));
+        assert(!timeline.updateWith(1, 10, 4, 110));
+        assert(timeline.maxElementNumber() == 15);
+        assert(timeline.updateWith(6, 5, 1, 160));
+        assert(timeline.maxElementNumber() == 17);
+        checkTime(timeline, 15, 150, 10);
+        checkTime(timeline, 16, 160, 5);
+        assert(timeline.getMinAheadScaledTime(10) == 60);
+
+        /* Known ones again */
+        assert(!timeline.updateWith(6, 5, 1, 160));
+        assert(!timeline.updateWith(7, 5, 0, 165));
+        assert(timeline.maxElementNumber() == 17);
+
+        /* After a discontinuity */
+        assert(timeline.updateWith(8, 10, 0, 200));
+        assert(timeline.maxElementNumber() == 18);
+        checkTime(timeline, 18, 200, 10);
+        assert(timeline.getElementNumberByScaledPlaybackTime(180) == 18);
+    }
+
+    return 0;
+}
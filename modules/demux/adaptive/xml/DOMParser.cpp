@@ -36,14 +36,16 @@ using namespace adaptive::xml;
 DOMParser::DOMParser() :
     root( NULL ),
     stream( NULL ),
-    vlc_reader( NULL )
+    vlc_reader( NULL ),
+    nodes( 0 )
 {
 }
 
 DOMParser::DOMParser    (stream_t *stream) :
     root( NULL ),
     stream( stream ),
-    vlc_reader( NULL )
+    vlc_reader( NULL ),
+    nodes( 0 )
 {
 }
 
@@ -58,6 +60,11 @@ Node*   DOMParser::getRootNode              ()
 {
     return this->root;
 }
+
+size_t  DOMParser::getNodesCount            () const
+{
+    return nodes;
+}
 bool    DOMParser::parse                    (bool b)
 {
     if(!stream)
@@ -84,6 +91,7 @@ bool DOMParser::reset(stream_t *s)
         return true;
     delete root;
     root = NULL;
+    nodes = 0;
     vlc_reader = xml_ReaderReset(vlc_reader, s);
     return !!vlc_reader;
 }
@@ -104,6 +112,7 @@ Node* DOMParser::processNode(bool b_strict)
                 Node *node = new (std::nothrow) Node();
                 if(node)
                 {
+                    nodes++;
                     if(!lifo.empty())
                         lifo.top()->addSubNode(node);
                     lifo.push(node);
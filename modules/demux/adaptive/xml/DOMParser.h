@@ -44,6 +44,7 @@ namespace adaptive
                 bool                parse       (bool);
                 bool                reset       (stream_t *);
                 Node*               getRootNode ();
+                size_t              getNodesCount() const;
                 void                print       ();
 
             private:
@@ -51,6 +52,7 @@ namespace adaptive
                 stream_t            *stream;
 
                 xml_reader_t        *vlc_reader;
+                size_t              nodes;
 
                 Node*   processNode             (bool);
                 void    addAttributesToNode     (Node *node);
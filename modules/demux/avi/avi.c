@@ -30,7 +30,9 @@
 #endif
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <limits.h>
+#include <sys/stat.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
@@ -43,6 +45,9 @@
 #include <vlc_codecs.h>
 #include <vlc_charset.h>
 #include <vlc_memory.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+#include <vlc_url.h>
 
 #include "libavi.h"
 #include "../rawdv.h"
@@ -58,18 +63,24 @@
     "Recreate a index for the AVI file. Use this if your AVI file is damaged "\
     "or incomplete (not seekable)." )
 
+#define INDEX_CACHE_TEXT N_("Cache rebuilt indexes")
+#define INDEX_CACHE_LONGTEXT N_( \
+    "Store the indexes built for damaged or incomplete AVI files in the " \
+    "cache directory, and use them when the same file is opened again." )
+
 #define BI_RAWRGB 0x00
 #define BI_RGBBITFIELDS 0x03
 
 static int  Open ( vlc_object_t * );
 static void Close( vlc_object_t * );
 
-static const int pi_index[] = {0,1,2,3};
+static const int pi_index[] = {0,1,2,3,4};
 
 static const char *const ppsz_indexes[] = { N_("Ask for action"),
                                             N_("Always fix"),
                                             N_("Never fix"),
-                                            N_("Fix when necessary")};
+                                            N_("Fix when necessary"),
+                                            N_("Fix in background")};
 
 vlc_module_begin ()
     set_shortname( "AVI" )
@@ -83,6 +94,8 @@ vlc_module_begin ()
     add_integer( "avi-index", 0,
               INDEX_TEXT, INDEX_LONGTEXT, false )
         change_integer_list( pi_index, ppsz_indexes )
+    add_bool( "avi-index-cache", false,
+              INDEX_CACHE_TEXT, INDEX_CACHE_LONGTEXT, true )
 
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -141,6 +154,8 @@ static void avi_index_Init( avi_index_t * );
 static void avi_index_Clean( avi_index_t * );
 static void avi_index_Append( avi_index_t *, off_t *, avi_entry_t * );
 
+typedef struct avi_indexer_t avi_indexer_t;
+
 typedef struct
 {
     bool            b_activated;
@@ -191,6 +206,13 @@ struct demux_sys_t
     off_t   i_movi_begin;
     off_t   i_movi_lastchunk_pos;   /* XXX position of last valid chunk */
 
+    /* index being built in the background */
+    avi_indexer_t *p_indexer;
+
+    /* trick play */
+    mtime_t i_keyframe_stride; /* 0 when demuxing every chunk */
+    mtime_t i_keyframe_next;   /* earliest time of the next keyframe */
+
     /* number of streams and information */
     unsigned int i_track;
     avi_track_t  **track;
@@ -222,17 +244,25 @@ static int AVI_StreamBytesSet ( demux_t *,
 vlc_fourcc_t AVI_FourccGetCodec( unsigned int i_cat, vlc_fourcc_t );
 static int   AVI_GetKeyFlag    ( vlc_fourcc_t , uint8_t * );
 
-static int AVI_PacketGetHeader( demux_t *, avi_packet_t *p_pk );
-static int AVI_PacketNext     ( demux_t * );
-static int AVI_PacketSearch   ( demux_t * );
+static int AVI_PacketGetHeader( stream_t *, avi_packet_t *p_pk );
+static int AVI_PacketNext     ( stream_t * );
+static int AVI_PacketSearch   ( demux_t *, stream_t * );
 
 static void AVI_IndexLoad    ( demux_t * );
 static void AVI_IndexCreate  ( demux_t * );
+static int  AVI_IndexCacheLoad( demux_t * );
+static void AVI_IndexCacheSave( demux_t *, const avi_index_t *, off_t );
+
+static int  AVI_IndexerStart( demux_t * );
+static void AVI_IndexerStop ( demux_t * );
+static void AVI_IndexerPoll ( demux_t * );
+static int  AVI_IndexerSeek ( demux_t *, mtime_t i_date, int i_percent );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
 static void AVI_DvHandleAudio( demux_t *, avi_track_t *, block_t * );
 
+static mtime_t  AVI_TrackGetLength( avi_track_t *, const avi_index_t * );
 static mtime_t  AVI_MovieGetLength( demux_t * );
 
 static void AVI_MetaLoad( demux_t *, avi_chunk_list_t *p_riff, avi_chunk_avih_t *p_avih );
@@ -731,7 +761,8 @@ static int Open( vlc_object_t * p_this )
 aviindex:
         if( p_sys->b_fastseekable )
         {
-            AVI_IndexCreate( p_demux );
+            if( AVI_IndexCacheLoad( p_demux ) )
+                AVI_IndexCreate( p_demux );
         }
         else if( p_sys->b_seekable )
         {
@@ -765,13 +796,27 @@ aviindex:
     {
         msg_Warn( p_demux, "broken or missing index, 'seek' will be "
                            "approximative or will exhibit strange behavior" );
-        if( (i_do_index == 0 || i_do_index == 3) && !b_index )
+        if( (i_do_index == 0 || i_do_index == 3 || i_do_index == 4) && !b_index )
         {
             if( !p_sys->b_fastseekable ) {
                 b_index = true;
                 goto aviindex;
             }
-            if( i_do_index == 0 )
+            if( AVI_IndexCacheLoad( p_demux ) == VLC_SUCCESS )
+            {
+                msg_Dbg( p_demux, "using cached AVI index" );
+                p_sys->i_length = AVI_MovieGetLength( p_demux );
+            }
+            else if( i_do_index == 4 &&
+                     AVI_IndexerStart( p_demux ) == VLC_SUCCESS )
+            {
+                /* Play without index until it covers the seek targets */
+                msg_Dbg( p_demux, "Fixing AVI index in background" );
+                p_sys->i_length = 0;
+                p_sys->b_indexloaded = true;
+                p_demux->pf_demux = Demux_UnSeekable;
+            }
+            else if( i_do_index == 0 )
             {
                 const char *psz_msg = _(
                     "Because this AVI file index is broken or missing, "
@@ -878,6 +923,9 @@ static void Close ( vlc_object_t * p_this )
     demux_t *    p_demux = (demux_t *)p_this;
     demux_sys_t *p_sys = p_demux->p_sys  ;
 
+    if( p_sys->p_indexer != NULL )
+        AVI_IndexerStop( p_demux );
+
     for( unsigned int i = 0; i < p_sys->i_track; i++ )
     {
         if( p_sys->track[i] )
@@ -992,10 +1040,72 @@ typedef struct
                    else : point on data directly */
 } avi_track_toread_t;
 
+static avi_track_t *AVI_GetKeyframeTrack( demux_sys_t *p_sys )
+{
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+        if( tk->b_activated && tk->i_cat == VIDEO_ES &&
+            tk->i_samplesize == 0 && tk->idx.i_size > 0 )
+            return tk;
+    }
+    return NULL;
+}
+
+/* Trick play: only send the first keyframe of the video track found at
+ * least i_keyframe_stride after the previous one */
+static int Demux_Keyframes( demux_t *p_demux, avi_track_t *tk )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( ; tk->i_idxposc < tk->idx.i_size; tk->i_idxposc++ )
+    {
+        const avi_entry_t *p_entry = &tk->idx.p_entry[tk->i_idxposc];
+        const mtime_t i_dts = AVI_GetPTS( tk );
+
+        if( !( p_entry->i_flags & AVIIF_KEYFRAME ) ||
+            i_dts < p_sys->i_keyframe_next )
+            continue;
+
+        tk->i_idxposb = 0;
+        if( vlc_stream_Seek( p_demux->s, p_entry->i_pos ) )
+            break;
+
+        block_t *p_frame = ReadFrame( p_demux, tk, 8, p_entry->i_length + 8 );
+        tk->i_idxposc++;
+        if( p_frame == NULL )
+        {
+            msg_Warn( p_demux, "failed reading data" );
+            return VLC_DEMUXER_EGENERIC;
+        }
+        p_frame->i_dts = VLC_TS_0 + i_dts;
+        p_frame->i_pts = VLC_TS_INVALID;
+        p_frame->i_flags = BLOCK_FLAG_TYPE_I;
+
+        p_sys->i_time = i_dts;
+        p_sys->i_keyframe_next = i_dts + p_sys->i_keyframe_stride;
+        es_out_Control( p_demux->out, ES_OUT_SET_PCR, VLC_TS_0 + i_dts );
+        es_out_Send( p_demux->out, tk->p_es, p_frame );
+        return VLC_DEMUXER_SUCCESS;
+    }
+
+    return VLC_DEMUXER_EOF;
+}
+
 static int Demux_Seekable( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    if( p_sys->p_indexer != NULL )
+        AVI_IndexerPoll( p_demux );
+
+    if( p_sys->i_keyframe_stride > 0 )
+    {
+        avi_track_t *tk = AVI_GetKeyframeTrack( p_sys );
+        if( tk != NULL )
+            return Demux_Keyframes( p_demux, tk );
+    }
+
     unsigned int i_track_count = 0;
     unsigned int i_track;
     /* cannot be more than 100 stream (dcXX or wbXX) */
@@ -1138,7 +1248,7 @@ static int Demux_Seekable( demux_t *p_demux )
             if( p_sys->b_seekable && p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
             {
                 vlc_stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return( AVI_TrackStopFinishedStreams( p_demux ) ? 0 : 1 );
                 }
@@ -1152,7 +1262,7 @@ static int Demux_Seekable( demux_t *p_demux )
             {
                 avi_packet_t avi_pk;
 
-                if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+                if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
                 {
                     msg_Warn( p_demux,
                              "cannot get packet header, track disabled" );
@@ -1161,7 +1271,7 @@ static int Demux_Seekable( demux_t *p_demux )
                 if( avi_pk.i_stream >= p_sys->i_track ||
                     ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
                 {
-                    if( AVI_PacketNext( p_demux ) )
+                    if( AVI_PacketNext( p_demux->s ) )
                     {
                         msg_Warn( p_demux,
                                   "cannot skip packet, track disabled" );
@@ -1202,7 +1312,7 @@ static int Demux_Seekable( demux_t *p_demux )
                     }
                     else
                     {
-                        if( AVI_PacketNext( p_demux ) )
+                        if( AVI_PacketNext( p_demux->s ) )
                         {
                             msg_Warn( p_demux,
                                       "cannot skip packet, track disabled" );
@@ -1350,6 +1460,13 @@ static int Demux_UnSeekable( demux_t *p_demux )
     unsigned int i_stream;
     unsigned int i_packet;
 
+    if( p_sys->p_indexer != NULL )
+    {
+        AVI_IndexerPoll( p_demux );
+        if( p_demux->pf_demux != Demux_UnSeekable )
+            return p_demux->pf_demux( p_demux );
+    }
+
     es_out_Control( p_demux->out, ES_OUT_SET_PCR, VLC_TS_0 + p_sys->i_time );
 
     /* *** find master stream for data packet skipping algo *** */
@@ -1402,7 +1519,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
 
         avi_packet_t    avi_pk;
 
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             return VLC_DEMUXER_EOF;
         }
@@ -1419,18 +1536,18 @@ static int Demux_UnSeekable( demux_t *p_demux )
                 case AVIFOURCC_JUNK:
                 case AVIFOURCC_LIST:
                 case AVIFOURCC_RIFF:
-                    return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                    return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                 case AVIFOURCC_idx1:
                     if( p_sys->b_odml )
                     {
-                        return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                        return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                     }
                     return VLC_DEMUXER_EOF;
                 default:
                     msg_Warn( p_demux,
                               "seems to have lost position @%"PRIu64", resync",
                               vlc_stream_Tell(p_demux->s) );
-                    if( AVI_PacketSearch( p_demux ) )
+                    if( AVI_PacketSearch( p_demux, p_demux->s ) )
                     {
                         msg_Err( p_demux, "resync failed" );
                         return VLC_DEMUXER_EGENERIC;
@@ -1466,7 +1583,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
             }
             else
             {
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return VLC_DEMUXER_EOF;
                 }
@@ -1506,6 +1623,19 @@ static int Seek( demux_t *p_demux, mtime_t i_date, int i_percent )
     {
         int64_t i_pos_backup = vlc_stream_Tell( p_demux->s );
 
+        if( p_sys->p_indexer != NULL )
+            AVI_IndexerPoll( p_demux );
+
+        bool b_date = i_date >= 0 && p_sys->i_length > 0;
+
+        /* Only seek within the part of the file indexed so far */
+        if( p_sys->p_indexer != NULL )
+        {
+            if( AVI_IndexerSeek( p_demux, i_date, i_percent ) )
+                return VLC_EGENERIC;
+            b_date = i_date >= 0;
+        }
+
         /* Check and lazy load indexes if it was not done (not fastseekable) */
         if ( !p_sys->b_indexloaded && ( p_sys->i_avih_flags & AVIF_HASINDEX ) )
         {
@@ -1528,7 +1658,7 @@ static int Seek( demux_t *p_demux, mtime_t i_date, int i_percent )
             p_sys->b_indexloaded = true; /* we don't want to try each time */
         }
 
-        if( !p_sys->i_length )
+        if( !b_date )
         {
             avi_track_t *p_stream = NULL;
             unsigned i_stream = 0;
@@ -1605,6 +1735,7 @@ static int Seek( demux_t *p_demux, mtime_t i_date, int i_percent )
             p_stream->b_eof = AVI_TrackSeek( p_demux, i_stream, i_date ) != 0;
         }
         p_sys->i_time = i_date;
+        p_sys->i_keyframe_next = i_date;
         es_out_Control( p_demux->out, ES_OUT_SET_PCR, VLC_TS_0 + p_sys->i_time );
         es_out_Control( p_demux->out, ES_OUT_SET_NEXT_DISPLAY_TIME, VLC_TS_0 + p_sys->i_time );
         msg_Dbg( p_demux, "seek: %"PRId64" seconds", p_sys->i_time /CLOCK_FREQ );
@@ -1667,6 +1798,11 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             {
                 return VLC_EGENERIC;
             }
+            else if( p_sys->p_indexer != NULL )
+            {
+                /* the length is not known until the index is complete */
+                return Seek( p_demux, -1, (int)(f * 100) );
+            }
             else
             {
                 i64 = (mtime_t)(f * CLOCK_FREQ * p_sys->i_length);
@@ -1703,6 +1839,27 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             *pi64 = p_sys->i_length * (mtime_t)CLOCK_FREQ;
             return VLC_SUCCESS;
 
+        case DEMUX_SET_KEYFRAME_STRIDE:
+            i64 = (int64_t)va_arg( args, int64_t );
+            if( i64 > 0 )
+            {
+                /* Only with the complete index */
+                if( !p_sys->b_seekable || !p_sys->b_indexloaded ||
+                    p_sys->p_indexer != NULL ||
+                    AVI_GetKeyframeTrack( p_sys ) == NULL )
+                    return VLC_EGENERIC;
+                if( p_sys->i_keyframe_stride == 0 )
+                    p_sys->i_keyframe_next = p_sys->i_time;
+                p_sys->i_keyframe_stride = i64;
+                return VLC_SUCCESS;
+            }
+            if( p_sys->i_keyframe_stride == 0 )
+                return VLC_SUCCESS;
+            p_sys->i_keyframe_stride = 0;
+            /* Realign all the tracks on the last keyframe */
+            return Seek( p_demux, p_sys->i_time, p_sys->i_length > 0 ?
+                         100 * p_sys->i_time / (p_sys->i_length*CLOCK_FREQ) : 0 );
+
         case DEMUX_GET_FPS:
             pf = (double*)va_arg( args, double * );
             *pf = 0.0;
@@ -1837,7 +1994,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
     if( p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
     {
         vlc_stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-        if( AVI_PacketNext( p_demux ) )
+        if( AVI_PacketNext( p_demux->s ) )
         {
             return VLC_EGENERIC;
         }
@@ -1849,7 +2006,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
 
     for( ;; )
     {
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             msg_Warn( p_demux, "cannot get packet header" );
             return VLC_EGENERIC;
@@ -1857,7 +2014,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
         if( avi_pk.i_stream >= p_sys->i_track ||
             ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
         {
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -1891,7 +2048,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
                 return VLC_SUCCESS;
             }
 
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -2189,17 +2346,17 @@ static void AVI_ParseStreamHeader( vlc_fourcc_t i_id,
 /****************************************************************************
  *
  ****************************************************************************/
-static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
+static int AVI_PacketGetHeader( stream_t *s, avi_packet_t *p_pk )
 {
     const uint8_t *p_peek;
 
-    if( vlc_stream_Peek( p_demux->s, &p_peek, 16 ) < 16 )
+    if( vlc_stream_Peek( s, &p_peek, 16 ) < 16 )
     {
         return VLC_EGENERIC;
     }
     p_pk->i_fourcc  = VLC_FOURCC( p_peek[0], p_peek[1], p_peek[2], p_peek[3] );
     p_pk->i_size    = GetDWLE( p_peek + 4 );
-    p_pk->i_pos     = vlc_stream_Tell( p_demux->s );
+    p_pk->i_pos     = vlc_stream_Tell( s );
     if( p_pk->i_fourcc == AVIFOURCC_LIST || p_pk->i_fourcc == AVIFOURCC_RIFF )
     {
         p_pk->i_type = VLC_FOURCC( p_peek[8],  p_peek[9],
@@ -2216,12 +2373,12 @@ static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketNext( demux_t *p_demux )
+static int AVI_PacketNext( stream_t *s )
 {
     avi_packet_t    avi_ck;
     size_t          i_skip = 0;
 
-    if( AVI_PacketGetHeader( p_demux, &avi_ck ) )
+    if( AVI_PacketGetHeader( s, &avi_ck ) )
     {
         return VLC_EGENERIC;
     }
@@ -2246,7 +2403,7 @@ static int AVI_PacketNext( demux_t *p_demux )
     if( i_skip > SSIZE_MAX )
         return VLC_EGENERIC;
 
-    ssize_t i_ret = vlc_stream_Read( p_demux->s, NULL, i_skip );
+    ssize_t i_ret = vlc_stream_Read( s, NULL, i_skip );
     if( i_ret < 0 || (size_t) i_ret != i_skip )
     {
         return VLC_EGENERIC;
@@ -2254,7 +2411,7 @@ static int AVI_PacketNext( demux_t *p_demux )
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketSearch( demux_t *p_demux )
+static int AVI_PacketSearch( demux_t *p_demux, stream_t *s )
 {
     demux_sys_t     *p_sys = p_demux->p_sys;
     avi_packet_t    avi_pk;
@@ -2262,11 +2419,11 @@ static int AVI_PacketSearch( demux_t *p_demux )
 
     for( ;; )
     {
-        if( vlc_stream_Read( p_demux->s, NULL, 1 ) != 1 )
+        if( vlc_stream_Read( s, NULL, 1 ) != 1 )
         {
             return VLC_EGENERIC;
         }
-        AVI_PacketGetHeader( p_demux, &avi_pk );
+        AVI_PacketGetHeader( s, &avi_pk );
         if( avi_pk.i_stream < p_sys->i_track &&
             ( avi_pk.i_cat == AUDIO_ES || avi_pk.i_cat == VIDEO_ES ) )
         {
@@ -2615,18 +2772,23 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
-static void AVI_IndexCreate( demux_t *p_demux )
+/* Scans LIST-movi and appends every chunk to p_idx (one index per track).
+ * pf_progress is called regularly with the current position and aborts the
+ * scan when it returns false. Appends are done with p_lock held, if any.
+ * Returns VLC_SUCCESS if the whole movie was scanned. */
+static int AVI_IndexScan( demux_t *p_demux, stream_t *s,
+                          avi_index_t *p_idx, off_t *pi_last_pos,
+                          vlc_mutex_t *p_lock,
+                          bool (*pf_progress)( demux_t *, void *, off_t ),
+                          void *p_data )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
     avi_chunk_list_t *p_riff;
     avi_chunk_list_t *p_movi;
 
-    unsigned int i_stream;
     off_t i_movi_end;
-
-    mtime_t i_dialog_update;
-    vlc_dialog_id *p_dialog_id = NULL;
+    mtime_t i_progress_update;
 
     p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
     p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
@@ -2634,48 +2796,30 @@ static void AVI_IndexCreate( demux_t *p_demux )
     if( !p_movi )
     {
         msg_Err( p_demux, "cannot find p_movi" );
-        return;
+        return VLC_EGENERIC;
     }
 
-    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
-        avi_index_Init( &p_sys->track[i_stream]->idx );
-
     i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
-                        stream_Size( p_demux->s ) );
-
-    vlc_stream_Seek( p_demux->s, p_movi->i_chunk_pos + 12 );
-    msg_Warn( p_demux, "creating index from LIST-movi, will take time !" );
-
+                        stream_Size( s ) );
 
-    /* Only show dialog if AVI is > 10MB */
-    i_dialog_update = mdate();
-    if( stream_Size( p_demux->s ) > 10000000 )
-    {
-        p_dialog_id =
-            vlc_dialog_display_progress( p_demux, false, 0.0, _("Cancel"),
-                                         _("Broken or missing AVI Index"),
-                                         _("Fixing AVI Index...") );
-    }
+    if( vlc_stream_Seek( s, p_movi->i_chunk_pos + 12 ) )
+        return VLC_EGENERIC;
 
+    i_progress_update = mdate();
     for( ;; )
     {
         avi_packet_t pk;
 
-        /* Don't update/check dialog too often */
-        if( p_dialog_id != NULL && mdate() - i_dialog_update > 100000 )
+        /* Don't report progress too often */
+        if( pf_progress != NULL && mdate() - i_progress_update > 100000 )
         {
-            if( vlc_dialog_is_cancelled( p_demux, p_dialog_id ) )
-                break;
-
-            double f_current = vlc_stream_Tell( p_demux->s );
-            double f_size    = stream_Size( p_demux->s );
-            double f_pos     = f_current / f_size;
-            vlc_dialog_update_progress( p_demux, p_dialog_id, f_pos );
+            if( !pf_progress( p_demux, p_data, vlc_stream_Tell( s ) ) )
+                return VLC_EGENERIC;
 
-            i_dialog_update = mdate();
+            i_progress_update = mdate();
         }
 
-        if( AVI_PacketGetHeader( p_demux, &pk ) )
+        if( AVI_PacketGetHeader( s, &pk ) )
             break;
 
         if( pk.i_stream < p_sys->i_track &&
@@ -2689,7 +2833,12 @@ static void AVI_IndexCreate( demux_t *p_demux )
             index.i_pos     = pk.i_pos;
             index.i_length  = pk.i_size;
             index.i_lengthtotal = pk.i_size;
-            avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
+
+            if( p_lock != NULL )
+                vlc_mutex_lock( p_lock );
+            avi_index_Append( &p_idx[pk.i_stream], pi_last_pos, &index );
+            if( p_lock != NULL )
+                vlc_mutex_unlock( p_lock );
         }
         else
         {
@@ -2703,12 +2852,11 @@ static void AVI_IndexCreate( demux_t *p_demux )
                                             AVIFOURCC_RIFF, 1 );
 
                     msg_Dbg( p_demux, "looking for new RIFF chunk" );
-                    if( vlc_stream_Seek( p_demux->s,
-                                         p_sysx->i_chunk_pos + 24 ) )
-                        goto print_stat;
+                    if( vlc_stream_Seek( s, p_sysx->i_chunk_pos + 24 ) )
+                        return VLC_SUCCESS;
                     break;
                 }
-                goto print_stat;
+                return VLC_SUCCESS;
 
             case AVIFOURCC_RIFF:
                     msg_Dbg( p_demux, "new RIFF chunk found" );
@@ -2720,30 +2868,598 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
             default:
                 msg_Warn( p_demux, "need resync, probably broken avi" );
-                if( AVI_PacketSearch( p_demux ) )
+                if( AVI_PacketSearch( p_demux, s ) )
                 {
                     msg_Warn( p_demux, "lost sync, abord index creation" );
-                    goto print_stat;
+                    return VLC_SUCCESS;
                 }
             }
         }
 
         if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
-            AVI_PacketNext( p_demux ) )
+            AVI_PacketNext( s ) )
         {
             break;
         }
     }
+    return VLC_SUCCESS;
+}
+
+static bool AVI_IndexCreateProgress( demux_t *p_demux, void *p_data,
+                                     off_t i_pos )
+{
+    vlc_dialog_id *p_dialog_id = p_data;
+
+    if( vlc_dialog_is_cancelled( p_demux, p_dialog_id ) )
+        return false;
+
+    double f_current = i_pos;
+    double f_size    = stream_Size( p_demux->s );
+    vlc_dialog_update_progress( p_demux, p_dialog_id, f_current / f_size );
+    return true;
+}
+
+static void AVI_IndexCreate( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    vlc_dialog_id *p_dialog_id = NULL;
+
+    assert( p_sys->i_track <= 100 );
+    avi_index_t p_idx[p_sys->i_track];
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        avi_index_Init( &p_idx[i] );
+
+    msg_Warn( p_demux, "creating index from LIST-movi, will take time !" );
+
+    /* Only show dialog if AVI is > 10MB */
+    if( stream_Size( p_demux->s ) > 10000000 )
+    {
+        p_dialog_id =
+            vlc_dialog_display_progress( p_demux, false, 0.0, _("Cancel"),
+                                         _("Broken or missing AVI Index"),
+                                         _("Fixing AVI Index...") );
+    }
+
+    off_t i_last_pos = p_sys->i_movi_lastchunk_pos;
+    int i_ret = AVI_IndexScan( p_demux, p_demux->s, p_idx, &i_last_pos, NULL,
+                               p_dialog_id ? AVI_IndexCreateProgress : NULL,
+                               p_dialog_id );
 
-print_stat:
     if( p_dialog_id != NULL )
         vlc_dialog_release( p_demux, p_dialog_id );
 
-    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+    if( i_ret == VLC_SUCCESS )
+        AVI_IndexCacheSave( p_demux, p_idx, i_last_pos );
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
     {
+        avi_index_Clean( &p_sys->track[i]->idx );
+        p_sys->track[i]->idx = p_idx[i];
+
         msg_Dbg( p_demux, "stream[%d] creating %d index entries",
-                i_stream, p_sys->track[i_stream]->idx.i_size );
+                 i, p_idx[i].i_size );
+    }
+    p_sys->i_movi_lastchunk_pos = i_last_pos;
+    p_sys->b_indexloaded = true;
+}
+
+/*****************************************************************************
+ * Background index creation:
+ *  Playback starts with Demux_UnSeekable while a second stream scans the
+ *  file. Seeking is allowed as soon as the index covers the target, and the
+ *  complete index replaces the current one once the scan is over.
+ *****************************************************************************/
+struct avi_indexer_t
+{
+    vlc_thread_t thread;
+    vlc_mutex_t  lock;
+    stream_t    *s;
+
+    /* Protected by lock */
+    avi_index_t *p_idx;         /* one per track */
+    off_t        i_last_pos;
+    off_t        i_scan_pos;
+    bool         b_stop;
+    bool         b_done;
+};
+
+static bool AVI_IndexerProgress( demux_t *p_demux, void *p_data, off_t i_pos )
+{
+    avi_indexer_t *p_indexer = p_data;
+    bool b_stop;
+
+    vlc_mutex_lock( &p_indexer->lock );
+    p_indexer->i_scan_pos = i_pos;
+    b_stop = p_indexer->b_stop;
+    vlc_mutex_unlock( &p_indexer->lock );
+
+    (void) p_demux;
+    return !b_stop;
+}
+
+static void *AVI_IndexerThread( void *data )
+{
+    demux_t *p_demux = data;
+    avi_indexer_t *p_indexer = p_demux->p_sys->p_indexer;
+
+    int i_ret = AVI_IndexScan( p_demux, p_indexer->s, p_indexer->p_idx,
+                               &p_indexer->i_last_pos, &p_indexer->lock,
+                               AVI_IndexerProgress, p_indexer );
+
+    /* Nothing else writes the index anymore */
+    if( i_ret == VLC_SUCCESS )
+        AVI_IndexCacheSave( p_demux, p_indexer->p_idx, p_indexer->i_last_pos );
+
+    vlc_mutex_lock( &p_indexer->lock );
+    p_indexer->b_done = true;
+    vlc_mutex_unlock( &p_indexer->lock );
+    return NULL;
+}
+
+static int AVI_IndexerStart( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* Reading the file twice is only reasonable for local files */
+    if( p_demux->psz_file == NULL || !p_sys->b_fastseekable )
+        return VLC_EGENERIC;
+
+    avi_indexer_t *p_indexer = calloc( 1, sizeof(*p_indexer) );
+    if( unlikely(p_indexer == NULL) )
+        return VLC_EGENERIC;
+    p_indexer->p_idx = calloc( p_sys->i_track, sizeof(*p_indexer->p_idx) );
+    if( unlikely(p_indexer->p_idx == NULL) )
+        goto error;
+
+    char *psz_url = vlc_path2uri( p_demux->psz_file, NULL );
+    if( psz_url == NULL )
+        goto error;
+    p_indexer->s = vlc_stream_NewURL( VLC_OBJECT(p_demux), psz_url );
+    free( psz_url );
+    if( p_indexer->s == NULL )
+        goto error;
+
+    p_indexer->i_last_pos = p_sys->i_movi_lastchunk_pos;
+    vlc_mutex_init( &p_indexer->lock );
+    p_sys->p_indexer = p_indexer;
+    if( vlc_clone( &p_indexer->thread, AVI_IndexerThread, p_demux,
+                   VLC_THREAD_PRIORITY_LOW ) )
+    {
+        p_sys->p_indexer = NULL;
+        vlc_mutex_destroy( &p_indexer->lock );
+        vlc_stream_Delete( p_indexer->s );
+        goto error;
+    }
+    return VLC_SUCCESS;
+
+error:
+    free( p_indexer->p_idx );
+    free( p_indexer );
+    return VLC_EGENERIC;
+}
+
+static void AVI_IndexerStop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_indexer_t *p_indexer = p_sys->p_indexer;
+
+    vlc_mutex_lock( &p_indexer->lock );
+    p_indexer->b_stop = true;
+    vlc_mutex_unlock( &p_indexer->lock );
+    vlc_join( p_indexer->thread, NULL );
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        avi_index_Clean( &p_indexer->p_idx[i] );
+    free( p_indexer->p_idx );
+    vlc_stream_Delete( p_indexer->s );
+    vlc_mutex_destroy( &p_indexer->lock );
+    free( p_indexer );
+    p_sys->p_indexer = NULL;
+}
+
+/* Reads the selection state that Demux_UnSeekable does not track */
+static void AVI_IndexerActivate( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+        bool b;
+
+        es_out_Control( p_demux->out, ES_OUT_GET_ES_STATE, tk->p_es, &b );
+        if( tk->p_es_dv_audio )
+        {
+            bool b_extra;
+            es_out_Control( p_demux->out, ES_OUT_GET_ES_STATE,
+                            tk->p_es_dv_audio, &b_extra );
+            b |= b_extra;
+        }
+        tk->b_activated = b;
+    }
+}
+
+/* Makes the index built so far the current one, for tracks where it is
+ * longer. Called with the indexer lock. */
+static void AVI_IndexerCopy( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_indexer_t *p_indexer = p_sys->p_indexer;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+        const avi_index_t *p_src = &p_indexer->p_idx[i];
+
+        if( p_src->i_size <= tk->idx.i_size )
+            continue;
+
+        avi_entry_t *p_entry = malloc( p_src->i_size * sizeof(*p_entry) );
+        if( unlikely(p_entry == NULL) )
+            continue;
+        memcpy( p_entry, p_src->p_entry, p_src->i_size * sizeof(*p_entry) );
+
+        avi_index_Clean( &tk->idx );
+        tk->idx.p_entry = p_entry;
+        tk->idx.i_size  = tk->idx.i_max = p_src->i_size;
+    }
+    p_sys->i_movi_lastchunk_pos = __MAX( p_sys->i_movi_lastchunk_pos,
+                                         p_indexer->i_last_pos );
+}
+
+/* Finds the first entry at or after i_pos */
+static unsigned AVI_IndexFindPos( const avi_index_t *p_index, off_t i_pos )
+{
+    unsigned i_low = 0, i_high = p_index->i_size;
+
+    while( i_low < i_high )
+    {
+        unsigned i_mid = (i_low + i_high) / 2;
+        if( p_index->p_entry[i_mid].i_pos < i_pos )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/* Replaces the index of a track, keeping the read position */
+static void AVI_IndexerAdopt( demux_t *p_demux, unsigned i_stream,
+                              avi_index_t *p_index, bool b_unseekable )
+{
+    avi_track_t *tk = p_demux->p_sys->track[i_stream];
+
+    if( b_unseekable )
+    {
+        /* Demux_UnSeekable counts chunks, or bytes for sample based
+         * tracks, without any index */
+        avi_index_Clean( &tk->idx );
+        tk->idx = *p_index;
+
+        if( tk->i_samplesize )
+        {
+            int64_t i_byte = tk->i_idxposb;
+            int64_t i_total = 0;
+
+            if( tk->idx.i_size > 0 )
+                i_total = tk->idx.p_entry[tk->idx.i_size - 1].i_lengthtotal +
+                          tk->idx.p_entry[tk->idx.i_size - 1].i_length;
+
+            tk->i_idxposc = 0;
+            tk->i_idxposb = 0;
+            if( i_byte >= i_total )
+                tk->i_idxposc = tk->idx.i_size;
+            else
+                AVI_StreamBytesSet( p_demux, i_stream, i_byte );
+        }
+        else
+            tk->i_idxposc = __MIN( tk->i_idxposc, tk->idx.i_size );
+        return;
+    }
+
+    /* Find the chunk being read in the new index */
+    unsigned i_idxposc = tk->i_idxposc;
+    unsigned i_idxposb = tk->i_idxposb;
+    if( i_idxposc < tk->idx.i_size )
+    {
+        off_t i_pos = tk->idx.p_entry[i_idxposc].i_pos;
+
+        i_idxposc = AVI_IndexFindPos( p_index, i_pos );
+        if( i_idxposc >= p_index->i_size ||
+            p_index->p_entry[i_idxposc].i_pos != i_pos )
+            i_idxposb = 0;
+    }
+    else if( tk->idx.i_size > 0 )
+    {
+        off_t i_pos = tk->idx.p_entry[tk->idx.i_size - 1].i_pos;
+
+        i_idxposc = AVI_IndexFindPos( p_index, i_pos + 1 );
+        i_idxposb = 0;
+    }
+
+    avi_index_Clean( &tk->idx );
+    tk->idx = *p_index;
+    tk->i_idxposc = i_idxposc;
+    tk->i_idxposb = i_idxposb;
+}
+
+/* Switches to the complete index once the background scan is over */
+static void AVI_IndexerPoll( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_indexer_t *p_indexer = p_sys->p_indexer;
+    bool b_done;
+
+    vlc_mutex_lock( &p_indexer->lock );
+    b_done = p_indexer->b_done;
+    vlc_mutex_unlock( &p_indexer->lock );
+    if( !b_done )
+        return;
+
+    vlc_join( p_indexer->thread, NULL );
+
+    const bool b_unseekable = p_demux->pf_demux == Demux_UnSeekable;
+    if( b_unseekable )
+        AVI_IndexerActivate( p_demux );
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        AVI_IndexerAdopt( p_demux, i, &p_indexer->p_idx[i], b_unseekable );
+        msg_Dbg( p_demux, "stream[%u] created %u index entries in background",
+                 i, p_sys->track[i]->idx.i_size );
+    }
+    p_sys->i_movi_lastchunk_pos = __MAX( p_sys->i_movi_lastchunk_pos,
+                                         p_indexer->i_last_pos );
+
+    free( p_indexer->p_idx );
+    vlc_stream_Delete( p_indexer->s );
+    vlc_mutex_destroy( &p_indexer->lock );
+    free( p_indexer );
+    p_sys->p_indexer = NULL;
+
+    p_sys->i_length = AVI_MovieGetLength( p_demux );
+    p_demux->pf_demux = Demux_Seekable;
+}
+
+/* Makes the index built so far usable if it covers the seek target (a date,
+ * or a percentage of the file if i_date is negative). */
+static int AVI_IndexerSeek( demux_t *p_demux, mtime_t i_date, int i_percent )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_indexer_t *p_indexer = p_sys->p_indexer;
+    bool b_covered = false;
+    off_t i_scan_pos;
+
+    vlc_mutex_lock( &p_indexer->lock );
+    i_scan_pos = p_indexer->i_scan_pos;
+    if( i_date >= 0 )
+    {
+        for( unsigned i = 0; i < p_sys->i_track && !b_covered; i++ )
+            b_covered = i_date < AVI_TrackGetLength( p_sys->track[i],
+                                                     &p_indexer->p_idx[i] );
+    }
+    else
+        b_covered = (int64_t)i_percent * stream_Size( p_demux->s ) / 100
+                        < i_scan_pos;
+    if( b_covered )
+        AVI_IndexerCopy( p_demux );
+    vlc_mutex_unlock( &p_indexer->lock );
+
+    if( !b_covered )
+    {
+        msg_Warn( p_demux, "cannot seek yet, index is being built (%"PRId64"%%)",
+                  100 * (int64_t)i_scan_pos / __MAX( stream_Size( p_demux->s ), 1 ) );
+        return VLC_EGENERIC;
+    }
+
+    if( p_demux->pf_demux == Demux_UnSeekable )
+    {
+        AVI_IndexerActivate( p_demux );
+        p_demux->pf_demux = Demux_Seekable;
+    }
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Index cache:
+ *  Rebuilt indexes are stored in the user cache directory, under the MD5 of
+ *  the file path, and are only used again if the file size and modification
+ *  time still match.
+ *****************************************************************************/
+#define AVI_INDEX_CACHE_MAGIC   "VLCAVIDX"
+#define AVI_INDEX_CACHE_VERSION 1
+#define AVI_INDEX_CACHE_HEADER  40
+#define AVI_INDEX_CACHE_ENTRY   20
+
+static char *AVI_IndexCachePath( demux_t *p_demux, uint64_t *pi_size,
+                                 uint64_t *pi_mtime )
+{
+    struct stat st;
+    struct md5_s md5;
+    char *psz_dir, *psz_hash, *psz_path;
+
+    if( p_demux->psz_file == NULL ||
+        !var_InheritBool( p_demux, "avi-index-cache" ) ||
+        vlc_stat( p_demux->psz_file, &st ) )
+        return NULL;
+    *pi_size  = st.st_size;
+    *pi_mtime = st.st_mtime;
+
+    psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_dir == NULL )
+        return NULL;
+
+    InitMD5( &md5 );
+    AddMD5( &md5, p_demux->psz_file, strlen( p_demux->psz_file ) );
+    EndMD5( &md5 );
+    psz_hash = psz_md5_hash( &md5 );
+
+    if( psz_hash == NULL ||
+        asprintf( &psz_path, "%s"DIR_SEP"avi-index"DIR_SEP"%s.idx",
+                  psz_dir, psz_hash ) == -1 )
+        psz_path = NULL;
+    free( psz_hash );
+    free( psz_dir );
+    return psz_path;
+}
+
+static int AVI_IndexCacheLoad( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint64_t i_size, i_mtime;
+    uint8_t p_buf[AVI_INDEX_CACHE_HEADER];
+    int i_ret = VLC_EGENERIC;
+
+    char *psz_path = AVI_IndexCachePath( p_demux, &i_size, &i_mtime );
+    if( psz_path == NULL )
+        return VLC_EGENERIC;
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    free( psz_path );
+    if( p_file == NULL )
+        return VLC_EGENERIC;
+
+    if( fread( p_buf, AVI_INDEX_CACHE_HEADER, 1, p_file ) != 1 ||
+        memcmp( p_buf, AVI_INDEX_CACHE_MAGIC, 8 ) ||
+        GetDWLE( &p_buf[8] ) != AVI_INDEX_CACHE_VERSION ||
+        GetDWLE( &p_buf[12] ) != p_sys->i_track ||
+        GetQWLE( &p_buf[16] ) != i_size ||
+        GetQWLE( &p_buf[24] ) != i_mtime )
+    {
+        fclose( p_file );
+        return VLC_EGENERIC;
+    }
+
+    assert( p_sys->i_track <= 100 );
+    avi_index_t p_idx[p_sys->i_track];
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        avi_index_Init( &p_idx[i] );
+    off_t i_last_pos = GetQWLE( &p_buf[32] );
+
+    unsigned i_track;
+    for( i_track = 0; i_track < p_sys->i_track; i_track++ )
+    {
+        uint8_t p_count[4];
+        if( fread( p_count, 4, 1, p_file ) != 1 )
+            break;
+
+        uint32_t i_count = GetDWLE( p_count );
+        uint32_t i;
+        for( i = 0; i < i_count; i++ )
+        {
+            uint8_t p_entry[AVI_INDEX_CACHE_ENTRY];
+            if( fread( p_entry, AVI_INDEX_CACHE_ENTRY, 1, p_file ) != 1 )
+                break;
+
+            avi_entry_t index;
+            index.i_id     = GetDWLE( &p_entry[0] );
+            index.i_flags  = GetDWLE( &p_entry[4] );
+            index.i_pos    = GetQWLE( &p_entry[8] );
+            index.i_length = GetDWLE( &p_entry[16] );
+            index.i_lengthtotal = index.i_length;
+            avi_index_Append( &p_idx[i_track], &i_last_pos, &index );
+            if( p_idx[i_track].p_entry == NULL )
+                break;
+        }
+        if( i < i_count )
+            break;
+    }
+    fclose( p_file );
+
+    if( i_track == p_sys->i_track )
+    {
+        for( unsigned i = 0; i < p_sys->i_track; i++ )
+        {
+            avi_index_Clean( &p_sys->track[i]->idx );
+            p_sys->track[i]->idx = p_idx[i];
+            msg_Dbg( p_demux, "stream[%u] loaded %u cached index entries",
+                     i, p_idx[i].i_size );
+        }
+        p_sys->i_movi_lastchunk_pos = i_last_pos;
+        p_sys->b_indexloaded = true;
+        i_ret = VLC_SUCCESS;
+    }
+    else
+    {
+        msg_Warn( p_demux, "cannot read cached index" );
+        for( unsigned i = 0; i < p_sys->i_track; i++ )
+            avi_index_Clean( &p_idx[i] );
+    }
+    return i_ret;
+}
+
+static void AVI_IndexCacheSave( demux_t *p_demux, const avi_index_t *p_idx,
+                                off_t i_last_pos )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint64_t i_size, i_mtime;
+    uint8_t p_buf[AVI_INDEX_CACHE_HEADER];
+    char *psz_tmp;
+    bool b_error = false;
+
+    char *psz_path = AVI_IndexCachePath( p_demux, &i_size, &i_mtime );
+    if( psz_path == NULL )
+        return;
+
+    /* Create the cache directories if needed */
+    for( char *psz_sep = strchr( psz_path + 1, DIR_SEP_CHAR );
+         psz_sep != NULL; psz_sep = strchr( psz_sep + 1, DIR_SEP_CHAR ) )
+    {
+        *psz_sep = '\0';
+        vlc_mkdir( psz_path, 0700 );
+        *psz_sep = DIR_SEP_CHAR;
+    }
+
+    if( asprintf( &psz_tmp, "%s.tmp", psz_path ) == -1 )
+    {
+        free( psz_path );
+        return;
+    }
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( p_file == NULL )
+    {
+        msg_Warn( p_demux, "cannot create index cache %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        goto out;
+    }
+
+    memcpy( p_buf, AVI_INDEX_CACHE_MAGIC, 8 );
+    SetDWLE( &p_buf[8], AVI_INDEX_CACHE_VERSION );
+    SetDWLE( &p_buf[12], p_sys->i_track );
+    SetQWLE( &p_buf[16], i_size );
+    SetQWLE( &p_buf[24], i_mtime );
+    SetQWLE( &p_buf[32], i_last_pos );
+    b_error = fwrite( p_buf, AVI_INDEX_CACHE_HEADER, 1, p_file ) != 1;
+
+    for( unsigned i = 0; i < p_sys->i_track && !b_error; i++ )
+    {
+        uint8_t p_count[4];
+        SetDWLE( p_count, p_idx[i].i_size );
+        b_error = fwrite( p_count, 4, 1, p_file ) != 1;
+
+        for( unsigned j = 0; j < p_idx[i].i_size && !b_error; j++ )
+        {
+            const avi_entry_t *p_entry = &p_idx[i].p_entry[j];
+            uint8_t p_data[AVI_INDEX_CACHE_ENTRY];
+
+            SetDWLE( &p_data[0], p_entry->i_id );
+            SetDWLE( &p_data[4], p_entry->i_flags );
+            SetQWLE( &p_data[8], p_entry->i_pos );
+            SetDWLE( &p_data[16], p_entry->i_length );
+            b_error = fwrite( p_data, AVI_INDEX_CACHE_ENTRY, 1, p_file ) != 1;
+        }
     }
+
+    if( fclose( p_file ) || b_error || vlc_rename( psz_tmp, psz_path ) )
+    {
+        msg_Warn( p_demux, "cannot write index cache %s", psz_path );
+        vlc_unlink( psz_tmp );
+    }
+    else
+        msg_Dbg( p_demux, "index cached in %s", psz_path );
+out:
+    free( psz_tmp );
+    free( psz_path );
 }
 
 /* */
@@ -3010,6 +3726,25 @@ static int AVI_TrackStopFinishedStreams( demux_t *p_demux )
     return( b_end );
 }
 
+/****************************************************************************
+ * AVI_TrackGetLength give the length of a stream covered by an index
+ ****************************************************************************/
+static mtime_t  AVI_TrackGetLength( avi_track_t *tk, const avi_index_t *p_index )
+{
+    if( p_index->i_size < 1 || !p_index->p_entry )
+    {
+        return 0;
+    }
+
+    if( tk->i_samplesize )
+    {
+        return AVI_GetDPTS( tk,
+                            p_index->p_entry[p_index->i_size-1].i_lengthtotal +
+                                p_index->p_entry[p_index->i_size-1].i_length );
+    }
+    return AVI_GetDPTS( tk, p_index->i_size );
+}
+
 /****************************************************************************
  * AVI_MovieGetLength give max streams length in second
  ****************************************************************************/
@@ -3030,16 +3765,7 @@ static mtime_t  AVI_MovieGetLength( demux_t *p_demux )
             continue;
         }
 
-        if( tk->i_samplesize )
-        {
-            i_length = AVI_GetDPTS( tk,
-                                    tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal +
-                                        tk->idx.p_entry[tk->idx.i_size-1].i_length );
-        }
-        else
-        {
-            i_length = AVI_GetDPTS( tk, tk->idx.i_size );
-        }
+        i_length = AVI_TrackGetLength( tk, &tk->idx );
         i_length /= CLOCK_FREQ;    /* in seconds */
 
         msg_Dbg( p_demux,
@@ -32,6 +32,7 @@
 #include "DASHManager.h"
 #include "mpd/ProgramInformation.h"
 #include "mpd/IsoffMainParser.h"
+#include "mpd/IsoffMainRefresher.h"
 #include "xml/DOMParser.h"
 #include "xml/Node.h"
 #include "../adaptive/tools/Helper.h"
@@ -40,6 +41,7 @@
 #include <vlc_demux.h>
 #include <vlc_meta.h>
 #include <vlc_block.h>
+#include <vlc_md5.h>
 #include "../adaptive/tools/Retrieve.hpp"
 
 #include <algorithm>
@@ -54,6 +56,7 @@ DASHManager::DASHManager(demux_t *demux_, MPD *mpd,
                          AbstractAdaptationLogic::LogicType type) :
              PlaylistManager(demux_, mpd, factory, type)
 {
+    memset(mpdDigest, 0, sizeof(mpdDigest));
 }
 
 DASHManager::~DASHManager   ()
@@ -107,17 +110,26 @@ bool DASHManager::updatePlaylist()
         if(!p_block)
             return false;
 
-        stream_t *mpdstream = vlc_stream_MemoryNew(p_demux, p_block->p_buffer, p_block->i_buffer, true);
-        if(!mpdstream)
+        const mtime_t i_start = mdate();
+
+        /* Unchanged manifest, there's nothing to merge */
+        struct md5_s md5;
+        InitMD5(&md5);
+        AddMD5(&md5, p_block->p_buffer, p_block->i_buffer);
+        EndMD5(&md5);
+        if(!memcmp(mpdDigest, md5.buf, sizeof(mpdDigest)))
         {
+            msg_Dbg(p_demux, "Refreshed MPD is unchanged");
+            var_SetInteger(p_demux, "adaptive-refresh-time", mdate() - i_start);
+            var_SetInteger(p_demux, "adaptive-refresh-allocations", 0);
             block_Release(p_block);
-            return false;
+            return true;
         }
+        memcpy(mpdDigest, md5.buf, sizeof(mpdDigest));
 
-        xml::DOMParser parser(mpdstream);
-        if(!parser.parse(true))
+        stream_t *mpdstream = vlc_stream_MemoryNew(p_demux, p_block->p_buffer, p_block->i_buffer, true);
+        if(!mpdstream)
         {
-            vlc_stream_Delete(mpdstream);
             block_Release(p_block);
             return false;
         }
@@ -131,14 +143,50 @@ bool DASHManager::updatePlaylist()
                 minsegmentTime = segmentTime;
         }
 
-        IsoffMainParser mpdparser(parser.getRootNode(), VLC_OBJECT(p_demux),
-                                  mpdstream, Helper::getDirectoryPath(url).append("/"));
-        MPD *newmpd = mpdparser.parse();
-        if(newmpd)
+        /* Merge the new timeline elements while reading, and only
+           build and merge a whole new MPD if that's not enough.
+           Merging what was already merged again is harmless. */
+        size_t i_allocations;
+        bool b_merged;
         {
-            playlist->mergeWith(newmpd, minsegmentTime);
-            delete newmpd;
+            IsoffMainRefresher refresher(playlist, minsegmentTime);
+            b_merged = refresher.refresh(mpdstream);
+            i_allocations = refresher.getAppendedCount();
         }
+
+        if(b_merged)
+        {
+            msg_Dbg(p_demux, "Refreshed MPD: %zu bytes, %zu new timeline elements, "
+                             "merged in %" PRId64 "us",
+                    p_block->i_buffer, i_allocations, mdate() - i_start);
+        }
+        else
+        {
+            xml::DOMParser parser(mpdstream);
+            if(vlc_stream_Seek(mpdstream, 0) || !parser.parse(true))
+            {
+                vlc_stream_Delete(mpdstream);
+                block_Release(p_block);
+                return false;
+            }
+
+            IsoffMainParser mpdparser(parser.getRootNode(), VLC_OBJECT(p_demux),
+                                      mpdstream, Helper::getDirectoryPath(url).append("/"));
+            MPD *newmpd = mpdparser.parse();
+            if(newmpd)
+            {
+                playlist->mergeWith(newmpd, minsegmentTime);
+                delete newmpd;
+            }
+
+            i_allocations += parser.getNodesCount();
+            msg_Dbg(p_demux, "Refreshed MPD: %zu bytes, %zu nodes, parsed and merged in %" PRId64 "us",
+                    p_block->i_buffer, parser.getNodesCount(), mdate() - i_start);
+        }
+
+        var_SetInteger(p_demux, "adaptive-refresh-time", mdate() - i_start);
+        var_SetInteger(p_demux, "adaptive-refresh-allocations", i_allocations);
+
         vlc_stream_Delete(mpdstream);
         block_Release(p_block);
     }
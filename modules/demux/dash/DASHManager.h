@@ -57,6 +57,9 @@ namespace dash
 
         protected:
             virtual int doControl(int, va_list); /* reimpl */
+
+        private:
+            uint8_t mpdDigest[16]; /* of the last refreshed MPD */
     };
 
 }
@@ -0,0 +1,306 @@
+/*
+ * IsoffMainRefresher.cpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "IsoffMainRefresher.h"
+#include "../adaptive/playlist/AbstractPlaylist.hpp"
+#include "../adaptive/playlist/BasePeriod.h"
+#include "../adaptive/playlist/SegmentInformation.hpp"
+#include "../adaptive/playlist/SegmentTimeline.h"
+#include "../adaptive/ID.hpp"
+#include <vlc_stream.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace dash::mpd;
+using namespace adaptive;
+using namespace adaptive::playlist;
+
+/* Nesting of the elements merged by ID, Periods being merged by index */
+static const char *const levels[] = { "Period", "AdaptationSet", "Representation" };
+
+IsoffMainRefresher::IsoffMainRefresher(AbstractPlaylist *playlist_, mtime_t prunebarrier_)
+{
+    playlist = playlist_;
+    prunebarrier = prunebarrier_;
+    reader = NULL;
+    b_empty = false;
+    appended = 0;
+}
+
+IsoffMainRefresher::~IsoffMainRefresher()
+{
+    if(reader)
+        xml_ReaderDelete(reader);
+}
+
+size_t IsoffMainRefresher::getAppendedCount() const
+{
+    return appended;
+}
+
+bool IsoffMainRefresher::refresh(stream_t *stream)
+{
+    if(!reader && !(reader = xml_ReaderCreate(stream, stream)))
+        return false;
+
+    const char *name;
+    int type;
+    while((type = xml_ReaderNextNode(reader, &name)) > 0 &&
+          type != XML_READER_STARTELEM);
+    if(type != XML_READER_STARTELEM)
+        return false;
+    b_empty = xml_ReaderIsEmptyElement(reader);
+
+    /* Like the full parser, ignores whatever follows the root element */
+    return b_empty || refreshPeriods();
+}
+
+/* Moves to the next child of the current element: returns 1 on a child
+ * element, 0 at the end of the current element and -1 on error.
+ * Whether the child is empty has to be known before reading its
+ * attributes, as the reader then no longer is on the element. */
+int IsoffMainRefresher::nextChild(const char **name)
+{
+    int type;
+    while((type = xml_ReaderNextNode(reader, name)) > 0)
+    {
+        if(type == XML_READER_STARTELEM)
+        {
+            b_empty = xml_ReaderIsEmptyElement(reader);
+            return 1;
+        }
+        if(type == XML_READER_ENDELEM)
+            return 0;
+    }
+    return -1;
+}
+
+/* Skips the current element, but fails on a descendant named lookedup,
+ * as the full parser looks those up at any depth, not only as children */
+bool IsoffMainRefresher::skip(const char *lookedup)
+{
+    if(b_empty)
+        return true;
+
+    const char *name;
+    int ret;
+    while((ret = nextChild(&name)) > 0)
+    {
+        if(lookedup && !strcmp(name, lookedup))
+            return false;
+        if(!skip(lookedup))
+            return false;
+    }
+    return ret == 0;
+}
+
+bool IsoffMainRefresher::refreshPeriods()
+{
+    const std::vector<BasePeriod *> &periods = playlist->getPeriods();
+    size_t index = 0;
+    const char *name;
+    int ret;
+
+    while((ret = nextChild(&name)) > 0)
+    {
+        if(!strcmp(name, levels[0]))
+        {
+            SegmentInformation *period = NULL;
+            if(index < periods.size())
+                period = periods.at(index);
+            index++;
+            if(!refreshInformation(period, 0))
+                return false;
+        }
+        else if(!skip(levels[0]))
+        {
+            return false;
+        }
+    }
+    return ret == 0;
+}
+
+/* Refreshes a Period, AdaptationSet or Representation from its element,
+ * the unknown ones (NULL) being skipped */
+bool IsoffMainRefresher::refreshInformation(SegmentInformation *info, unsigned level)
+{
+    const char *childname = (level + 1 < ARRAY_SIZE(levels)) ? levels[level + 1] : NULL;
+
+    if(!info)
+        return skip(NULL);
+    if(b_empty)
+        return true;
+
+    /* Only the first element with a given ID is merged */
+    std::vector<SegmentInformation *> refreshed;
+    uint64_t nextid = 0;
+    bool b_template = false;
+    const char *name;
+    int ret;
+
+    while((ret = nextChild(&name)) > 0)
+    {
+        if(childname && !strcmp(name, childname))
+        {
+            const char *attr, *value;
+            std::string id;
+            bool b_id = false;
+            while((attr = xml_ReaderNextAttr(reader, &value)))
+            {
+                if(!strcmp(attr, "id"))
+                {
+                    id = value;
+                    b_id = true;
+                }
+            }
+
+            SegmentInformation *child = info->getChildByID(b_id ? ID(id) : ID(nextid++));
+            if(child)
+            {
+                if(std::find(refreshed.begin(), refreshed.end(), child) != refreshed.end())
+                    child = NULL;
+                else
+                    refreshed.push_back(child);
+            }
+            if(!refreshInformation(child, level + 1))
+                return false;
+        }
+        else if(!strcmp(name, "SegmentTemplate") && !b_template)
+        {
+            b_template = true;
+            if(!refreshTemplate(info->getSegmentTimeline(), childname))
+                return false;
+        }
+        else if(!strcmp(name, "SegmentList"))
+        {
+            return false;
+        }
+        else if(!skip(childname))
+        {
+            return false;
+        }
+    }
+    return ret == 0;
+}
+
+bool IsoffMainRefresher::refreshTemplate(SegmentTimeline *timeline, const char *lookedup)
+{
+    const char *attr, *value;
+    uint64_t number = 1;
+    bool b_media = false;
+    while((attr = xml_ReaderNextAttr(reader, &value)))
+    {
+        if(!strcmp(attr, "media"))
+            b_media = *value;
+        else if(!strcmp(attr, "startNumber"))
+            number = strtoull(value, NULL, 10);
+    }
+
+    /* Not merged without a timeline on both sides */
+    if(!timeline || !b_media || b_empty)
+        return skip(lookedup);
+
+    bool b_timeline = false;
+    const char *name;
+    int ret;
+    while((ret = nextChild(&name)) > 0)
+    {
+        if(!strcmp(name, "SegmentTimeline") && !b_timeline)
+        {
+            b_timeline = true;
+            if(!refreshTimeline(timeline, number))
+                return false;
+        }
+        else if(!skip(lookedup))
+        {
+            return false;
+        }
+    }
+    return ret == 0;
+}
+
+bool IsoffMainRefresher::refreshTimeline(SegmentTimeline *timeline, uint64_t number)
+{
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(reader, &value)))
+    {
+        if(!strcmp(attr, "startNumber"))
+            number = strtoull(value, NULL, 10);
+    }
+
+    if(!b_empty)
+    {
+        /* a missing or zero start time follows the previous element */
+        stime_t next = 0;
+        bool b_first = true;
+        const char *name;
+        int ret;
+        while((ret = nextChild(&name)) > 0)
+        {
+            if(strcmp(name, "S"))
+            {
+                if(!skip("S"))
+                    return false;
+                continue;
+            }
+
+            stime_t t = 0, d = 0;
+            uint64_t r = 0; // never repeats by default
+            bool b_d = false;
+            while((attr = xml_ReaderNextAttr(reader, &value)))
+            {
+                if(!strcmp(attr, "t"))
+                    t = strtoll(value, NULL, 10);
+                else if(!strcmp(attr, "d"))
+                {
+                    d = strtoll(value, NULL, 10);
+                    b_d = true;
+                }
+                else if(!strcmp(attr, "r"))
+                    r = strtoull(value, NULL, 10);
+            }
+            if(!skip(NULL))
+                return false;
+            if(!b_d) /* Mandatory */
+                continue;
+
+            if(!b_first && !t)
+                t = next;
+            if(timeline->updateWith(number, d, r, t))
+                appended++;
+            number += (1 + r);
+            next = t + d * (stime_t)(r + 1);
+            b_first = false;
+        }
+        if(ret != 0)
+            return false;
+    }
+
+    if(prunebarrier)
+        timeline->pruneByPlaybackTime(prunebarrier);
+    return true;
+}
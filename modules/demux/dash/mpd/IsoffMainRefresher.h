@@ -0,0 +1,79 @@
+/*
+ * IsoffMainRefresher.h
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef ISOFFMAINREFRESHER_H_
+#define ISOFFMAINREFRESHER_H_
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_xml.h>
+
+namespace adaptive
+{
+    namespace playlist
+    {
+        class AbstractPlaylist;
+        class SegmentInformation;
+        class SegmentTimeline;
+    }
+}
+
+namespace dash
+{
+    namespace mpd
+    {
+        using namespace adaptive::playlist;
+
+        /* Merges a refreshed MPD into the playlist while reading it, with the
+         * same outcome as IsoffMainParser and AbstractPlaylist::mergeWith(),
+         * but without building its tree nor a new playlist: the unknown
+         * Periods, AdaptationSets and Representations are skipped, and only
+         * the new SegmentTimeline elements of the known ones are appended.
+         * Fails whenever the full parser is needed (SegmentList, misplaced
+         * elements, errors), in which case it is safe to parse and merge the
+         * same MPD again. */
+        class IsoffMainRefresher
+        {
+            public:
+                IsoffMainRefresher(AbstractPlaylist *, mtime_t);
+                ~IsoffMainRefresher();
+                bool    refresh(stream_t *);
+                size_t  getAppendedCount() const;
+
+            private:
+                int     nextChild(const char **);
+                bool    skip(const char *);
+                bool    refreshPeriods();
+                bool    refreshInformation(SegmentInformation *, unsigned);
+                bool    refreshTemplate(SegmentTimeline *, const char *);
+                bool    refreshTimeline(SegmentTimeline *, uint64_t);
+
+                AbstractPlaylist *playlist;
+                mtime_t           prunebarrier;
+                xml_reader_t     *reader;
+                bool              b_empty;
+                size_t            appended;
+        };
+    }
+}
+
+#endif /* ISOFFMAINREFRESHER_H_ */
@@ -0,0 +1,282 @@
+/*****************************************************************************
+ * IsoffMainRefresher_test.cpp: incremental MPD refresh tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "IsoffMainRefresher.h"
+#include "IsoffMainParser.h"
+#include "MPD.h"
+#include "../adaptive/playlist/BasePeriod.h"
+#include "../adaptive/playlist/BaseAdaptationSet.h"
+#include "../adaptive/playlist/BaseRepresentation.h"
+#include "../adaptive/playlist/SegmentTimeline.h"
+#include "../adaptive/xml/DOMParser.h"
+#include "../../../../lib/libvlc_internal.h"
+
+#include <vlc_stream.h>
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+using namespace dash::mpd;
+using namespace adaptive::playlist;
+
+/* Video segments 5 to 7 at 10, 12 and 14 s, then 8 at 16 s. Audio segments
+ * 1 and 2 at 10 and 13 s. */
+static const char initial[] =
+    "<MPD type=\"dynamic\" minimumUpdatePeriod=\"PT2S\">"
+    " <Period start=\"PT0S\">"
+    "  <AdaptationSet id=\"1\" mimeType=\"video/mp4\">"
+    "   <SegmentTemplate media=\"v$Number$.m4s\" timescale=\"10\" startNumber=\"5\">"
+    "    <SegmentTimeline>"
+    "     <S t=\"100\" d=\"20\" r=\"2\"/><S d=\"10\"/>"
+    "    </SegmentTimeline>"
+    "   </SegmentTemplate>"
+    "   <Representation id=\"v1\" bandwidth=\"1000\"/>"
+    "   <Representation id=\"v2\" bandwidth=\"2000\"/>"
+    "  </AdaptationSet>"
+    "  <AdaptationSet mimeType=\"audio/mp4\">"
+    "   <Representation bandwidth=\"100\">"
+    "    <SegmentTemplate media=\"a$Time$.m4s\" timescale=\"10\">"
+    "     <SegmentTimeline><S t=\"100\" d=\"30\" r=\"1\"/></SegmentTimeline>"
+    "    </SegmentTemplate>"
+    "   </Representation>"
+    "  </AdaptationSet>"
+    " </Period>"
+    "</MPD>";
+
+/* Slid and extended timelines, new Periods, AdaptationSets and
+ * Representations to be skipped, and elements the merge ignores */
+static const char refreshed[] =
+    "<?xml version=\"1.0\"?>"
+    "<MPD type=\"dynamic\" minimumUpdatePeriod=\"PT2S\">"
+    " <BaseURL>http://example.com/</BaseURL>"
+    " <Period start=\"PT0S\">"
+    "  <AdaptationSet id=\"1\" mimeType=\"video/mp4\">"
+    "   <ContentProtection schemeIdUri=\"urn:mpeg:dash:mp4protection:2011\"/>"
+    "   <SegmentTemplate media=\"v$Number$.m4s\" timescale=\"10\" startNumber=\"6\">"
+    "    <SegmentTimeline>"
+    "     <S t=\"120\" d=\"20\" r=\"1\"/><S d=\"10\"/><S d=\"10\" r=\"2\"/>"
+    "     <S r=\"4\"/>"
+    "     <S t=\"300\" d=\"20\"></S>"
+    "    </SegmentTimeline>"
+    "    <SegmentTimeline><S t=\"0\" d=\"1000\"/></SegmentTimeline>"
+    "   </SegmentTemplate>"
+    "   <SegmentTemplate media=\"x$Number$.m4s\">"
+    "    <SegmentTimeline><S t=\"0\" d=\"1000\"/></SegmentTimeline>"
+    "   </SegmentTemplate>"
+    "   <Representation id=\"v1\" bandwidth=\"1000\"><BaseURL>v1/</BaseURL></Representation>"
+    "   <Representation id=\"v3\" bandwidth=\"3000\">"
+    "    <SegmentTemplate media=\"v3$Number$.m4s\">"
+    "     <SegmentTimeline><S t=\"0\" d=\"1000\"/></SegmentTimeline>"
+    "    </SegmentTemplate>"
+    "   </Representation>"
+    "   <Representation id=\"v2\" bandwidth=\"2000\"/>"
+    "  </AdaptationSet>"
+    "  <AdaptationSet id=\"text\" mimeType=\"application/mp4\">"
+    "   <Representation id=\"t1\" bandwidth=\"10\">"
+    "    <SegmentList duration=\"10\"><SegmentURL media=\"t.m4s\"/></SegmentList>"
+    "   </Representation>"
+    "  </AdaptationSet>"
+    "  <AdaptationSet mimeType=\"audio/mp4\">"
+    "   <Role schemeIdUri=\"urn:mpeg:dash:role:2011\" value=\"main\"/>"
+    "   <Representation bandwidth=\"100\">"
+    "    <SegmentTemplate media=\"a$Time$.m4s\" timescale=\"10\">"
+    "     <SegmentTimeline><S t=\"130\" d=\"30\" r=\"2\"/></SegmentTimeline>"
+    "    </SegmentTemplate>"
+    "   </Representation>"
+    "  </AdaptationSet>"
+    " </Period>"
+    " <Period start=\"PT60S\">"
+    "  <AdaptationSet><SegmentList/></AdaptationSet>"
+    " </Period>"
+    "</MPD>";
+
+static const char *const fallbacks[] = {
+    /* A segment list to merge */
+    "<MPD><Period><AdaptationSet id=\"1\"><Representation id=\"v1\">"
+    "<SegmentList duration=\"10\"><SegmentURL media=\"v.m4s\"/></SegmentList>"
+    "</Representation></AdaptationSet></Period></MPD>",
+    /* Elements the full parser would find deeper */
+    "<MPD><Location><Period/></Location></MPD>",
+    "<MPD><Period><EventStream><AdaptationSet/></EventStream></Period></MPD>",
+    "<MPD><Period><AdaptationSet id=\"1\"><SegmentTemplate media=\"v\">"
+    "<SegmentTimeline><Foo><S d=\"10\"/></Foo></SegmentTimeline>"
+    "</SegmentTemplate></AdaptationSet></Period></MPD>",
+    /* Truncated */
+    "<MPD><Period><AdaptationSet id=\"1\">",
+    "",
+};
+
+static stream_t *open(vlc_object_t *obj, const char *xml)
+{
+    stream_t *s = vlc_stream_MemoryNew(obj, (uint8_t *)xml, strlen(xml), true);
+    assert(s != NULL);
+    return s;
+}
+
+static MPD *parse(vlc_object_t *obj, const char *xml)
+{
+    stream_t *s = open(obj, xml);
+    adaptive::xml::DOMParser parser(s);
+    assert(parser.parse(true));
+    IsoffMainParser mpdparser(parser.getRootNode(), obj, s, "http://example.com/");
+    MPD *mpd = mpdparser.parse();
+    assert(mpd != NULL);
+    vlc_stream_Delete(s);
+    return mpd;
+}
+
+static size_t refresh(vlc_object_t *obj, MPD *mpd, const char *xml, mtime_t prunebarrier)
+{
+    stream_t *s = open(obj, xml);
+    IsoffMainRefresher refresher(mpd, prunebarrier);
+    assert(refresher.refresh(s));
+    vlc_stream_Delete(s);
+    return refresher.getAppendedCount();
+}
+
+static void checkSame(const SegmentTimeline *a, const SegmentTimeline *b)
+{
+    assert((a == NULL) == (b == NULL));
+    if(a == NULL)
+        return;
+
+    assert(a->minElementNumber() == b->minElementNumber());
+    assert(a->maxElementNumber() == b->maxElementNumber());
+    assert(a->start() == b->start());
+    assert(a->end() == b->end());
+    for(uint64_t number = a->minElementNumber(); number <= a->maxElementNumber(); number++)
+    {
+        stime_t ta, da, tb, db;
+        assert(a->getScaledPlaybackTimeDurationBySegmentNumber(number, &ta, &da));
+        assert(b->getScaledPlaybackTimeDurationBySegmentNumber(number, &tb, &db));
+        assert(ta == tb && da == db);
+    }
+}
+
+/* Compares the timelines of both playlists, of the same structure */
+static void checkSame(MPD *a, MPD *b)
+{
+    const std::vector<BasePeriod *> &pa = a->getPeriods(), &pb = b->getPeriods();
+    assert(pa.size() == pb.size());
+    for(size_t i = 0; i < pa.size(); i++)
+    {
+        checkSame(pa[i]->getSegmentTimeline(), pb[i]->getSegmentTimeline());
+
+        const std::vector<BaseAdaptationSet *> &sa = pa[i]->getAdaptationSets(),
+                                               &sb = pb[i]->getAdaptationSets();
+        assert(sa.size() == sb.size());
+        for(size_t j = 0; j < sa.size(); j++)
+        {
+            checkSame(sa[j]->getSegmentTimeline(), sb[j]->getSegmentTimeline());
+
+            std::vector<BaseRepresentation *> &ra = sa[j]->getRepresentations(),
+                                              &rb = sb[j]->getRepresentations();
+            assert(ra.size() == rb.size());
+            for(size_t k = 0; k < ra.size(); k++)
+                checkSame(ra[k]->getSegmentTimeline(), rb[k]->getSegmentTimeline());
+        }
+    }
+}
+
+static const SegmentTimeline *getTimeline(MPD *mpd, size_t set, size_t rep)
+{
+    BaseAdaptationSet *adaptSet = mpd->getPeriods().front()->getAdaptationSets().at(set);
+    if(rep == SIZE_MAX)
+        return adaptSet->getSegmentTimeline();
+    return adaptSet->getRepresentations().at(rep)->getSegmentTimeline();
+}
+
+int main(void)
+{
+    const char *argv[] = { "vlc", NULL };
+
+    setenv("VLC_PLUGIN_PATH", ".", 1);
+    libvlc_int_t *libvlc = libvlc_InternalCreate();
+    assert(libvlc != NULL);
+    assert(libvlc_InternalInit(libvlc, 1, argv) == 0);
+    vlc_object_t *obj = VLC_OBJECT(libvlc);
+
+    /* Same outcome as a full parse and merge, pruned before 15 s */
+    {
+        MPD *incremental = parse(obj, initial);
+        MPD *full = parse(obj, initial);
+
+        assert(refresh(obj, incremental, refreshed, 15 * CLOCK_FREQ) == 2);
+        MPD *updated = parse(obj, refreshed);
+        full->mergeWith(updated, 15 * CLOCK_FREQ);
+        delete updated;
+        checkSame(incremental, full);
+
+        const SegmentTimeline *video = getTimeline(incremental, 0, SIZE_MAX);
+        assert(video->minElementNumber() == 7);
+        assert(video->maxElementNumber() == 12);
+        assert(video->getScaledPlaybackTimeByElementNumber(9) == 170);
+        assert(video->getScaledPlaybackTimeByElementNumber(12) == 300);
+        assert(getTimeline(incremental, 0, 0) == NULL);
+
+        const SegmentTimeline *audio = getTimeline(incremental, 1, 0);
+        assert(audio->minElementNumber() == 2);
+        assert(audio->maxElementNumber() == 4);
+        assert(audio->end() == 22 * CLOCK_FREQ);
+
+        /* Again, nothing new */
+        assert(refresh(obj, incremental, refreshed, 15 * CLOCK_FREQ) == 0);
+        checkSame(incremental, full);
+
+        delete incremental;
+        delete full;
+    }
+
+    /* Without pruning */
+    {
+        MPD *incremental = parse(obj, initial);
+        MPD *full = parse(obj, initial);
+
+        refresh(obj, incremental, refreshed, 0);
+        MPD *updated = parse(obj, refreshed);
+        full->mergeWith(updated, 0);
+        delete updated;
+        checkSame(incremental, full);
+        assert(getTimeline(incremental, 0, SIZE_MAX)->minElementNumber() == 5);
+
+        delete incremental;
+        delete full;
+    }
+
+    /* Left to the full parser */
+    for(size_t i = 0; i < ARRAY_SIZE(fallbacks); i++)
+    {
+        MPD *mpd = parse(obj, initial);
+        stream_t *s = open(obj, fallbacks[i]);
+        IsoffMainRefresher refresher(mpd, 0);
+        assert(!refresher.refresh(s));
+        vlc_stream_Delete(s);
+        delete mpd;
+    }
+
+    libvlc_InternalCleanup(libvlc);
+    libvlc_InternalDestroy(libvlc);
+    return 0;
+}
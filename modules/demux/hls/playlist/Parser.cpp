@@ -35,6 +35,7 @@
 
 #include <vlc_strings.h>
 #include <vlc_stream.h>
+#include <vlc_md5.h>
 #include <cstdio>
 #include <sstream>
 #include <map>
@@ -158,228 +159,364 @@ void M3U8Parser::createAndFillRepresentation(vlc_object_t *p_obj, BaseAdaptation
     }
 }
 
+class M3U8Parser::SegmentsContext
+{
+    public:
+        SegmentsContext(Representation *rep)
+        {
+            segmentList = new (std::nothrow) SegmentList(rep);
+            totalduration = 0;
+            nzStartTime = 0;
+            absReferenceTime = VLC_TS_INVALID;
+            sequenceNumber = 0;
+            discontinuity = false;
+            prevbyterangeoffset = 0;
+            b_byterange = false;
+            b_extinf = false;
+            extinfDuration = 0.0;
+            b_skip = false;
+            lastKnownNumber = 0;
+            created = skipped = allocations = 0;
+        }
+
+        SegmentList *segmentList;
+        mtime_t totalduration;
+        mtime_t nzStartTime;
+        mtime_t absReferenceTime;
+        uint64_t sequenceNumber;
+        bool discontinuity;
+        std::size_t prevbyterangeoffset;
+        bool b_byterange;
+        std::pair<std::size_t,std::size_t> byterange;
+        bool b_extinf;
+        double extinfDuration;
+        SegmentEncryption encryption;
+        std::string keyUrl; /* fetched on first use */
+
+        bool b_skip;
+        uint64_t lastKnownNumber;
+
+        /* stats */
+        unsigned created;
+        unsigned skipped;
+        unsigned allocations;
+};
+
 bool M3U8Parser::appendSegmentsFromPlaylistURI(vlc_object_t *p_obj, Representation *rep)
 {
     block_t *p_block = Retrieve::HTTP(p_obj, rep->getPlaylistUrl().toString());
-    if(p_block)
+    if(!p_block)
+        return false;
+
+    const mtime_t i_start = mdate();
+
+    /* Live servers often serve the very same playlist a few times
+     * before a new segment is published: don't parse it again */
+    struct md5_s md5;
+    InitMD5(&md5);
+    AddMD5(&md5, p_block->p_buffer, p_block->i_buffer);
+    EndMD5(&md5);
+    if(rep->b_loaded && !memcmp(rep->playlistDigest, md5.buf, sizeof(rep->playlistDigest)))
+    {
+        msg_Dbg(p_obj, "Refreshed playlist ID %s is unchanged", rep->getID().str().c_str());
+        var_SetInteger(p_obj, "adaptive-refresh-time", mdate() - i_start);
+        var_SetInteger(p_obj, "adaptive-refresh-allocations", 0);
+        block_Release(p_block);
+        return true;
+    }
+    memcpy(rep->playlistDigest, md5.buf, sizeof(rep->playlistDigest));
+
+    stream_t *substream = vlc_stream_MemoryNew(p_obj, p_block->p_buffer, p_block->i_buffer, true);
+    if(substream)
     {
-        stream_t *substream = vlc_stream_MemoryNew(p_obj, p_block->p_buffer, p_block->i_buffer, true);
-        if(substream)
+        SegmentsContext ctx(rep);
+        if(ctx.segmentList)
         {
-            std::list<Tag *> tagslist = parseEntries(substream);
-            vlc_stream_Delete(substream);
+            rep->setTimescale(100);
+            rep->b_loaded = true;
+
+            /* Segments up to the last known one will be dropped by the merge,
+             * so they are only accounted, never allocated */
+            std::vector<ISegment *> list;
+            if(rep->getSegments(SegmentInformation::INFOTYPE_MEDIA, list))
+            {
+                ctx.b_skip = true;
+                ctx.lastKnownNumber = list.back()->getSequenceNumber();
+            }
+
+            char *psz_line;
+            while((psz_line = vlc_stream_ReadLine(substream)))
+            {
+                Tag *tag = parseEntry(psz_line);
+                free(psz_line);
+                if(tag)
+                {
+                    ctx.allocations++;
+                    parseSegmentTag(p_obj, rep, ctx, tag);
+                    delete tag;
+                }
+            }
 
-            parseSegments(p_obj, rep, tagslist);
+            endSegments(rep, ctx);
 
-            releaseTagsList(tagslist);
+            const mtime_t i_duration = mdate() - i_start;
+            msg_Dbg(p_obj, "Refreshed playlist ID %s: %u new segments, %u known skipped, "
+                           "%u allocations, parsed in %" PRId64 "us",
+                    rep->getID().str().c_str(), ctx.created, ctx.skipped,
+                    ctx.allocations, i_duration);
+            var_SetInteger(p_obj, "adaptive-refresh-time", i_duration);
+            var_SetInteger(p_obj, "adaptive-refresh-allocations", ctx.allocations);
         }
-        block_Release(p_block);
-        return true;
+        vlc_stream_Delete(substream);
     }
-    return false;
+    block_Release(p_block);
+    return true;
 }
 
 void M3U8Parser::parseSegments(vlc_object_t *p_obj, Representation *rep, const std::list<Tag *> &tagslist)
 {
-    SegmentList *segmentList = new (std::nothrow) SegmentList(rep);
+    SegmentsContext ctx(rep);
+    if(!ctx.segmentList)
+        return;
 
     rep->setTimescale(100);
     rep->b_loaded = true;
 
-    mtime_t totalduration = 0;
-    mtime_t nzStartTime = 0;
-    mtime_t absReferenceTime = VLC_TS_INVALID;
-    uint64_t sequenceNumber = 0;
-    bool discontinuity = false;
-    std::size_t prevbyterangeoffset = 0;
-    const SingleValueTag *ctx_byterange = NULL;
-    SegmentEncryption encryption;
-    const ValuesListTag *ctx_extinf = NULL;
-
     std::list<Tag *>::const_iterator it;
     for(it = tagslist.begin(); it != tagslist.end(); ++it)
+        parseSegmentTag(p_obj, rep, ctx, *it);
+
+    endSegments(rep, ctx);
+}
+
+void M3U8Parser::parseSegmentTag(vlc_object_t *p_obj, Representation *rep,
+                                 SegmentsContext &ctx, const Tag *tag)
+{
+    switch(tag->getType())
     {
-        const Tag *tag = *it;
-        switch(tag->getType())
+        /* using static cast as attribute type permits avoiding class check */
+        case SingleValueTag::EXTXMEDIASEQUENCE:
         {
-            /* using static cast as attribute type permits avoiding class check */
-            case SingleValueTag::EXTXMEDIASEQUENCE:
-            {
-                sequenceNumber = (static_cast<const SingleValueTag*>(tag))->getValue().decimal();
-            }
-            break;
+            ctx.sequenceNumber = (static_cast<const SingleValueTag*>(tag))->getValue().decimal();
+        }
+        break;
 
-            case ValuesListTag::EXTINF:
+        case ValuesListTag::EXTINF:
+        {
+            const Attribute *durAttr = static_cast<const ValuesListTag *>(tag)->getAttributeByName("DURATION");
+            ctx.b_extinf = true;
+            ctx.extinfDuration = durAttr ? durAttr->floatingPoint() : -1.0;
+        }
+        break;
+
+        case SingleValueTag::URI:
+        {
+            const SingleValueTag *uritag = static_cast<const SingleValueTag *>(tag);
+            if(uritag->getValue().value.empty())
             {
-                ctx_extinf = static_cast<const ValuesListTag *>(tag);
+                ctx.b_extinf = false;
+                ctx.b_byterange = false;
+                break;
             }
-            break;
 
-            case SingleValueTag::URI:
+            if(ctx.b_skip && ctx.sequenceNumber + ISegment::SEQUENCE_FIRST <= ctx.lastKnownNumber)
             {
-                const SingleValueTag *uritag = static_cast<const SingleValueTag *>(tag);
-                if(uritag->getValue().value.empty())
+                if(ctx.b_extinf && ctx.extinfDuration >= 0.0)
                 {
-                    ctx_extinf = NULL;
-                    ctx_byterange = NULL;
-                    break;
+                    const mtime_t nzDuration = CLOCK_FREQ * ctx.extinfDuration;
+                    ctx.nzStartTime += nzDuration;
+                    ctx.totalduration += nzDuration;
+                    if(ctx.absReferenceTime > VLC_TS_INVALID)
+                        ctx.absReferenceTime += nzDuration;
                 }
-
-                HLSSegment *segment = new (std::nothrow) HLSSegment(rep, sequenceNumber++);
-                if(!segment)
-                    break;
-
-                segment->setSourceUrl(uritag->getValue().value);
-                if((unsigned)rep->getStreamFormat() == StreamFormat::UNKNOWN)
-                    setFormatFromExtension(rep, uritag->getValue().value);
-
-                if(ctx_extinf)
+                if(ctx.b_byterange)
                 {
-                    if(ctx_extinf->getAttributeByName("DURATION"))
-                    {
-                        const mtime_t nzDuration = CLOCK_FREQ * ctx_extinf->getAttributeByName("DURATION")->floatingPoint();
-                        segment->duration.Set(ctx_extinf->getAttributeByName("DURATION")->floatingPoint() * (uint64_t) rep->getTimescale());
-                        segment->startTime.Set(rep->getTimescale().ToScaled(nzStartTime));
-                        nzStartTime += nzDuration;
-                        totalduration += nzDuration;
-
-                        if(absReferenceTime > VLC_TS_INVALID)
-                        {
-                            segment->utcTime = absReferenceTime;
-                            absReferenceTime += nzDuration;
-                        }
-                    }
-                    ctx_extinf = NULL;
+                    if(ctx.byterange.first == 0)
+                        ctx.byterange.first = ctx.prevbyterangeoffset;
+                    ctx.prevbyterangeoffset = ctx.byterange.first + ctx.byterange.second;
                 }
+                ctx.sequenceNumber++;
+                ctx.skipped++;
+                ctx.b_extinf = false;
+                ctx.b_byterange = false;
+                ctx.discontinuity = false;
+                break;
+            }
 
-                segmentList->addSegment(segment);
+            HLSSegment *segment = new (std::nothrow) HLSSegment(rep, ctx.sequenceNumber++);
+            if(!segment)
+                break;
+            ctx.created++;
+            ctx.allocations++;
 
-                if(ctx_byterange)
-                {
-                    std::pair<std::size_t,std::size_t> range = ctx_byterange->getValue().getByteRange();
-                    if(range.first == 0) /* first == size, second = offset */
-                        range.first = prevbyterangeoffset;
-                    prevbyterangeoffset = range.first + range.second;
-                    segment->setByteRange(range.first, prevbyterangeoffset - 1);
-                    ctx_byterange = NULL;
-                }
+            segment->setSourceUrl(uritag->getValue().value);
+            if((unsigned)rep->getStreamFormat() == StreamFormat::UNKNOWN)
+                setFormatFromExtension(rep, uritag->getValue().value);
 
-                if(discontinuity)
+            if(ctx.b_extinf)
+            {
+                if(ctx.extinfDuration >= 0.0)
                 {
-                    segment->discontinuity = true;
-                    discontinuity = false;
-                }
+                    const mtime_t nzDuration = CLOCK_FREQ * ctx.extinfDuration;
+                    segment->duration.Set(ctx.extinfDuration * (uint64_t) rep->getTimescale());
+                    segment->startTime.Set(rep->getTimescale().ToScaled(ctx.nzStartTime));
+                    ctx.nzStartTime += nzDuration;
+                    ctx.totalduration += nzDuration;
 
-                if(encryption.method != SegmentEncryption::NONE)
-                    segment->setEncryption(encryption);
+                    if(ctx.absReferenceTime > VLC_TS_INVALID)
+                    {
+                        segment->utcTime = ctx.absReferenceTime;
+                        ctx.absReferenceTime += nzDuration;
+                    }
+                }
+                ctx.b_extinf = false;
             }
-            break;
 
-            case SingleValueTag::EXTXTARGETDURATION:
-                rep->targetDuration = static_cast<const SingleValueTag *>(tag)->getValue().decimal();
-                break;
+            ctx.segmentList->addSegment(segment);
 
-            case SingleValueTag::EXTXPLAYLISTTYPE:
-                rep->b_live = (static_cast<const SingleValueTag *>(tag)->getValue().value != "VOD");
-                break;
-
-            case SingleValueTag::EXTXBYTERANGE:
-                ctx_byterange = static_cast<const SingleValueTag *>(tag);
-                break;
+            if(ctx.b_byterange)
+            {
+                std::pair<std::size_t,std::size_t> range = ctx.byterange;
+                if(range.first == 0) /* first == size, second = offset */
+                    range.first = ctx.prevbyterangeoffset;
+                ctx.prevbyterangeoffset = range.first + range.second;
+                segment->setByteRange(range.first, ctx.prevbyterangeoffset - 1);
+                ctx.b_byterange = false;
+            }
 
-            case SingleValueTag::EXTXPROGRAMDATETIME:
-                rep->b_consistent = false;
-                absReferenceTime = VLC_TS_0 +
-                        UTCTime(static_cast<const SingleValueTag *>(tag)->getValue().value).mtime();
-                break;
+            if(ctx.discontinuity)
+            {
+                segment->discontinuity = true;
+                ctx.discontinuity = false;
+            }
 
-            case AttributesTag::EXTXKEY:
+            if(ctx.encryption.method != SegmentEncryption::NONE)
             {
-                const AttributesTag *keytag = static_cast<const AttributesTag *>(tag);
-                if( keytag->getAttributeByName("METHOD") &&
-                    keytag->getAttributeByName("METHOD")->value == "AES-128" &&
-                    keytag->getAttributeByName("URI") )
+                if(!ctx.keyUrl.empty())
                 {
-                    encryption.method = SegmentEncryption::AES_128;
-                    encryption.key.clear();
-
-                    Url keyurl(keytag->getAttributeByName("URI")->quotedString());
-                    if(!keyurl.hasScheme())
-                    {
-                        keyurl.prepend(Helper::getDirectoryPath(rep->getPlaylistUrl().toString()).append("/"));
-                    }
-
-                    block_t *p_block = Retrieve::HTTP(p_obj, keyurl.toString());
+                    block_t *p_block = Retrieve::HTTP(p_obj, ctx.keyUrl);
                     if(p_block)
                     {
                         if(p_block->i_buffer == 16)
                         {
-                            encryption.key.resize(16);
-                            memcpy(&encryption.key[0], p_block->p_buffer, 16);
+                            ctx.encryption.key.resize(16);
+                            memcpy(&ctx.encryption.key[0], p_block->p_buffer, 16);
                         }
                         block_Release(p_block);
                     }
+                    ctx.keyUrl.clear();
+                }
+                segment->setEncryption(ctx.encryption);
+            }
+        }
+        break;
 
-                    if(keytag->getAttributeByName("IV"))
-                    {
-                        encryption.iv.clear();
-                        encryption.iv = keytag->getAttributeByName("IV")->hexSequence();
-                    }
+        case SingleValueTag::EXTXTARGETDURATION:
+            rep->targetDuration = static_cast<const SingleValueTag *>(tag)->getValue().decimal();
+            break;
+
+        case SingleValueTag::EXTXPLAYLISTTYPE:
+            rep->b_live = (static_cast<const SingleValueTag *>(tag)->getValue().value != "VOD");
+            break;
+
+        case SingleValueTag::EXTXBYTERANGE:
+            ctx.b_byterange = true;
+            ctx.byterange = static_cast<const SingleValueTag *>(tag)->getValue().getByteRange();
+            break;
+
+        case SingleValueTag::EXTXPROGRAMDATETIME:
+            rep->b_consistent = false;
+            ctx.absReferenceTime = VLC_TS_0 +
+                    UTCTime(static_cast<const SingleValueTag *>(tag)->getValue().value).mtime();
+            break;
+
+        case AttributesTag::EXTXKEY:
+        {
+            const AttributesTag *keytag = static_cast<const AttributesTag *>(tag);
+            if( keytag->getAttributeByName("METHOD") &&
+                keytag->getAttributeByName("METHOD")->value == "AES-128" &&
+                keytag->getAttributeByName("URI") )
+            {
+                ctx.encryption.method = SegmentEncryption::AES_128;
+                ctx.encryption.key.clear();
+
+                Url keyurl(keytag->getAttributeByName("URI")->quotedString());
+                if(!keyurl.hasScheme())
+                {
+                    keyurl.prepend(Helper::getDirectoryPath(rep->getPlaylistUrl().toString()).append("/"));
                 }
-                else
+
+                /* Only retrieved once a segment uses it, as keys of
+                 * already known segments are not needed again */
+                ctx.keyUrl = keyurl.toString();
+
+                if(keytag->getAttributeByName("IV"))
                 {
-                    /* unsupported or invalid */
-                    encryption.method = SegmentEncryption::NONE;
-                    encryption.key.clear();
-                    encryption.iv.clear();
+                    ctx.encryption.iv.clear();
+                    ctx.encryption.iv = keytag->getAttributeByName("IV")->hexSequence();
                 }
             }
-            break;
+            else
+            {
+                /* unsupported or invalid */
+                ctx.encryption.method = SegmentEncryption::NONE;
+                ctx.encryption.key.clear();
+                ctx.encryption.iv.clear();
+                ctx.keyUrl.clear();
+            }
+        }
+        break;
 
-            case AttributesTag::EXTXMAP:
+        case AttributesTag::EXTXMAP:
+        {
+            const AttributesTag *keytag = static_cast<const AttributesTag *>(tag);
+            const Attribute *uriAttr;
+            if(!ctx.b_skip && /* already set from the first load */
+               keytag && (uriAttr = keytag->getAttributeByName("URI")) &&
+               !ctx.segmentList->initialisationSegment.Get()) /* FIXME: handle discontinuities */
             {
-                const AttributesTag *keytag = static_cast<const AttributesTag *>(tag);
-                const Attribute *uriAttr;
-                if(keytag && (uriAttr = keytag->getAttributeByName("URI")) &&
-                   !segmentList->initialisationSegment.Get()) /* FIXME: handle discontinuities */
+                InitSegment *initSegment = new (std::nothrow) InitSegment(rep);
+                if(initSegment)
                 {
-                    InitSegment *initSegment = new (std::nothrow) InitSegment(rep);
-                    if(initSegment)
+                    ctx.allocations++;
+                    initSegment->setSourceUrl(uriAttr->quotedString());
+                    const Attribute *byterangeAttr = keytag->getAttributeByName("BYTERANGE");
+                    if(byterangeAttr)
                     {
-                        initSegment->setSourceUrl(uriAttr->quotedString());
-                        const Attribute *byterangeAttr = keytag->getAttributeByName("BYTERANGE");
-                        if(byterangeAttr)
-                        {
-                            const std::pair<std::size_t,std::size_t> range = byterangeAttr->unescapeQuotes().getByteRange();
-                            initSegment->setByteRange(range.first, range.first + range.second - 1);
-                        }
-                        segmentList->initialisationSegment.Set(initSegment);
+                        const std::pair<std::size_t,std::size_t> range = byterangeAttr->unescapeQuotes().getByteRange();
+                        initSegment->setByteRange(range.first, range.first + range.second - 1);
                     }
+                    ctx.segmentList->initialisationSegment.Set(initSegment);
                 }
             }
-            break;
+        }
+        break;
 
-            case Tag::EXTXDISCONTINUITY:
-                discontinuity  = true;
-                break;
+        case Tag::EXTXDISCONTINUITY:
+            ctx.discontinuity  = true;
+            break;
 
-            case Tag::EXTXENDLIST:
-                rep->b_live = false;
-                break;
-        }
+        case Tag::EXTXENDLIST:
+            rep->b_live = false;
+            break;
     }
+}
 
+void M3U8Parser::endSegments(Representation *rep, SegmentsContext &ctx)
+{
     if(rep->isLive())
     {
         rep->getPlaylist()->duration.Set(0);
     }
-    else if(totalduration > rep->getPlaylist()->duration.Get())
+    else if(ctx.totalduration > rep->getPlaylist()->duration.Get())
     {
-        rep->getPlaylist()->duration.Set(totalduration);
+        rep->getPlaylist()->duration.Set(ctx.totalduration);
     }
 
-    rep->appendSegmentList(segmentList, true);
+    rep->appendSegmentList(ctx.segmentList, true);
+    ctx.segmentList = NULL;
 }
+
 M3U8 * M3U8Parser::parse(vlc_object_t *p_object, stream_t *p_stream, const std::string &playlisturl)
 {
     char *psz_line = vlc_stream_ReadLine(p_stream);
@@ -511,6 +648,40 @@ M3U8 * M3U8Parser::parse(vlc_object_t *p_object, stream_t *p_stream, const std::
     return playlist;
 }
 
+Tag * M3U8Parser::parseEntry(const char *psz_line)
+{
+    if(*psz_line == '#')
+    {
+        if(strncmp(psz_line, "#EXT", 4)) /* comment */
+            return NULL;
+
+        std::string key;
+        std::string attributes;
+        const char *split = strchr(psz_line, ':');
+        if(split)
+        {
+            key = std::string(psz_line + 1, split - psz_line - 1);
+            attributes = std::string(split + 1);
+        }
+        else
+        {
+            key = std::string(psz_line + 1);
+        }
+
+        if(key.empty())
+            return NULL;
+
+        return TagFactory::createTagByName(key, attributes);
+    }
+    else if(*psz_line)
+    {
+        /* URI, playlist tag, will take modifiers */
+        return TagFactory::createTagByName("", std::string(psz_line));
+    }
+
+    return NULL;
+}
+
 std::list<Tag *> M3U8Parser::parseEntries(stream_t *stream)
 {
     std::list<Tag *> entrieslist;
@@ -519,54 +690,24 @@ std::list<Tag *> M3U8Parser::parseEntries(stream_t *stream)
 
     while((psz_line = vlc_stream_ReadLine(stream)))
     {
-        if(*psz_line == '#')
+        if(*psz_line && *psz_line != '#' &&
+           lastTag && lastTag->getType() == AttributesTag::EXTXSTREAMINF)
         {
-            if(!strncmp(psz_line, "#EXT", 4)) //tag
-            {
-                std::string key;
-                std::string attributes;
-                const char *split = strchr(psz_line, ':');
-                if(split)
-                {
-                    key = std::string(psz_line + 1, split - psz_line - 1);
-                    attributes = std::string(split + 1);
-                }
-                else
-                {
-                    key = std::string(psz_line + 1);
-                }
-
-                if(!key.empty())
-                {
-                    Tag *tag = TagFactory::createTagByName(key, attributes);
-                    if(tag)
-                        entrieslist.push_back(tag);
-                    lastTag = tag;
-                }
-            }
-        }
-        else if(*psz_line)
-        {
-            /* URI */
-            if(lastTag && lastTag->getType() == AttributesTag::EXTXSTREAMINF)
-            {
-                AttributesTag *streaminftag = static_cast<AttributesTag *>(lastTag);
-                /* master playlist uri, merge as attribute */
-                Attribute *uriAttr = new (std::nothrow) Attribute("URI", std::string(psz_line));
-                if(uriAttr)
-                    streaminftag->addAttribute(uriAttr);
-            }
-            else /* playlist tag, will take modifiers */
-            {
-                Tag *tag = TagFactory::createTagByName("", std::string(psz_line));
-                if(tag)
-                    entrieslist.push_back(tag);
-            }
+            AttributesTag *streaminftag = static_cast<AttributesTag *>(lastTag);
+            /* master playlist uri, merge as attribute */
+            Attribute *uriAttr = new (std::nothrow) Attribute("URI", std::string(psz_line));
+            if(uriAttr)
+                streaminftag->addAttribute(uriAttr);
             lastTag = NULL;
         }
-        else // drop
+        else
         {
-            lastTag = NULL;
+            Tag *tag = parseEntry(psz_line);
+            if(tag)
+                entrieslist.push_back(tag);
+            /* comments don't break the tag/URI pair */
+            if(*psz_line != '#' || !strncmp(psz_line, "#EXT", 4))
+                lastTag = (*psz_line == '#') ? tag : NULL;
         }
 
         free(psz_line);
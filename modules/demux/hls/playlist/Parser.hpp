@@ -62,8 +62,12 @@ namespace hls
                 Representation * createRepresentation(BaseAdaptationSet *, const AttributesTag *);
                 void createAndFillRepresentation(vlc_object_t *, BaseAdaptationSet *,
                                                  const AttributesTag *, const std::list<Tag *>&);
+                class SegmentsContext;
                 void parseSegments(vlc_object_t *, Representation *, const std::list<Tag *>&);
+                void parseSegmentTag(vlc_object_t *, Representation *, SegmentsContext &, const Tag *);
+                void endSegments(Representation *, SegmentsContext &);
                 void setFormatFromExtension(Representation *rep, const std::string &);
+                static Tag * parseEntry(const char *);
                 std::list<Tag *> parseEntries(stream_t *);
         };
     }
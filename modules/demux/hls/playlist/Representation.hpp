@@ -57,6 +57,7 @@ namespace hls
                 StreamFormat streamFormat;
                 bool b_live;
                 bool b_loaded;
+                uint8_t playlistDigest[16]; /* of the last loaded playlist */
                 time_t nextUpdateTime;
                 time_t targetDuration;
                 Url playlistUrl;
@@ -93,6 +93,10 @@ struct demux_sys_t
 
     mp4_fragments_t fragments;
 
+    /* Trick play */
+    mtime_t      i_keyframe_stride; /* 0 when demuxing every sample */
+    mtime_t      i_keyframe_next;   /* earliest time of the next keyframe */
+
     struct
     {
         mp4_fragment_t *p_fragment;
@@ -134,6 +138,8 @@ static int  MP4_TrackSelect ( demux_t *, mp4_track_t *, mtime_t );
 static void MP4_TrackUnselect(demux_t *, mp4_track_t * );
 
 static int  MP4_TrackSeek   ( demux_t *, mp4_track_t *, mtime_t );
+static int  TrackGotoChunkSample( demux_t *, mp4_track_t *,
+                                  unsigned int, unsigned int );
 
 static uint64_t MP4_TrackGetPos    ( mp4_track_t * );
 static uint32_t MP4_TrackGetReadSize( mp4_track_t *, uint32_t * );
@@ -1187,11 +1193,76 @@ end:
     return VLC_DEMUXER_EGENERIC;
 }
 
+static mp4_track_t * MP4_GetKeyframeTrack( demux_sys_t *p_sys )
+{
+    for( unsigned i = 0; i < p_sys->i_tracks; i++ )
+    {
+        mp4_track_t *tk = &p_sys->track[i];
+        if( tk->b_ok && tk->b_selected && !tk->b_chapters_source &&
+            tk->fmt.i_cat == VIDEO_ES && MP4_BoxGet( tk->p_stbl, "stss" ) )
+            return tk;
+    }
+    return NULL;
+}
+
+/* Trick play: only send the first sync sample of the video track found at
+ * least i_keyframe_stride after the previous one */
+static int DemuxKeyframes( demux_t *p_demux, mp4_track_t *tk )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const MP4_Box_t *p_box = MP4_BoxGet( tk->p_stbl, "stss" );
+    const MP4_Box_data_stss_t *p_stss = p_box ? p_box->data.p_stss : NULL;
+
+    if( !p_stss )
+        return VLC_DEMUXER_EGENERIC;
+
+    for( uint32_t i = 0; i < p_stss->i_entry_count; i++ )
+    {
+        const uint32_t i_sample = p_stss->i_sample_number[i];
+
+        if( i_sample < tk->i_sample )
+            continue;
+        if( i_sample >= tk->i_sample_count )
+            break;
+
+        uint32_t i_chunk = tk->i_chunk;
+        while( i_chunk + 1 < tk->i_chunk_count &&
+               i_sample >= tk->chunk[i_chunk].i_sample_first +
+                           tk->chunk[i_chunk].i_sample_count )
+            i_chunk++;
+
+        if( TrackGotoChunkSample( p_demux, tk, i_chunk, i_sample ) )
+            return VLC_DEMUXER_EGENERIC;
+        MP4_TrackNextSample( p_demux, tk, 0 ); /* updates the edit list */
+
+        const mtime_t i_nzdts = MP4_TrackGetDTS( p_demux, tk );
+        if( i_nzdts < p_sys->i_keyframe_next )
+            continue;
+
+        p_sys->i_time = i_nzdts * p_sys->i_timescale / CLOCK_FREQ;
+        p_sys->i_pcr = i_nzdts;
+        p_sys->i_keyframe_next = i_nzdts + p_sys->i_keyframe_stride;
+        es_out_Control( p_demux->out, ES_OUT_SET_PCR, VLC_TS_0 + i_nzdts );
+        MP4_UpdateSeekpoint( p_demux, i_nzdts );
+
+        return DemuxTrack( p_demux, tk, MP4_TrackGetPos( tk ), 0 );
+    }
+
+    return VLC_DEMUXER_EOF;
+}
+
 static int Demux( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     unsigned int i_track;
 
+    if( p_sys->i_keyframe_stride > 0 )
+    {
+        mp4_track_t *tk = MP4_GetKeyframeTrack( p_sys );
+        if( tk )
+            return DemuxKeyframes( p_demux, tk );
+    }
+
     /* check for newly selected/unselected track */
     for( i_track = 0; i_track < p_sys->i_tracks; i_track++ )
     {
@@ -1341,6 +1412,7 @@ static int Seek( demux_t *p_demux, mtime_t i_date )
     /* First update global time */
     p_sys->i_time = i_date * p_sys->i_timescale / CLOCK_FREQ;
     p_sys->i_pcr  = VLC_TS_INVALID;
+    p_sys->i_keyframe_next = 0;
 
     /* Now for each stream try to go to this time */
     for( i_track = 0; i_track < p_sys->i_tracks; i_track++ )
@@ -1627,6 +1699,25 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             else
                 return Seek( p_demux, i64 );
 
+        case DEMUX_SET_KEYFRAME_STRIDE:
+            i64 = (int64_t)va_arg( args, int64_t );
+            if( p_demux->pf_demux != Demux )
+                return VLC_EGENERIC;
+            if( i64 > 0 )
+            {
+                if( !MP4_GetKeyframeTrack( p_sys ) )
+                    return VLC_EGENERIC;
+                if( p_sys->i_keyframe_stride == 0 )
+                    p_sys->i_keyframe_next = MP4_GetMoviePTS( p_sys );
+                p_sys->i_keyframe_stride = i64;
+                return VLC_SUCCESS;
+            }
+            if( p_sys->i_keyframe_stride == 0 )
+                return VLC_SUCCESS;
+            p_sys->i_keyframe_stride = 0;
+            /* Realign all the tracks on the last keyframe */
+            return Seek( p_demux, MP4_GetMoviePTS( p_sys ) );
+
         case DEMUX_GET_LENGTH:
             pi64 = (int64_t*)va_arg( args, int64_t * );
             if( p_sys->i_timescale > 0 )
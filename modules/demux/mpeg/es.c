@@ -36,9 +36,11 @@
 #include <vlc_codec.h>
 #include <vlc_codecs.h>
 #include <vlc_input.h>
+#include <vlc_url.h>
 
 #include "../../packetizer/a52.h"
 #include "../../packetizer/dts_header.h"
+#include "../../packetizer/mpegaudio.h"
 #include "../meta_engine/ID3Tag.h"
 
 /*****************************************************************************
@@ -48,6 +50,11 @@ static int  OpenAudio( vlc_object_t * );
 static int  OpenVideo( vlc_object_t * );
 static void Close    ( vlc_object_t * );
 
+#define INDEX_TEXT N_("Build a frame index")
+#define INDEX_LONGTEXT N_("Scan local audio files in the background to " \
+    "index the position of every frame. Seeking is then exact, and the " \
+    "exact duration is known once the whole file is scanned.")
+
 #define FPS_TEXT N_("Frames per Second")
 #define FPS_LONGTEXT N_("This is the frame rate used as a fallback when " \
     "playing MPEG video elementary streams.")
@@ -66,6 +73,7 @@ vlc_module_begin ()
                   "eac3",
                   "dts",
                   "mlp", "thd" )
+    add_bool( "es-index", true, INDEX_TEXT, INDEX_LONGTEXT, true )
 
     add_submodule()
     set_description( N_("MPEG-4 video" ) )
@@ -83,6 +91,14 @@ vlc_module_end ()
 static int Demux  ( demux_t * );
 static int Control( demux_t *, int, va_list );
 
+/* Frame found by the index scanner */
+typedef struct
+{
+    unsigned i_size;    /* in bytes */
+    unsigned i_samples; /* 0 if the frame does not advance the time */
+    unsigned i_rate;
+} es_frame_t;
+
 typedef struct
 {
     vlc_fourcc_t i_codec;
@@ -90,6 +106,11 @@ typedef struct
     const char *psz_name;
     int  (*pf_probe)( demux_t *p_demux, int64_t *pi_offset );
     int  (*pf_init)( demux_t *p_demux );
+    /* Frame header parser for the index (NULL if not supported) */
+    bool (*pf_frame)( const uint8_t *p_peek, es_frame_t *p_frame );
+    int  i_frame_header; /* bytes needed by pf_frame */
+    int  i_sync_byte;    /* first byte of every frame, or -1 */
+    int  i_preroll;      /* frames to decode before a seek target */
 } codec_t;
 
 typedef struct
@@ -119,6 +140,37 @@ typedef struct
     sync_table_ctx_t current;
 } sync_table_t;
 
+/* Index entry, every ES_INDEX_GROUP frames and after skipped data */
+typedef struct
+{
+    uint64_t i_pos;    /* relative to the stream offset */
+    uint64_t i_sample; /* samples before the frame */
+    uint32_t i_frame;  /* frame number */
+} es_index_point_t;
+
+typedef struct
+{
+    vlc_mutex_t lock;
+    vlc_thread_t thread;
+    stream_t *s;        /* private stream used by the scanner */
+    bool b_stop;
+    bool b_done;        /* the whole stream is indexed */
+
+    unsigned i_rate;
+    uint64_t i_samples; /* total */
+    uint64_t i_end;     /* end of the last indexed frame */
+
+    es_index_point_t *p_points;
+    size_t i_points;
+    size_t i_points_max;
+
+    /* Size and samples of every frame */
+    uint16_t *pi_size;
+    uint16_t *pi_samples;
+    size_t i_frames;
+    size_t i_frames_max;
+} es_index_t;
+
 struct demux_sys_t
 {
     codec_t codec;
@@ -157,6 +209,9 @@ struct demux_sys_t
     } xing;
 
     sync_table_t mllt;
+
+    bool b_index;
+    es_index_t index;
 };
 
 static int MpgaProbe( demux_t *p_demux, int64_t *pi_offset );
@@ -176,25 +231,44 @@ static int MlpProbe( demux_t *p_demux, int64_t *pi_offset );
 static int ThdProbe( demux_t *p_demux, int64_t *pi_offset );
 static int MlpInit( demux_t *p_demux );
 
+static bool MpgaFrame( const uint8_t *p_peek, es_frame_t *p_frame );
+static bool AacFrame( const uint8_t *p_peek, es_frame_t *p_frame );
+static bool A52Frame( const uint8_t *p_peek, es_frame_t *p_frame );
+static bool EA52Frame( const uint8_t *p_peek, es_frame_t *p_frame );
+static bool DtsFrame( const uint8_t *p_peek, es_frame_t *p_frame );
+static bool MlpFrame( const uint8_t *p_peek, es_frame_t *p_frame );
+
 static bool Parse( demux_t *p_demux, block_t **pp_output );
 static uint64_t SeekByMlltTable( demux_t *p_demux, mtime_t *pi_time );
 
+static int  IndexStart( demux_t *p_demux );
+static void IndexStop( demux_t *p_demux );
+static int  IndexSeek( demux_t *p_demux, mtime_t i_time, bool b_precise );
+static int  IndexGetLength( demux_t *p_demux, mtime_t *pi_length );
+
 static const codec_t p_codecs[] = {
-    { VLC_CODEC_MP4A, false, "mp4 audio",  AacProbe,  AacInit },
-    { VLC_CODEC_MPGA, false, "mpeg audio", MpgaProbe, MpgaInit },
-    { VLC_CODEC_A52, true,  "a52 audio",  A52Probe,  A52Init },
-    { VLC_CODEC_EAC3, true,  "eac3 audio", EA52Probe, A52Init },
-    { VLC_CODEC_DTS, false, "dts audio",  DtsProbe,  DtsInit },
-    { VLC_CODEC_MLP, false, "mlp audio",  MlpProbe,  MlpInit },
-    { VLC_CODEC_TRUEHD, false, "TrueHD audio",  ThdProbe,  MlpInit },
-
-    { 0, false, NULL, NULL, NULL }
+    { VLC_CODEC_MP4A, false, "mp4 audio",  AacProbe,  AacInit,
+      AacFrame, 7, 0xff, 1 },
+    { VLC_CODEC_MPGA, false, "mpeg audio", MpgaProbe, MpgaInit,
+      MpgaFrame, MPGA_HEADER_SIZE, 0xff, 2 },
+    { VLC_CODEC_A52, true,  "a52 audio",  A52Probe,  A52Init,
+      A52Frame, VLC_A52_HEADER_SIZE, -1, 1 },
+    { VLC_CODEC_EAC3, true,  "eac3 audio", EA52Probe, A52Init,
+      EA52Frame, VLC_A52_HEADER_SIZE, -1, 1 },
+    { VLC_CODEC_DTS, false, "dts audio",  DtsProbe,  DtsInit,
+      DtsFrame, VLC_DTS_HEADER_SIZE, -1, 1 },
+    { VLC_CODEC_MLP, false, "mlp audio",  MlpProbe,  MlpInit,
+      MlpFrame, 10, -1, 0 },
+    { VLC_CODEC_TRUEHD, false, "TrueHD audio",  ThdProbe,  MlpInit,
+      MlpFrame, 10, -1, 0 },
+
+    { 0, false, NULL, NULL, NULL, NULL, 0, -1, 0 }
 };
 
 static int VideoInit( demux_t *p_demux );
 
 static const codec_t codec_m4v = {
-    VLC_CODEC_MP4V, false, "mp4 video", NULL,  VideoInit
+    VLC_CODEC_MP4V, false, "mp4 video", NULL,  VideoInit, NULL, 0, -1, 0
 };
 
 /*****************************************************************************
@@ -270,6 +344,9 @@ static int OpenCommon( demux_t *p_demux,
             break;
     }
 
+    if( p_sys->codec.pf_frame != NULL && var_InheritBool( p_demux, "es-index" ) )
+        p_sys->b_index = IndexStart( p_demux ) == VLC_SUCCESS;
+
     return VLC_SUCCESS;
 }
 static int OpenAudio( vlc_object_t *p_this )
@@ -371,6 +448,8 @@ static void Close( vlc_object_t * p_this )
     demux_t     *p_demux = (demux_t*)p_this;
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    if( p_sys->b_index )
+        IndexStop( p_demux );
     if( p_sys->p_packetized_data )
         block_ChainRelease( p_sys->p_packetized_data );
     if( p_sys->mllt.p_bits )
@@ -405,6 +484,17 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         {
             va_list ap;
 
+            if( p_sys->b_index )
+            {
+                mtime_t i_length;
+                if( IndexGetLength( p_demux, &i_length ) == VLC_SUCCESS )
+                {
+                    pi64 = (int64_t *)va_arg( args, int64_t * );
+                    *pi64 = i_length;
+                    return VLC_SUCCESS;
+                }
+            }
+
             va_copy ( ap, args );
             i_ret = demux_vaControlHelper( p_demux->s, p_sys->i_stream_offset,
                                     -1, p_sys->i_bitrate_avg, 1, i_query, ap );
@@ -431,8 +521,56 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             return i_ret;
         }
 
+        case DEMUX_GET_POSITION:
+        {
+            mtime_t i_length;
+            if( p_sys->b_index
+             && IndexGetLength( p_demux, &i_length ) == VLC_SUCCESS
+             && i_length > 0 )
+            {
+                double *pf = va_arg( args, double * );
+                *pf = (double)( p_sys->i_pts + p_sys->i_time_offset )
+                      / i_length;
+                return VLC_SUCCESS;
+            }
+            goto helper;
+        }
+
+        case DEMUX_SET_POSITION:
+        {
+            mtime_t i_length;
+            if( p_sys->b_index
+             && IndexGetLength( p_demux, &i_length ) == VLC_SUCCESS )
+            {
+                va_list ap;
+
+                va_copy( ap, args );
+                double f_pos = va_arg( ap, double );
+                bool b_precise = va_arg( ap, int );
+                va_end( ap );
+
+                if( IndexSeek( p_demux, f_pos * i_length,
+                               b_precise ) == VLC_SUCCESS )
+                    return VLC_SUCCESS;
+            }
+            goto helper;
+        }
+
         case DEMUX_SET_TIME:
         {
+            if( p_sys->b_index )
+            {
+                va_list ap;
+
+                va_copy( ap, args );
+                int64_t i_time = va_arg( ap, int64_t );
+                bool b_precise = va_arg( ap, int );
+                va_end( ap );
+
+                /* Exact if the index already covers the target */
+                if( IndexSeek( p_demux, i_time, b_precise ) == VLC_SUCCESS )
+                    return VLC_SUCCESS;
+            }
             if( p_sys->mllt.p_bits )
             {
                 int64_t i_time = va_arg(args, int64_t);
@@ -447,10 +585,10 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
                 p_sys->p_packetized_data = NULL;
                 return VLC_SUCCESS;
             }
-            /* FIXME TODO: implement a high precision seek (with mp3 parsing)
-             * needed for multi-input */
         }
+        /* fall through */
         default:
+        helper:
             i_ret = demux_vaControlHelper( p_demux->s, p_sys->i_stream_offset, -1,
                                             p_sys->i_bitrate_avg, 1, i_query,
                                             args );
@@ -550,6 +688,389 @@ static bool Parse( demux_t *p_demux, block_t **pp_output )
     return b_eof;
 }
 
+/*****************************************************************************
+ * Frame index
+ *****************************************************************************
+ * A private stream is scanned in the background, from header to header. The
+ * size and sample count of every frame are kept, with the absolute position
+ * and sample count every ES_INDEX_GROUP frames, so that any frame can be
+ * found quickly with a few bytes per frame.
+ *****************************************************************************/
+#define ES_INDEX_GROUP 64
+#define ES_INDEX_READ  (256 * 1024)
+
+static int IndexAdd( es_index_t *p_index, uint64_t i_pos,
+                     const es_frame_t *p_frame )
+{
+    if( p_frame->i_size > UINT16_MAX || p_frame->i_samples > UINT16_MAX )
+        return VLC_EGENERIC;
+
+    if( p_frame->i_samples > 0 )
+    {
+        if( p_index->i_rate == 0 )
+            p_index->i_rate = p_frame->i_rate;
+        else if( p_index->i_rate != p_frame->i_rate )
+            return VLC_EGENERIC; /* sample rate changes are not indexed */
+    }
+
+    vlc_mutex_lock( &p_index->lock );
+
+    /* Fold skipped data into the previous frame if possible */
+    if( p_index->i_frames > 0 && i_pos != p_index->i_end
+     && i_pos - p_index->i_end + p_index->pi_size[p_index->i_frames - 1]
+        <= UINT16_MAX )
+    {
+        p_index->pi_size[p_index->i_frames - 1] += i_pos - p_index->i_end;
+        p_index->i_end = i_pos;
+    }
+
+    if( p_index->i_frames >= p_index->i_frames_max )
+    {
+        size_t i_max = p_index->i_frames_max ? 2 * p_index->i_frames_max
+                                             : 4096;
+        uint16_t *pi_size = realloc( p_index->pi_size,
+                                     i_max * sizeof (*pi_size) );
+        if( pi_size != NULL )
+            p_index->pi_size = pi_size;
+        uint16_t *pi_samples = realloc( p_index->pi_samples,
+                                        i_max * sizeof (*pi_samples) );
+        if( pi_samples != NULL )
+            p_index->pi_samples = pi_samples;
+        if( unlikely(pi_size == NULL || pi_samples == NULL) )
+            goto error;
+        p_index->i_frames_max = i_max;
+    }
+
+    if( p_index->i_points == 0 || i_pos != p_index->i_end
+     || p_index->i_frames - p_index->p_points[p_index->i_points - 1].i_frame
+        >= ES_INDEX_GROUP )
+    {
+        if( p_index->i_points >= p_index->i_points_max )
+        {
+            size_t i_max = p_index->i_points_max ? 2 * p_index->i_points_max
+                                                 : 64;
+            es_index_point_t *p_points = realloc( p_index->p_points,
+                                                  i_max * sizeof (*p_points) );
+            if( unlikely(p_points == NULL) )
+                goto error;
+            p_index->p_points = p_points;
+            p_index->i_points_max = i_max;
+        }
+
+        es_index_point_t *p_point = &p_index->p_points[p_index->i_points++];
+        p_point->i_pos = i_pos;
+        p_point->i_sample = p_index->i_samples;
+        p_point->i_frame = p_index->i_frames;
+    }
+
+    p_index->pi_size[p_index->i_frames] = p_frame->i_size;
+    p_index->pi_samples[p_index->i_frames] = p_frame->i_samples;
+    p_index->i_frames++;
+    p_index->i_samples += p_frame->i_samples;
+    p_index->i_end = i_pos + p_frame->i_size;
+
+    vlc_mutex_unlock( &p_index->lock );
+    return VLC_SUCCESS;
+
+error:
+    vlc_mutex_unlock( &p_index->lock );
+    return VLC_ENOMEM;
+}
+
+static void *IndexThread( void *data )
+{
+    demux_t *p_demux = data;
+    demux_sys_t *p_sys = p_demux->p_sys;
+    es_index_t *p_index = &p_sys->index;
+    const codec_t *p_codec = &p_sys->codec;
+    const size_t i_header = p_codec->i_frame_header;
+
+    uint8_t *p_buf = malloc( ES_INDEX_READ );
+    if( unlikely(p_buf == NULL) )
+        return NULL;
+
+    uint64_t i_buf_pos = 0; /* position of p_buf[0] */
+    size_t i_buf = 0, i_off = 0;
+    bool b_eof = false, b_sync = true;
+    es_frame_t frame = { 0, 0, 0 };
+    int i_ret = VLC_SUCCESS;
+
+    for( ;; )
+    {
+        /* Refill once the next header (or the one after it, to check a
+         * resynchronization) might not be in the buffer */
+        if( !b_eof && i_buf - i_off < UINT16_MAX + i_header )
+        {
+            vlc_mutex_lock( &p_index->lock );
+            bool b_stop = p_index->b_stop;
+            vlc_mutex_unlock( &p_index->lock );
+            if( b_stop )
+                break;
+
+            memmove( p_buf, &p_buf[i_off], i_buf - i_off );
+            i_buf_pos += i_off;
+            i_buf -= i_off;
+            i_off = 0;
+
+            ssize_t i_read = vlc_stream_Read( p_index->s, &p_buf[i_buf],
+                                              ES_INDEX_READ - i_buf );
+            if( i_read > 0 )
+                i_buf += i_read;
+            else
+                b_eof = true;
+        }
+
+        if( i_buf - i_off < i_header )
+            break; /* end of stream */
+
+        const uint8_t *p_frame = &p_buf[i_off];
+        es_frame_t next = frame;
+
+        if( !b_sync )
+        {   /* Fast path to the next possible sync byte */
+            if( p_codec->i_sync_byte >= 0 )
+            {
+                const uint8_t *p = memchr( p_frame, p_codec->i_sync_byte,
+                                           i_buf - i_off - i_header + 1 );
+                if( p == NULL )
+                {
+                    i_off = i_buf - i_header + 1;
+                    continue;
+                }
+                i_off = p - p_buf;
+                p_frame = p;
+            }
+
+            /* Resynchronize on two consecutive valid headers */
+            next.i_rate = 0;
+            if( !p_codec->pf_frame( p_frame, &next ) )
+            {
+                i_off++;
+                continue;
+            }
+            if( i_off + next.i_size + i_header <= i_buf )
+            {
+                es_frame_t check = next;
+                if( !p_codec->pf_frame( &p_frame[next.i_size], &check ) )
+                {
+                    i_off++;
+                    continue;
+                }
+            }
+            b_sync = true;
+        }
+        else if( !p_codec->pf_frame( p_frame, &next ) )
+        {
+            if( p_index->i_frames == 0 )
+            {   /* Not a supported stream (LOAS, free bitrate...) */
+                i_ret = VLC_EGENERIC;
+                break;
+            }
+            b_sync = false;
+            continue;
+        }
+
+        if( i_off + next.i_size > i_buf && b_eof )
+            break; /* truncated last frame */
+
+        i_ret = IndexAdd( p_index, i_buf_pos + i_off, &next );
+        if( i_ret != VLC_SUCCESS )
+            break;
+        frame = next;
+        i_off += next.i_size;
+    }
+    free( p_buf );
+
+    vlc_mutex_lock( &p_index->lock );
+    if( i_ret == VLC_SUCCESS && !p_index->b_stop )
+    {
+        p_index->b_done = true;
+        msg_Dbg( p_demux, "indexed %zu frames, %"PRIu64" samples at %u Hz",
+                 p_index->i_frames, p_index->i_samples, p_index->i_rate );
+    }
+    else if( i_ret != VLC_SUCCESS )
+    {
+        msg_Warn( p_demux, "cannot index the stream" );
+        p_index->i_frames = 0;
+        p_index->i_points = 0;
+    }
+    vlc_mutex_unlock( &p_index->lock );
+    return NULL;
+}
+
+static int IndexStart( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    es_index_t *p_index = &p_sys->index;
+    bool b_seekable;
+
+    /* Reading the whole stream twice is only reasonable for local files */
+    if( p_demux->psz_file == NULL
+     || vlc_stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &b_seekable )
+     || !b_seekable )
+        return VLC_EGENERIC;
+
+    char *psz_url = vlc_path2uri( p_demux->psz_file, NULL );
+    if( psz_url == NULL )
+        return VLC_EGENERIC;
+    p_index->s = vlc_stream_NewURL( VLC_OBJECT(p_demux), psz_url );
+    free( psz_url );
+    if( p_index->s == NULL )
+        return VLC_EGENERIC;
+
+    if( vlc_stream_Seek( p_index->s, p_sys->i_stream_offset ) )
+    {
+        vlc_stream_Delete( p_index->s );
+        return VLC_EGENERIC;
+    }
+
+    vlc_mutex_init( &p_index->lock );
+    if( vlc_clone( &p_index->thread, IndexThread, p_demux,
+                   VLC_THREAD_PRIORITY_LOW ) )
+    {
+        vlc_mutex_destroy( &p_index->lock );
+        vlc_stream_Delete( p_index->s );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static void IndexStop( demux_t *p_demux )
+{
+    es_index_t *p_index = &p_demux->p_sys->index;
+
+    vlc_mutex_lock( &p_index->lock );
+    p_index->b_stop = true;
+    vlc_mutex_unlock( &p_index->lock );
+    vlc_join( p_index->thread, NULL );
+
+    vlc_stream_Delete( p_index->s );
+    vlc_mutex_destroy( &p_index->lock );
+    free( p_index->p_points );
+    free( p_index->pi_size );
+    free( p_index->pi_samples );
+}
+
+/* Finds the position and first sample of a frame. Called with the lock. */
+static void IndexGetFrame( const es_index_t *p_index, size_t i_frame,
+                           uint64_t *pi_pos, uint64_t *pi_sample )
+{
+    size_t i_low = 0, i_high = p_index->i_points;
+
+    while( i_high - i_low > 1 )
+    {
+        size_t i_mid = (i_low + i_high) / 2;
+        if( p_index->p_points[i_mid].i_frame <= i_frame )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
+    }
+
+    const es_index_point_t *p_point = &p_index->p_points[i_low];
+    uint64_t i_pos = p_point->i_pos, i_sample = p_point->i_sample;
+
+    for( size_t i = p_point->i_frame; i < i_frame; i++ )
+    {
+        i_pos += p_index->pi_size[i];
+        i_sample += p_index->pi_samples[i];
+    }
+    *pi_pos = i_pos;
+    *pi_sample = i_sample;
+}
+
+/* Finds the frame containing a sample. Called with the lock. */
+static size_t IndexFindFrame( const es_index_t *p_index, uint64_t i_sample )
+{
+    size_t i_low = 0, i_high = p_index->i_points;
+
+    while( i_high - i_low > 1 )
+    {
+        size_t i_mid = (i_low + i_high) / 2;
+        if( p_index->p_points[i_mid].i_sample <= i_sample )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
+    }
+
+    const es_index_point_t *p_point = &p_index->p_points[i_low];
+    uint64_t i_end = p_point->i_sample;
+    size_t i_frame = p_point->i_frame;
+
+    for( ; i_frame + 1 < p_index->i_frames; i_frame++ )
+    {
+        i_end += p_index->pi_samples[i_frame];
+        if( i_end > i_sample )
+            break;
+    }
+    return i_frame;
+}
+
+static int IndexSeek( demux_t *p_demux, mtime_t i_time, bool b_precise )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    es_index_t *p_index = &p_sys->index;
+    uint64_t i_pos, i_sample, i_start_sample;
+
+    if( i_time < 0 )
+        i_time = 0;
+
+    vlc_mutex_lock( &p_index->lock );
+    const unsigned i_rate = p_index->i_rate;
+    const uint64_t i_target = i_time / CLOCK_FREQ * i_rate
+                            + i_time % CLOCK_FREQ * i_rate / CLOCK_FREQ;
+
+    if( i_rate == 0 || p_index->i_frames == 0
+     || ( !p_index->b_done && i_target >= p_index->i_samples ) )
+    {   /* Not indexed (yet) */
+        vlc_mutex_unlock( &p_index->lock );
+        return VLC_EGENERIC;
+    }
+
+    size_t i_frame = IndexFindFrame( p_index, i_target );
+    IndexGetFrame( p_index, i_frame, &i_pos, &i_start_sample );
+    /* Decode a few frames before (overlap, bit reservoir) and drop them */
+    i_frame = i_frame > (size_t)p_sys->codec.i_preroll
+            ? i_frame - p_sys->codec.i_preroll : 0;
+    IndexGetFrame( p_index, i_frame, &i_pos, &i_sample );
+    vlc_mutex_unlock( &p_index->lock );
+
+    if( vlc_stream_Seek( p_demux->s, p_sys->i_stream_offset + i_pos ) )
+        return VLC_EGENERIC;
+
+    /* Restart the timestamps exactly at the frame */
+    if( p_sys->p_packetizer->pf_flush != NULL )
+        p_sys->p_packetizer->pf_flush( p_sys->p_packetizer );
+    if( p_sys->p_packetized_data )
+        block_ChainRelease( p_sys->p_packetized_data );
+    p_sys->p_packetized_data = NULL;
+    p_sys->b_start = true;
+    p_sys->i_pts = 0;
+    p_sys->i_bytes = 0;
+    p_sys->i_time_offset = i_sample * CLOCK_FREQ / i_rate;
+
+    if( !b_precise )
+        i_time = i_start_sample * CLOCK_FREQ / i_rate;
+    if( i_time > p_sys->i_time_offset )
+        es_out_Control( p_demux->out, ES_OUT_SET_NEXT_DISPLAY_TIME,
+                        VLC_TS_0 + i_time );
+    return VLC_SUCCESS;
+}
+
+static int IndexGetLength( demux_t *p_demux, mtime_t *pi_length )
+{
+    es_index_t *p_index = &p_demux->p_sys->index;
+    int i_ret = VLC_EGENERIC;
+
+    vlc_mutex_lock( &p_index->lock );
+    if( p_index->b_done && p_index->i_rate > 0 )
+    {
+        *pi_length = p_index->i_samples * CLOCK_FREQ / p_index->i_rate;
+        i_ret = VLC_SUCCESS;
+    }
+    vlc_mutex_unlock( &p_index->lock );
+    return i_ret;
+}
+
 /* Check to apply to WAVE fmt header */
 static int GenericFormatCheck( int i_format, const uint8_t *p_head )
 {
@@ -758,6 +1279,23 @@ static int MpgaGetFrameSamples( uint32_t h )
     }
 }
 
+static bool MpgaFrame( const uint8_t *p_peek, es_frame_t *p_frame )
+{
+    unsigned i_channels, i_channels_conf, i_bitrate, i_max_size, i_layer;
+
+    if( !MpgaCheckSync( p_peek ) )
+        return false;
+
+    int i_size = mpga_SyncInfo( GetDWBE( p_peek ), &i_channels,
+                                &i_channels_conf, &p_frame->i_rate,
+                                &i_bitrate, &p_frame->i_samples,
+                                &i_max_size, &i_layer );
+    if( i_size <= 0 ) /* free bitrate frames cannot be indexed */
+        return false;
+    p_frame->i_size = i_size;
+    return true;
+}
+
 static int MpgaProbe( demux_t *p_demux, int64_t *pi_offset )
 {
     const int pi_wav[] = { WAVE_FORMAT_MPEG, WAVE_FORMAT_MPEGLAYER3, WAVE_FORMAT_UNKNOWN };
@@ -1080,6 +1618,24 @@ static int AacInit( demux_t *p_demux )
 
     return VLC_SUCCESS;
 }
+static bool AacFrame( const uint8_t *p_peek, es_frame_t *p_frame )
+{
+    static const unsigned pi_rate[16] = {
+        96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050,
+        16000, 12000, 11025, 8000,  7350,  0,     0,     0
+    };
+
+    /* ADTS header (LOAS is not indexed) */
+    if( p_peek[0] != 0xff || (p_peek[1] & 0xf6) != 0xf0 )
+        return false;
+
+    p_frame->i_rate = pi_rate[(p_peek[2] >> 2) & 0x0f];
+    p_frame->i_size = ((p_peek[3] & 0x03) << 11) | (p_peek[4] << 3)
+                    | (p_peek[5] >> 5);
+    p_frame->i_samples = 1024 * ((p_peek[6] & 0x03) + 1);
+
+    return p_frame->i_rate != 0 && p_frame->i_size >= 7;
+}
 
 
 /*****************************************************************************
@@ -1153,6 +1709,40 @@ static int A52Init( demux_t *p_demux )
     return VLC_SUCCESS;
 }
 
+static bool A52FrameCommon( const uint8_t *p_peek, es_frame_t *p_frame,
+                            bool b_eac3 )
+{
+    vlc_a52_header_t header;
+    uint8_t p_tmp[VLC_A52_HEADER_SIZE];
+
+    if( p_peek[0] == 0x77 && p_peek[1] == 0x0b )
+    {
+        swab( p_peek, p_tmp, VLC_A52_HEADER_SIZE );
+        p_peek = p_tmp;
+    }
+
+    if( vlc_a52_header_Parse( &header, p_peek, VLC_A52_HEADER_SIZE )
+     || !header.b_eac3 != !b_eac3 )
+        return false;
+
+    p_frame->i_size = header.i_size;
+    p_frame->i_rate = header.i_rate;
+    /* Dependent substreams cover the time of their independent frame */
+    if( header.b_eac3 && header.eac3.strmtyp == EAC3_STRMTYP_DEPENDENT )
+        p_frame->i_samples = 0;
+    else
+        p_frame->i_samples = header.i_samples;
+    return true;
+}
+static bool A52Frame( const uint8_t *p_peek, es_frame_t *p_frame )
+{
+    return A52FrameCommon( p_peek, p_frame, false );
+}
+static bool EA52Frame( const uint8_t *p_peek, es_frame_t *p_frame )
+{
+    return A52FrameCommon( p_peek, p_frame, true );
+}
+
 /*****************************************************************************
  * DTS
  *****************************************************************************/
@@ -1188,6 +1778,24 @@ static int DtsInit( demux_t *p_demux )
 
     return VLC_SUCCESS;
 }
+static bool DtsFrame( const uint8_t *p_peek, es_frame_t *p_frame )
+{
+    vlc_dts_header_t dts;
+
+    if( vlc_dts_header_Parse( &dts, p_peek, VLC_DTS_HEADER_SIZE )
+     || dts.i_frame_size == 0 )
+        return false;
+
+    p_frame->i_size = dts.i_frame_size;
+    if( dts.b_substream )
+    {   /* Extension of the previous core frame */
+        p_frame->i_samples = 0;
+        return p_frame->i_rate != 0;
+    }
+    p_frame->i_rate = dts.i_rate;
+    p_frame->i_samples = dts.i_frame_length;
+    return dts.i_rate != 0;
+}
 
 /*****************************************************************************
  * MLP
@@ -1241,6 +1849,27 @@ static int MlpInit( demux_t *p_demux )
 
     return VLC_SUCCESS;
 }
+static bool MlpFrame( const uint8_t *p_peek, es_frame_t *p_frame )
+{
+    /* Only the major sync tells the rate (cf. the MLP packetizer), so
+     * access units are indexed from the first major sync onward */
+    if( p_peek[4+0] == 0xf8 && p_peek[4+1] == 0x72 && p_peek[4+2] == 0x6f
+     && ( p_peek[4+3] == 0xbb || p_peek[4+3] == 0xba ) )
+    {
+        const unsigned i_rate_idx = ( p_peek[4+3] == 0xbb ? p_peek[4+5]
+                                                          : p_peek[4+4] ) >> 4;
+        if( i_rate_idx == 0x0f )
+            return false;
+        p_frame->i_rate = ( ( i_rate_idx & 0x8 ) ? 44100 : 48000 )
+                          << ( i_rate_idx & 0x7 );
+        p_frame->i_samples = 40 << ( i_rate_idx & 0x7 );
+    }
+    else if( p_frame->i_rate == 0 )
+        return false;
+
+    p_frame->i_size = ( GetWBE( p_peek ) & 0xfff ) * 2;
+    return p_frame->i_size >= 4;
+}
 
 /*****************************************************************************
  * Video
@@ -126,6 +126,11 @@ static int probe_luascript( vlc_object_t *p_this, const char * psz_filename,
     VLC_UNUSED(p_context);
     demux_t * p_demux = (demux_t *)p_this;
 
+    /* Skip scripts that cannot handle this input without loading them */
+    if( !vlclua_script_may_probe( psz_filename, p_demux->psz_access,
+                                  p_demux->psz_location ) )
+        return VLC_EGENERIC;
+
     p_demux->p_sys->psz_filename = strdup(psz_filename);
 
     /* Initialise Lua state structure */
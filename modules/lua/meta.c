@@ -109,6 +109,7 @@ static int run( vlc_object_t *p_this, const char * psz_filename,
         lua_pop( L, 1 );
     }
     lua_pop( L, 1 );
+    vlclua_script_set_scope( psz_filename, e_scope );
 
     if ( p_context && p_context->pf_validator && !p_context->pf_validator( p_context, e_scope ) )
     {
@@ -151,9 +152,26 @@ static bool validate_scope( const luabatch_context_t *p_context, meta_fetcher_sc
         return ( p_context->e_scope == e_scope );
 }
 
+/* Skips scripts whose scope is already known not to match, without loading
+ * them */
+static bool skip_scope( vlc_object_t *p_this, const char *psz_filename,
+                        const luabatch_context_t *p_context )
+{
+    int i_scope = vlclua_script_get_scope( psz_filename );
+
+    if( i_scope < 0 || !p_context || !p_context->pf_validator
+     || p_context->pf_validator( p_context, i_scope ) )
+        return false;
+    msg_Dbg( p_this, "skipping script (unmatched scope) %s", psz_filename );
+    return true;
+}
+
 static int fetch_art( vlc_object_t *p_this, const char * psz_filename,
                       const luabatch_context_t *p_context )
 {
+    if( skip_scope( p_this, psz_filename, p_context ) )
+        return VLC_EGENERIC;
+
     lua_State *L = init( p_this, p_context->p_item, psz_filename );
     if( !L )
         return VLC_EGENERIC;
@@ -225,6 +243,9 @@ static int read_meta( vlc_object_t *p_this, const char * psz_filename,
 static int fetch_meta( vlc_object_t *p_this, const char * psz_filename,
                        const luabatch_context_t *p_context )
 {
+    if( skip_scope( p_this, psz_filename, p_context ) )
+        return VLC_EGENERIC;
+
     lua_State *L = init( p_this, p_context->p_item, psz_filename );
     if( !L )
         return VLC_EGENERIC;
@@ -756,17 +756,320 @@ int vlclua_add_modules_path( lua_State *L, const char *psz_filename )
     return 0;
 }
 
+/*****************************************************************************
+ * Local scripts cache
+ *****************************************************************************/
+/* Local scripts are compiled only once per process: the precompiled chunk is
+ * kept, along with the probe filter that the script declares, if any. Entries
+ * are invalidated when the script file changes, and are never freed (there
+ * are only as many entries as installed scripts). */
+typedef struct vlclua_script_t vlclua_script_t;
+struct vlclua_script_t
+{
+    vlclua_script_t *p_next;
+    char *psz_filename;
+    time_t i_mtime;
+    off_t i_size;
+
+    char *p_chunk;  /**< precompiled chunk, or NULL */
+    size_t i_chunk;
+
+    bool b_filter;  /**< the filter was read from the script */
+    char **ppsz_access; /**< NULL-terminated access names, or NULL for any */
+    char **ppsz_path;   /**< NULL-terminated path prefixes, or NULL for any */
+    int i_scope;    /**< meta fetcher scope, -1 if unknown */
+};
+
+static vlc_mutex_t script_lock = VLC_STATIC_MUTEX;
+static vlclua_script_t *p_scripts = NULL;
+
+static void vlclua_list_free( char **ppsz_list )
+{
+    if( ppsz_list == NULL )
+        return;
+    for( char **ppsz = ppsz_list; *ppsz; ppsz++ )
+        free( *ppsz );
+    free( ppsz_list );
+}
+
+/**
+ * Finds the cache entry of a script, creating it if needed.
+ * Called with script_lock held.
+ */
+static vlclua_script_t *vlclua_script_get( const char *psz_filename,
+                                           const struct stat *p_st,
+                                           bool b_create )
+{
+    vlclua_script_t *p_script = p_scripts;
+    while( p_script != NULL && strcmp( p_script->psz_filename, psz_filename ) )
+        p_script = p_script->p_next;
+
+    if( p_script == NULL )
+    {
+        if( !b_create )
+            return NULL;
+        p_script = calloc( 1, sizeof( *p_script ) );
+        if( unlikely(p_script == NULL) )
+            return NULL;
+        p_script->psz_filename = strdup( psz_filename );
+        if( unlikely(p_script->psz_filename == NULL) )
+        {
+            free( p_script );
+            return NULL;
+        }
+        p_script->p_next = p_scripts;
+        p_scripts = p_script;
+    }
+    else if( p_script->i_mtime == p_st->st_mtime
+          && p_script->i_size == p_st->st_size )
+        return p_script;
+    else
+    {   /* The script changed */
+        FREENULL( p_script->p_chunk );
+        vlclua_list_free( p_script->ppsz_access );
+        vlclua_list_free( p_script->ppsz_path );
+        p_script->ppsz_access = p_script->ppsz_path = NULL;
+    }
+
+    p_script->i_mtime = p_st->st_mtime;
+    p_script->i_size = p_st->st_size;
+    p_script->i_chunk = 0;
+    p_script->b_filter = false;
+    p_script->i_scope = -1;
+    return p_script;
+}
+
+typedef struct
+{
+    char *p_data;
+    size_t i_data;
+} vlclua_chunk_t;
+
+static int vlclua_chunk_writer( lua_State *L, const void *p, size_t i_size,
+                                void *data )
+{
+    vlclua_chunk_t *p_chunk = data;
+    VLC_UNUSED( L );
+
+    char *p_data = realloc( p_chunk->p_data, p_chunk->i_data + i_size );
+    if( unlikely(p_data == NULL) )
+        return 1;
+    memcpy( p_data + p_chunk->i_data, p, i_size );
+    p_chunk->p_data = p_data;
+    p_chunk->i_data += i_size;
+    return 0;
+}
+
+/**
+ * Reads a list of strings from a field of the table at the top of the stack.
+ */
+static char **vlclua_read_list( lua_State *L, const char *psz_field )
+{
+    char **ppsz_list = NULL;
+
+    lua_getfield( L, -1, psz_field );
+    if( lua_istable( L, -1 ) )
+    {
+        size_t i_count = 0;
+
+        for( ;; )
+        {
+            lua_rawgeti( L, -1, i_count + 1 );
+            if( !lua_isstring( L, -1 ) )
+            {
+                lua_pop( L, 1 );
+                break;
+            }
+
+            char **ppsz_new = realloc( ppsz_list,
+                                       (i_count + 2) * sizeof( *ppsz_list ) );
+            if( unlikely(ppsz_new == NULL) )
+            {
+                lua_pop( L, 1 );
+                goto error;
+            }
+            ppsz_list = ppsz_new;
+            ppsz_list[i_count] = NULL;
+
+            char *psz = strdup( lua_tostring( L, -1 ) );
+            lua_pop( L, 1 );
+            if( unlikely(psz == NULL) )
+                goto error;
+            ppsz_list[i_count++] = psz;
+            ppsz_list[i_count] = NULL;
+        }
+    }
+    lua_pop( L, 1 );
+    return ppsz_list;
+
+error:
+    /* Match any */
+    vlclua_list_free( ppsz_list );
+    lua_pop( L, 1 );
+    return NULL;
+}
+
+/**
+ * Loads a local script, from the cache if possible, and runs it.
+ */
+static int vlclua_dofile_local( lua_State *L, const char *psz_filename,
+                                const char *psz_path )
+{
+    vlclua_script_t *p_script = NULL;
+    struct stat st;
+    int i_ret;
+
+    if( vlc_stat( psz_filename, &st ) == 0 )
+    {
+        vlc_mutex_lock( &script_lock );
+        p_script = vlclua_script_get( psz_filename, &st, true );
+        if( p_script != NULL && p_script->p_chunk != NULL )
+        {
+            /* Use the same chunk name as luaL_loadfile() */
+            lua_pushfstring( L, "@%s", psz_path );
+            i_ret = luaL_loadbuffer( L, p_script->p_chunk, p_script->i_chunk,
+                                     lua_tostring( L, -1 ) );
+            lua_remove( L, -2 );
+        }
+        else
+            i_ret = -1;
+        vlc_mutex_unlock( &script_lock );
+    }
+    else
+        i_ret = -1;
+
+    if( i_ret == -1 )
+    {
+        i_ret = luaL_loadfile( L, psz_path );
+
+        vlclua_chunk_t chunk = { NULL, 0 };
+        if( !i_ret && p_script != NULL
+#if LUA_VERSION_NUM >= 503
+         && !lua_dump( L, vlclua_chunk_writer, &chunk, 0 )
+#else
+         && !lua_dump( L, vlclua_chunk_writer, &chunk )
+#endif
+          )
+        {
+            vlc_mutex_lock( &script_lock );
+            if( p_script->p_chunk == NULL && p_script->i_mtime == st.st_mtime
+             && p_script->i_size == st.st_size )
+            {
+                p_script->p_chunk = chunk.p_data;
+                p_script->i_chunk = chunk.i_data;
+                chunk.p_data = NULL;
+            }
+            vlc_mutex_unlock( &script_lock );
+        }
+        free( chunk.p_data );
+    }
+
+    if( !i_ret )
+        i_ret = lua_pcall( L, 0, LUA_MULTRET, 0 );
+
+    if( !i_ret && p_script != NULL )
+    {
+        char **ppsz_access = NULL, **ppsz_path = NULL;
+
+        lua_getglobal( L, "probe_filter" );
+        if( lua_istable( L, -1 ) )
+        {
+            ppsz_access = vlclua_read_list( L, "access" );
+            ppsz_path = vlclua_read_list( L, "path" );
+        }
+        lua_pop( L, 1 );
+
+        vlc_mutex_lock( &script_lock );
+        if( !p_script->b_filter && p_script->i_mtime == st.st_mtime
+         && p_script->i_size == st.st_size )
+        {
+            p_script->b_filter = true;
+            p_script->ppsz_access = ppsz_access;
+            p_script->ppsz_path = ppsz_path;
+            ppsz_access = ppsz_path = NULL;
+        }
+        vlc_mutex_unlock( &script_lock );
+        vlclua_list_free( ppsz_access );
+        vlclua_list_free( ppsz_path );
+    }
+    return i_ret;
+}
+
+static bool vlclua_list_match( char **ppsz_list, const char *psz, bool b_prefix )
+{
+    if( ppsz_list == NULL )
+        return true;
+    if( psz == NULL )
+        return false;
+
+    for( char **ppsz = ppsz_list; *ppsz; ppsz++ )
+        if( b_prefix ? !strncasecmp( psz, *ppsz, strlen( *ppsz ) )
+                     : !strcasecmp( psz, *ppsz ) )
+            return true;
+    return false;
+}
+
+bool vlclua_script_may_probe( const char *psz_filename,
+                              const char *psz_access, const char *psz_path )
+{
+    struct stat st;
+    bool b_ret = true;
+
+    if( !strncasecmp( psz_filename, "file://", 7 ) )
+        psz_filename += 7;
+    if( vlc_stat( psz_filename, &st ) )
+        return true;
+
+    vlc_mutex_lock( &script_lock );
+    vlclua_script_t *p_script = vlclua_script_get( psz_filename, &st, false );
+    if( p_script != NULL && p_script->b_filter )
+        b_ret = vlclua_list_match( p_script->ppsz_access, psz_access, false )
+             && vlclua_list_match( p_script->ppsz_path, psz_path, true );
+    vlc_mutex_unlock( &script_lock );
+    return b_ret;
+}
+
+int vlclua_script_get_scope( const char *psz_filename )
+{
+    struct stat st;
+    int i_scope = -1;
+
+    if( vlc_stat( psz_filename, &st ) )
+        return -1;
+
+    vlc_mutex_lock( &script_lock );
+    vlclua_script_t *p_script = vlclua_script_get( psz_filename, &st, false );
+    if( p_script != NULL )
+        i_scope = p_script->i_scope;
+    vlc_mutex_unlock( &script_lock );
+    return i_scope;
+}
+
+void vlclua_script_set_scope( const char *psz_filename, int i_scope )
+{
+    struct stat st;
+
+    if( vlc_stat( psz_filename, &st ) )
+        return;
+
+    vlc_mutex_lock( &script_lock );
+    vlclua_script_t *p_script = vlclua_script_get( psz_filename, &st, true );
+    if( p_script != NULL )
+        p_script->i_scope = i_scope;
+    vlc_mutex_unlock( &script_lock );
+}
+
 /** Replacement for luaL_dofile, using VLC's input capabilities */
 int vlclua_dofile( vlc_object_t *p_this, lua_State *L, const char *curi )
 {
     char *uri = ToLocaleDup( curi );
     if( !strstr( uri, "://" ) ) {
-        int ret = luaL_dofile( L, uri );
+        int ret = vlclua_dofile_local( L, curi, uri );
         free( uri );
         return ret;
     }
     if( !strncasecmp( uri, "file://", 7 ) ) {
-        int ret = luaL_dofile( L, uri + 7 );
+        int ret = vlclua_dofile_local( L, curi + 7, uri + 7 );
         free( uri );
         return ret;
     }
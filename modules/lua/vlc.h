@@ -170,6 +170,17 @@ char *vlclua_find_file( const char *psz_luadirname, const char *psz_name );
  *****************************************************************************/
 int vlclua_dofile( vlc_object_t *p_this, lua_State *L, const char *url );
 
+/*****************************************************************************
+ * Local scripts cache: vlclua_dofile() precompiles local scripts once, and
+ * records the probe_filter table they declare, if any.
+ *****************************************************************************/
+/* Returns false if the script declared it cannot handle the access/path */
+bool vlclua_script_may_probe( const char *psz_filename,
+                              const char *psz_access, const char *psz_path );
+/* Meta fetcher scope of a script, or -1 if unknown */
+int vlclua_script_get_scope( const char *psz_filename );
+void vlclua_script_set_scope( const char *psz_filename, int i_scope );
+
 /*****************************************************************************
  * Playlist and meta data internal utilities.
  *****************************************************************************/
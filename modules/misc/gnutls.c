@@ -388,6 +388,83 @@ done:
     return 0;
 }
 
+/*
+ * Client session resumption: the session parameters of the last few verified
+ * servers are kept, so that new connections to the same servers can skip the
+ * full handshake. The cache is process-wide and bounded, and never freed.
+ */
+#define GNUTLS_RESUME_MAX 16
+#define GNUTLS_RESUME_TIME (INT64_C(3600) * CLOCK_FREQ)
+
+static struct
+{
+    char *host;
+    gnutls_datum_t data;
+    mtime_t date;
+} gnutls_resume[GNUTLS_RESUME_MAX];
+static vlc_mutex_t gnutls_resume_lock = VLC_STATIC_MUTEX;
+
+static void gnutls_ClientSessionResume(vlc_tls_creds_t *crd,
+                                       gnutls_session_t session,
+                                       const char *host)
+{
+    mtime_t now = mdate();
+
+    vlc_mutex_lock(&gnutls_resume_lock);
+    for (unsigned i = 0; i < GNUTLS_RESUME_MAX; i++)
+        if (gnutls_resume[i].host != NULL
+         && !strcasecmp(gnutls_resume[i].host, host)
+         && now - gnutls_resume[i].date < GNUTLS_RESUME_TIME)
+        {
+            int val = gnutls_session_set_data(session,
+                                              gnutls_resume[i].data.data,
+                                              gnutls_resume[i].data.size);
+            if (val == 0)
+                msg_Dbg(crd, "trying to resume TLS session with %s", host);
+            break;
+        }
+    vlc_mutex_unlock(&gnutls_resume_lock);
+}
+
+static void gnutls_ClientSessionSave(gnutls_session_t session,
+                                     const char *host)
+{
+    gnutls_datum_t data;
+
+    if (host == NULL || gnutls_session_get_data2(session, &data) != 0)
+        return;
+
+    char *name = strdup(host);
+    if (unlikely(name == NULL))
+    {
+        gnutls_free(data.data);
+        return;
+    }
+
+    unsigned slot = 0;
+
+    vlc_mutex_lock(&gnutls_resume_lock);
+    /* Replace the entry for the same host, else the oldest one */
+    for (unsigned i = 0; i < GNUTLS_RESUME_MAX; i++)
+    {
+        if (gnutls_resume[i].host != NULL
+         && !strcasecmp(gnutls_resume[i].host, host))
+        {
+            slot = i;
+            break;
+        }
+        if (gnutls_resume[i].date < gnutls_resume[slot].date)
+            slot = i;
+    }
+
+    free(gnutls_resume[slot].host);
+    gnutls_free(gnutls_resume[slot].data.data);
+    gnutls_resume[slot].host = name;
+    gnutls_resume[slot].data = data;
+    gnutls_resume[slot].date = mdate();
+    vlc_mutex_unlock(&gnutls_resume_lock);
+}
+
 static int gnutls_ClientSessionOpen(vlc_tls_creds_t *crd, vlc_tls_t *tls,
                                     vlc_tls_t *sk, const char *hostname,
                                     const char *const *alpn)
@@ -402,9 +479,12 @@ static int gnutls_ClientSessionOpen(vlc_tls_creds_t *crd, vlc_tls_t *tls,
     gnutls_dh_set_prime_bits (session, 1024);
 
     if (likely(hostname != NULL))
+    {
         /* fill Server Name Indication */
         gnutls_server_name_set (session, GNUTLS_NAME_DNS,
                                 hostname, strlen (hostname));
+        gnutls_ClientSessionResume(crd, session, hostname);
+    }
 
     return VLC_SUCCESS;
 }
@@ -421,6 +501,9 @@ static int gnutls_ClientHandshake(vlc_tls_creds_t *creds, vlc_tls_t *tls,
     gnutls_session_t session = tls->sys;
     unsigned status;
 
+    if (gnutls_session_is_resumed(session))
+        msg_Dbg(creds, "TLS session resumed");
+
     val = gnutls_certificate_verify_peers3 (session, host, &status);
     if (val)
     {
@@ -430,7 +513,7 @@ static int gnutls_ClientHandshake(vlc_tls_creds_t *creds, vlc_tls_t *tls,
     }
 
     if (status == 0) /* Good certificate */
-        return 0;
+        goto done;
 
     /* Bad certificate */
     gnutls_datum_t desc;
@@ -468,7 +551,7 @@ static int gnutls_ClientHandshake(vlc_tls_creds_t *creds, vlc_tls_t *tls,
     {
         case 0:
             msg_Dbg(creds, "certificate key match for %s", host);
-            return 0;
+            goto done;
         case GNUTLS_E_NO_CERTIFICATE_FOUND:
             msg_Dbg(creds, "no known certificates for %s", host);
             msg = N_("However the security certificate presented by the "
@@ -531,6 +614,8 @@ static int gnutls_ClientHandshake(vlc_tls_creds_t *creds, vlc_tls_t *tls,
         default:
             goto error;
     }
+done:
+    gnutls_ClientSessionSave(session, host);
     return 0;
 
 error:
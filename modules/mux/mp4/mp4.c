@@ -33,6 +33,7 @@
 #include <vlc_plugin.h>
 #include <vlc_sout.h>
 #include <vlc_block.h>
+#include <vlc_dialog.h>
 
 #include <assert.h>
 #include <time.h>
@@ -53,6 +54,20 @@
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
 
+#define MOOV_RESERVE_TEXT N_("Space reserved for the index (kB)")
+#define MOOV_RESERVE_LONGTEXT N_(\
+    "Space reserved in front of the media data for the \"Fast Start\" " \
+    "index, so that it can be written in place when the file is closed " \
+    "instead of moving all the media data. By default (-1), it is " \
+    "estimated from the tracks and the expected duration, if any. " \
+    "0 disables it.")
+
+#define DURATION_TEXT N_("Expected duration (s)")
+#define DURATION_LONGTEXT N_(\
+    "Expected duration of the output, from which the space reserved for " \
+    "the \"Fast Start\" index is estimated. The muxer cannot know the " \
+    "duration of its input. 0 means unknown.")
+
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
 static int  OpenFrag   (vlc_object_t *);
@@ -69,6 +84,10 @@ vlc_module_begin ()
     add_bool(SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true)
+    add_integer_with_range(SOUT_CFG_PREFIX "moov-reserve", -1, -1, 65536,
+                           MOOV_RESERVE_TEXT, MOOV_RESERVE_LONGTEXT, true)
+    add_integer(SOUT_CFG_PREFIX "duration", 0,
+                DURATION_TEXT, DURATION_LONGTEXT, true)
     set_capability("sout mux", 5)
     add_shortcut("mp4", "mov", "3gp")
     set_callbacks(Open, Close)
@@ -88,7 +107,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "moov-reserve", "duration", NULL
 };
 
 static int Control(sout_mux_t *, int, va_list);
@@ -157,9 +176,12 @@ struct sout_mux_sys_t
     bool b_3gp;
     bool b_64_ext;
     bool b_fast_start;
+    bool b_mdat_started;
 
     uint64_t i_mdat_pos;
     uint64_t i_pos;
+    uint64_t i_moov_reserve; /* free box in front of the mdat */
+    mtime_t  i_expected_duration;
     mtime_t  i_read_duration;
     mtime_t  i_start_dts;
 
@@ -208,6 +230,10 @@ static int Open(vlc_object_t *p_this)
     p_sys->i_read_duration   = 0;
     p_sys->i_start_dts = VLC_TS_INVALID;
     p_sys->b_fragmented = false;
+    p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
+    p_sys->i_moov_reserve = 0;
+    p_sys->i_expected_duration =
+        var_GetInteger(p_this, SOUT_CFG_PREFIX "duration") * CLOCK_FREQ;
 
     if (!p_sys->b_mov) {
         /* Now add ftyp header */
@@ -237,13 +263,94 @@ static int Open(vlc_object_t *p_this)
      * Quicktime actually doesn't like the 64 bits extensions !!! */
     p_sys->b_64_ext = false;
 
+    /* The reserved space and the mdat header are written with the first
+     * data, once all the tracks are known */
+    p_sys->b_mdat_started = false;
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * EstimateMoovSize: upper bound of the moov size for a given duration
+ *****************************************************************************/
+static uint64_t EstimateMoovSize(sout_mux_t *p_mux, mtime_t i_duration)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    uint64_t i_size = 1024; /* mvhd and metadata */
+
+    for (unsigned i = 0; i < p_sys->i_nb_streams; i++) {
+        const es_format_t *p_fmt = &p_sys->pp_streams[i]->mux.fmt;
+        uint64_t i_samples;
+        unsigned i_entry;
+
+        /* Sample tables: a size, a chunk offset and a samples to chunk
+         * entry per sample when interleaved, and a sync or composition
+         * entry for video, or a timing entry for sparse tracks */
+        switch (p_fmt->i_cat) {
+        case VIDEO_ES:
+            i_samples = i_duration * p_fmt->video.i_frame_rate /
+                        p_fmt->video.i_frame_rate_base / CLOCK_FREQ;
+            i_entry = 28;
+            break;
+        case AUDIO_ES:
+            i_samples = i_duration * p_fmt->audio.i_rate /
+                        (p_fmt->audio.i_frame_length ?
+                         p_fmt->audio.i_frame_length : 1024) / CLOCK_FREQ;
+            i_entry = 20;
+            break;
+        default:
+            i_samples = i_duration / CLOCK_FREQ;
+            i_entry = 28;
+            break;
+        }
+
+        /* Track headers and sample description */
+        i_size += 2048 + p_fmt->i_extra + i_samples * i_entry;
+    }
+    return i_size;
+}
+
+/*****************************************************************************
+ * StartMdat: write the space reserved for the moov and the mdat header
+ *****************************************************************************/
+static int StartMdat(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    p_sys->b_mdat_started = true;
+
+    /* Reserve room for the moov, to be filled in place on close */
+    if (p_sys->b_fast_start) {
+        int64_t i_reserve = var_GetInteger(p_mux, SOUT_CFG_PREFIX "moov-reserve");
+
+        if (i_reserve >= 0)
+            p_sys->i_moov_reserve = i_reserve * 1024;
+        else if (p_sys->i_expected_duration > 0)
+            p_sys->i_moov_reserve = EstimateMoovSize(p_mux,
+                                                     p_sys->i_expected_duration);
+        if (p_sys->i_moov_reserve > 0)
+            msg_Dbg(p_mux, "reserving %"PRIu64" bytes for the moov",
+                    p_sys->i_moov_reserve);
+    }
+    if (p_sys->i_moov_reserve > 0) {
+        block_t *p_free = block_Alloc(p_sys->i_moov_reserve);
+        if (!p_free) {
+            p_sys->i_moov_reserve = 0;
+            return VLC_ENOMEM;
+        }
+        memset(p_free->p_buffer, 0, p_free->i_buffer);
+        SetDWBE(p_free->p_buffer, p_free->i_buffer);
+        memcpy(&p_free->p_buffer[4], "free", 4);
+
+        p_sys->i_pos += p_free->i_buffer;
+        p_sys->i_mdat_pos = p_sys->i_pos;
+        sout_AccessOutWrite(p_mux->p_access, p_free);
+    }
+
     /* Now add mdat header */
-    box = box_new("mdat");
+    bo_t *box = box_new("mdat");
     if(!box)
-    {
-        free(p_sys);
         return VLC_ENOMEM;
-    }
     bo_add_64be  (box, 0); // enough to store an extended size
 
     if(box->b)
@@ -254,6 +361,62 @@ static int Open(vlc_object_t *p_this)
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * MoveMdat: shift the media data forward to make room for the moov
+ *****************************************************************************/
+#define MOVE_CHUNK_SIZE (4 * 1024 * 1024)
+
+static int MoveMdat(sout_mux_t *p_mux, uint64_t i_shift)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    const uint64_t i_total = p_sys->i_pos - p_sys->i_mdat_pos;
+    uint64_t i_size = i_total;
+    vlc_dialog_id *p_dialog_id = NULL;
+    int i_ret = VLC_SUCCESS;
+
+    msg_Dbg(p_mux, "moving %"PRIu64" bytes of media data by %"PRIu64,
+            i_total, i_shift);
+
+    /* Only show progress if there is more than a few chunks to move */
+    if (i_total > 4 * MOVE_CHUNK_SIZE)
+        p_dialog_id =
+            vlc_dialog_display_progress(p_mux, false, 0.0, NULL,
+                                        _("MP4 fast start"),
+                                        _("Moving the media data..."));
+
+    /* Copy backwards so that nothing gets overwritten before being read */
+    while (i_size > 0) {
+        size_t i_chunk = __MIN(MOVE_CHUNK_SIZE, i_size);
+        block_t *p_buf = block_Alloc(i_chunk);
+        if (!p_buf) {
+            i_ret = VLC_ENOMEM;
+            break;
+        }
+
+        sout_AccessOutSeek(p_mux->p_access,
+                           p_sys->i_mdat_pos + i_size - i_chunk);
+        if (sout_AccessOutRead(p_mux->p_access, p_buf) < (ssize_t)i_chunk) {
+            msg_Warn(p_mux, "read() not supported by access output, "
+                      "won't create a fast start file");
+            block_Release(p_buf);
+            i_ret = VLC_EGENERIC;
+            break;
+        }
+        sout_AccessOutSeek(p_mux->p_access,
+                           p_sys->i_mdat_pos + i_size - i_chunk + i_shift);
+        sout_AccessOutWrite(p_mux->p_access, p_buf);
+        i_size -= i_chunk;
+
+        if (p_dialog_id != NULL)
+            vlc_dialog_update_progress(p_mux, p_dialog_id,
+                                       (double)(i_total - i_size) / i_total);
+    }
+
+    if (p_dialog_id != NULL)
+        vlc_dialog_release(p_mux, p_dialog_id);
+    return i_ret;
+}
+
 /*****************************************************************************
  * Close:
  *****************************************************************************/
@@ -264,6 +427,9 @@ static void Close(vlc_object_t *p_this)
 
     msg_Dbg(p_mux, "Close");
 
+    if (!p_sys->b_mdat_started && StartMdat(p_mux) != VLC_SUCCESS)
+        goto cleanup;
+
     /* Update mdat size */
     bo_t bo;
     if (!bo_init(&bo, 16))
@@ -289,59 +455,55 @@ static void Close(vlc_object_t *p_this)
     bo_t *moov = BuildMoov(p_mux);
 
     /* Check we need to create "fast start" files */
-    p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
-    while (p_sys->b_fast_start && moov && moov->b) {
-        /* Move data to the end of the file so we can fit the moov header
-         * at the start */
-        int64_t i_size = p_sys->i_pos - p_sys->i_mdat_pos;
-        int i_moov_size = moov->b->i_buffer;
-
-        while (i_size > 0) {
-            int64_t i_chunk = __MIN(32768, i_size);
-            block_t *p_buf = block_Alloc(i_chunk);
-            sout_AccessOutSeek(p_mux->p_access,
-                                p_sys->i_mdat_pos + i_size - i_chunk);
-            if (sout_AccessOutRead(p_mux->p_access, p_buf) < i_chunk) {
-                msg_Warn(p_this, "read() not supported by access output, "
-                          "won't create a fast start file");
-                p_sys->b_fast_start = false;
-                block_Release(p_buf);
-                break;
+    if (p_sys->b_fast_start && moov && moov->b) {
+        const uint64_t i_reserve = p_sys->i_moov_reserve;
+        const uint64_t i_moov_size = moov->b->i_buffer;
+        uint64_t i_shift = 0;
+
+        /* The moov goes into the reserved space and what is left of it
+         * must fit a free box. Otherwise, the data is moved to make room */
+        if (i_moov_size > i_reserve)
+            i_shift = i_moov_size - i_reserve;
+        else if (i_moov_size < i_reserve && i_reserve - i_moov_size < 8)
+            i_shift = 8 - (i_reserve - i_moov_size);
+
+        if (i_shift > 0 && i_reserve > 0)
+            msg_Warn(p_this, "moov (%"PRIu64" bytes) does not fit in the "
+                     "reserved space (%"PRIu64" bytes)", i_moov_size, i_reserve);
+
+        if (i_shift == 0 || MoveMdat(p_mux, i_shift) == VLC_SUCCESS) {
+            i_moov_pos = p_sys->i_mdat_pos - i_reserve;
+            p_sys->i_mdat_pos += i_shift;
+
+            /* Fix-up samples to chunks table in MOOV header */
+            for (unsigned int i_trak = 0; i_shift > 0 && i_trak < p_sys->i_nb_streams; i_trak++) {
+                mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+                unsigned i_written = 0;
+                for (unsigned i = 0; i < p_stream->mux.i_entry_count; ) {
+                    mp4mux_entry_t *entry = p_stream->mux.entry;
+                    if (b_stco64)
+                        bo_set_64be(moov, p_stream->mux.i_stco_pos + i_written++ * 8, entry[i].i_pos + i_shift);
+                    else
+                        bo_set_32be(moov, p_stream->mux.i_stco_pos + i_written++ * 4, entry[i].i_pos + i_shift);
+
+                    for (; i < p_stream->mux.i_entry_count; i++)
+                        if (i >= p_stream->mux.i_entry_count - 1 ||
+                            entry[i].i_pos + entry[i].i_size != entry[i+1].i_pos) {
+                            i++;
+                            break;
+                        }
+                }
             }
-            sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos + i_size +
-                                i_moov_size - i_chunk);
-            sout_AccessOutWrite(p_mux->p_access, p_buf);
-            i_size -= i_chunk;
-        }
 
-        if (!p_sys->b_fast_start)
-            break;
-
-        /* Update pos pointers */
-        i_moov_pos = p_sys->i_mdat_pos;
-        p_sys->i_mdat_pos += moov->b->i_buffer;
-
-        /* Fix-up samples to chunks table in MOOV header */
-        for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
-            mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
-            unsigned i_written = 0;
-            for (unsigned i = 0; i < p_stream->mux.i_entry_count; ) {
-                mp4mux_entry_t *entry = p_stream->mux.entry;
-                if (b_stco64)
-                    bo_set_64be(moov, p_stream->mux.i_stco_pos + i_written++ * 8, entry[i].i_pos + p_sys->i_mdat_pos - i_moov_pos);
-                else
-                    bo_set_32be(moov, p_stream->mux.i_stco_pos + i_written++ * 4, entry[i].i_pos + p_sys->i_mdat_pos - i_moov_pos);
-
-                for (; i < p_stream->mux.i_entry_count; i++)
-                    if (i >= p_stream->mux.i_entry_count - 1 ||
-                        entry[i].i_pos + entry[i].i_size != entry[i+1].i_pos) {
-                        i++;
-                        break;
-                    }
+            /* Leave the remaining reserved space as a free box */
+            uint64_t i_free = i_reserve + i_shift - i_moov_size;
+            if (i_free > 0 && bo_init(&bo, 8)) {
+                bo_add_32be  (&bo, i_free);
+                bo_add_fourcc(&bo, "free");
+                sout_AccessOutSeek(p_mux->p_access, i_moov_pos + i_moov_size);
+                sout_AccessOutWrite(p_mux->p_access, bo.b);
             }
         }
-
-        p_sys->b_fast_start = false;
     }
 
     /* Write MOOV header */
@@ -582,6 +744,12 @@ static int Mux(sout_mux_t *p_mux)
 {
     sout_mux_sys_t *p_sys = p_mux->p_sys;
 
+    if (!p_sys->b_mdat_started) {
+        int i_ret = StartMdat(p_mux);
+        if (i_ret != VLC_SUCCESS)
+            return i_ret;
+    }
+
     for (;;) {
         int i_stream = sout_MuxGetStream(p_mux, 2, NULL);
         if (i_stream < 0)
@@ -1259,6 +1427,8 @@ static void WriteFragments(sout_mux_t *p_mux, bool b_flush)
         msg_Dbg(p_mux, "writing moof @ %"PRId64, p_sys->i_pos);
         p_sys->i_pos += moof->b->i_buffer;
         assert(moof->b->i_flags & BLOCK_FLAG_TYPE_I); /* http sout */
+        /* fragment start time, for segmenting access outputs */
+        moof->b->i_dts = p_sys->i_start_dts + p_sys->i_written_duration;
         box_send(p_mux, moof);
         msg_Dbg(p_mux, "writing mdat @ %"PRId64, p_sys->i_pos);
         WriteFragmentMDAT(p_mux, i_mdat_size);
@@ -52,6 +52,39 @@ static subpicture_t *Filter ( filter_t *, mtime_t );
 static int MosaicCallback   ( vlc_object_t *, char const *, vlc_value_t,
                               vlc_value_t, void * );
 
+#define MOSAIC_THREADS_MAX 16
+
+/* Element composited on the canvas */
+typedef struct
+{
+    bridged_es_t *p_es;
+    picture_t *p_source;        /* picture to composite */
+    picture_t *pp_drawn[2];     /* picture last composited on each canvas */
+    filter_chain_t *p_chain;    /* scaler, NULL if a copy is enough */
+    video_format_t fmt_in;      /* source format the scaler was made for */
+    video_format_t fmt_out;     /* format of the tile in the canvas */
+    int i_x, i_y;               /* position of the tile in the canvas */
+    int i_alpha;                /* opacity of the element */
+    picture_t *p_canvas;        /* canvas being rendered */
+    bool b_failed;              /* no scaler available */
+    bool b_used;                /* still part of the mosaic */
+} mosaic_tile_t;
+
+/* Threads scaling the tiles */
+typedef struct
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait_job;        /* signaled when tiles are queued */
+    vlc_cond_t wait_done;       /* signaled when all tiles are scaled */
+    mosaic_tile_t **pp_jobs;
+    int i_jobs;
+    int i_next;                 /* next tile to scale */
+    int i_pending;              /* tiles not scaled yet */
+    bool b_closing;
+    unsigned i_threads;
+    vlc_thread_t threads[MOSAIC_THREADS_MAX];
+} mosaic_workers_t;
+
 /*****************************************************************************
  * filter_sys_t : filter descriptor
  *****************************************************************************/
@@ -79,6 +112,15 @@ struct filter_sys_t
     int i_offsets_length;
 
     mtime_t i_delay;
+
+    /* Canvas compositing */
+    bool b_canvas;
+    picture_t *pp_canvas[2];  /* canvases, used alternately */
+    unsigned i_canvas;        /* index of the next canvas to render */
+    mosaic_tile_t **pp_tiles;
+    int i_tiles;
+    bool b_layout_changed;
+    mosaic_workers_t workers;
 };
 
 /*****************************************************************************
@@ -151,6 +193,11 @@ struct filter_sys_t
         "(only used if positioning method is set to \"offsets\"). You " \
         "must give a comma-separated list of coordinates (eg: 10,10,150,10)." )
 
+#define CANVAS_TEXT N_("Composite on a canvas")
+#define CANVAS_LONGTEXT N_( \
+        "Scale the elements in parallel, and only when they change, into " \
+        "a single picture, instead of blending each of them separately." )
+
 #define DELAY_TEXT N_("Delay")
 #define DELAY_LONGTEXT N_( \
         "Pictures coming from the mosaic elements will be delayed " \
@@ -223,13 +270,16 @@ vlc_module_begin ()
 
     add_integer( CFG_PREFIX "delay", 0, DELAY_TEXT, DELAY_LONGTEXT,
                  false )
+
+    add_bool( CFG_PREFIX "canvas", false,
+              CANVAS_TEXT, CANVAS_LONGTEXT, true )
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
     "alpha", "height", "width", "align", "xoffset", "yoffset",
     "borderw", "borderh", "position", "rows", "cols",
     "keep-aspect-ratio", "keep-picture", "order", "offsets",
-    "delay", NULL
+    "delay", "canvas", NULL
 };
 
 /*****************************************************************************
@@ -272,6 +322,448 @@ static void mosaic_ParseSetOffsets( vlc_object_t *p_this,
 #define mosaic_ParseSetOffsets( a, b, c ) \
             mosaic_ParseSetOffsets( VLC_OBJECT( a ), b, c )
 
+/*****************************************************************************
+ * Canvas compositing
+ *****************************************************************************
+ * Each element is scaled by its own converter, kept as long as the source
+ * format and the tile geometry do not change, and written into a single
+ * YUVA canvas with its opacity, so that the renderer blends one region
+ * instead of one per element. The tiles are scaled in parallel, and only if
+ * the source picture changed since the canvas was last rendered. Two
+ * canvases are used alternately, since the previous one may still be
+ * referenced by the subpicture being displayed.
+ *****************************************************************************/
+
+/* Writes a scaled (I420 or YUVA) element into the canvas. */
+static void TileBlit( const mosaic_tile_t *p_tile, const picture_t *p_pic )
+{
+    picture_t *p_canvas = p_tile->p_canvas;
+    const unsigned i_width = p_tile->fmt_out.i_visible_width;
+    const unsigned i_height = p_tile->fmt_out.i_visible_height;
+    const bool b_alpha = p_pic->format.i_chroma == VLC_CODEC_YUVA;
+
+    for( unsigned y = 0; y < i_height; y++ )
+    {
+        uint8_t *pp_dst[4];
+        for( int i = 0; i < 4; i++ )
+            pp_dst[i] = &p_canvas->p[i].p_pixels[
+                (p_tile->i_y + y) * p_canvas->p[i].i_pitch + p_tile->i_x];
+
+        const unsigned y_src = b_alpha ? y : y / 2;
+        const uint8_t *p_u = &p_pic->p[U_PLANE].p_pixels[
+                                            y_src * p_pic->p[U_PLANE].i_pitch];
+        const uint8_t *p_v = &p_pic->p[V_PLANE].p_pixels[
+                                            y_src * p_pic->p[V_PLANE].i_pitch];
+
+        memcpy( pp_dst[Y_PLANE], &p_pic->p[Y_PLANE].p_pixels[
+                    y * p_pic->p[Y_PLANE].i_pitch], i_width );
+        if( b_alpha )
+        {
+            const uint8_t *p_a = &p_pic->p[A_PLANE].p_pixels[
+                                            y * p_pic->p[A_PLANE].i_pitch];
+
+            memcpy( pp_dst[U_PLANE], p_u, i_width );
+            memcpy( pp_dst[V_PLANE], p_v, i_width );
+            for( unsigned x = 0; x < i_width; x++ )
+                pp_dst[A_PLANE][x] = p_a[x] * p_tile->i_alpha / 255;
+        }
+        else
+        {   /* Upsample the chroma */
+            for( unsigned x = 0; x < i_width; x++ )
+            {
+                pp_dst[U_PLANE][x] = p_u[x / 2];
+                pp_dst[V_PLANE][x] = p_v[x / 2];
+            }
+            memset( pp_dst[A_PLANE], p_tile->i_alpha, i_width );
+        }
+    }
+}
+
+static picture_t *TileNewBuffer( filter_t *p_scaler )
+{
+    return picture_NewFromFormat( &p_scaler->fmt_out.video );
+}
+
+static void TileDraw( mosaic_tile_t *p_tile )
+{
+    picture_t *p_pic = picture_Hold( p_tile->p_source );
+
+    if( p_tile->p_chain != NULL )
+        p_pic = filter_chain_VideoFilter( p_tile->p_chain, p_pic );
+    if( p_pic != NULL )
+    {
+        TileBlit( p_tile, p_pic );
+        picture_Release( p_pic );
+    }
+}
+
+/* Forces the tile to be drawn again on both canvases. */
+static void TileInvalidate( mosaic_tile_t *p_tile )
+{
+    for( int i = 0; i < 2; i++ )
+        if( p_tile->pp_drawn[i] != NULL )
+        {
+            picture_Release( p_tile->pp_drawn[i] );
+            p_tile->pp_drawn[i] = NULL;
+        }
+}
+
+static void TileReset( mosaic_tile_t *p_tile )
+{
+    if( p_tile->p_chain != NULL )
+    {
+        filter_chain_Delete( p_tile->p_chain );
+        p_tile->p_chain = NULL;
+    }
+    video_format_Clean( &p_tile->fmt_in );
+    video_format_Init( &p_tile->fmt_in, 0 );
+    p_tile->b_failed = false;
+    TileInvalidate( p_tile );
+}
+
+static void TileDelete( mosaic_tile_t *p_tile )
+{
+    TileReset( p_tile );
+    if( p_tile->p_source != NULL )
+        picture_Release( p_tile->p_source );
+    video_format_Clean( &p_tile->fmt_out );
+    free( p_tile );
+}
+
+/* Creates the scaler if the source format or the tile geometry changed. */
+static void TileSetup( filter_t *p_filter, mosaic_tile_t *p_tile )
+{
+    const video_format_t *p_src = &p_tile->p_source->format;
+
+    if( p_tile->fmt_in.i_chroma == p_src->i_chroma
+     && p_tile->fmt_in.i_width == p_src->i_width
+     && p_tile->fmt_in.i_height == p_src->i_height
+     && p_tile->fmt_in.i_visible_width == p_src->i_visible_width
+     && p_tile->fmt_in.i_visible_height == p_src->i_visible_height )
+        return;
+
+    TileReset( p_tile );
+    video_format_Copy( &p_tile->fmt_in, p_src );
+
+    if( p_src->i_chroma == p_tile->fmt_out.i_chroma
+     && p_src->i_visible_width == p_tile->fmt_out.i_visible_width
+     && p_src->i_visible_height == p_tile->fmt_out.i_visible_height )
+        return; /* no scaling needed */
+
+    filter_owner_t owner = {
+        .video = {
+            .buffer_new = TileNewBuffer,
+        },
+    };
+    es_format_t fmt_in, fmt_out;
+
+    es_format_Init( &fmt_in, VIDEO_ES, p_src->i_chroma );
+    video_format_Copy( &fmt_in.video, p_src );
+    es_format_Init( &fmt_out, VIDEO_ES, p_tile->fmt_out.i_chroma );
+    video_format_Copy( &fmt_out.video, &p_tile->fmt_out );
+
+    p_tile->p_chain = filter_chain_NewVideo( p_filter, false, &owner );
+    if( p_tile->p_chain != NULL )
+    {
+        filter_chain_Reset( p_tile->p_chain, &fmt_in, &fmt_out );
+        if( filter_chain_AppendConverter( p_tile->p_chain, NULL, NULL ) )
+        {
+            filter_chain_Delete( p_tile->p_chain );
+            p_tile->p_chain = NULL;
+        }
+    }
+    if( p_tile->p_chain == NULL )
+    {
+        msg_Warn( p_filter, "image resizing and chroma conversion failed" );
+        p_tile->b_failed = true;
+    }
+    es_format_Clean( &fmt_out );
+    es_format_Clean( &fmt_in );
+}
+
+/**
+ * Adds an element to the canvas at the given position (relative to the top
+ * left corner of the mosaic). Called with the mosaic lock held.
+ * \return VLC_SUCCESS, VLC_EGENERIC if the element does not fit in the
+ * canvas, or VLC_ENOMEM
+ */
+static int CanvasAddTile( filter_t *p_filter, bridged_es_t *p_es,
+                           const video_format_t *p_fmt, int i_x, int i_y )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const unsigned i_width = p_fmt->i_width & ~1;
+    const unsigned i_height = p_fmt->i_height & ~1;
+
+    /* Chroma planes of I420 elements are subsampled */
+    i_x &= ~1;
+    i_y &= ~1;
+    if( i_x < 0 || i_y < 0 || i_width == 0 || i_height == 0
+     || i_x + i_width > (unsigned)(p_sys->i_width & ~1)
+     || i_y + i_height > (unsigned)(p_sys->i_height & ~1) )
+        return VLC_EGENERIC; /* outside of the canvas */
+
+    mosaic_tile_t *p_tile = NULL;
+    for( int i = 0; i < p_sys->i_tiles; i++ )
+        if( p_sys->pp_tiles[i]->p_es == p_es && !p_sys->pp_tiles[i]->b_used )
+        {
+            p_tile = p_sys->pp_tiles[i];
+            break;
+        }
+
+    if( p_tile == NULL )
+    {
+        p_tile = calloc( 1, sizeof (*p_tile) );
+        if( unlikely(p_tile == NULL) )
+            return VLC_ENOMEM;
+        p_tile->p_es = p_es;
+        video_format_Init( &p_tile->fmt_in, 0 );
+        video_format_Init( &p_tile->fmt_out, 0 );
+        TAB_APPEND( p_sys->i_tiles, p_sys->pp_tiles, p_tile );
+        p_sys->b_layout_changed = true;
+    }
+
+    if( p_tile->i_x != i_x || p_tile->i_y != i_y
+     || p_tile->fmt_out.i_chroma != p_fmt->i_chroma
+     || p_tile->fmt_out.i_visible_width != i_width
+     || p_tile->fmt_out.i_visible_height != i_height )
+    {
+        TileReset( p_tile );
+        p_tile->i_x = i_x;
+        p_tile->i_y = i_y;
+        video_format_Clean( &p_tile->fmt_out );
+        video_format_Init( &p_tile->fmt_out, p_fmt->i_chroma );
+        video_format_Setup( &p_tile->fmt_out, p_fmt->i_chroma,
+                            i_width, i_height, i_width, i_height, 1, 1 );
+        p_sys->b_layout_changed = true;
+    }
+
+    if( p_tile->i_alpha != p_es->i_alpha )
+    {
+        p_tile->i_alpha = p_es->i_alpha;
+        TileInvalidate( p_tile );
+    }
+
+    if( p_tile->p_source != NULL )
+        picture_Release( p_tile->p_source );
+    p_tile->p_source = picture_Hold( p_es->p_picture );
+    p_tile->b_used = true;
+
+    TileSetup( p_filter, p_tile );
+    return VLC_SUCCESS;
+}
+
+/* Scales queued tiles until none is left. Called with the lock held. */
+static void WorkersProcess( mosaic_workers_t *p_workers )
+{
+    while( p_workers->i_next < p_workers->i_jobs )
+    {
+        mosaic_tile_t *p_tile = p_workers->pp_jobs[p_workers->i_next++];
+
+        vlc_mutex_unlock( &p_workers->lock );
+        TileDraw( p_tile );
+        vlc_mutex_lock( &p_workers->lock );
+
+        if( --p_workers->i_pending == 0 )
+            vlc_cond_signal( &p_workers->wait_done );
+    }
+}
+
+static void *WorkerThread( void *data )
+{
+    mosaic_workers_t *p_workers = data;
+
+    vlc_mutex_lock( &p_workers->lock );
+    for( ;; )
+    {
+        while( !p_workers->b_closing
+            && p_workers->i_next >= p_workers->i_jobs )
+            vlc_cond_wait( &p_workers->wait_job, &p_workers->lock );
+        if( p_workers->b_closing )
+            break;
+        WorkersProcess( p_workers );
+    }
+    vlc_mutex_unlock( &p_workers->lock );
+    return NULL;
+}
+
+static void WorkersStart( mosaic_workers_t *p_workers )
+{
+    unsigned i_count = vlc_GetCPUCount();
+
+    vlc_mutex_init( &p_workers->lock );
+    vlc_cond_init( &p_workers->wait_job );
+    vlc_cond_init( &p_workers->wait_done );
+    p_workers->pp_jobs = NULL;
+    p_workers->i_jobs = p_workers->i_next = p_workers->i_pending = 0;
+    p_workers->b_closing = false;
+    p_workers->i_threads = 0;
+
+    /* The calling thread scales tiles too */
+    if( i_count > MOSAIC_THREADS_MAX + 1 )
+        i_count = MOSAIC_THREADS_MAX + 1;
+    while( p_workers->i_threads + 1 < i_count )
+    {
+        if( vlc_clone( &p_workers->threads[p_workers->i_threads],
+                       WorkerThread, p_workers, VLC_THREAD_PRIORITY_VIDEO ) )
+            break;
+        p_workers->i_threads++;
+    }
+}
+
+static void WorkersStop( mosaic_workers_t *p_workers )
+{
+    vlc_mutex_lock( &p_workers->lock );
+    p_workers->b_closing = true;
+    vlc_cond_broadcast( &p_workers->wait_job );
+    vlc_mutex_unlock( &p_workers->lock );
+
+    for( unsigned i = 0; i < p_workers->i_threads; i++ )
+        vlc_join( p_workers->threads[i], NULL );
+
+    free( p_workers->pp_jobs );
+    vlc_cond_destroy( &p_workers->wait_done );
+    vlc_cond_destroy( &p_workers->wait_job );
+    vlc_mutex_destroy( &p_workers->lock );
+}
+
+static picture_t *CanvasNew( filter_sys_t *p_sys )
+{
+    picture_t *p_canvas = picture_New( VLC_CODEC_YUVA, p_sys->i_width & ~1,
+                                       p_sys->i_height & ~1, 1, 1 );
+    if( unlikely(p_canvas == NULL) )
+        return NULL;
+
+    /* Transparent black */
+    memset( p_canvas->p[Y_PLANE].p_pixels, 0x10,
+            p_canvas->p[Y_PLANE].i_pitch * p_canvas->p[Y_PLANE].i_lines );
+    memset( p_canvas->p[U_PLANE].p_pixels, 0x80,
+            p_canvas->p[U_PLANE].i_pitch * p_canvas->p[U_PLANE].i_lines );
+    memset( p_canvas->p[V_PLANE].p_pixels, 0x80,
+            p_canvas->p[V_PLANE].i_pitch * p_canvas->p[V_PLANE].i_lines );
+    memset( p_canvas->p[A_PLANE].p_pixels, 0x00,
+            p_canvas->p[A_PLANE].i_pitch * p_canvas->p[A_PLANE].i_lines );
+    return p_canvas;
+}
+
+/**
+ * Scales the changed tiles into the canvas, and attaches it to the
+ * subpicture. Called with the mosaic lock held.
+ */
+static void CanvasRender( filter_t *p_filter, subpicture_t *p_spu )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    mosaic_workers_t *p_workers = &p_sys->workers;
+
+    /* Drop the elements that left the mosaic */
+    for( int i = 0; i < p_sys->i_tiles; )
+    {
+        mosaic_tile_t *p_tile = p_sys->pp_tiles[i];
+        if( !p_tile->b_used )
+        {
+            TileDelete( p_tile );
+            TAB_ERASE( p_sys->i_tiles, p_sys->pp_tiles, i );
+            p_sys->b_layout_changed = true;
+            continue;
+        }
+        p_tile->b_used = false;
+        i++;
+    }
+
+    for( int k = 0; k < 2; k++ )
+    {
+        picture_t *p_canvas = p_sys->pp_canvas[k];
+        if( p_canvas == NULL )
+            continue;
+        /* Blank the areas left by the tiles (and resize the canvas) */
+        if( p_sys->b_layout_changed
+         || p_canvas->format.i_width != (unsigned)(p_sys->i_width & ~1)
+         || p_canvas->format.i_height != (unsigned)(p_sys->i_height & ~1) )
+        {
+            picture_Release( p_canvas );
+            p_sys->pp_canvas[k] = NULL;
+        }
+    }
+    p_sys->b_layout_changed = false;
+
+    const unsigned k = p_sys->i_canvas;
+    p_sys->i_canvas = !k;
+
+    /* The canvas may still be used, e.g. by a previous subpicture */
+    if( p_sys->pp_canvas[k] != NULL
+     && picture_IsReferenced( p_sys->pp_canvas[k] ) )
+    {
+        picture_Release( p_sys->pp_canvas[k] );
+        p_sys->pp_canvas[k] = NULL;
+    }
+    if( p_sys->pp_canvas[k] == NULL )
+    {
+        if( p_sys->i_width < 2 || p_sys->i_height < 2 )
+            return;
+        p_sys->pp_canvas[k] = CanvasNew( p_sys );
+        if( p_sys->pp_canvas[k] == NULL )
+            return;
+        for( int i = 0; i < p_sys->i_tiles; i++ )
+        {
+            mosaic_tile_t *p_tile = p_sys->pp_tiles[i];
+            if( p_tile->pp_drawn[k] != NULL )
+            {
+                picture_Release( p_tile->pp_drawn[k] );
+                p_tile->pp_drawn[k] = NULL;
+            }
+        }
+    }
+
+    picture_t *p_canvas = p_sys->pp_canvas[k];
+    mosaic_tile_t **pp_jobs = realloc( p_workers->pp_jobs,
+                                       p_sys->i_tiles * sizeof (*pp_jobs) );
+    int i_jobs = 0;
+
+    if( unlikely(pp_jobs == NULL && p_sys->i_tiles > 0) )
+        return;
+
+    /* Only scale the tiles whose source changed */
+    for( int i = 0; i < p_sys->i_tiles; i++ )
+    {
+        mosaic_tile_t *p_tile = p_sys->pp_tiles[i];
+
+        if( p_tile->b_failed || p_tile->pp_drawn[k] == p_tile->p_source )
+            continue;
+
+        if( p_tile->pp_drawn[k] != NULL )
+            picture_Release( p_tile->pp_drawn[k] );
+        p_tile->pp_drawn[k] = picture_Hold( p_tile->p_source );
+        p_tile->p_canvas = p_canvas;
+        pp_jobs[i_jobs++] = p_tile;
+    }
+
+    vlc_mutex_lock( &p_workers->lock );
+    p_workers->pp_jobs = pp_jobs;
+    p_workers->i_jobs = i_jobs;
+    p_workers->i_next = 0;
+    p_workers->i_pending = i_jobs;
+    vlc_cond_broadcast( &p_workers->wait_job );
+    WorkersProcess( p_workers );
+    while( p_workers->i_pending > 0 )
+        vlc_cond_wait( &p_workers->wait_done, &p_workers->lock );
+    p_workers->i_jobs = p_workers->i_next = 0;
+    vlc_mutex_unlock( &p_workers->lock );
+
+    /* Emit the canvas as a single opaque region */
+    subpicture_region_t *p_region = subpicture_region_New( &p_canvas->format );
+    if( unlikely(p_region == NULL) )
+        return;
+
+    picture_Release( p_region->p_picture );
+    p_region->p_picture = picture_Hold( p_canvas );
+    p_region->i_x = p_sys->i_xoffset;
+    p_region->i_y = p_sys->i_yoffset;
+    p_region->i_align = p_sys->i_align;
+    p_region->i_alpha = 255;
+    /* Below the elements left out of the canvas, if any */
+    p_region->p_next = p_spu->p_region;
+    p_spu->p_region = p_region;
+}
+
 /*****************************************************************************
  * CreateFiler: allocate mosaic video filter
  *****************************************************************************/
@@ -333,6 +825,16 @@ static int CreateFilter( vlc_object_t *p_this )
         p_sys->p_image = image_HandlerCreate( p_filter );
     }
 
+    p_sys->b_canvas = !p_sys->b_keep
+                   && var_CreateGetBool( p_filter, CFG_PREFIX "canvas" );
+    p_sys->pp_canvas[0] = p_sys->pp_canvas[1] = NULL;
+    p_sys->i_canvas = 0;
+    p_sys->pp_tiles = NULL;
+    p_sys->i_tiles = 0;
+    p_sys->b_layout_changed = false;
+    if( p_sys->b_canvas )
+        WorkersStart( &p_sys->workers );
+
     p_sys->i_order_length = 0;
     p_sys->ppsz_order = NULL;
     psz_order = var_CreateGetStringCommand( p_filter, CFG_PREFIX "order" );
@@ -401,6 +903,17 @@ static void DestroyFilter( vlc_object_t *p_this )
     DEL_CB( order );
 #undef DEL_CB
 
+    if( p_sys->b_canvas )
+    {
+        WorkersStop( &p_sys->workers );
+        for( int i = 0; i < p_sys->i_tiles; i++ )
+            TileDelete( p_sys->pp_tiles[i] );
+        TAB_CLEAN( p_sys->i_tiles, p_sys->pp_tiles );
+        for( int i = 0; i < 2; i++ )
+            if( p_sys->pp_canvas[i] != NULL )
+                picture_Release( p_sys->pp_canvas[i] );
+    }
+
     if( !p_sys->b_keep )
     {
         image_HandlerDelete( p_sys->p_image );
@@ -618,15 +1131,20 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
             fmt_out.i_visible_width = fmt_out.i_width;
             fmt_out.i_visible_height = fmt_out.i_height;
 
-            p_converted = image_Convert( p_sys->p_image, p_es->p_picture,
-                                         &fmt_in, &fmt_out );
-            if( !p_converted )
+            if( p_sys->b_canvas )
+                p_converted = NULL; /* scaled later, into the canvas */
+            else
             {
-                msg_Warn( p_filter,
-                           "image resizing and chroma conversion failed" );
-                video_format_Clean( &fmt_in );
-                video_format_Clean( &fmt_out );
-                continue;
+                p_converted = image_Convert( p_sys->p_image, p_es->p_picture,
+                                             &fmt_in, &fmt_out );
+                if( !p_converted )
+                {
+                    msg_Warn( p_filter,
+                               "image resizing and chroma conversion failed" );
+                    video_format_Clean( &fmt_in );
+                    video_format_Clean( &fmt_out );
+                    continue;
+                }
             }
         }
         else
@@ -639,33 +1157,16 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
             fmt_out.i_visible_height = fmt_out.i_height;
         }
 
-        p_region = subpicture_region_New( &fmt_out );
-        /* FIXME the copy is probably not needed anymore */
-        if( p_region )
-            picture_Copy( p_region->p_picture, p_converted );
-        if( !p_sys->b_keep )
-            picture_Release( p_converted );
-
-        if( !p_region )
-        {
-            video_format_Clean( &fmt_in );
-            video_format_Clean( &fmt_out );
-            msg_Err( p_filter, "cannot allocate SPU region" );
-            subpicture_Delete( p_spu );
-            vlc_global_unlock( VLC_MOSAIC_MUTEX );
-            vlc_mutex_unlock( &p_sys->lock );
-            return NULL;
-        }
-
+        int i_x, i_y;
         if( p_es->i_x >= 0 && p_es->i_y >= 0 )
         {
-            p_region->i_x = p_es->i_x;
-            p_region->i_y = p_es->i_y;
+            i_x = p_es->i_x;
+            i_y = p_es->i_y;
         }
         else if( p_sys->i_position == position_offsets )
         {
-            p_region->i_x = p_sys->pi_x_offsets[i_real_index];
-            p_region->i_y = p_sys->pi_y_offsets[i_real_index];
+            i_x = p_sys->pi_x_offsets[i_real_index];
+            i_y = p_sys->pi_y_offsets[i_real_index];
         }
         else
         {
@@ -674,17 +1175,17 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
             {
                 /* we don't have to center the video since it takes the
                 whole rectangle area or it's larger than the rectangle */
-                p_region->i_x = p_sys->i_xoffset
-                            + i_col * ( p_sys->i_width / p_sys->i_cols )
-                            + ( i_col * p_sys->i_borderw ) / p_sys->i_cols;
+                i_x = p_sys->i_xoffset
+                    + i_col * ( p_sys->i_width / p_sys->i_cols )
+                    + ( i_col * p_sys->i_borderw ) / p_sys->i_cols;
             }
             else
             {
                 /* center the video in the dedicated rectangle */
-                p_region->i_x = p_sys->i_xoffset
-                        + i_col * ( p_sys->i_width / p_sys->i_cols )
-                        + ( i_col * p_sys->i_borderw ) / p_sys->i_cols
-                        + ( col_inner_width - fmt_out.i_width ) / 2;
+                i_x = p_sys->i_xoffset
+                    + i_col * ( p_sys->i_width / p_sys->i_cols )
+                    + ( i_col * p_sys->i_borderw ) / p_sys->i_cols
+                    + ( col_inner_width - fmt_out.i_width ) / 2;
             }
 
             if( fmt_out.i_height > row_inner_height
@@ -692,19 +1193,65 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
             {
                 /* we don't have to center the video since it takes the
                 whole rectangle area or it's taller than the rectangle */
-                p_region->i_y = p_sys->i_yoffset
-                        + i_row * ( p_sys->i_height / p_sys->i_rows )
-                        + ( i_row * p_sys->i_borderh ) / p_sys->i_rows;
+                i_y = p_sys->i_yoffset
+                    + i_row * ( p_sys->i_height / p_sys->i_rows )
+                    + ( i_row * p_sys->i_borderh ) / p_sys->i_rows;
             }
             else
             {
                 /* center the video in the dedicated rectangle */
-                p_region->i_y = p_sys->i_yoffset
-                        + i_row * ( p_sys->i_height / p_sys->i_rows )
-                        + ( i_row * p_sys->i_borderh ) / p_sys->i_rows
-                        + ( row_inner_height - fmt_out.i_height ) / 2;
+                i_y = p_sys->i_yoffset
+                    + i_row * ( p_sys->i_height / p_sys->i_rows )
+                    + ( i_row * p_sys->i_borderh ) / p_sys->i_rows
+                    + ( row_inner_height - fmt_out.i_height ) / 2;
             }
         }
+
+        if( p_sys->b_canvas )
+        {   /* Scaled later, directly into the canvas */
+            if( CanvasAddTile( p_filter, p_es, &fmt_out, i_x - p_sys->i_xoffset,
+                               i_y - p_sys->i_yoffset ) == VLC_SUCCESS )
+            {
+                video_format_Clean( &fmt_in );
+                video_format_Clean( &fmt_out );
+                continue;
+            }
+
+            /* Blend the elements that cannot be drawn into the canvas as
+             * separate regions, as without the canvas. */
+            if( !p_sys->b_keep )
+                p_converted = image_Convert( p_sys->p_image, p_es->p_picture,
+                                             &fmt_in, &fmt_out );
+            if( !p_converted )
+            {
+                msg_Warn( p_filter,
+                          "image resizing and chroma conversion failed" );
+                video_format_Clean( &fmt_in );
+                video_format_Clean( &fmt_out );
+                continue;
+            }
+        }
+
+        p_region = subpicture_region_New( &fmt_out );
+        /* FIXME the copy is probably not needed anymore */
+        if( p_region )
+            picture_Copy( p_region->p_picture, p_converted );
+        if( !p_sys->b_keep )
+            picture_Release( p_converted );
+
+        if( !p_region )
+        {
+            video_format_Clean( &fmt_in );
+            video_format_Clean( &fmt_out );
+            msg_Err( p_filter, "cannot allocate SPU region" );
+            subpicture_Delete( p_spu );
+            vlc_global_unlock( VLC_MOSAIC_MUTEX );
+            vlc_mutex_unlock( &p_sys->lock );
+            return NULL;
+        }
+
+        p_region->i_x = i_x;
+        p_region->i_y = i_y;
         p_region->i_align = p_sys->i_align;
         p_region->i_alpha = p_es->i_alpha;
 
@@ -724,6 +1271,8 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
     }
 
     vlc_global_unlock( VLC_MOSAIC_MUTEX );
+    if( p_sys->b_canvas )
+        CanvasRender( p_filter, p_spu );
     vlc_mutex_unlock( &p_sys->lock );
 
     return p_spu;
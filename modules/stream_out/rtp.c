@@ -173,6 +173,12 @@ static const char *const ppsz_protocols[] = {
     "negative value or zero disables timeouts. The default is 60 (one " \
     "minute)." )
 
+#define RTSP_VOD_CACHE_TEXT N_( "VoD packet cache size (MiB)" )
+#define RTSP_VOD_CACHE_LONGTEXT N_( "The packets sent to the first " \
+    "client playing a VoD media from its beginning are kept in memory, " \
+    "up to this size, to serve the following clients without decoding " \
+    "the media again. Setting it to zero disables the cache." )
+
 #define RTSP_USER_TEXT N_("Username")
 #define RTSP_USER_LONGTEXT N_("Username that will be " \
                               "requested to access the stream." )
@@ -254,6 +260,8 @@ vlc_module_begin ()
     add_shortcut( "rtsp" )
     add_integer( "rtsp-timeout", 60, RTSP_TIMEOUT_TEXT,
                  RTSP_TIMEOUT_LONGTEXT, true )
+    add_integer( "rtsp-vod-cache", 256, RTSP_VOD_CACHE_TEXT,
+                 RTSP_VOD_CACHE_LONGTEXT, true )
     add_string( "sout-rtsp-user", "",
                 RTSP_USER_TEXT, RTSP_USER_LONGTEXT, true )
     add_password( "sout-rtsp-pwd", "",
@@ -389,6 +397,11 @@ struct sout_stream_id_sys_t
 
     block_fifo_t     *p_fifo;
     int64_t           i_caching;
+
+    /* VoD packet cache being recorded */
+    vod_cache_t      *p_cache;
+    unsigned          i_cache_track;
+    bool              b_cache_rap;
 };
 
 /*****************************************************************************
@@ -666,6 +679,9 @@ static void Close( vlc_object_t * p_this )
         }
     }
 
+    if( p_sys->p_vod_media != NULL )
+        vod_record_end( p_sys->p_vod_media, p_sys->psz_vod_session );
+
     if( p_sys->rtsp != NULL )
         RtspUnsetup( p_sys->rtsp );
 
@@ -981,6 +997,8 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     id->rtsp_id = NULL;
     id->p_fifo = NULL;
     id->listen.fd = NULL;
+    id->p_cache = NULL;
+    id->b_cache_rap = true;
 
     id->b_first_packet = true;
     id->i_caching =
@@ -1053,6 +1071,18 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
 
     id->i_seq_sent_next = id->i_sequence;
 
+    if (p_sys->p_vod_media != NULL && format)
+    {
+#ifdef HAVE_SRTP
+        /* The cache keeps the packets before encryption */
+        if (id->srtp == NULL)
+#endif
+            id->p_cache = vod_record_id(p_sys->p_vod_media,
+                                        p_sys->psz_vod_session,
+                                        p_fmt ? p_fmt->i_id : 0,
+                                        &id->i_cache_track);
+    }
+
     int mcast_fd = -1;
     if( p_sys->psz_destination != NULL )
     {
@@ -1286,6 +1316,10 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
                                           p_buffer->i_pts);
         }
 
+        /* The next packet starts a random access point for the cache */
+        id->b_cache_rap = id->rtp_fmt.cat != VIDEO_ES
+                       || (p_buffer->i_flags & BLOCK_FLAG_TYPE_I);
+
         if( id->rtp_fmt.pf_packetize( id, p_buffer ) )
             break;
 
@@ -1661,6 +1695,16 @@ uint16_t rtp_get_extended_sequence( sout_stream_id_sys_t *id )
 
 void rtp_packetize_send( sout_stream_id_sys_t *id, block_t *out )
 {
+    if( id->p_cache != NULL )
+    {
+        sout_stream_sys_t *p_sys = id->p_stream->p_sys;
+
+        /* Muxed streams can be resumed from any packet */
+        vod_cache_Append( id->p_cache, p_sys->psz_vod_session,
+                          id->i_cache_track, out,
+                          id->b_cache_rap || p_sys->p_mux != NULL );
+        id->b_cache_rap = false;
+    }
     block_FifoPut( id->p_fifo, out );
 }
 
@@ -41,6 +41,9 @@ int RtspTrackAttach( rtsp_stream_t *rtsp, const char *name,
                      uint32_t *ssrc, uint16_t *seq_init );
 void RtspTrackDetach( rtsp_stream_t *rtsp, const char *name,
                       sout_stream_id_sys_t *sout_id);
+bool RtspSessionIdle( rtsp_stream_t *rtsp, const char *name );
+int RtspTrackOpen( rtsp_stream_t *rtsp, const char *name,
+                   rtsp_stream_id_t *id, uint32_t *ssrc, uint16_t *seq_init );
 
 char *SDPGenerate( sout_stream_t *p_stream, const char *rtsp_url );
 char *SDPGenerateVoD( const vod_media_t *p_media, const char *rtsp_url );
@@ -110,4 +113,42 @@ int vod_init_id(vod_media_t *p_media, const char *psz_session, int es_id,
                 uint32_t *ssrc, uint16_t *seq_init);
 void vod_detach_id(vod_media_t *p_media, const char *psz_session,
                    sout_stream_id_sys_t *sout_id);
+uint16_t vod_get_seq(vod_media_t *p_media, const char *psz_session,
+                     rtsp_stream_id_t *id, uint16_t seq);
+
+/* VoD packet cache */
+typedef struct vod_cache_t vod_cache_t;
+
+typedef struct vod_cache_sink_t
+{
+    int      fd;   /* -1 if the track was not SETUP */
+    uint32_t ssrc;
+    uint16_t seq;
+} vod_cache_sink_t;
+
+vod_cache_t *vod_record_id(vod_media_t *p_media, const char *psz_session,
+                           int es_id, unsigned *track);
+void vod_record_end(vod_media_t *p_media, const char *psz_session);
+
+vod_cache_t *vod_cache_New( vlc_object_t *obj, unsigned trackc,
+                            const unsigned *clock_ratev, size_t max_size,
+                            mtime_t length );
+void vod_cache_Delete( vod_cache_t *cache );
+
+bool vod_cache_Record( vod_cache_t *cache, const char *psz_session );
+bool vod_cache_IsRecorder( vod_cache_t *cache, const char *psz_session );
+void vod_cache_Append( vod_cache_t *cache, const char *psz_session,
+                       unsigned track, const block_t *p_packet, bool b_rap );
+void vod_cache_End( vod_cache_t *cache, const char *psz_session,
+                    bool b_abort );
+bool vod_cache_IsReady( vod_cache_t *cache );
+
+int vod_cache_Play( vod_cache_t *cache, const char *psz_session,
+                    const vod_cache_sink_t *sinks, int64_t ts_init,
+                    int64_t *start, int64_t end );
+int vod_cache_Pause( vod_cache_t *cache, const char *psz_session,
+                     int64_t *npt );
+bool vod_cache_Stop( vod_cache_t *cache, const char *psz_session );
+bool vod_cache_GetSeq( vod_cache_t *cache, const char *psz_session,
+                       unsigned track, uint16_t *seq );
 
@@ -528,6 +528,53 @@ out:
 }
 
 
+/* Tell whether no VoD RTP output is attached to a session */
+bool RtspSessionIdle( rtsp_stream_t *rtsp, const char *name )
+{
+    bool idle = true;
+
+    vlc_mutex_lock(&rtsp->lock);
+    rtsp_session_t *session = RtspClientGet(rtsp, name);
+    if (session != NULL)
+    {
+        for (int i = 0; i < session->trackc; i++)
+            if (session->trackv[i].sout_id != NULL)
+                idle = false;
+    }
+    vlc_mutex_unlock(&rtsp->lock);
+    return idle;
+}
+
+
+/* Return a socket to the destination of a VoD track, for the packet cache
+ * to send to, along with the parameters of the SETUP request, or -1 if the
+ * track was not SETUP */
+int RtspTrackOpen( rtsp_stream_t *rtsp, const char *name,
+                   rtsp_stream_id_t *id, uint32_t *ssrc, uint16_t *seq_init )
+{
+    int fd = -1;
+
+    vlc_mutex_lock(&rtsp->lock);
+    rtsp_session_t *session = RtspClientGet(rtsp, name);
+    if (session != NULL)
+    {
+        for (int i = 0; i < session->trackc; i++)
+        {
+            rtsp_strack_t *tr = session->trackv + i;
+            if (tr->id == id && tr->setup_fd != -1)
+            {
+                fd = dup_socket(tr->setup_fd);
+                *ssrc = tr->ssrc;
+                *seq_init = tr->seq_init;
+                break;
+            }
+        }
+    }
+    vlc_mutex_unlock(&rtsp->lock);
+    return fd;
+}
+
+
 /** rtsp must be locked */
 static void RtspTrackClose( rtsp_strack_t *tr )
 {
@@ -1010,8 +1057,11 @@ static int RtspHandler( rtsp_stream_t *rtsp, rtsp_stream_id_t *id,
                         {
                             /* Track not PLAYing yet */
                             if (tr->sout_id == NULL)
-                                /* Instance not running yet (VoD) */
-                                seq = tr->seq_init;
+                                /* Instance not running yet (VoD), or
+                                 * session served from the packet cache */
+                                seq = vod_get_seq(rtsp->vod_media,
+                                                  psz_session, tr->id,
+                                                  tr->seq_init);
                             else
                             {
                                 /* Instance running, add a sink to it */
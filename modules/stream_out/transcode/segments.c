@@ -0,0 +1,543 @@
+/*****************************************************************************
+ * segments.c: transcoding stream output module (parallel video segments)
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * The coded input is cut on keyframes into segments of at least
+ * vsegment-length. Each segment is decoded, filtered and encoded from
+ * scratch by a worker thread with its own video chain, and the encoded
+ * segments are handed to the next stream output in their input order.
+ * Every encoder gets the whole target bitrate, as it only sees its part of
+ * the stream.
+ *
+ * If no keyframe flagged by the packetizer comes within vsegment-length,
+ * the input cannot be cut safely: the segments queued so far are output,
+ * and the rest of the input is encoded serially by a single chain.
+ */
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#include "transcode.h"
+
+enum
+{
+    SEGMENT_QUEUED,
+    SEGMENT_RUNNING,
+    SEGMENT_DONE,
+};
+
+typedef struct video_segment_t video_segment_t;
+
+struct video_segment_t
+{
+    video_segment_t *p_next;
+    unsigned        i_index;
+    int             i_state;
+    bool            b_error;
+
+    block_t         *p_in;      /* coded input, starting on a keyframe */
+    block_t         **pp_in_last;
+    mtime_t         i_start;
+
+    block_t         *p_out;     /* encoded output */
+    es_format_t     fmt;        /* format of the encoded output */
+};
+
+struct transcode_segments_t
+{
+    sout_stream_t        *p_stream;
+    sout_stream_id_sys_t *id;
+
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait_queued;
+    vlc_cond_t      wait_done;
+    bool            b_abort;
+
+    /* segments not handed over yet, in input order */
+    video_segment_t *p_first;
+    video_segment_t **pp_last;
+    unsigned        i_segments;
+    unsigned        i_max_segments;
+
+    video_segment_t *p_current; /* being received */
+    unsigned        i_next_index;
+    mtime_t         i_last_dts;
+    mtime_t         i_last_keyframe; /* input dts */
+
+    sout_stream_id_sys_t *p_serial; /* encodes the input that cannot be cut */
+
+    vlc_thread_t    *p_threads;
+    int             i_threads;
+};
+
+static sout_stream_id_sys_t *SegmentChainNew( transcode_segments_t *p_segs )
+{
+    sout_stream_t *p_stream = p_segs->p_stream;
+    const es_format_t *p_fmt = &p_segs->id->p_decoder->fmt_in;
+
+    sout_stream_id_sys_t *id = calloc( 1, sizeof( *id ) );
+    if( !id )
+        return NULL;
+    id->b_segment = true;
+
+    id->p_decoder = vlc_object_create( p_stream, sizeof( decoder_t ) );
+    if( !id->p_decoder )
+        goto error;
+    id->p_decoder->p_module = NULL;
+    id->p_decoder->fmt_in = *p_fmt;
+    id->p_decoder->b_frame_drop_allowed = false;
+
+    id->p_encoder = sout_EncoderCreate( p_stream );
+    if( !id->p_encoder )
+        goto error;
+    id->p_encoder->p_module = NULL;
+
+    es_format_Init( &id->p_encoder->fmt_out, p_fmt->i_cat, 0 );
+    id->p_encoder->fmt_out.i_id    = p_fmt->i_id;
+    id->p_encoder->fmt_out.i_group = p_fmt->i_group;
+
+    if( !transcode_video_add( p_stream, p_fmt, id ) )
+        goto error;
+    return id;
+
+error:
+    if( id->p_decoder )
+        vlc_object_release( id->p_decoder );
+    if( id->p_encoder )
+    {
+        es_format_Clean( &id->p_encoder->fmt_out );
+        vlc_object_release( id->p_encoder );
+    }
+    free( id );
+    return NULL;
+}
+
+static void SegmentChainDelete( sout_stream_t *p_stream,
+                                sout_stream_id_sys_t *id )
+{
+    /* The chain is already closed if the encoder could not be opened */
+    if( id->b_transcode )
+        transcode_video_close( p_stream, id );
+
+    vlc_object_release( id->p_decoder );
+    es_format_Clean( &id->p_encoder->fmt_out );
+    vlc_object_release( id->p_encoder );
+    free( id );
+}
+
+static void SegmentEncode( transcode_segments_t *p_segs,
+                           video_segment_t *p_seg )
+{
+    sout_stream_t *p_stream = p_segs->p_stream;
+    block_t *p_in = p_seg->p_in;
+    block_t *p_out;
+
+    p_seg->p_in = NULL;
+    p_seg->pp_in_last = &p_seg->p_in;
+
+    sout_stream_id_sys_t *id = SegmentChainNew( p_segs );
+    if( !id )
+    {
+        block_ChainRelease( p_in );
+        p_seg->b_error = true;
+        return;
+    }
+
+    while( p_in )
+    {
+        block_t *p_next = p_in->p_next;
+
+        p_in->p_next = NULL;
+        if( transcode_video_process( p_stream, id, p_in, &p_out )
+            != VLC_SUCCESS )
+        {
+            block_ChainRelease( p_next );
+            p_seg->b_error = true;
+            break;
+        }
+        block_ChainAppend( &p_seg->p_out, p_out );
+        p_in = p_next;
+    }
+
+    if( !p_seg->b_error &&
+        transcode_video_drain( p_stream, id, &p_out ) == VLC_SUCCESS )
+        block_ChainAppend( &p_seg->p_out, p_out );
+
+    if( id->p_encoder->p_module )
+        es_format_Copy( &p_seg->fmt, &id->p_encoder->fmt_out );
+    else
+        p_seg->b_error = true;
+
+    SegmentChainDelete( p_stream, id );
+}
+
+static void *SegmentThread( void *data )
+{
+    transcode_segments_t *p_segs = data;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_segs->lock );
+    for( ;; )
+    {
+        video_segment_t *p_seg = NULL;
+
+        for( video_segment_t *p = p_segs->p_first; p != NULL; p = p->p_next )
+            if( p->i_state == SEGMENT_QUEUED )
+            {
+                p_seg = p;
+                break;
+            }
+
+        if( p_seg == NULL )
+        {
+            if( p_segs->b_abort )
+                break;
+            vlc_cond_wait( &p_segs->wait_queued, &p_segs->lock );
+            continue;
+        }
+
+        p_seg->i_state = SEGMENT_RUNNING;
+        vlc_mutex_unlock( &p_segs->lock );
+
+        SegmentEncode( p_segs, p_seg );
+        msg_Dbg( p_segs->p_stream, "video segment %u encoded%s",
+                 p_seg->i_index, p_seg->b_error ? " with errors" : "" );
+
+        vlc_mutex_lock( &p_segs->lock );
+        p_seg->i_state = SEGMENT_DONE;
+        vlc_cond_broadcast( &p_segs->wait_done );
+    }
+    vlc_mutex_unlock( &p_segs->lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static void SegmentDelete( video_segment_t *p_seg )
+{
+    block_ChainRelease( p_seg->p_in );
+    block_ChainRelease( p_seg->p_out );
+    es_format_Clean( &p_seg->fmt );
+    free( p_seg );
+}
+
+/* Appends encoded blocks, with their dates following the ones of the
+ * previous segments. The blocks are released if the stream is missing. */
+static void SegmentsSend( transcode_segments_t *p_segs,
+                          const es_format_t *p_fmt, block_t *p_blocks,
+                          block_t **out )
+{
+    sout_stream_t *p_stream = p_segs->p_stream;
+    sout_stream_id_sys_t *id = p_segs->id;
+
+    if( id->id == NULL && p_fmt != NULL )
+    {
+        id->id = sout_StreamIdAdd( p_stream->p_next, p_fmt );
+        if( !id->id )
+            msg_Err( p_stream, "cannot add this stream" );
+    }
+
+    if( id->id == NULL )
+    {
+        block_ChainRelease( p_blocks );
+        return;
+    }
+
+    /* Each encoder starts its decoding dates before its first frame */
+    for( block_t *p_block = p_blocks; p_block; p_block = p_block->p_next )
+    {
+        if( p_block->i_dts <= VLC_TS_INVALID )
+            continue;
+        if( p_segs->i_last_dts > VLC_TS_INVALID &&
+            p_block->i_dts <= p_segs->i_last_dts )
+            p_block->i_dts = p_segs->i_last_dts + 1;
+        p_segs->i_last_dts = p_block->i_dts;
+    }
+    block_ChainAppend( out, p_blocks );
+}
+
+static void SegmentOutput( transcode_segments_t *p_segs,
+                           video_segment_t *p_seg, block_t **out )
+{
+    if( p_seg->b_error )
+        msg_Err( p_segs->p_stream, "video segment %u could not be transcoded",
+                 p_seg->i_index );
+
+    SegmentsSend( p_segs, p_seg->b_error ? NULL : &p_seg->fmt,
+                  p_seg->p_out, out );
+    p_seg->p_out = NULL;
+    SegmentDelete( p_seg );
+}
+
+/* Hands the encoded segments over in order, waiting until no more than
+ * i_keep segments are left */
+static void SegmentsCollect( transcode_segments_t *p_segs, unsigned i_keep,
+                             block_t **out )
+{
+    vlc_mutex_lock( &p_segs->lock );
+    while( p_segs->p_first != NULL )
+    {
+        video_segment_t *p_seg = p_segs->p_first;
+
+        if( p_seg->i_state != SEGMENT_DONE )
+        {
+            if( p_segs->i_segments <= i_keep )
+                break;
+            vlc_cond_wait( &p_segs->wait_done, &p_segs->lock );
+            continue;
+        }
+
+        p_segs->p_first = p_seg->p_next;
+        if( p_segs->p_first == NULL )
+            p_segs->pp_last = &p_segs->p_first;
+        p_segs->i_segments--;
+
+        vlc_mutex_unlock( &p_segs->lock );
+        SegmentOutput( p_segs, p_seg, out );
+        vlc_mutex_lock( &p_segs->lock );
+    }
+    vlc_mutex_unlock( &p_segs->lock );
+}
+
+static void SegmentQueue( transcode_segments_t *p_segs )
+{
+    video_segment_t *p_seg = p_segs->p_current;
+
+    if( p_seg == NULL )
+        return;
+    p_segs->p_current = NULL;
+
+    vlc_mutex_lock( &p_segs->lock );
+    p_seg->i_state = SEGMENT_QUEUED;
+    *p_segs->pp_last = p_seg;
+    p_segs->pp_last = &p_seg->p_next;
+    p_segs->i_segments++;
+    vlc_cond_signal( &p_segs->wait_queued );
+    vlc_mutex_unlock( &p_segs->lock );
+}
+
+/* Encodes a block with the serial chain, or drains it if there is none */
+static int SerialProcess( transcode_segments_t *p_segs, block_t *in,
+                          block_t **out )
+{
+    sout_stream_t *p_stream = p_segs->p_stream;
+    sout_stream_id_sys_t *id = p_segs->p_serial;
+    block_t *p_out = NULL;
+    int i_ret;
+
+    if( in != NULL )
+        i_ret = transcode_video_process( p_stream, id, in, &p_out );
+    else
+        i_ret = transcode_video_drain( p_stream, id, &p_out );
+
+    if( p_out != NULL )
+        SegmentsSend( p_segs, id->p_encoder->p_module ?
+                      &id->p_encoder->fmt_out : NULL, p_out, out );
+    return i_ret;
+}
+
+/* Gives up cutting the input: outputs the queued segments, then encodes
+ * the current one and what follows with a single chain */
+static int SegmentsSerial( transcode_segments_t *p_segs, block_t **out )
+{
+    sout_stream_t *p_stream = p_segs->p_stream;
+    video_segment_t *p_seg = p_segs->p_current;
+
+    msg_Warn( p_stream, "no keyframe within %"PRId64"s of video, "
+              "encoding the rest of it serially",
+              p_stream->p_sys->i_vsegment_length / CLOCK_FREQ );
+
+    p_segs->p_current = NULL;
+    SegmentsCollect( p_segs, 0, out );
+
+    p_segs->p_serial = SegmentChainNew( p_segs );
+    if( !p_segs->p_serial )
+    {
+        SegmentDelete( p_seg );
+        return VLC_EGENERIC;
+    }
+
+    block_t *p_in = p_seg->p_in;
+    int i_ret = VLC_SUCCESS;
+
+    p_seg->p_in = NULL;
+    while( p_in != NULL )
+    {
+        block_t *p_next = p_in->p_next;
+
+        p_in->p_next = NULL;
+        i_ret = SerialProcess( p_segs, p_in, out );
+        if( i_ret != VLC_SUCCESS )
+        {
+            block_ChainRelease( p_next );
+            break;
+        }
+        p_in = p_next;
+    }
+    SegmentDelete( p_seg );
+    return i_ret;
+}
+
+int transcode_segments_process( sout_stream_t *p_stream,
+                                sout_stream_id_sys_t *id,
+                                block_t *in, block_t **out )
+{
+    transcode_segments_t *p_segs = id->p_segments;
+    *out = NULL;
+
+    if( p_segs->p_serial != NULL )
+        return SerialProcess( p_segs, in, out );
+
+    if( unlikely( in == NULL ) )
+    {
+        SegmentQueue( p_segs );
+        SegmentsCollect( p_segs, 0, out );
+        return VLC_SUCCESS;
+    }
+
+    /* Cut on keyframes only, so that every segment decodes on its own */
+    video_segment_t *p_seg = p_segs->p_current;
+    if( p_seg != NULL && ( in->i_flags & BLOCK_FLAG_TYPE_I ) &&
+        in->i_dts > VLC_TS_INVALID &&
+        in->i_dts - p_seg->i_start >= p_stream->p_sys->i_vsegment_length )
+    {
+        SegmentQueue( p_segs );
+        p_seg = NULL;
+    }
+
+    if( p_seg == NULL )
+    {
+        p_seg = calloc( 1, sizeof( *p_seg ) );
+        if( unlikely( p_seg == NULL ) )
+        {
+            block_Release( in );
+            return VLC_ENOMEM;
+        }
+        p_seg->i_index = p_segs->i_next_index++;
+        p_seg->pp_in_last = &p_seg->p_in;
+        p_seg->i_start = in->i_dts;
+        es_format_Init( &p_seg->fmt, VIDEO_ES, 0 );
+        p_segs->p_current = p_seg;
+    }
+    else if( p_seg->i_start <= VLC_TS_INVALID )
+        p_seg->i_start = in->i_dts;
+
+    const mtime_t i_dts = in->i_dts;
+    if( i_dts > VLC_TS_INVALID &&
+        ( ( in->i_flags & BLOCK_FLAG_TYPE_I ) ||
+          p_segs->i_last_keyframe <= VLC_TS_INVALID ) )
+        p_segs->i_last_keyframe = i_dts;
+    block_ChainLastAppend( &p_seg->pp_in_last, in );
+
+    /* The input cannot be cut without flagged keyframes, do not buffer it */
+    if( i_dts > VLC_TS_INVALID &&
+        i_dts - p_segs->i_last_keyframe >= p_stream->p_sys->i_vsegment_length )
+        return SegmentsSerial( p_segs, out );
+
+    SegmentsCollect( p_segs, p_segs->i_max_segments, out );
+    return VLC_SUCCESS;
+}
+
+int transcode_segments_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( p_sys->p_spu || p_sys->b_soverlay )
+        msg_Warn( p_stream, "overlays are not applied to video segments" );
+
+    transcode_segments_t *p_segs = calloc( 1, sizeof( *p_segs ) );
+    if( !p_segs )
+        return VLC_ENOMEM;
+
+    p_segs->p_threads = calloc( p_sys->i_vsegments, sizeof( vlc_thread_t ) );
+    if( !p_segs->p_threads )
+    {
+        free( p_segs );
+        return VLC_ENOMEM;
+    }
+
+    p_segs->p_stream = p_stream;
+    p_segs->id = id;
+    vlc_mutex_init( &p_segs->lock );
+    vlc_cond_init( &p_segs->wait_queued );
+    vlc_cond_init( &p_segs->wait_done );
+    p_segs->b_abort = false;
+    p_segs->p_first = NULL;
+    p_segs->pp_last = &p_segs->p_first;
+    /* keep as many segments waiting as being encoded */
+    p_segs->i_max_segments = 2 * p_sys->i_vsegments;
+    p_segs->i_last_dts = VLC_TS_INVALID;
+    p_segs->i_last_keyframe = VLC_TS_INVALID;
+
+    int i_priority = p_sys->b_high_priority ? VLC_THREAD_PRIORITY_OUTPUT :
+                       VLC_THREAD_PRIORITY_VIDEO;
+    for( int i = 0; i < p_sys->i_vsegments; i++ )
+    {
+        if( vlc_clone( &p_segs->p_threads[i], SegmentThread, p_segs,
+                       i_priority ) )
+        {
+            msg_Err( p_stream, "cannot spawn segment encoder thread" );
+            break;
+        }
+        p_segs->i_threads++;
+    }
+
+    id->p_segments = p_segs;
+    if( p_segs->i_threads == 0 )
+    {
+        transcode_segments_close( p_stream, id );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+void transcode_segments_close( sout_stream_t *p_stream,
+                               sout_stream_id_sys_t *id )
+{
+    transcode_segments_t *p_segs = id->p_segments;
+
+    vlc_mutex_lock( &p_segs->lock );
+    p_segs->b_abort = true;
+    vlc_cond_broadcast( &p_segs->wait_queued );
+    vlc_mutex_unlock( &p_segs->lock );
+
+    for( int i = 0; i < p_segs->i_threads; i++ )
+        vlc_join( p_segs->p_threads[i], NULL );
+
+    /* Left over if the stream was not flushed */
+    while( p_segs->p_first != NULL )
+    {
+        video_segment_t *p_seg = p_segs->p_first;
+        p_segs->p_first = p_seg->p_next;
+        SegmentDelete( p_seg );
+    }
+    if( p_segs->p_current )
+        SegmentDelete( p_segs->p_current );
+    if( p_segs->p_serial )
+        SegmentChainDelete( p_stream, p_segs->p_serial );
+
+    vlc_cond_destroy( &p_segs->wait_done );
+    vlc_cond_destroy( &p_segs->wait_queued );
+    vlc_mutex_destroy( &p_segs->lock );
+    free( p_segs->p_threads );
+    free( p_segs );
+    id->p_segments = NULL;
+}
@@ -0,0 +1,207 @@
+/*****************************************************************************
+ * segments_test.c: transcoding parallel video segments tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "transcode.h"
+#include "../../../lib/libvlc_internal.h"
+
+#undef NDEBUG
+#include <assert.h>
+#include <poll.h>
+
+#define INTERVAL  (CLOCK_FREQ / 25) /* between frames */
+#define GOP       10                /* frames per group of pictures */
+#define LENGTH    CLOCK_FREQ        /* vsegment-length */
+#define FRAMES    300
+
+static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+static unsigned chains;
+
+/* Mock video chain: each output block is the input one, the first one of a
+ * chain being dated before its input as by an encoder with B-frames */
+
+struct decoder_sys_t
+{
+    unsigned count;
+};
+
+bool transcode_video_add( sout_stream_t *p_stream, const es_format_t *p_fmt,
+                          sout_stream_id_sys_t *id )
+{
+    (void) p_stream;
+    assert( p_fmt->i_cat == VIDEO_ES );
+    id->p_decoder->p_sys = calloc( 1, sizeof( struct decoder_sys_t ) );
+    assert( id->p_decoder->p_sys != NULL );
+    id->p_encoder->fmt_out.i_codec = VLC_FOURCC('t','e','s','t');
+    id->b_transcode = true;
+
+    vlc_mutex_lock( &lock );
+    chains++;
+    vlc_mutex_unlock( &lock );
+    return true;
+}
+
+int transcode_video_process( sout_stream_t *p_stream,
+                             sout_stream_id_sys_t *id,
+                             block_t *in, block_t **out )
+{
+    (void) p_stream;
+    struct decoder_sys_t *p_sys = id->p_decoder->p_sys;
+    unsigned i_frame = GetDWBE( in->p_buffer );
+
+    /* Each chain decodes from a keyframe */
+    if( p_sys->count++ == 0 )
+    {
+        assert( i_frame == 0 || ( in->i_flags & BLOCK_FLAG_TYPE_I ) );
+        in->i_dts -= 2 * INTERVAL;
+    }
+    /* Slow the first segment down, so that it completes last */
+    if( i_frame < GOP )
+        poll( NULL, 0, 1 );
+
+    id->p_encoder->p_module = (module_t *)id;
+    *out = in;
+    return VLC_SUCCESS;
+}
+
+int transcode_video_drain( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                           block_t **out )
+{
+    (void) p_stream; (void) id;
+    *out = NULL;
+    return VLC_SUCCESS;
+}
+
+void transcode_video_close( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    (void) p_stream;
+    free( id->p_decoder->p_sys );
+    id->b_transcode = false;
+}
+
+/* Mock next stream output */
+
+static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
+                                  const es_format_t *p_fmt )
+{
+    assert( p_fmt->i_codec == VLC_FOURCC('t','e','s','t') );
+    return (sout_stream_id_sys_t *)p_stream;
+}
+
+/* Feeds the frames, the ones before key_end starting a group of pictures
+ * being flagged as keyframes, and checks that the output comes in order */
+static void run( sout_stream_t *p_stream, unsigned key_end,
+                 unsigned *first_out )
+{
+    sout_stream_id_sys_t id;
+    block_t *p_out, *p_all = NULL, **pp_last = &p_all;
+
+    memset( &id, 0, sizeof( id ) );
+    id.p_decoder = vlc_object_create( p_stream, sizeof( decoder_t ) );
+    assert( id.p_decoder != NULL );
+    es_format_Init( &id.p_decoder->fmt_in, VIDEO_ES, VLC_CODEC_MP4V );
+    assert( transcode_segments_new( p_stream, &id ) == VLC_SUCCESS );
+
+    *first_out = FRAMES;
+    for( unsigned i = 0; i <= FRAMES; i++ )
+    {
+        block_t *p_in = NULL;
+
+        if( i < FRAMES )
+        {
+            p_in = block_Alloc( 4 );
+            assert( p_in != NULL );
+            SetDWBE( p_in->p_buffer, i );
+            p_in->i_dts = p_in->i_pts = VLC_TS_0 + CLOCK_FREQ + i * INTERVAL;
+            if( i < key_end && ( i % GOP ) == 0 )
+                p_in->i_flags |= BLOCK_FLAG_TYPE_I;
+        }
+
+        assert( transcode_segments_process( p_stream, &id, p_in, &p_out )
+                == VLC_SUCCESS );
+        if( p_out == NULL )
+            continue;
+        if( *first_out == FRAMES )
+            *first_out = i;
+        block_ChainLastAppend( &pp_last, p_out );
+    }
+    assert( id.id == (void *)p_stream->p_next );
+
+    /* Every frame once and in order, with increasing decoding dates */
+    unsigned i = 0;
+    mtime_t i_dts = VLC_TS_INVALID;
+    for( block_t *p_block = p_all; p_block != NULL; p_block = p_block->p_next )
+    {
+        assert( GetDWBE( p_block->p_buffer ) == i++ );
+        assert( p_block->i_dts > i_dts );
+        i_dts = p_block->i_dts;
+    }
+    assert( i == FRAMES );
+    block_ChainRelease( p_all );
+
+    transcode_segments_close( p_stream, &id );
+    assert( id.p_segments == NULL );
+    vlc_object_release( id.p_decoder );
+}
+
+int main( void )
+{
+    libvlc_int_t *p_libvlc = libvlc_InternalCreate();
+    assert( p_libvlc != NULL );
+    p_libvlc->obj.flags |= OBJECT_FLAGS_QUIET;
+
+    sout_stream_t *p_stream = vlc_object_create( p_libvlc, sizeof( *p_stream ) );
+    sout_stream_t *p_next = vlc_object_create( p_libvlc, sizeof( *p_next ) );
+    assert( p_stream != NULL && p_next != NULL );
+
+    sout_stream_sys_t sys;
+    memset( &sys, 0, sizeof( sys ) );
+    sys.i_vsegments = 3;
+    sys.i_vsegment_length = LENGTH;
+    p_stream->p_sys = &sys;
+    p_stream->p_next = p_next;
+    p_next->pf_add = Add;
+
+    const unsigned per_segment = ( LENGTH + GOP * INTERVAL - 1 ) /
+                                 ( GOP * INTERVAL ) * GOP;
+    unsigned first_out;
+
+    /* Cut on every keyframe past the segment length */
+    chains = 0;
+    run( p_stream, FRAMES, &first_out );
+    assert( chains == FRAMES / per_segment );
+
+    /* Without flagged keyframes, the input is encoded serially once the
+     * segment length is reached */
+    chains = 0;
+    run( p_stream, 0, &first_out );
+    assert( chains == 1 );
+    assert( first_out == LENGTH / INTERVAL );
+
+    /* Keyframes stop being flagged: segments, then the rest serially */
+    const unsigned key_end = 5 * per_segment + 1;
+    chains = 0;
+    run( p_stream, key_end, &first_out );
+    assert( chains == 5 + 1 );
+
+    vlc_object_release( p_next );
+    vlc_object_release( p_stream );
+    libvlc_InternalDestroy( p_libvlc );
+    return 0;
+}
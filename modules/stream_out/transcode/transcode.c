@@ -80,6 +80,17 @@
 #define VFILTER_LONGTEXT N_( \
     "Video filters will be applied to the video streams (after overlays " \
     "are applied). You can enter a colon-separated list of filters." )
+#define VSEGMENTS_TEXT N_("Parallel video segments")
+#define VSEGMENTS_LONGTEXT N_( \
+    "Number of video segments, cut on keyframes, that are decoded and " \
+    "encoded concurrently, each one by its own decoder and encoder. This " \
+    "is meant for file to file transcoding. Overlays are not supported. " \
+    "0 disables it." )
+#define VSEGMENT_LENGTH_TEXT N_("Video segment length")
+#define VSEGMENT_LENGTH_LONGTEXT N_( \
+    "Minimum duration in seconds of the video segments encoded in parallel. " \
+    "If no keyframe comes within that duration, the rest of the video is " \
+    "encoded serially." )
 
 #define AENC_TEXT N_("Audio encoder")
 #define AENC_LONGTEXT N_( \
@@ -182,6 +193,12 @@ vlc_module_begin ()
                  MAXHEIGHT_LONGTEXT, true )
     add_module_list( SOUT_CFG_PREFIX "vfilter", "video filter",
                      NULL, VFILTER_TEXT, VFILTER_LONGTEXT, false )
+    add_integer( SOUT_CFG_PREFIX "vsegments", 0, VSEGMENTS_TEXT,
+                 VSEGMENTS_LONGTEXT, true )
+        change_integer_range( 0, 64 )
+    add_integer( SOUT_CFG_PREFIX "vsegment-length", 10, VSEGMENT_LENGTH_TEXT,
+                 VSEGMENT_LENGTH_LONGTEXT, true )
+        change_integer_range( 1, 3600 )
 
     set_section( N_("Audio"), NULL )
     add_module( SOUT_CFG_PREFIX "aenc", "encoder", NULL, AENC_TEXT,
@@ -232,7 +249,7 @@ static const char *const ppsz_sout_options[] = {
     "deinterlace-module", "threads", "aenc", "acodec", "ab", "alang",
     "afilter", "samplerate", "channels", "senc", "scodec", "soverlay",
     "sfilter", "osd", "high-priority", "maxwidth", "maxheight", "pool-size",
-    NULL
+    "vsegments", "vsegment-length", NULL
 };
 
 /*****************************************************************************
@@ -377,6 +394,20 @@ static int Open( vlc_object_t *p_this )
     p_sys->pool_size = var_GetInteger( p_stream, SOUT_CFG_PREFIX "pool-size" );
     p_sys->b_high_priority = var_GetBool( p_stream, SOUT_CFG_PREFIX "high-priority" );
 
+    p_sys->i_vsegments = var_GetInteger( p_stream, SOUT_CFG_PREFIX "vsegments" );
+    p_sys->i_vsegment_length = CLOCK_FREQ *
+        var_GetInteger( p_stream, SOUT_CFG_PREFIX "vsegment-length" );
+    if( p_sys->i_vsegments > 0 )
+    {
+        /* Segments are encoded by their own threads */
+        if( p_sys->i_threads > 0 )
+            msg_Warn( p_stream, "threads option ignored with vsegments" );
+        p_sys->i_threads = 0;
+        msg_Dbg( p_stream, "video encoded as %d parallel segments of %"PRId64
+                 "s at least", p_sys->i_vsegments,
+                 p_sys->i_vsegment_length / CLOCK_FREQ );
+    }
+
     if( p_sys->i_vcodec )
     {
         msg_Dbg( p_stream, "codec video=%4.4s %dx%d scaling: %f %dkb/s",
@@ -604,7 +635,10 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
             break;
         case VIDEO_ES:
             Send( p_stream, id, NULL );
-            transcode_video_close( p_stream, id );
+            if( id->p_segments )
+                transcode_segments_close( p_stream, id );
+            else
+                transcode_video_close( p_stream, id );
             break;
         case SPU_ES:
             if( p_sys->b_osd )
@@ -658,7 +692,15 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         break;
 
     case VIDEO_ES:
-        if( transcode_video_process( p_stream, id, p_buffer, &p_out )
+        if( id->p_segments )
+        {
+            if( transcode_segments_process( p_stream, id, p_buffer, &p_out )
+                != VLC_SUCCESS )
+            {
+                return VLC_EGENERIC;
+            }
+        }
+        else if( transcode_video_process( p_stream, id, p_buffer, &p_out )
             != VLC_SUCCESS )
         {
             return VLC_EGENERIC;
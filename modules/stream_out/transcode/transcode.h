@@ -54,6 +54,9 @@ struct sout_stream_sys_t
 
     char            *psz_vf2;
 
+    int             i_vsegments; /* segments encoded concurrently */
+    mtime_t         i_vsegment_length;
+
     /* SPU */
     vlc_fourcc_t    i_scodec;   /* codec spu (0 if not transcode) */
     char            *psz_senc;
@@ -75,6 +78,7 @@ struct sout_stream_sys_t
 };
 
 struct aout_filters;
+typedef struct transcode_segments_t transcode_segments_t;
 
 struct sout_stream_id_sys_t
 {
@@ -105,6 +109,10 @@ struct sout_stream_id_sys_t
     /* Encoder */
     encoder_t       *p_encoder;
 
+    /* Segment-parallel video encoding */
+    transcode_segments_t *p_segments;
+    bool            b_segment; /**< encodes a single segment */
+
     /* Sync */
     date_t          next_input_pts; /**< Incoming calculated PTS */
     date_t          next_output_pts; /**< output calculated PTS */
@@ -144,3 +152,12 @@ int  transcode_video_process( sout_stream_t *, sout_stream_id_sys_t *,
                                      block_t *, block_t ** );
 bool transcode_video_add    ( sout_stream_t *, const es_format_t *,
                                 sout_stream_id_sys_t *);
+int  transcode_video_drain  ( sout_stream_t *, sout_stream_id_sys_t *,
+                                     block_t ** );
+
+/* VIDEO SEGMENTS */
+
+int  transcode_segments_new    ( sout_stream_t *, sout_stream_id_sys_t * );
+void transcode_segments_close  ( sout_stream_t *, sout_stream_id_sys_t * );
+int  transcode_segments_process( sout_stream_t *, sout_stream_id_sys_t *,
+                                        block_t *, block_t ** );
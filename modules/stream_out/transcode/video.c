@@ -597,6 +597,10 @@ static int transcode_video_encoder_open( sout_stream_t *p_stream,
     id->p_encoder->fmt_out.i_codec =
         vlc_fourcc_GetCodec( VIDEO_ES, id->p_encoder->fmt_out.i_codec );
 
+    /* The output of a segment is added by the owner of the segments */
+    if( id->b_segment )
+        return VLC_SUCCESS;
+
     id->id = sout_StreamIdAdd( p_stream->p_next, &id->p_encoder->fmt_out );
     if( !id->id )
     {
@@ -657,7 +661,7 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
      * Encoding
      */
     /* Check if we have a subpicture to overlay */
-    if( p_sys->p_spu )
+    if( p_sys->p_spu && !id->b_segment )
     {
         video_format_t fmt = id->p_encoder->fmt_in.video;
         if( fmt.i_visible_width <= 0 || fmt.i_visible_height <= 0 )
@@ -718,44 +722,15 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
         picture_Release( p_pic );
 }
 
-int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
-                                    block_t *in, block_t **out )
+/* Decodes, filters and encodes; drains the decoder if pp_in is NULL */
+static int transcode_video_decode( sout_stream_t *p_stream,
+                                   sout_stream_id_sys_t *id,
+                                   block_t **pp_in, block_t **out )
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
-    picture_t *p_pic = NULL;
-    *out = NULL;
+    picture_t *p_pic;
 
-    if( unlikely( in == NULL ) )
-    {
-        if( p_sys->i_threads == 0 )
-        {
-            block_t *p_block;
-            do {
-                p_block = id->p_encoder->pf_encode_video(id->p_encoder, NULL );
-                block_ChainAppend( out, p_block );
-            } while( p_block );
-        }
-        else
-        {
-            msg_Dbg( p_stream, "Flushing thread and waiting that");
-            vlc_mutex_lock( &p_stream->p_sys->lock_out );
-            p_stream->p_sys->b_abort = true;
-            vlc_cond_signal( &p_stream->p_sys->cond );
-            vlc_mutex_unlock( &p_stream->p_sys->lock_out );
-
-            vlc_join( p_stream->p_sys->thread, NULL );
-            vlc_mutex_lock( &p_sys->lock_out );
-            *out = p_sys->p_buffers;
-            p_sys->p_buffers = NULL;
-            vlc_mutex_unlock( &p_sys->lock_out );
-
-            msg_Dbg( p_stream, "Flushing done");
-        }
-        return VLC_SUCCESS;
-    }
-
-
-    while( (p_pic = id->p_decoder->pf_decode_video( id->p_decoder, &in )) )
+    while( (p_pic = id->p_decoder->pf_decode_video( id->p_decoder, pp_in )) )
     {
 
         if( unlikely (
@@ -804,7 +779,8 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
             if( transcode_video_encoder_open( p_stream, id ) != VLC_SUCCESS )
             {
                 picture_Release( p_pic );
-                block_Release( in );
+                if( pp_in && *pp_in )
+                    block_Release( *pp_in );
                 transcode_video_close( p_stream, id );
                 id->b_transcode = false;
                 return VLC_EGENERIC;
@@ -842,6 +818,47 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         }
     }
 
+    return VLC_SUCCESS;
+}
+
+int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                                    block_t *in, block_t **out )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    *out = NULL;
+
+    if( unlikely( in == NULL ) )
+    {
+        if( p_sys->i_threads == 0 )
+        {
+            block_t *p_block;
+            do {
+                p_block = id->p_encoder->pf_encode_video(id->p_encoder, NULL );
+                block_ChainAppend( out, p_block );
+            } while( p_block );
+        }
+        else
+        {
+            msg_Dbg( p_stream, "Flushing thread and waiting that");
+            vlc_mutex_lock( &p_stream->p_sys->lock_out );
+            p_stream->p_sys->b_abort = true;
+            vlc_cond_signal( &p_stream->p_sys->cond );
+            vlc_mutex_unlock( &p_stream->p_sys->lock_out );
+
+            vlc_join( p_stream->p_sys->thread, NULL );
+            vlc_mutex_lock( &p_sys->lock_out );
+            *out = p_sys->p_buffers;
+            p_sys->p_buffers = NULL;
+            vlc_mutex_unlock( &p_sys->lock_out );
+
+            msg_Dbg( p_stream, "Flushing done");
+        }
+        return VLC_SUCCESS;
+    }
+
+    if( transcode_video_decode( p_stream, id, &in, out ) != VLC_SUCCESS )
+        return VLC_EGENERIC;
+
     if( p_sys->i_threads >= 1 )
     {
         /* Pick up any return data the encoder thread wants to output. */
@@ -854,6 +871,25 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
     return VLC_SUCCESS;
 }
 
+int transcode_video_drain( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                          block_t **out )
+{
+    *out = NULL;
+
+    if( transcode_video_decode( p_stream, id, NULL, out ) != VLC_SUCCESS )
+        return VLC_EGENERIC;
+
+    if( id->p_encoder->p_module )
+    {
+        block_t *p_block;
+        do {
+            p_block = id->p_encoder->pf_encode_video( id->p_encoder, NULL );
+            block_ChainAppend( out, p_block );
+        } while( p_block );
+    }
+    return VLC_SUCCESS;
+}
+
 bool transcode_video_add( sout_stream_t *p_stream, const es_format_t *p_fmt,
                                 sout_stream_id_sys_t *id )
 {
@@ -876,6 +912,17 @@ bool transcode_video_add( sout_stream_t *p_stream, const es_format_t *p_fmt,
         return false;
     }
 
+    if( p_sys->i_vsegments > 0 && !id->b_segment )
+    {
+        /* The chain was only checked, each segment gets its own */
+        transcode_video_close( p_stream, id );
+        if( transcode_segments_new( p_stream, id ) )
+        {
+            msg_Err( p_stream, "cannot create video segments" );
+            return false;
+        }
+    }
+
     /* Stream will be added later on because we don't know
      * all the characteristics of the decoded stream yet */
     id->b_transcode = true;
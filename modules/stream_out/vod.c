@@ -73,6 +73,9 @@ struct vod_media_t
 
     /* Infos */
     mtime_t i_length;
+
+    /* Packets shared between sessions */
+    vod_cache_t *cache;
 };
 
 struct vod_sys_t
@@ -260,6 +263,18 @@ static vod_media_t *MediaNew( vod_t *p_vod, const char *psz_name,
         goto error;
     }
 
+    /* The cache needs the length to tell whether it was fully recorded */
+    int64_t i_cache = var_InheritInteger(p_vod, "rtsp-vod-cache");
+    if (i_cache > 0 && p_media->i_length > 0)
+    {
+        unsigned clock_ratev[p_media->i_es];
+        for (int i = 0; i < p_media->i_es; i++)
+            clock_ratev[i] = p_media->es[i]->rtp_fmt.clock_rate;
+        p_media->cache = vod_cache_New(VLC_OBJECT(p_vod), p_media->i_es,
+                                       clock_ratev, i_cache << 20,
+                                       p_media->i_length);
+    }
+
     msg_Dbg(p_vod, "adding media '%s'", psz_name);
 
     CommandPush( p_vod, RTSP_CMD_TYPE_ADD, p_media, psz_name );
@@ -314,6 +329,9 @@ static void MediaDel( vod_t *p_vod, vod_media_t *p_media )
         RtspUnsetup(p_media->rtsp);
     }
 
+    if (p_media->cache != NULL)
+        vod_cache_Delete(p_media->cache);
+
     for( int i = 0; i < p_media->i_es; i++ )
     {
         free( p_media->es[i]->rtp_fmt.fmtp );
@@ -470,6 +488,50 @@ int vod_check_range(vod_media_t *p_media, const char *psz_session,
     return VLC_SUCCESS;
 }
 
+/* Serve a session from the packet cache if it is ready, else let the
+ * first session playing from the beginning record it */
+static bool vod_play_cached(vod_media_t *p_media, const char *psz_session,
+                            int64_t *start, int64_t end)
+{
+    vod_cache_t *cache = p_media->cache;
+    int64_t ts_init = rtp_get_ts(NULL, NULL, p_media, psz_session, NULL);
+
+    /* Seek or resume within the cache */
+    if (vod_cache_Play(cache, psz_session, NULL, ts_init,
+                       start, end) == VLC_SUCCESS)
+        return true;
+
+    if (!RtspSessionIdle(p_media->rtsp, psz_session))
+    {
+        /* The session goes on with its own instance, whose packets do not
+         * follow the timeline of the media anymore */
+        vod_cache_End(cache, psz_session, true);
+        return false;
+    }
+
+    if (!vod_cache_IsReady(cache))
+    {
+        if (*start <= 0)
+            vod_cache_Record(cache, psz_session);
+        return false;
+    }
+
+    vod_cache_sink_t sinks[p_media->i_es];
+    for (int i = 0; i < p_media->i_es; i++)
+        sinks[i].fd = RtspTrackOpen(p_media->rtsp, psz_session,
+                                    p_media->es[i]->rtsp_id,
+                                    &sinks[i].ssrc, &sinks[i].seq);
+
+    if (vod_cache_Play(cache, psz_session, sinks, ts_init,
+                       start, end) == VLC_SUCCESS)
+        return true;
+
+    for (int i = 0; i < p_media->i_es; i++)
+        if (sinks[i].fd != -1)
+            net_Close(sinks[i].fd);
+    return false;
+}
+
 /* TODO: add support in the VLM for queueing proper PLAY requests with
  * start and end times, fetch whether the input is seekable... and then
  * clean this up */
@@ -479,6 +541,10 @@ void vod_play(vod_media_t *p_media, const char *psz_session,
     if (vod_check_range(p_media, psz_session, *start, end) != VLC_SUCCESS)
         return;
 
+    if (p_media->cache != NULL
+     && vod_play_cached(p_media, psz_session, start, end))
+        return;
+
     /* We're passing the #vod{} sout chain here */
     vod_MediaControl(p_media->p_vod, p_media, psz_session,
                      VOD_MEDIA_PLAY, "vod", start);
@@ -486,12 +552,26 @@ void vod_play(vod_media_t *p_media, const char *psz_session,
 
 void vod_pause(vod_media_t *p_media, const char *psz_session, int64_t *npt)
 {
+    if (p_media->cache != NULL)
+    {
+        vod_cache_End(p_media->cache, psz_session, true);
+        if (vod_cache_Pause(p_media->cache, psz_session, npt) == VLC_SUCCESS)
+            return;
+    }
+
     vod_MediaControl(p_media->p_vod, p_media, psz_session,
                      VOD_MEDIA_PAUSE, npt);
 }
 
 void vod_stop(vod_media_t *p_media, const char *psz_session)
 {
+    if (p_media->cache != NULL)
+    {
+        vod_cache_End(p_media->cache, psz_session, false);
+        if (vod_cache_Stop(p_media->cache, psz_session))
+            return;
+    }
+
     CommandPush(p_media->p_vod, RTSP_CMD_TYPE_STOP, p_media, psz_session);
 }
 
@@ -502,34 +582,33 @@ const char *vod_get_mux(const vod_media_t *p_media)
 }
 
 
+/* Find the index of the VoD media ES of an RTP id */
+static int MediaFindEs(const vod_media_t *p_media, int es_id)
+{
+    if (p_media->psz_mux != NULL)
+    {
+        assert(p_media->i_es == 1);
+        return 0;
+    }
+
+    /* No locking needed, the ES table can't be modified now */
+    for (int i = 0; i < p_media->i_es; i++)
+        if (p_media->es[i]->es_id == es_id)
+            return i;
+    return -1;
+}
+
 /* Match an RTP id to a VoD media ES and RTSP track to initialize it
  * with the data that was already set up */
 int vod_init_id(vod_media_t *p_media, const char *psz_session, int es_id,
                 sout_stream_id_sys_t *sout_id, rtp_format_t *rtp_fmt,
                 uint32_t *ssrc, uint16_t *seq_init)
 {
-    media_es_t *p_es;
+    int i = MediaFindEs(p_media, es_id);
+    if (i < 0)
+        return VLC_EGENERIC;
 
-    if (p_media->psz_mux != NULL)
-    {
-        assert(p_media->i_es == 1);
-        p_es = p_media->es[0];
-    }
-    else
-    {
-        p_es = NULL;
-        /* No locking needed, the ES table can't be modified now */
-        for (int i = 0; i < p_media->i_es; i++)
-        {
-            if (p_media->es[i]->es_id == es_id)
-            {
-                p_es = p_media->es[i];
-                break;
-            }
-        }
-        if (p_es == NULL)
-            return VLC_EGENERIC;
-    }
+    media_es_t *p_es = p_media->es[i];
 
     memcpy(rtp_fmt, &p_es->rtp_fmt, sizeof(*rtp_fmt));
     if (p_es->rtp_fmt.fmtp != NULL)
@@ -546,3 +625,45 @@ void vod_detach_id(vod_media_t *p_media, const char *psz_session,
     RtspTrackDetach(p_media->rtsp, psz_session, sout_id);
 }
 
+/* Return the packet cache that the RTP id of a VoD session records, if
+ * the session is the one recording it */
+vod_cache_t *vod_record_id(vod_media_t *p_media, const char *psz_session,
+                           int es_id, unsigned *track)
+{
+    if (p_media->cache == NULL || !vod_cache_IsRecorder(p_media->cache,
+                                                         psz_session))
+        return NULL;
+
+    int i = MediaFindEs(p_media, es_id);
+    if (i < 0)
+        return NULL;
+
+    *track = i;
+    return p_media->cache;
+}
+
+/* The RTP output of a VoD session is closing */
+void vod_record_end(vod_media_t *p_media, const char *psz_session)
+{
+    if (p_media->cache != NULL)
+        vod_cache_End(p_media->cache, psz_session, false);
+}
+
+/* Return the sequence number of the next packet of a track, which is
+ * seq_init unless the session is served from the packet cache */
+uint16_t vod_get_seq(vod_media_t *p_media, const char *psz_session,
+                     rtsp_stream_id_t *id, uint16_t seq)
+{
+    if (p_media->cache == NULL)
+        return seq;
+
+    for (int i = 0; i < p_media->i_es; i++)
+    {
+        if (p_media->es[i]->rtsp_id == id)
+        {
+            vod_cache_GetSeq(p_media->cache, psz_session, i, &seq);
+            break;
+        }
+    }
+    return seq;
+}
@@ -0,0 +1,676 @@
+/*****************************************************************************
+ * vodcache.c: RTP packet cache for the RTSP VoD server
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * The first session that plays a VoD media from its beginning records the
+ * RTP packets its output sends, ordered by NPT. Once the whole media has
+ * gone through, the following sessions are served from these packets by a
+ * single thread: each session only rewrites the RTP header (SSRC, sequence
+ * number and timestamp), paces the packets against its own clock, and
+ * hands them over to the kernel in batches. No input, demuxer nor
+ * packetizer is created for them.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_sout.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+
+#include <assert.h>
+
+#include "rtp.h"
+
+/* Packets sent per system call */
+#define VOD_CACHE_BATCH 32
+/* How far from the media length the recording may end and still be
+ * considered complete */
+#define VOD_CACHE_SLACK CLOCK_FREQ
+
+typedef struct
+{
+    /* RTP packets, in sending order, with the NPT in i_dts and random
+     * access points flagged with BLOCK_FLAG_TYPE_I */
+    block_t  **packetv;
+    size_t     packetc;
+    size_t     packetmax;
+    unsigned   clock_rate;
+    bool       b_started;
+    uint32_t   ts_zero; /* RTP timestamp of NPT 0 in the recording */
+} vod_cache_track_t;
+
+typedef struct
+{
+    int            fd;
+    rtcp_sender_t *rtcp;
+    uint32_t       ssrc;
+    uint16_t       seq;
+    uint32_t       ts_offset;
+    size_t         next; /* next packet to send */
+} vod_cache_strack_t;
+
+typedef struct
+{
+    char    *psz_name;
+    int64_t  i_ts_init;
+    bool     b_playing;
+    int64_t  i_npt;     /* NPT the session (re)started from */
+    int64_t  i_npt_end; /* NPT to stop at, or -1 */
+    mtime_t  i_date;    /* date at which i_npt was due */
+
+    vod_cache_strack_t trackv[];
+} vod_cache_session_t;
+
+enum
+{
+    VOD_CACHE_EMPTY,
+    VOD_CACHE_RECORDING,
+    VOD_CACHE_READY,
+    VOD_CACHE_DISABLED,
+};
+
+struct vod_cache_t
+{
+    vlc_object_t *obj;
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait;
+    vlc_thread_t  thread;
+    bool          b_thread;
+    bool          b_stop;
+
+    int           state;
+    char         *psz_recorder;
+    mtime_t       i_origin;   /* DTS of NPT 0 in the recording */
+    int64_t       i_recorded; /* highest recorded NPT */
+    size_t        i_size;
+    size_t        i_max_size;
+    mtime_t       i_length;
+
+    int                   sessionc;
+    vod_cache_session_t **sessionv;
+
+    unsigned              trackc;
+    vod_cache_track_t     trackv[];
+};
+
+static void *Thread( void * );
+
+vod_cache_t *vod_cache_New( vlc_object_t *obj, unsigned trackc,
+                            const unsigned *clock_ratev, size_t max_size,
+                            mtime_t length )
+{
+    vod_cache_t *cache = calloc( 1, sizeof( *cache )
+                                    + trackc * sizeof( cache->trackv[0] ) );
+    if( unlikely(cache == NULL) )
+        return NULL;
+
+    cache->obj = obj;
+    vlc_mutex_init( &cache->lock );
+    vlc_cond_init( &cache->wait );
+    cache->state = VOD_CACHE_EMPTY;
+    cache->i_max_size = max_size;
+    cache->i_length = length;
+    TAB_INIT( cache->sessionc, cache->sessionv );
+
+    cache->trackc = trackc;
+    for( unsigned i = 0; i < trackc; i++ )
+        cache->trackv[i].clock_rate = clock_ratev[i];
+    return cache;
+}
+
+/** cache must be locked */
+static void Clear( vod_cache_t *cache )
+{
+    for( unsigned i = 0; i < cache->trackc; i++ )
+    {
+        vod_cache_track_t *t = cache->trackv + i;
+
+        for( size_t j = 0; j < t->packetc; j++ )
+            block_Release( t->packetv[j] );
+        free( t->packetv );
+        t->packetv = NULL;
+        t->packetc = t->packetmax = 0;
+        t->b_started = false;
+    }
+    cache->i_size = 0;
+    cache->i_recorded = 0;
+    free( cache->psz_recorder );
+    cache->psz_recorder = NULL;
+}
+
+static void SessionDelete( vod_cache_t *cache, vod_cache_session_t *s )
+{
+    for( unsigned i = 0; i < cache->trackc; i++ )
+    {
+        vod_cache_strack_t *st = s->trackv + i;
+
+        if( st->fd == -1 )
+            continue;
+        CloseRTCP( st->rtcp );
+        net_Close( st->fd );
+    }
+    free( s->psz_name );
+    free( s );
+}
+
+void vod_cache_Delete( vod_cache_t *cache )
+{
+    if( cache->b_thread )
+    {
+        vlc_mutex_lock( &cache->lock );
+        cache->b_stop = true;
+        vlc_cond_signal( &cache->wait );
+        vlc_mutex_unlock( &cache->lock );
+        vlc_join( cache->thread, NULL );
+    }
+
+    for( int i = 0; i < cache->sessionc; i++ )
+        SessionDelete( cache, cache->sessionv[i] );
+    TAB_CLEAN( cache->sessionc, cache->sessionv );
+
+    Clear( cache );
+    vlc_cond_destroy( &cache->wait );
+    vlc_mutex_destroy( &cache->lock );
+    free( cache );
+}
+
+/*****************************************************************************
+ * Recording
+ *****************************************************************************/
+
+/* Let a session starting from the beginning of the media fill the cache,
+ * unless another one already does */
+bool vod_cache_Record( vod_cache_t *cache, const char *psz_session )
+{
+    bool b_record = false;
+
+    vlc_mutex_lock( &cache->lock );
+    if( cache->state == VOD_CACHE_EMPTY )
+    {
+        cache->psz_recorder = strdup( psz_session );
+        if( likely(cache->psz_recorder != NULL) )
+        {
+            cache->state = VOD_CACHE_RECORDING;
+            cache->i_origin = VLC_TS_INVALID;
+            b_record = true;
+            msg_Dbg( cache->obj, "session %s records the VoD cache",
+                     psz_session );
+        }
+    }
+    vlc_mutex_unlock( &cache->lock );
+    return b_record;
+}
+
+bool vod_cache_IsRecorder( vod_cache_t *cache, const char *psz_session )
+{
+    vlc_mutex_lock( &cache->lock );
+    bool b_recorder = cache->state == VOD_CACHE_RECORDING
+                   && !strcmp( cache->psz_recorder, psz_session );
+    vlc_mutex_unlock( &cache->lock );
+    return b_recorder;
+}
+
+/* Store a copy of a packet sent to the recording session */
+void vod_cache_Append( vod_cache_t *cache, const char *psz_session,
+                       unsigned track, const block_t *p_packet, bool b_rap )
+{
+    assert( track < cache->trackc );
+
+    vlc_mutex_lock( &cache->lock );
+    if( cache->state != VOD_CACHE_RECORDING
+     || strcmp( cache->psz_recorder, psz_session ) )
+        goto out;
+
+    vod_cache_track_t *t = cache->trackv + track;
+
+    if( cache->i_size + p_packet->i_buffer > cache->i_max_size )
+    {
+        msg_Warn( cache->obj, "media too large for the VoD cache (%zu "
+                  "bytes), sessions will not share it", cache->i_max_size );
+        Clear( cache );
+        cache->state = VOD_CACHE_DISABLED;
+        goto out;
+    }
+
+    if( t->packetc == t->packetmax )
+    {
+        size_t max = t->packetmax ? 2 * t->packetmax : 1024;
+        block_t **packetv = realloc( t->packetv, max * sizeof( *packetv ) );
+        if( unlikely(packetv == NULL) )
+            goto out;
+        t->packetv = packetv;
+        t->packetmax = max;
+    }
+
+    block_t *p_copy = block_Alloc( p_packet->i_buffer );
+    if( unlikely(p_copy == NULL) )
+        goto out;
+    memcpy( p_copy->p_buffer, p_packet->p_buffer, p_packet->i_buffer );
+
+    int64_t npt;
+    if( p_packet->i_dts > VLC_TS_INVALID )
+    {
+        if( cache->i_origin == VLC_TS_INVALID )
+            cache->i_origin = p_packet->i_dts;
+        npt = p_packet->i_dts - cache->i_origin;
+        if( npt < 0 )
+            npt = 0;
+    }
+    else if( t->b_started )
+    {
+        /* Some packetizers leave the DTS out, use the RTP timestamp */
+        uint32_t ts = GetDWBE( p_packet->p_buffer + 4 ) - t->ts_zero;
+        npt = (int64_t)ts * CLOCK_FREQ / t->clock_rate;
+    }
+    else
+        npt = cache->i_recorded;
+
+    p_copy->i_dts = npt;
+    p_copy->i_flags = b_rap ? BLOCK_FLAG_TYPE_I : 0;
+
+    if( !t->b_started )
+    {
+        t->ts_zero = GetDWBE( p_packet->p_buffer + 4 )
+                   - rtp_compute_ts( t->clock_rate, npt );
+        t->b_started = true;
+    }
+
+    t->packetv[t->packetc++] = p_copy;
+    cache->i_size += p_copy->i_buffer;
+    if( npt > cache->i_recorded )
+        cache->i_recorded = npt;
+out:
+    vlc_mutex_unlock( &cache->lock );
+}
+
+/* Finish the recording of a session: the cache becomes ready if it covers
+ * the whole media. A seek or a pause aborts it, since the timeline of the
+ * packets would not be that of the media anymore. */
+void vod_cache_End( vod_cache_t *cache, const char *psz_session,
+                    bool b_abort )
+{
+    vlc_mutex_lock( &cache->lock );
+    if( cache->state != VOD_CACHE_RECORDING
+     || strcmp( cache->psz_recorder, psz_session ) )
+        goto out;
+
+    if( !b_abort && cache->i_recorded + VOD_CACHE_SLACK >= cache->i_length )
+    {
+        size_t packets = 0;
+        for( unsigned i = 0; i < cache->trackc; i++ )
+            packets += cache->trackv[i].packetc;
+
+        msg_Dbg( cache->obj, "VoD cache ready: %zu packets, %zu bytes",
+                 packets, cache->i_size );
+        free( cache->psz_recorder );
+        cache->psz_recorder = NULL;
+        cache->state = VOD_CACHE_READY;
+    }
+    else
+    {
+        msg_Dbg( cache->obj, "session %s stopped recording the VoD cache at "
+                 "%"PRId64" us", psz_session, cache->i_recorded );
+        Clear( cache );
+        cache->state = VOD_CACHE_EMPTY;
+    }
+out:
+    vlc_mutex_unlock( &cache->lock );
+}
+
+bool vod_cache_IsReady( vod_cache_t *cache )
+{
+    vlc_mutex_lock( &cache->lock );
+    bool b_ready = cache->state == VOD_CACHE_READY;
+    vlc_mutex_unlock( &cache->lock );
+    return b_ready;
+}
+
+/*****************************************************************************
+ * Playback
+ *****************************************************************************/
+
+/** cache must be locked */
+static vod_cache_session_t *SessionGet( vod_cache_t *cache,
+                                        const char *psz_session )
+{
+    for( int i = 0; i < cache->sessionc; i++ )
+        if( !strcmp( cache->sessionv[i]->psz_name, psz_session ) )
+            return cache->sessionv[i];
+    return NULL;
+}
+
+/* Find the first packet to send from a given NPT: the random access point
+ * at or before the first packet at or after it */
+static size_t TrackFind( const vod_cache_track_t *t, int64_t npt )
+{
+    size_t lo = 0, hi = t->packetc;
+
+    while( lo < hi )
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if( t->packetv[mid]->i_dts < npt )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* i wraps around below 0 */
+    for( size_t i = lo; i < t->packetc; i-- )
+        if( t->packetv[i]->i_flags & BLOCK_FLAG_TYPE_I )
+            return i;
+    return lo;
+}
+
+/** cache must be locked */
+static int64_t SessionGetNPT( const vod_cache_t *cache,
+                              const vod_cache_session_t *s )
+{
+    if( !s->b_playing )
+        return s->i_npt;
+
+    int64_t npt = s->i_npt + (mdate() - s->i_date);
+    return (npt < cache->i_length) ? npt : cache->i_length;
+}
+
+/** cache must be locked */
+static void SessionSeek( vod_cache_t *cache, vod_cache_session_t *s,
+                         int64_t npt, int64_t end )
+{
+    s->i_npt = npt;
+    s->i_npt_end = end;
+    s->i_date = mdate();
+    s->b_playing = true;
+
+    for( unsigned i = 0; i < cache->trackc; i++ )
+    {
+        const vod_cache_track_t *t = cache->trackv + i;
+        vod_cache_strack_t *st = s->trackv + i;
+
+        /* The packet at npt gets the rtptime of RTP-Info */
+        st->next = TrackFind( t, npt );
+        st->ts_offset = rtp_compute_ts( t->clock_rate, s->i_ts_init )
+                      - rtp_compute_ts( t->clock_rate, npt ) - t->ts_zero;
+    }
+}
+
+/* Serve a session from the cache. If it is not yet, sinks gives the
+ * destination of each track, and the cache takes ownership of the sockets
+ * on success. */
+int vod_cache_Play( vod_cache_t *cache, const char *psz_session,
+                    const vod_cache_sink_t *sinks, int64_t ts_init,
+                    int64_t *start, int64_t end )
+{
+    int val = VLC_EGENERIC;
+
+    vlc_mutex_lock( &cache->lock );
+    vod_cache_session_t *s = SessionGet( cache, psz_session );
+    if( s != NULL )
+    {
+        /* PLAY without a range resumes from where the session is */
+        if( *start < 0 )
+        {
+            *start = SessionGetNPT( cache, s );
+            if( s->b_playing )
+            {
+                s->i_npt_end = end;
+                val = VLC_SUCCESS;
+                goto out;
+            }
+        }
+        SessionSeek( cache, s, *start, end );
+        vlc_cond_signal( &cache->wait );
+        val = VLC_SUCCESS;
+        goto out;
+    }
+
+    if( sinks == NULL || cache->state != VOD_CACHE_READY )
+        goto out;
+
+    s = malloc( sizeof( *s ) + cache->trackc * sizeof( s->trackv[0] ) );
+    if( unlikely(s == NULL) )
+        goto out;
+    s->psz_name = strdup( psz_session );
+    if( unlikely(s->psz_name == NULL) )
+    {
+        free( s );
+        goto out;
+    }
+    s->i_ts_init = ts_init;
+
+    if( !cache->b_thread )
+    {
+        if( vlc_clone( &cache->thread, Thread, cache,
+                       VLC_THREAD_PRIORITY_HIGHEST ) )
+        {
+            free( s->psz_name );
+            free( s );
+            goto out;
+        }
+        cache->b_thread = true;
+    }
+
+    for( unsigned i = 0; i < cache->trackc; i++ )
+    {
+        vod_cache_strack_t *st = s->trackv + i;
+
+        st->fd = sinks[i].fd;
+        st->rtcp = NULL;
+        if( st->fd != -1 )
+            st->rtcp = OpenRTCP( cache->obj, st->fd, IPPROTO_UDP, false );
+        st->ssrc = sinks[i].ssrc;
+        st->seq = sinks[i].seq;
+    }
+
+    if( *start < 0 )
+        *start = 0;
+    SessionSeek( cache, s, *start, end );
+    TAB_APPEND( cache->sessionc, cache->sessionv, s );
+    vlc_cond_signal( &cache->wait );
+
+    msg_Dbg( cache->obj, "session %s served from the VoD cache (%d "
+             "sessions)", psz_session, cache->sessionc );
+    val = VLC_SUCCESS;
+out:
+    vlc_mutex_unlock( &cache->lock );
+    return val;
+}
+
+int vod_cache_Pause( vod_cache_t *cache, const char *psz_session,
+                     int64_t *npt )
+{
+    int val = VLC_EGENERIC;
+
+    vlc_mutex_lock( &cache->lock );
+    vod_cache_session_t *s = SessionGet( cache, psz_session );
+    if( s != NULL )
+    {
+        s->i_npt = *npt = SessionGetNPT( cache, s );
+        s->b_playing = false;
+        val = VLC_SUCCESS;
+    }
+    vlc_mutex_unlock( &cache->lock );
+    return val;
+}
+
+bool vod_cache_Stop( vod_cache_t *cache, const char *psz_session )
+{
+    vlc_mutex_lock( &cache->lock );
+    vod_cache_session_t *s = SessionGet( cache, psz_session );
+    if( s != NULL )
+    {
+        TAB_REMOVE( cache->sessionc, cache->sessionv, s );
+        SessionDelete( cache, s );
+    }
+    vlc_mutex_unlock( &cache->lock );
+    return s != NULL;
+}
+
+/* Return the sequence number of the next packet of a session track */
+bool vod_cache_GetSeq( vod_cache_t *cache, const char *psz_session,
+                       unsigned track, uint16_t *seq )
+{
+    assert( track < cache->trackc );
+
+    vlc_mutex_lock( &cache->lock );
+    vod_cache_session_t *s = SessionGet( cache, psz_session );
+    if( s != NULL )
+        *seq = s->trackv[track].seq;
+    vlc_mutex_unlock( &cache->lock );
+    return s != NULL;
+}
+
+/*****************************************************************************
+ * Sending
+ *****************************************************************************/
+static void SendBatch( vod_cache_strack_t *st, struct iovec (*iov)[2],
+                       unsigned count )
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgv[VOD_CACHE_BATCH];
+
+    memset( msgv, 0, count * sizeof( msgv[0] ) );
+    for( unsigned i = 0; i < count; i++ )
+    {
+        msgv[i].msg_hdr.msg_iov = iov[i];
+        msgv[i].msg_hdr.msg_iovlen = 2;
+    }
+
+    for( unsigned i = 0; i < count; )
+    {
+        int val = sendmmsg( st->fd, msgv + i, count - i, 0 );
+        /* Drop the packet that failed, as ThreadSend() does */
+        i += (val > 0) ? (unsigned)val : 1;
+    }
+#else
+    for( unsigned i = 0; i < count; i++ )
+    {
+        struct msghdr msg = { .msg_iov = iov[i], .msg_iovlen = 2 };
+        sendmsg( st->fd, &msg, 0 );
+    }
+#endif
+}
+
+/** cache must be locked
+ * Send the packets of a session track that are due, and return the date
+ * at which the next one will be */
+static mtime_t SendTrack( vod_cache_t *cache, vod_cache_session_t *s,
+                          unsigned track, mtime_t now )
+{
+    const vod_cache_track_t *t = cache->trackv + track;
+    vod_cache_strack_t *st = s->trackv + track;
+    uint8_t hdrv[VOD_CACHE_BATCH][12];
+    struct iovec iov[VOD_CACHE_BATCH][2];
+    mtime_t deadline = INT64_MAX;
+    unsigned count = 0;
+
+    while( st->next + count < t->packetc )
+    {
+        if( count == VOD_CACHE_BATCH )
+        {
+            deadline = now;
+            break;
+        }
+
+        const block_t *pkt = t->packetv[st->next + count];
+        if( s->i_npt_end >= 0 && pkt->i_dts > s->i_npt_end )
+            break;
+
+        /* The packets before the start point, from the random access
+         * point, are sent right away */
+        mtime_t due = s->i_date;
+        if( pkt->i_dts > s->i_npt )
+            due += pkt->i_dts - s->i_npt;
+        if( due > now )
+        {
+            deadline = due;
+            break;
+        }
+
+        uint8_t *hdr = hdrv[count];
+        memcpy( hdr, pkt->p_buffer, 12 );
+        SetWBE( hdr + 2, st->seq + count );
+        SetDWBE( hdr + 4, GetDWBE( hdr + 4 ) + st->ts_offset );
+        SetDWBE( hdr + 8, st->ssrc );
+
+        iov[count][0].iov_base = hdr;
+        iov[count][0].iov_len = 12;
+        iov[count][1].iov_base = pkt->p_buffer + 12;
+        iov[count][1].iov_len = pkt->i_buffer - 12;
+        count++;
+    }
+
+    if( count == 0 )
+        return deadline;
+
+    SendBatch( st, iov, count );
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        /* SendRTCP() only reads the RTP header, and the size of the
+         * packet for its statistics */
+        block_t rtp;
+        block_Init( &rtp, hdrv[i], t->packetv[st->next + i]->i_buffer );
+        SendRTCP( st->rtcp, &rtp );
+    }
+
+    st->seq += count;
+    st->next += count;
+    return deadline;
+}
+
+static void *Thread( void *data )
+{
+    vod_cache_t *cache = data;
+
+    vlc_mutex_lock( &cache->lock );
+    while( !cache->b_stop )
+    {
+        mtime_t now = mdate();
+        mtime_t deadline = INT64_MAX;
+
+        for( int i = 0; i < cache->sessionc; i++ )
+        {
+            vod_cache_session_t *s = cache->sessionv[i];
+
+            if( !s->b_playing )
+                continue;
+
+            for( unsigned j = 0; j < cache->trackc; j++ )
+            {
+                if( s->trackv[j].fd == -1 )
+                    continue;
+
+                mtime_t next = SendTrack( cache, s, j, now );
+                if( next < deadline )
+                    deadline = next;
+            }
+        }
+
+        if( deadline == INT64_MAX )
+            vlc_cond_wait( &cache->wait, &cache->lock );
+        else if( deadline > now )
+            vlc_cond_timedwait( &cache->wait, &cache->lock, deadline );
+    }
+    vlc_mutex_unlock( &cache->lock );
+    return NULL;
+}
@@ -0,0 +1,246 @@
+/*****************************************************************************
+ * vodcache_test.c: RTP packet cache for the RTSP VoD server tests
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <vlc_common.h>
+#include <vlc_sout.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+
+#include "rtp.h"
+
+#define CLOCK_RATE 90000
+#define PACKETS    50
+#define INTERVAL   (CLOCK_FREQ / 25) /* between packets */
+#define RAP_EVERY  10
+#define TS_FIRST   1000 /* RTP timestamp of the first recorded packet */
+#define LENGTH     (PACKETS * INTERVAL)
+
+static struct vlc_object_t obj;
+
+/* Mock RTP stream output */
+
+uint32_t rtp_compute_ts( unsigned i_clock_rate, int64_t i_pts )
+{
+    lldiv_t q = lldiv( i_pts, CLOCK_FREQ );
+    return q.quot * (int64_t)i_clock_rate
+          + q.rem * (int64_t)i_clock_rate / CLOCK_FREQ;
+}
+
+rtcp_sender_t *OpenRTCP( vlc_object_t *o, int rtp_fd, int proto, bool mux )
+{
+    (void) o; (void) rtp_fd; (void) proto; (void) mux;
+    return NULL;
+}
+
+void CloseRTCP( rtcp_sender_t *rtcp )
+{
+    assert( rtcp == NULL );
+}
+
+void SendRTCP( rtcp_sender_t *restrict rtcp, const block_t *rtp )
+{
+    assert( rtcp == NULL );
+    assert( rtp->i_buffer >= 12 );
+}
+
+/* Packets as recorded from the RTP output: 12 bytes header, then the
+ * packet index */
+static block_t *packet( unsigned i, mtime_t origin )
+{
+    block_t *p = block_Alloc( 16 );
+    assert( p != NULL );
+
+    p->p_buffer[0] = 0x80;
+    p->p_buffer[1] = 96;
+    SetWBE( p->p_buffer + 2, 4242 + i );
+    SetDWBE( p->p_buffer + 4,
+             TS_FIRST + rtp_compute_ts( CLOCK_RATE, i * INTERVAL ) );
+    SetDWBE( p->p_buffer + 8, 0xdeadbeef );
+    SetDWBE( p->p_buffer + 12, i );
+    p->i_dts = origin + i * INTERVAL;
+    return p;
+}
+
+static void record( vod_cache_t *cache, const char *session, unsigned count )
+{
+    for( unsigned i = 0; i < count; i++ )
+    {
+        block_t *p = packet( i, VLC_TS_0 + 12345678 );
+
+        vod_cache_Append( cache, session, 0, p, (i % RAP_EVERY) == 0 );
+        block_Release( p );
+    }
+}
+
+static vod_cache_t *cache_new( size_t max_size )
+{
+    const unsigned rate = CLOCK_RATE;
+    vod_cache_t *cache = vod_cache_New( &obj, 1, &rate, max_size, LENGTH );
+
+    assert( cache != NULL );
+    return cache;
+}
+
+/* Receives the next packet sent to a session and returns its index */
+static unsigned receive( int fd, uint32_t ssrc, uint16_t seq,
+                         uint32_t *restrict ts )
+{
+    uint8_t buf[64];
+    ssize_t val = recv( fd, buf, sizeof (buf), 0 );
+
+    assert( val == 16 );
+    assert( buf[0] == 0x80 && buf[1] == 96 );
+    assert( GetWBE( buf + 2 ) == seq );
+    assert( GetDWBE( buf + 8 ) == ssrc );
+    *ts = GetDWBE( buf + 4 );
+    return GetDWBE( buf + 12 );
+}
+
+int main( void )
+{
+    vod_cache_t *cache;
+    int64_t start, npt;
+    uint16_t seq;
+    uint32_t ts;
+
+    obj.obj.flags = OBJECT_FLAGS_QUIET;
+
+    /* Single recorder, which may abort */
+    cache = cache_new( 1 << 20 );
+    assert( !vod_cache_IsReady( cache ) );
+    assert( vod_cache_Record( cache, "A" ) );
+    assert( !vod_cache_Record( cache, "B" ) );
+    assert( vod_cache_IsRecorder( cache, "A" ) );
+    assert( !vod_cache_IsRecorder( cache, "B" ) );
+    record( cache, "A", PACKETS );
+    vod_cache_End( cache, "A", true );
+    assert( !vod_cache_IsReady( cache ) );
+    assert( !vod_cache_IsRecorder( cache, "A" ) );
+
+    /* Incomplete recording */
+    assert( vod_cache_Record( cache, "B" ) );
+    record( cache, "B", PACKETS / 2 );
+    vod_cache_End( cache, "B", false );
+    assert( !vod_cache_IsReady( cache ) );
+
+    /* Packets from other sessions are ignored */
+    assert( vod_cache_Record( cache, "C" ) );
+    record( cache, "A", PACKETS );
+    vod_cache_End( cache, "A", false );
+    assert( vod_cache_IsRecorder( cache, "C" ) );
+    vod_cache_End( cache, "C", false );
+    assert( !vod_cache_IsReady( cache ) );
+
+    /* No session is served before the recording is complete */
+    vod_cache_sink_t sink = { -1, 0, 0 };
+    start = 0;
+    assert( vod_cache_Play( cache, "D", &sink, 0, &start, -1 ) != 0 );
+    vod_cache_Delete( cache );
+
+    /* Media larger than the cache */
+    cache = cache_new( 16 * (PACKETS / 2) );
+    assert( vod_cache_Record( cache, "A" ) );
+    record( cache, "A", PACKETS );
+    assert( !vod_cache_IsRecorder( cache, "A" ) );
+    vod_cache_End( cache, "A", false );
+    assert( !vod_cache_IsReady( cache ) );
+    assert( !vod_cache_Record( cache, "B" ) );
+    vod_cache_Delete( cache );
+
+    /* Complete recording */
+    cache = cache_new( 1 << 20 );
+    assert( vod_cache_Record( cache, "A" ) );
+    record( cache, "A", PACKETS );
+    vod_cache_End( cache, "A", false );
+    assert( vod_cache_IsReady( cache ) );
+    assert( !vod_cache_Record( cache, "B" ) );
+
+    /* Playback from the middle of a group of pictures, up to an end */
+    int fds[2];
+    if( vlc_socketpair( PF_LOCAL, SOCK_DGRAM, 0, fds, false ) )
+        assert( !"socketpair" );
+
+    const unsigned first = 25, end = 30;
+    sink.fd = fds[0];
+    sink.ssrc = 0x12345678;
+    sink.seq = 65530;
+    start = first * INTERVAL;
+    assert( vod_cache_Play( cache, "B", &sink, 424242, &start,
+                            end * INTERVAL ) == 0 );
+    assert( start == first * INTERVAL );
+
+    /* Sent from the preceding random access point */
+    const unsigned rap = first - (first % RAP_EVERY);
+    for( unsigned i = rap; i <= end; i++ )
+    {
+        assert( receive( fds[1], sink.ssrc, sink.seq++, &ts ) == i );
+        /* The start packet has the timestamp given in RTP-Info */
+        assert( ts == rtp_compute_ts( CLOCK_RATE, 424242 )
+                    + rtp_compute_ts( CLOCK_RATE, i * INTERVAL )
+                    - rtp_compute_ts( CLOCK_RATE, first * INTERVAL ) );
+    }
+    struct pollfd ufd = { .fd = fds[1], .events = POLLIN };
+    assert( poll( &ufd, 1, 4 * INTERVAL / 1000 ) == 0 );
+    assert( vod_cache_GetSeq( cache, "B", 0, &seq ) );
+    assert( seq == sink.seq );
+
+    /* Pause, then resume without a range */
+    assert( vod_cache_Pause( cache, "B", &npt ) == 0 );
+    assert( npt >= end * INTERVAL );
+    start = -1;
+    assert( vod_cache_Play( cache, "B", NULL, 424242, &start, -1 ) == 0 );
+    assert( start == npt );
+    const unsigned next = (npt + INTERVAL - 1) / INTERVAL;
+    assert( receive( fds[1], sink.ssrc, sink.seq++, &ts )
+            == next - (next % RAP_EVERY) );
+
+    /* Seek backward */
+    start = 0;
+    assert( vod_cache_Play( cache, "B", NULL, 424242, &start, 0 ) == 0 );
+    unsigned index = receive( fds[1], sink.ssrc, sink.seq, &ts );
+    while( index != 0 ) /* packets sent before the seek */
+        index = receive( fds[1], sink.ssrc, ++sink.seq, &ts );
+    assert( ts == rtp_compute_ts( CLOCK_RATE, 424242 ) );
+
+    /* Unknown sessions */
+    assert( vod_cache_Pause( cache, "C", &npt ) != 0 );
+    assert( !vod_cache_GetSeq( cache, "C", 0, &seq ) );
+    assert( !vod_cache_Stop( cache, "C" ) );
+
+    /* The cache closes the socket of its sessions */
+    assert( vod_cache_Stop( cache, "B" ) );
+    assert( !vod_cache_Stop( cache, "B" ) );
+    assert( send( fds[1], &ts, sizeof (ts), MSG_NOSIGNAL ) < 0 );
+    vod_cache_Delete( cache );
+    vlc_close( fds[1] );
+    return 0;
+}
@@ -87,7 +87,8 @@ static int Open(vlc_object_t *object,
         return VLC_EGENERIC;
     sys->pool = NULL;
 
-    /* p_vd->info is not modified */
+    /* Pictures are only read, if at all */
+    vd->info.has_foreign_pictures = true;
 
     char *chroma = var_InheritString(vd, "dummy-chroma");
     if (chroma) {
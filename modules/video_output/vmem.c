@@ -82,6 +82,7 @@ vlc_module_end()
  * Local prototypes
  *****************************************************************************/
 struct picture_sys_t {
+    vout_display_sys_t *sys;
     void *id;
 };
 
@@ -95,6 +96,8 @@ struct vout_display_sys_t {
     void (*unlock)(void *sys, void *id, void *const *plane);
     void (*display)(void *sys, void *id);
     void (*cleanup)(void *sys);
+    void *(*alloc)(void *sys, void **plane);
+    void (*release)(void *sys, void *id);
 
     unsigned pitches[PICTURE_PLANE_MAX];
     unsigned lines[PICTURE_PLANE_MAX];
@@ -124,7 +127,11 @@ static int Open(vlc_object_t *object)
     vlc_format_cb setup = var_InheritAddress(vd, "vmem-setup");
 
     sys->lock = var_InheritAddress(vd, "vmem-lock");
-    if (sys->lock == NULL) {
+    sys->alloc = var_InheritAddress(vd, "vmem-alloc");
+    sys->release = var_InheritAddress(vd, "vmem-release");
+    if (sys->alloc == NULL)
+        sys->release = NULL;
+    if (sys->lock == NULL && sys->alloc == NULL) {
         msg_Err(vd, "missing lock callback");
         free(sys);
         return VLC_EGENERIC;
@@ -210,6 +217,9 @@ static int Open(vlc_object_t *object)
     /* */
     vout_display_info_t info = vd->info;
     info.has_hide_mouse = true;
+    /* Pictures are copied to the application buffers, unless those are
+     * the pictures */
+    info.has_foreign_pictures = sys->alloc == NULL;
 
     /* */
     vd->sys     = sys;
@@ -232,19 +242,90 @@ static void Close(vlc_object_t *object)
     vout_display_t *vd = (vout_display_t *)object;
     vout_display_sys_t *sys = vd->sys;
 
-    if (sys->cleanup)
-        sys->cleanup(sys->opaque);
+    /* Application buffers are released before the cleanup callback */
     if (sys->pool)
         picture_pool_Release(sys->pool);
+    if (sys->cleanup)
+        sys->cleanup(sys->opaque);
     free(sys);
 }
 
+static void DestroyPicture(picture_t *pic)
+{
+    picture_sys_t *picsys = pic->p_sys;
+    vout_display_sys_t *sys = picsys->sys;
+
+    if (sys->release != NULL)
+        sys->release(sys->opaque, picsys->id);
+    free(picsys);
+    free(pic);
+}
+
+/* Allocates the pictures in application memory. */
+static picture_pool_t *PoolAlloc(vout_display_t *vd, unsigned count)
+{
+    vout_display_sys_t *sys = vd->sys;
+    picture_t **pictures = malloc(count * sizeof (*pictures));
+    unsigned n;
+
+    if (unlikely(pictures == NULL))
+        return NULL;
+
+    for (n = 0; n < count; n++) {
+        picture_sys_t *picsys = malloc(sizeof (*picsys));
+        if (unlikely(picsys == NULL))
+            break;
+
+        void *planes[PICTURE_PLANE_MAX] = { NULL };
+
+        picsys->sys = sys;
+        picsys->id = sys->alloc(sys->opaque, planes);
+        if (picsys->id == NULL) {
+            free(picsys);
+            break;
+        }
+
+        picture_resource_t rsc = {
+            .p_sys = picsys,
+            .pf_destroy = DestroyPicture,
+        };
+
+        for (unsigned i = 0; i < PICTURE_PLANE_MAX; i++) {
+            rsc.p[i].p_pixels = planes[i];
+            rsc.p[i].i_lines  = sys->lines[i];
+            rsc.p[i].i_pitch  = sys->pitches[i];
+        }
+
+        pictures[n] = picture_NewFromResource(&vd->fmt, &rsc);
+        if (unlikely(pictures[n] == NULL)) {
+            if (sys->release != NULL)
+                sys->release(sys->opaque, picsys->id);
+            free(picsys);
+            break;
+        }
+    }
+
+    picture_pool_t *pool = NULL;
+    if (n > 0) {
+        if (n < count)
+            msg_Warn(vd, "only %u of %u pictures allocated", n, count);
+        pool = picture_pool_New(n, pictures);
+        if (pool == NULL)
+            while (n > 0)
+                picture_Release(pictures[--n]);
+    }
+    free(pictures);
+    return pool;
+}
+
 static picture_pool_t *Pool(vout_display_t *vd, unsigned count)
 {
     vout_display_sys_t *sys = vd->sys;
 
     if (sys->pool == NULL)
-        sys->pool = picture_pool_NewFromFormat(&vd->fmt, count);
+        sys->pool = (sys->alloc != NULL)
+            ? PoolAlloc(vd, count)
+            : picture_pool_NewFromFormat(&vd->fmt, count);
     return sys->pool;
 }
 
@@ -254,6 +335,18 @@ static void Prepare(vout_display_t *vd, picture_t *pic, subpicture_t *subpic)
     picture_resource_t rsc = { .p_sys = NULL };
     void *planes[PICTURE_PLANE_MAX];
 
+    if (sys->alloc != NULL) {
+        /* The picture is already in application memory: no copy */
+        sys->pic_opaque = pic->p_sys->id;
+        if (sys->unlock != NULL) {
+            for (int i = 0; i < pic->i_planes; i++)
+                planes[i] = pic->p[i].p_pixels;
+            sys->unlock(sys->opaque, sys->pic_opaque, planes);
+        }
+        (void) subpic;
+        return;
+    }
+
     sys->pic_opaque = sys->lock(sys->opaque, planes);
 
     for (unsigned i = 0; i < PICTURE_PLANE_MAX; i++) {
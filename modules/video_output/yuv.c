@@ -156,6 +156,7 @@ static int Open(vlc_object_t *object)
     /* */
     vout_display_info_t info = vd->info;
     info.has_hide_mouse = true;
+    info.has_foreign_pictures = true;
 
     /* */
     vd->fmt     = fmt;
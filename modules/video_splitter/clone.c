@@ -184,6 +184,22 @@ static void Close( vlc_object_t *p_this )
 static int Filter( video_splitter_t *p_splitter,
                    picture_t *pp_dst[], picture_t *p_src )
 {
+    /* Share the source picture between the outputs if possible: the video
+     * output core copies it for the displays that need their own buffers. */
+    for( int i = 0; i < p_splitter->i_output; i++ )
+    {
+        pp_dst[i] = picture_Clone( p_src );
+        if( pp_dst[i] == NULL )
+        {
+            while( i > 0 )
+                picture_Release( pp_dst[--i] );
+            goto copy;
+        }
+    }
+    picture_Release( p_src );
+    return VLC_SUCCESS;
+
+copy:
     if( video_splitter_NewPicture( p_splitter, pp_dst ) )
     {
         picture_Release( p_src );
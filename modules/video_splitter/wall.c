@@ -387,10 +387,49 @@ static void Close( vlc_object_t *p_this )
     free( p_sys );
 }
 
+/**
+ * Creates the tiles as views of the source picture, without copying pixels.
+ * The video output core copies them for the displays that need their own
+ * buffers.
+ */
+static int FilterShared( video_splitter_t *p_splitter, picture_t *pp_dst[],
+                         picture_t *p_src )
+{
+    video_splitter_sys_t *p_sys = p_splitter->p_sys;
+
+    for( int y = 0; y < p_sys->i_row; y++ )
+    {
+        for( int x = 0; x < p_sys->i_col; x++ )
+        {
+            wall_output_t *p_output = &p_sys->pp_output[x][y];
+            if( !p_output->b_active )
+                continue;
+
+            const int i_output = p_output->i_output;
+            pp_dst[i_output] = picture_NewView( p_src,
+                                    &p_splitter->p_output[i_output].fmt,
+                                    p_output->i_left, p_output->i_top );
+            if( pp_dst[i_output] == NULL )
+            {
+                for( int i = 0; i < i_output; i++ )
+                    picture_Release( pp_dst[i] );
+                return VLC_EGENERIC;
+            }
+        }
+    }
+    return VLC_SUCCESS;
+}
+
 static int Filter( video_splitter_t *p_splitter, picture_t *pp_dst[], picture_t *p_src )
 {
     video_splitter_sys_t *p_sys = p_splitter->p_sys;
 
+    if( FilterShared( p_splitter, pp_dst, p_src ) == VLC_SUCCESS )
+    {
+        picture_Release( p_src );
+        return VLC_SUCCESS;
+    }
+
     if( video_splitter_NewPicture( p_splitter, pp_dst ) )
     {
         picture_Release( p_src );
@@ -22,6 +22,9 @@
  51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http" } }
+
 -- Probe function.
 function probe()
     return vlc.access == "http"
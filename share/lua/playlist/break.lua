@@ -18,6 +18,11 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http" },
+                 path = { "break.com/video/",
+                          "www.break.com/video/" } }
+
 -- Probe function.
 function probe()
     local path = vlc.path:gsub("^www%.", "")
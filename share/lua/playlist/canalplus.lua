@@ -18,6 +18,9 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http" }, path = { "www.canalplus.fr/" } }
+
 -- Probe function.
 function probe()
     return vlc.access == "http" and string.match( vlc.path, "^www%.canalplus%.fr/.+" )
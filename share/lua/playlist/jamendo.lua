@@ -22,6 +22,9 @@
 
 require "simplexml"
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http" }, path = { "api.jamendo.com/" } }
+
 -- Probe function.
 function probe()
     return vlc.access == "http"
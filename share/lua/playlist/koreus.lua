@@ -17,6 +17,11 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http", "https" },
+                 path = { "koreus.com/video/",
+                          "www.koreus.com/video/" } }
+
 -- Probe function.
 function probe()
     local path = vlc.path:gsub("^www%.", "")
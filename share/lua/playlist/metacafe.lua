@@ -18,6 +18,9 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http" }, path = { "metacafe.com/" } }
+
 -- Probe function.
 function probe()
     local path = vlc.path:gsub("^www%.", "")
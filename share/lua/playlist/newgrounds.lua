@@ -20,6 +20,9 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http", "https" }, path = { "www.newgrounds.com/" } }
+
 -- Probe function.
 function probe()
     return ( vlc.access == "http" or vlc.access == "https" )
@@ -21,6 +21,11 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http", "https" },
+                 path = { "soundcloud.com/",
+                          "www.soundcloud.com/" } }
+
 -- Probe function.
 function probe()
     local path = vlc.path
@@ -22,6 +22,13 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http", "https" },
+                 path = { "vimeo.com/",
+                          "www.vimeo.com/",
+                          "player.vimeo.com/",
+                          "www.player.vimeo.com/" } }
+
 -- Probe function.
 function probe()
     local path = vlc.path
@@ -23,6 +23,9 @@
 -- Set to "mp3", "ogg", "flac" or "wav"
 local fmt = "mp3"
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http", "https" }, path = { "vocaroo.com/i/" } }
+
 -- Probe function.
 function probe()
     return ( vlc.access == "http" or vlc.access == "https" )
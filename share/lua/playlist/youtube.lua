@@ -224,6 +224,9 @@ function pick_url( url_map, fmt, js_url )
     return path
 end
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http", "https" }, path = { "www.youtube.com/" } }
+
 -- Probe function.
 function probe()
     return ( ( vlc.access == "http" or vlc.access == "https" )
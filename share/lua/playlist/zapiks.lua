@@ -20,6 +20,11 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
 --]]
 
+-- Inputs not matching this filter are not probed
+probe_filter = { access = { "http" },
+                 path = { "zapiks.fr/",
+                          "26in.fr/" } }
+
 -- Probe function.
 function probe()
     local path = vlc.path:gsub("^www%.", "")
@@ -95,6 +95,21 @@ struct decoder_owner_sys_t
     /* fifo */
     block_fifo_t *p_fifo;
 
+    /* Batch of blocks taken at once from the fifo (protected by the fifo
+     * lock, except the blocks being decoded) */
+    block_t *p_batch; /* blocks left to decode after an interruption */
+    unsigned i_batch; /* blocks out of the fifo and not decoded yet */
+    atomic_bool batch_abort; /* stop decoding the current batch */
+    bool b_batching; /* waiting for more blocks to coalesce wake-ups */
+    mtime_t i_batch_delay;
+    struct
+    {
+        mtime_t i_start;
+        unsigned i_wakeups; /* batches taken from the fifo */
+        unsigned i_blocks;
+        unsigned i_max_depth;
+    } batch_stats;
+
     /* Lock for communication with decoder thread */
     vlc_mutex_t lock;
     vlc_cond_t  wait_request;
@@ -120,6 +135,10 @@ struct decoder_owner_sys_t
     bool b_first;
     bool b_has_data;
 
+    /* Trick play */
+    atomic_bool keyframe_only; /* decode only the intra pictures */
+    bool b_keyframe_wait; /* decoder thread: drop until the next intra picture */
+
     /* Flushing */
     bool flushing;
     bool b_draining;
@@ -145,6 +164,10 @@ struct decoder_owner_sys_t
 /* */
 #define DECODER_SPU_VOUT_WAIT_DURATION ((int)(0.200*CLOCK_FREQ))
 
+/* Number of queued blocks waking up the decoder before the end of the
+ * decoder-batch-delay (must remain below the pacing threshold) */
+#define DECODER_BATCH_BLOCKS 8
+
 /**
  * Load a decoder module
  */
@@ -885,8 +908,9 @@ static void DecoderGetCc( decoder_t *p_dec, decoder_t *p_dec_cc )
         if( !p_owner->cc.pp_decoder[i] )
             continue;
 
-        block_FifoPut( p_owner->cc.pp_decoder[i]->p_owner->p_fifo,
-            (i_cc_decoder > 1) ? block_Duplicate(p_cc) : p_cc);
+        input_DecoderDecode( p_owner->cc.pp_decoder[i],
+                             (i_cc_decoder > 1) ? block_Duplicate(p_cc) : p_cc,
+                             false );
 
         i_cc_decoder--;
         b_processed = true;
@@ -1000,6 +1024,19 @@ discard:
     return 0;
 }
 
+static void DecoderUpdateStatBatch( decoder_t *p_dec, unsigned blocks )
+{
+    input_thread_t *p_input = p_dec->p_owner->p_input;
+
+    if( p_input == NULL )
+        return;
+
+    vlc_mutex_lock( &input_priv(p_input)->counters.counters_lock );
+    stats_Update( input_priv(p_input)->counters.p_decoder_wakeups, 1, NULL );
+    stats_Update( input_priv(p_input)->counters.p_decoder_blocks, blocks, NULL );
+    vlc_mutex_unlock( &input_priv(p_input)->counters.counters_lock );
+}
+
 static void DecoderUpdateStatVideo( decoder_t *p_dec, unsigned decoded,
                                     unsigned lost )
 {
@@ -1037,12 +1074,41 @@ static int DecoderQueueVideo( decoder_t *p_dec, picture_t *p_pic )
     return ret;
 }
 
+/* Returns true if the block must not be decoded because of trick play */
+static bool DecoderSkipVideo( decoder_t *p_dec, const block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    /* Blocks without a known type are always decoded */
+    const bool b_inter = ( p_block->i_flags & BLOCK_FLAG_TYPE_MASK ) &&
+                         !( p_block->i_flags & BLOCK_FLAG_TYPE_I );
+
+    if( atomic_load( &p_owner->keyframe_only ) )
+    {
+        p_owner->b_keyframe_wait = true;
+        return b_inter;
+    }
+    if( p_owner->b_keyframe_wait )
+    {
+        /* The references of the inter pictures were not decoded */
+        if( b_inter )
+            return true;
+        p_owner->b_keyframe_wait = false;
+    }
+    return false;
+}
+
 static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
 {
     picture_t      *p_pic;
     block_t **pp_block = p_block ? &p_block : NULL;
     unsigned i_lost = 0, i_decoded = 0;
 
+    if( p_block && DecoderSkipVideo( p_dec, p_block ) )
+    {
+        block_Release( p_block );
+        return;
+    }
+
     while( (p_pic = p_dec->pf_decode_video( p_dec, pp_block ) ) )
     {
         i_decoded++;
@@ -1512,6 +1578,7 @@ static void *DecoderThread( void *p_data )
     decoder_t *p_dec = (decoder_t *)p_data;
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
     bool paused = false;
+    bool coalesced = false;
 
     /* The decoder's main loop */
     vlc_fifo_Lock( p_owner->p_fifo );
@@ -1519,6 +1586,8 @@ static void *DecoderThread( void *p_data )
 
     for( ;; )
     {
+        unsigned batched = 0;
+
         if( p_owner->flushing )
         {   /* Flush before/regardless of pause. We do not want to resume just
              * for the sake of flushing (glitches could otherwise happen). */
@@ -1571,7 +1640,49 @@ static void *DecoderThread( void *p_data )
         vlc_cond_signal( &p_owner->wait_fifo );
         vlc_testcancel(); /* forced expedited cancellation in case of stop */
 
-        block_t *p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
+        if( p_owner->p_batch == NULL && !coalesced
+         && p_owner->i_batch_delay > 0 && !p_owner->paused
+         && !p_owner->b_draining && !vlc_fifo_IsEmpty( p_owner->p_fifo )
+         && vlc_fifo_GetCount( p_owner->p_fifo ) < DECODER_BATCH_BLOCKS )
+        {   /* Let a few more blocks come before decoding. The fifo signals
+             * every queued block, so wait on another condition variable. */
+            mtime_t deadline = mdate() + p_owner->i_batch_delay;
+
+            p_owner->b_batching = true;
+            while( !p_owner->flushing && !p_owner->b_draining
+                && paused == p_owner->paused
+                && vlc_fifo_GetCount( p_owner->p_fifo ) < DECODER_BATCH_BLOCKS
+                && vlc_fifo_TimedWaitCond( p_owner->p_fifo,
+                                           &p_owner->wait_timed,
+                                           deadline ) == 0 );
+            p_owner->b_batching = false;
+            coalesced = true;
+            continue;
+        }
+
+        if( p_owner->p_batch == NULL )
+        {   /* Take all the queued blocks at once, or only one when stepping
+             * frame by frame */
+            unsigned count = vlc_fifo_GetCount( p_owner->p_fifo );
+
+            if( p_owner->paused )
+                p_owner->p_batch = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
+            else
+                p_owner->p_batch = vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo );
+
+            if( p_owner->p_batch != NULL )
+            {
+                p_owner->i_batch = p_owner->paused ? 1 : count;
+                batched = p_owner->i_batch;
+                p_owner->batch_stats.i_wakeups++;
+                p_owner->batch_stats.i_blocks += p_owner->i_batch;
+                if( count > p_owner->batch_stats.i_max_depth )
+                    p_owner->batch_stats.i_max_depth = count;
+            }
+        }
+        coalesced = false;
+
+        block_t *p_block = p_owner->p_batch;
         if( p_block == NULL )
         {
             if( likely(!p_owner->b_draining) )
@@ -1586,25 +1697,70 @@ static void *DecoderThread( void *p_data )
             p_owner->b_draining = false;
         }
 
+        if( p_block != NULL && p_owner->paused )
+        {   /* Stepping frame by frame: one block at a time */
+            p_owner->p_batch = p_block->p_next;
+            p_block->p_next = NULL;
+        }
+        else
+            p_owner->p_batch = NULL;
+        atomic_store_explicit( &p_owner->batch_abort, false,
+                               memory_order_relaxed );
         vlc_fifo_Unlock( p_owner->p_fifo );
 
+        if( batched > 0 )
+            DecoderUpdateStatBatch( p_dec, batched );
+
         int canc = vlc_savecancel();
-        DecoderProcess( p_dec, p_block );
+        bool drained = p_block == NULL;
 
-        if( p_block == NULL )
-        {   /* Draining: the decoder is drained and all decoded buffers are
+        if( drained )
+        {
+            DecoderProcess( p_dec, NULL );
+
+            /* Draining: the decoder is drained and all decoded buffers are
              * queued to the output at this point. Now drain the output. */
             if( p_owner->p_aout != NULL )
                 aout_DecFlush( p_owner->p_aout, true );
         }
+        else
+        do
+        {
+            block_t *p_next = p_block->p_next;
+
+            p_block->p_next = NULL;
+            DecoderProcess( p_dec, p_block );
+            p_block = p_next;
+        }
+        while( p_block != NULL
+            && !atomic_load_explicit( &p_owner->batch_abort,
+                                      memory_order_relaxed ) );
         vlc_restorecancel( canc );
 
         /* Given that the drained flag is only polled, an atomic variable is
          * sufficient. TODO? Wait for draining instead of polling. */
-        atomic_store( &p_owner->drained, (p_block == NULL) );
+        atomic_store( &p_owner->drained, drained );
 
         vlc_mutex_lock( &p_owner->lock );
         vlc_fifo_Lock( p_owner->p_fifo );
+        /* Keep the rest of an interrupted batch, unless flushed meanwhile */
+        if( p_block != NULL && p_owner->flushing )
+        {
+            block_ChainRelease( p_block );
+            p_block = NULL;
+        }
+        if( p_block != NULL )
+        {
+            block_t **pp_last = &p_block->p_next;
+            while( *pp_last != NULL )
+                pp_last = &(*pp_last)->p_next;
+            *pp_last = p_owner->p_batch;
+            p_owner->p_batch = p_block;
+        }
+        p_owner->i_batch = 0;
+        for( p_block = p_owner->p_batch; p_block != NULL;
+             p_block = p_block->p_next )
+            p_owner->i_batch++;
         vlc_cond_signal( &p_owner->wait_acknowledge );
         vlc_mutex_unlock( &p_owner->lock );
     }
@@ -1664,6 +1820,9 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->b_first = true;
     p_owner->b_has_data = false;
 
+    atomic_init( &p_owner->keyframe_only, false );
+    p_owner->b_keyframe_wait = false;
+
     p_owner->flushing = false;
     p_owner->b_draining = false;
     atomic_init( &p_owner->drained, false );
@@ -1680,6 +1839,16 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
         vlc_object_release( p_dec );
         return NULL;
     }
+    p_owner->p_batch = NULL;
+    p_owner->i_batch = 0;
+    atomic_init( &p_owner->batch_abort, false );
+    p_owner->b_batching = false;
+    p_owner->i_batch_delay =
+        var_InheritInteger( p_dec, "decoder-batch-delay" ) * (CLOCK_FREQ / 1000);
+    p_owner->batch_stats.i_start = mdate();
+    p_owner->batch_stats.i_wakeups = 0;
+    p_owner->batch_stats.i_blocks = 0;
+    p_owner->batch_stats.i_max_depth = 0;
 
     vlc_mutex_init( &p_owner->lock );
     vlc_cond_init( &p_owner->wait_request );
@@ -1775,10 +1944,25 @@ static void DeleteDecoder( decoder_t * p_dec )
              (char*)&p_dec->fmt_in.i_codec,
              (unsigned)block_FifoCount( p_owner->p_fifo ) );
 
+    if( p_owner->batch_stats.i_wakeups > 0 )
+    {
+        mtime_t duration = mdate() - p_owner->batch_stats.i_start;
+
+        msg_Dbg( p_dec, "%u block(s) in %u wake-up(s) (%.1f per second), "
+                 "%.1f block(s) per wake-up, max queue depth %u",
+                 p_owner->batch_stats.i_blocks, p_owner->batch_stats.i_wakeups,
+                 duration > 0 ? (double)p_owner->batch_stats.i_wakeups
+                                * CLOCK_FREQ / duration : 0.,
+                 (double)p_owner->batch_stats.i_blocks
+                 / p_owner->batch_stats.i_wakeups,
+                 p_owner->batch_stats.i_max_depth );
+    }
+
     const bool b_flush_spu = p_dec->fmt_out.i_cat == SPU_ES;
     UnloadDecoder( p_dec );
 
     /* Free all packets still in the decoder fifo. */
+    block_ChainRelease( p_owner->p_batch );
     block_FifoRelease( p_owner->p_fifo );
 
     /* Cleanup */
@@ -1950,6 +2134,7 @@ void input_DecoderDelete( decoder_t *p_dec )
     vlc_fifo_Lock( p_owner->p_fifo );
     /* Signal DecoderTimedWait */
     p_owner->flushing = true;
+    atomic_store( &p_owner->batch_abort, true );
     vlc_cond_signal( &p_owner->wait_timed );
     vlc_fifo_Unlock( p_owner->p_fifo );
 
@@ -2016,6 +2201,9 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
     }
 
     vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
+    if( p_owner->b_batching
+     && vlc_fifo_GetCount( p_owner->p_fifo ) >= DECODER_BATCH_BLOCKS )
+        vlc_cond_signal( &p_owner->wait_timed );
     vlc_fifo_Unlock( p_owner->p_fifo );
 }
 
@@ -2025,7 +2213,10 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
 
     assert( !p_owner->b_waiting );
 
-    if( block_FifoCount( p_dec->p_owner->p_fifo ) > 0 )
+    vlc_fifo_Lock( p_owner->p_fifo );
+    bool b_queued = !vlc_fifo_IsEmpty( p_owner->p_fifo ) || p_owner->i_batch > 0;
+    vlc_fifo_Unlock( p_owner->p_fifo );
+    if( b_queued )
         return false;
 
     bool b_empty;
@@ -2075,8 +2266,12 @@ void input_DecoderFlush( decoder_t *p_dec )
 
     vlc_fifo_Lock( p_owner->p_fifo );
 
-    /* Empty the fifo */
+    /* Empty the fifo, and stop decoding the current batch */
     block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+    block_ChainRelease( p_owner->p_batch );
+    p_owner->p_batch = NULL;
+    p_owner->i_batch = 0;
+    atomic_store( &p_owner->batch_abort, true );
 
     /* Don't need to wait for the DecoderThread to flush. Indeed, if called a
      * second time, this function will clear the FIFO again before anything was
@@ -2189,10 +2384,19 @@ void input_DecoderChangePause( decoder_t *p_dec, bool b_paused, mtime_t i_date )
     p_owner->paused = b_paused;
     p_owner->pause_date = i_date;
     p_owner->frames_countdown = 0;
+    if( b_paused )
+        atomic_store( &p_owner->batch_abort, true );
     vlc_fifo_Signal( p_owner->p_fifo );
     vlc_fifo_Unlock( p_owner->p_fifo );
 }
 
+void input_DecoderSetKeyframeOnly( decoder_t *p_dec, bool b_keyframe_only )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    atomic_store( &p_owner->keyframe_only, b_keyframe_only );
+}
+
 void input_DecoderChangeDelay( decoder_t *p_dec, mtime_t i_delay )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
@@ -2242,7 +2446,8 @@ void input_DecoderWait( decoder_t *p_dec )
         if( p_owner->paused )
             break;
         vlc_fifo_Lock( p_owner->p_fifo );
-        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo )
+         && p_owner->p_batch == NULL )
         {
             msg_Err( p_dec, "buffer deadlock prevented" );
             vlc_fifo_Unlock( p_owner->p_fifo );
@@ -58,6 +58,13 @@ void input_DecoderWait( decoder_t * );
  */
 void input_DecoderStopWait( decoder_t * );
 
+/**
+ * This function makes a video decoder skip every picture but the intra ones
+ * (trick play). When it is disabled again, the decoder drops the pictures
+ * until the next intra one.
+ */
+void input_DecoderSetKeyframeOnly( decoder_t *, bool b_keyframe_only );
+
 /**
  * This function returns true if the decoder fifo is empty and false otherwise.
  */
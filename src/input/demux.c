@@ -141,6 +141,133 @@ static const char* DemuxNameFromExtension( char const* ext,
     return result ? result->name : NULL;
 }
 
+/* Signatures of formats with strong magic bytes. When the demux is not known
+ * from the extension or content type, the candidate demuxers whose signature
+ * match the stream head are tried first (not forced), before all others in
+ * score order.
+ * NOTE: only add signatures that no higher priority demuxer would claim:
+ *  - no RIFF/WAVE ('cause of a52 and dts in them as raw audio)
+ *  - no playlists (#EXTM3U, XML...) that may be adaptive streams */
+typedef const struct
+{
+    char const name[8];  /**< demux shortcut */
+    struct
+    {
+        uint16_t offset;
+        uint8_t length;  /**< 0 if unused */
+        char const magic[20];
+    } parts[2];          /**< all parts must match */
+
+} demux_signature;
+
+#define SIG( name, offset, magic ) \
+    { name, { { offset, sizeof(magic) - 1, magic } } }
+#define SIG2( name, offset, magic, offset2, magic2 ) \
+    { name, { { offset, sizeof(magic) - 1, magic }, \
+              { offset2, sizeof(magic2) - 1, magic2 } } }
+
+static demux_signature signatures[] =
+{
+    SIG( "mp4",  4, "ftyp" ),
+    SIG( "mp4",  4, "moov" ),
+    SIG( "mp4",  4, "mdat" ),
+    SIG( "mkv",  0, "\x1A\x45\xDF\xA3" ),
+    SIG2( "avi", 0, "RIFF", 8, "AVI " ),
+    SIG( "asf",  0, "\x30\x26\xB2\x75\x8E\x66\xCF\x11" ),
+    SIG( "ogg",  0, "OggS" ),
+    SIG( "flac", 0, "fLaC" ),
+    SIG( "caf",  0, "caff" ),
+    SIG2( "aiff", 0, "FORM", 8, "AIF" ),
+    SIG( "au",   0, ".snd" ),
+    SIG( "smf",  0, "MThd" ),
+    SIG( "voc",  0, "Creative Voice File\x1A" ),
+    SIG( "nsv",  0, "NSV" ),
+    SIG( "ps",   0, "\x00\x00\x01\xBA" ),
+    SIG2( "ts",  0, "\x47", 188, "\x47" ),
+    SIG2( "ts",  4, "\x47", 196, "\x47" ), /* M2TS */
+};
+
+#undef SIG2
+#undef SIG
+
+static bool DemuxSignatureMatch( demux_signature *sig,
+                                 const uint8_t *p_peek, size_t i_peek )
+{
+    for( size_t i = 0; i < ARRAY_SIZE(sig->parts); i++ )
+    {
+        size_t i_offset = sig->parts[i].offset;
+        size_t i_length = sig->parts[i].length;
+
+        if( i_length == 0 )
+            break;
+        if( i_offset + i_length > i_peek
+         || memcmp( p_peek + i_offset, sig->parts[i].magic, i_length ) )
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Matches all the signatures against the stream head, in one peek.
+ * @param psz_names buffer for the comma-separated list of candidates
+ * @return the index of the first matching signature, or -1
+ */
+static int DemuxNamesFromSignature( stream_t *s, char *psz_names,
+                                    size_t i_names )
+{
+    /* Enough for all the signatures */
+    const size_t i_max = 200;
+    const uint8_t *p_peek;
+    int i_first = -1, i_last = -1;
+
+    ssize_t i_peek = vlc_stream_Peek( s, &p_peek, i_max );
+    if( i_peek <= 0 )
+        return -1;
+
+    *psz_names = '\0';
+    for( size_t i = 0; i < ARRAY_SIZE(signatures); i++ )
+    {
+        demux_signature *sig = &signatures[i];
+
+        if( !DemuxSignatureMatch( sig, p_peek, i_peek ) )
+            continue;
+        /* Signatures of the same demux are contiguous */
+        if( i_first != -1 && !strcmp( signatures[i_last].name, sig->name ) )
+            continue;
+        if( i_first == -1 )
+            i_first = i;
+        i_last = i;
+
+        size_t i_len = strlen( psz_names );
+        if( i_len + strlen( sig->name ) + 2 > i_names )
+            break;
+        if( i_len > 0 )
+            psz_names[i_len++] = ',';
+        strcpy( psz_names + i_len, sig->name );
+    }
+    return i_first;
+}
+
+/**
+ * Counts a signature hit (the first candidate opened the stream) or miss.
+ * The counts are kept per LibVLC instance, in the integer variables
+ * "demux-signature-<name>-hits" and "demux-signature-<name>-misses" of the
+ * instance object.
+ * @return the updated count
+ */
+static int64_t DemuxSignatureCount( demux_t *p_demux, demux_signature *sig,
+                                    bool b_hit )
+{
+    vlc_object_t *p_libvlc = VLC_OBJECT(p_demux->obj.libvlc);
+    char psz_var[sizeof("demux-signature--misses") + sizeof(sig->name)];
+
+    snprintf( psz_var, sizeof(psz_var), "demux-signature-%.*s-%s",
+              (int)sizeof(sig->name), sig->name, b_hit ? "hits" : "misses" );
+    if( var_Type( p_libvlc, psz_var ) == 0 )
+        var_Create( p_libvlc, psz_var, VLC_VAR_INTEGER );
+    return var_IncInteger( p_libvlc, psz_var );
+}
+
 /*****************************************************************************
  * demux_New:
  *  if s is NULL then load a access_demux
@@ -255,9 +382,33 @@ demux_t *demux_NewAdvanced( vlc_object_t *p_obj, input_thread_t *p_parent_input,
           ;
         SkipAPETag( p_demux );
 
+        /* Try the demuxers matching the stream signature first */
+        char psz_names[32];
+        int i_signature = -1;
+        if( !strcmp( psz_module, "any" ) || !psz_module[0] )
+        {
+            i_signature = DemuxNamesFromSignature( s, psz_names,
+                                                   sizeof(psz_names) );
+            if( i_signature >= 0 )
+                psz_module = psz_names;
+        }
+
         p_demux->p_module =
             module_need( p_demux, "demux", psz_module,
                          !strcmp( psz_module, p_demux->psz_demux ) );
+
+        if( i_signature >= 0 )
+        {
+            demux_signature *sig = &signatures[i_signature];
+            bool b_hit = p_demux->p_module != NULL
+              && !strcmp( module_get_object( p_demux->p_module ), sig->name );
+
+            int64_t i_count = DemuxSignatureCount( p_demux, sig, b_hit );
+
+            msg_Dbg( p_demux, "signature match %s (candidates: %s): %s "
+                     "(%"PRId64" time(s))", sig->name, psz_names,
+                     b_hit ? "hit" : "miss", i_count );
+        }
     }
     else
     {
@@ -475,6 +626,7 @@ int demux_vaControlHelper( stream_t *s,
         case DEMUX_TEST_AND_CLEAR_FLAGS:
         case DEMUX_GET_TITLE:
         case DEMUX_GET_SEEKPOINT:
+        case DEMUX_SET_KEYFRAME_STRIDE:
             return VLC_EGENERIC;
 
         case DEMUX_SET_TITLE:
@@ -160,6 +160,9 @@ struct es_out_sys_t
     /* Current preroll */
     mtime_t     i_preroll_end;
 
+    /* Trick play */
+    bool        b_keyframe_only;
+
     /* Used for buffering */
     bool        b_buffering;
     mtime_t     i_buffering_extra_initial;
@@ -331,6 +334,7 @@ es_out_t *input_EsOutNew( input_thread_t *p_input, int i_rate )
 
     p_sys->b_buffering = true;
     p_sys->i_preroll_end = -1;
+    p_sys->b_keyframe_only = false;
     p_sys->i_prev_stream_level = -1;
 
     return out;
@@ -590,6 +594,20 @@ static void EsOutChangeRate( es_out_t *out, int i_rate )
     EsOutProgramsChangeRate( out );
 }
 
+static void EsOutChangeKeyframeOnly( es_out_t *out, bool b_keyframe_only )
+{
+    es_out_sys_t *p_sys = out->p_sys;
+
+    p_sys->b_keyframe_only = b_keyframe_only;
+    for( int i = 0; i < p_sys->i_es; i++ )
+    {
+        es_out_id_t *es = p_sys->es[i];
+
+        if( es->p_dec && es->fmt.i_cat == VIDEO_ES )
+            input_DecoderSetKeyframeOnly( es->p_dec, b_keyframe_only );
+    }
+}
+
 static void EsOutChangePosition( es_out_t *out )
 {
     es_out_sys_t      *p_sys = out->p_sys;
@@ -685,6 +703,9 @@ static void EsOutDecodersStopBuffering( es_out_t *out, bool b_forced )
 
         if( !p_es->p_dec || p_es->fmt.i_cat == SPU_ES )
             continue;
+        /* muted audio gets no data to wait for */
+        if( p_sys->b_keyframe_only && p_es->fmt.i_cat == AUDIO_ES )
+            continue;
         input_DecoderWait( p_es->p_dec );
         if( p_es->p_dec_record )
             input_DecoderWait( p_es->p_dec_record );
@@ -1667,6 +1688,9 @@ static void EsCreateDecoder( es_out_t *out, es_out_id_t *p_es )
         if( p_sys->b_buffering )
             input_DecoderStartWait( p_es->p_dec );
 
+        if( p_sys->b_keyframe_only && p_es->fmt.i_cat == VIDEO_ES )
+            input_DecoderSetKeyframeOnly( p_es->p_dec, true );
+
         if( !p_es->p_master && p_sys->p_sout_record )
         {
             p_es->p_dec_record = input_DecoderNew( p_input, &p_es->fmt, p_es->p_pgrm->p_clock, p_sys->p_sout_record );
@@ -1997,7 +2021,8 @@ static int EsOutSend( es_out_t *out, es_out_id_t *es, block_t *p_block )
             p_block->i_flags |= BLOCK_FLAG_PREROLL;
     }
 
-    if( !es->p_dec )
+    if( !es->p_dec ||
+        ( p_sys->b_keyframe_only && es->fmt.i_cat == AUDIO_ES ) )
     {
         block_Release( p_block );
         vlc_mutex_unlock( &p_sys->lock );
@@ -2670,6 +2695,13 @@ static int EsOutControlLocked( es_out_t *out, int i_query, va_list args )
         EsOutFrameNext( out );
         return VLC_SUCCESS;
 
+    case ES_OUT_SET_KEYFRAME_ONLY:
+    {
+        const bool b_keyframe_only = (bool)va_arg( args, int );
+        EsOutChangeKeyframeOnly( out, b_keyframe_only );
+        return VLC_SUCCESS;
+    }
+
     case ES_OUT_SET_TIMES:
     {
         double f_position = (double)va_arg( args, double );
@@ -82,6 +82,9 @@ enum es_out_query_private_e
 
     /* Set End Of Stream */
     ES_OUT_SET_EOS,                                 /* res=cannot fail */
+
+    /* Decode only the video keyframes and drop the audio (trick play) */
+    ES_OUT_SET_KEYFRAME_ONLY,                       /* arg1=bool                res=cannot fail */
 };
 
 static inline void es_out_SetMode( es_out_t *p_out, int i_mode )
@@ -167,6 +170,11 @@ static inline void es_out_Eos( es_out_t *p_out )
     int i_ret = es_out_Control( p_out, ES_OUT_SET_EOS );
     assert( !i_ret );
 }
+static inline void es_out_SetKeyframeOnly( es_out_t *p_out, bool b_keyframe_only )
+{
+    int i_ret = es_out_Control( p_out, ES_OUT_SET_KEYFRAME_ONLY, b_keyframe_only );
+    assert( !i_ret );
+}
 
 es_out_t  *input_EsOutNew( input_thread_t *, int i_rate );
 
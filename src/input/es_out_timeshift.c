@@ -741,6 +741,12 @@ static int ControlLocked( es_out_t *p_out, int i_query, va_list args )
         int *pi_group = va_arg( args, int * );
         return es_out_Control( p_sys->p_out, ES_OUT_GET_GROUP_FORCED, pi_group );
     }
+    case ES_OUT_SET_KEYFRAME_ONLY:
+    {
+        const bool b_keyframe_only = (bool)va_arg( args, int );
+        es_out_SetKeyframeOnly( p_sys->p_out, b_keyframe_only );
+        return VLC_SUCCESS;
+    }
 
     default:
         msg_Err( p_sys->p_input, "Unknown es_out_Control query !" );
@@ -314,6 +314,7 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
     priv->is_stopped = false;
     priv->b_recording = false;
     priv->i_rate = INPUT_RATE_DEFAULT;
+    priv->b_keyframe_only = false;
     memset( &priv->bookmark, 0, sizeof(priv->bookmark) );
     TAB_INIT( priv->i_bookmark, priv->pp_bookmark );
     TAB_INIT( priv->i_attachment, priv->attachment );
@@ -819,6 +820,8 @@ static void InitStatistics( input_thread_t *p_input )
         INIT_COUNTER( decoded_audio, COUNTER );
         INIT_COUNTER( decoded_video, COUNTER );
         INIT_COUNTER( decoded_sub, COUNTER );
+        INIT_COUNTER( decoder_blocks, COUNTER );
+        INIT_COUNTER( decoder_wakeups, COUNTER );
         priv->counters.p_sout_send_bitrate = NULL;
         priv->counters.p_sout_sent_packets = NULL;
         priv->counters.p_sout_sent_bytes = NULL;
@@ -940,6 +943,7 @@ static void StartTitle( input_thread_t * p_input )
         priv->i_stop = 0;
     }
     priv->b_fast_seek = var_GetBool( p_input, "input-fast-seek" );
+    priv->f_trickplay_rate = var_GetFloat( p_input, "input-trickplay-rate" );
 }
 
 static int SlaveCompare(const void *a, const void *b)
@@ -1404,6 +1408,8 @@ error:
         EXIT_COUNTER( decoded_audio );
         EXIT_COUNTER( decoded_video );
         EXIT_COUNTER( decoded_sub );
+        EXIT_COUNTER( decoder_blocks );
+        EXIT_COUNTER( decoder_wakeups );
 
         if( input_priv(p_input)->p_sout )
         {
@@ -1476,6 +1482,8 @@ do { \
             CL_CO( decoded_audio) ;
             CL_CO( decoded_video );
             CL_CO( decoded_sub) ;
+            CL_CO( decoder_blocks );
+            CL_CO( decoder_wakeups );
         }
 
         /* Close optional stream output instance */
@@ -1722,6 +1730,48 @@ static void ControlUnpause( input_thread_t *p_input, mtime_t i_control_date )
     es_out_SetPauseState( input_priv(p_input)->p_es_out, false, false, i_control_date );
 }
 
+/* Number of pictures per second shown during keyframe-only playback */
+#define TRICKPLAY_FPS 8
+
+static void ControlTrickPlay( input_thread_t *p_input )
+{
+    input_thread_private_t *priv = input_priv(p_input);
+    const int i_rate = priv->i_rate;
+
+    /* Faster than :input-trickplay-rate, ie.
+     * INPUT_RATE_DEFAULT / i_rate > f_trickplay_rate (disabled below 1) */
+    const bool b_keyframe_only = priv->b_can_pace_control && i_rate > 0 &&
+        priv->f_trickplay_rate >= 1.f &&
+        i_rate * priv->f_trickplay_rate < INPUT_RATE_DEFAULT;
+
+    if( !b_keyframe_only && !priv->b_keyframe_only )
+        return;
+
+    /* The demuxer jumps from keyframe to keyframe, without it the decoders
+     * still skip the inter pictures */
+    const int64_t i_stride = b_keyframe_only ?
+        (int64_t)CLOCK_FREQ * INPUT_RATE_DEFAULT / i_rate / TRICKPLAY_FPS : 0;
+    if( demux_Control( priv->master->p_demux, DEMUX_SET_KEYFRAME_STRIDE,
+                       i_stride ) && b_keyframe_only )
+        msg_Dbg( p_input, "demuxer cannot skip to the keyframes" );
+
+    if( b_keyframe_only != priv->b_keyframe_only )
+    {
+        msg_Dbg( p_input, "%s keyframe-only playback",
+                 b_keyframe_only ? "starting" : "stopping" );
+        es_out_SetKeyframeOnly( priv->p_es_out, b_keyframe_only );
+        priv->b_keyframe_only = b_keyframe_only;
+
+        if( !b_keyframe_only )
+        {
+            /* Resume from the picture being displayed, not from the
+             * keyframes demuxed in advance */
+            vlc_value_t val = { .i_int = var_GetInteger( p_input, "time" ) };
+            input_ControlPush( p_input, INPUT_CONTROL_SET_TIME, &val );
+        }
+    }
+}
+
 static bool Control( input_thread_t *p_input,
                      int i_type, vlc_value_t val )
 {
@@ -1904,6 +1954,7 @@ static bool Control( input_thread_t *p_input,
                     const int i_rate_source = (input_priv(p_input)->b_can_pace_control || input_priv(p_input)->b_can_rate_control ) ? i_rate : INPUT_RATE_DEFAULT;
                     es_out_SetRate( input_priv(p_input)->p_es_out, i_rate_source, i_rate );
                 }
+                ControlTrickPlay( p_input );
 
                 b_force_update = true;
             }
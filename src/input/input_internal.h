@@ -104,6 +104,8 @@ typedef struct input_thread_private_t
     int64_t     i_stop;     /* :stop-time, 0 if none */
     int64_t     i_time;     /* Current time */
     bool        b_fast_seek;/* :input-fast-seek */
+    float       f_trickplay_rate; /* :input-trickplay-rate */
+    bool        b_keyframe_only; /* trick play */
 
     /* Output */
     bool            b_out_pace_control; /* XXX Move it ot es_sout ? */
@@ -156,6 +158,8 @@ typedef struct input_thread_private_t
         counter_t *p_decoded_audio;
         counter_t *p_decoded_video;
         counter_t *p_decoded_sub;
+        counter_t *p_decoder_blocks;
+        counter_t *p_decoder_wakeups;
         counter_t *p_sout_sent_packets;
         counter_t *p_sout_sent_bytes;
         counter_t *p_sout_send_bitrate;
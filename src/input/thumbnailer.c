@@ -0,0 +1,772 @@
+/*****************************************************************************
+ * thumbnailer.c: Fast thumbnail extraction
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_thumbnailer.h>
+#include <vlc_codec.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_image.h>
+#include <vlc_meta.h>
+#include <vlc_modules.h>
+#include <vlc_stream.h>
+#include "libvlc.h"
+#include "stream.h"
+
+/* Demux calls allowed to find the video track when it is not declared at
+ * open time (TS, PS...) */
+#define THUMBNAILER_PROBE_DEMUX 1000
+/* Video blocks decoded after a seek before giving up on a timestamp */
+#define THUMBNAILER_MAX_BLOCKS  300
+/* Demux calls after a seek before giving up on a timestamp, as the other
+ * tracks or a missing video track may not feed the decoder at all */
+#define THUMBNAILER_MAX_DEMUX   10000
+
+struct es_out_sys_t
+{
+    vlc_thumbnailer_t *p_thumbnailer;
+};
+
+struct es_out_id_t
+{
+    int i_cat;
+};
+
+struct decoder_owner_sys_t
+{
+    vlc_thumbnailer_t *p_thumbnailer;
+};
+
+struct vlc_thumbnailer_t
+{
+    VLC_COMMON_MEMBERS
+
+    demux_t             *p_demux;
+    es_out_t             out;
+    es_out_sys_t         out_sys;
+    int                  i_es_all;   /* tracks the demuxer did not delete */
+    es_out_id_t        **pp_es_all;
+
+    /* Video track being decoded */
+    es_out_id_t         *p_es;
+    decoder_t           *p_packetizer;
+    decoder_t           *p_dec;
+    decoder_owner_sys_t  owner;
+
+    /* Current request */
+    bool                 b_probing;
+    unsigned             i_blocks;
+    picture_t           *p_pic;
+
+    /* Last decoded keyframe, reused when a seek lands on it again */
+    picture_t           *p_last;
+    mtime_t              i_last_ts;
+
+    /* Scaler and encoder, reused across requests */
+    image_handler_t     *p_image;
+};
+
+/*****************************************************************************
+ * Decoder
+ *****************************************************************************/
+static int DecoderFormatUpdate( decoder_t *p_dec )
+{
+    p_dec->fmt_out.video.i_chroma = p_dec->fmt_out.i_codec;
+    return 0;
+}
+
+static picture_t *DecoderBufferNew( decoder_t *p_dec )
+{
+    return picture_NewFromFormat( &p_dec->fmt_out.video );
+}
+
+static int DecoderQueueVideo( decoder_t *p_dec, picture_t *p_pic )
+{
+    vlc_thumbnailer_t *p_th = p_dec->p_owner->p_thumbnailer;
+
+    /* Only the first picture after the seek is wanted */
+    if( p_th->p_pic == NULL )
+        p_th->p_pic = p_pic;
+    else
+        picture_Release( p_pic );
+    return 0;
+}
+
+static void DeleteDecoder( decoder_t *p_dec )
+{
+    if( p_dec->p_module != NULL )
+        module_unneed( p_dec, p_dec->p_module );
+
+    es_format_Clean( &p_dec->fmt_in );
+    es_format_Clean( &p_dec->fmt_out );
+
+    if( p_dec->p_description != NULL )
+        vlc_meta_Delete( p_dec->p_description );
+
+    vlc_object_release( p_dec );
+}
+
+static decoder_t *CreateDecoder( vlc_thumbnailer_t *p_th,
+                                 const es_format_t *p_fmt, bool b_packetizer )
+{
+    decoder_t *p_dec = vlc_custom_create( p_th, sizeof( *p_dec ),
+                                          b_packetizer ? "packetizer"
+                                                       : "decoder" );
+    if( unlikely(p_dec == NULL) )
+        return NULL;
+
+    es_format_Copy( &p_dec->fmt_in, p_fmt );
+    es_format_Init( &p_dec->fmt_out, VIDEO_ES, 0 );
+    p_dec->b_frame_drop_allowed = true;
+
+    p_dec->pf_vout_format_update = DecoderFormatUpdate;
+    p_dec->pf_vout_buffer_new = DecoderBufferNew;
+    p_dec->pf_queue_video = DecoderQueueVideo;
+    p_dec->p_owner = &p_th->owner;
+
+    if( b_packetizer )
+        p_dec->p_module = module_need( p_dec, "packetizer", "$packetizer",
+                                       false );
+    else
+        p_dec->p_module = module_need( p_dec, "decoder", "$codec", false );
+
+    if( p_dec->p_module == NULL
+     || (!b_packetizer && p_dec->pf_decode_video == NULL) )
+    {
+        msg_Dbg( p_th, "no suitable %s module for fourcc `%4.4s'",
+                 b_packetizer ? "packetizer" : "decoder",
+                 (const char *)&p_fmt->i_codec );
+        DeleteDecoder( p_dec );
+        return NULL;
+    }
+    return p_dec;
+}
+
+static void CloseDecoder( vlc_thumbnailer_t *p_th )
+{
+    if( p_th->p_packetizer != NULL )
+    {
+        DeleteDecoder( p_th->p_packetizer );
+        p_th->p_packetizer = NULL;
+    }
+    if( p_th->p_dec != NULL )
+    {
+        DeleteDecoder( p_th->p_dec );
+        p_th->p_dec = NULL;
+    }
+    if( p_th->p_last != NULL )
+    {
+        picture_Release( p_th->p_last );
+        p_th->p_last = NULL;
+    }
+}
+
+static int OpenDecoder( vlc_thumbnailer_t *p_th, const es_format_t *p_fmt )
+{
+    const es_format_t *p_dec_fmt = p_fmt;
+
+    if( !p_fmt->b_packetized )
+    {
+        p_th->p_packetizer = CreateDecoder( p_th, p_fmt, true );
+        if( p_th->p_packetizer == NULL )
+            return VLC_EGENERIC;
+        p_dec_fmt = &p_th->p_packetizer->fmt_out;
+    }
+
+    p_th->p_dec = CreateDecoder( p_th, p_dec_fmt, false );
+    if( p_th->p_dec == NULL )
+    {
+        CloseDecoder( p_th );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static void FlushDecoder( vlc_thumbnailer_t *p_th )
+{
+    if( p_th->p_packetizer != NULL && p_th->p_packetizer->pf_flush != NULL )
+        p_th->p_packetizer->pf_flush( p_th->p_packetizer );
+    if( p_th->p_dec != NULL && p_th->p_dec->pf_flush != NULL )
+        p_th->p_dec->pf_flush( p_th->p_dec );
+}
+
+static void DecodeVideo( vlc_thumbnailer_t *p_th, block_t *p_block )
+{
+    decoder_t *p_dec = p_th->p_dec;
+    block_t **pp_block = p_block != NULL ? &p_block : NULL;
+    picture_t *p_pic;
+
+    while( (p_pic = p_dec->pf_decode_video( p_dec, pp_block )) != NULL )
+        DecoderQueueVideo( p_dec, p_pic );
+}
+
+static void DecodeBlock( vlc_thumbnailer_t *p_th, block_t *p_block )
+{
+    if( p_th->p_dec == NULL || p_th->p_pic != NULL )
+    {
+        block_Release( p_block );
+        return;
+    }
+
+    /* Only a keyframe can be decoded on its own */
+    if( (p_block->i_flags & BLOCK_FLAG_TYPE_MASK)
+     && !(p_block->i_flags & BLOCK_FLAG_TYPE_I) )
+    {
+        block_Release( p_block );
+        return;
+    }
+
+    mtime_t i_ts = p_block->i_dts > VLC_TS_INVALID ? p_block->i_dts
+                                                   : p_block->i_pts;
+    if( p_th->p_last != NULL && i_ts > VLC_TS_INVALID
+     && i_ts == p_th->i_last_ts )
+    {
+        /* Same keyframe as last time: do not decode it again */
+        p_th->p_pic = picture_Hold( p_th->p_last );
+        block_Release( p_block );
+        return;
+    }
+
+    p_th->i_blocks++;
+    DecodeVideo( p_th, p_block );
+    if( p_th->p_pic == NULL )
+    {
+        /* The decoder may be holding the frame back for reordering */
+        DecodeVideo( p_th, NULL );
+        FlushDecoder( p_th );
+    }
+
+    if( p_th->p_pic != NULL )
+    {
+        if( p_th->p_last != NULL )
+            picture_Release( p_th->p_last );
+        p_th->p_last = picture_Hold( p_th->p_pic );
+        p_th->i_last_ts = i_ts;
+    }
+}
+
+/*****************************************************************************
+ * Elementary streams output
+ *****************************************************************************/
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *p_fmt )
+{
+    vlc_thumbnailer_t *p_th = out->p_sys->p_thumbnailer;
+
+    es_out_id_t *id = malloc( sizeof( *id ) );
+    if( unlikely(id == NULL) )
+        return NULL;
+    id->i_cat = p_fmt->i_cat;
+    TAB_APPEND( p_th->i_es_all, p_th->pp_es_all, id );
+
+    /* Keep the first video track that can be decoded */
+    if( p_th->p_es == NULL && p_fmt->i_cat == VIDEO_ES
+     && p_fmt->i_priority >= ES_PRIORITY_SELECTABLE_MIN
+     && OpenDecoder( p_th, p_fmt ) == VLC_SUCCESS )
+    {
+        msg_Dbg( p_th, "using video track %d (fourcc `%4.4s')",
+                 p_fmt->i_id, (const char *)&p_fmt->i_codec );
+        p_th->p_es = id;
+    }
+    return id;
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *p_block )
+{
+    vlc_thumbnailer_t *p_th = out->p_sys->p_thumbnailer;
+    decoder_t *p_packetizer = p_th->p_packetizer;
+
+    if( id != p_th->p_es || p_th->b_probing )
+    {
+        block_Release( p_block );
+        return VLC_SUCCESS;
+    }
+
+    if( p_packetizer == NULL )
+    {
+        DecodeBlock( p_th, p_block );
+        return VLC_SUCCESS;
+    }
+
+    block_t *p_packetized;
+    while( (p_packetized = p_packetizer->pf_packetize( p_packetizer,
+                                                       &p_block )) != NULL )
+    {
+        if( p_th->p_dec != NULL
+         && !es_format_IsSimilar( &p_th->p_dec->fmt_in,
+                                  &p_packetizer->fmt_out ) )
+        {
+            msg_Dbg( p_th, "restarting decoder due to input format change" );
+            DeleteDecoder( p_th->p_dec );
+            p_th->p_dec = CreateDecoder( p_th, &p_packetizer->fmt_out, false );
+        }
+
+        while( p_packetized != NULL )
+        {
+            block_t *p_next = p_packetized->p_next;
+
+            p_packetized->p_next = NULL;
+            DecodeBlock( p_th, p_packetized );
+            p_packetized = p_next;
+        }
+    }
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    vlc_thumbnailer_t *p_th = out->p_sys->p_thumbnailer;
+
+    if( id == p_th->p_es )
+    {
+        CloseDecoder( p_th );
+        p_th->p_es = NULL;
+    }
+    TAB_REMOVE( p_th->i_es_all, p_th->pp_es_all, id );
+    free( id );
+}
+
+static int EsOutControl( es_out_t *out, int i_query, va_list args )
+{
+    vlc_thumbnailer_t *p_th = out->p_sys->p_thumbnailer;
+
+    switch( i_query )
+    {
+        case ES_OUT_GET_ES_STATE:
+        {
+            /* Lets the demuxer skip the other tracks */
+            es_out_id_t *id = va_arg( args, es_out_id_t * );
+            bool *pb_enabled = va_arg( args, bool * );
+
+            *pb_enabled = id == p_th->p_es;
+            return VLC_SUCCESS;
+        }
+
+        case ES_OUT_SET_ES_FMT:
+        {
+            es_out_id_t *id = va_arg( args, es_out_id_t * );
+            const es_format_t *p_fmt = va_arg( args, const es_format_t * );
+
+            if( id == p_th->p_es )
+            {
+                CloseDecoder( p_th );
+                if( OpenDecoder( p_th, p_fmt ) != VLC_SUCCESS )
+                    p_th->p_es = NULL;
+            }
+            return VLC_SUCCESS;
+        }
+
+        case ES_OUT_GET_EMPTY:
+            *va_arg( args, bool * ) = true;
+            return VLC_SUCCESS;
+
+        case ES_OUT_SET_ES:
+        case ES_OUT_RESTART_ES:
+        case ES_OUT_SET_ES_DEFAULT:
+        case ES_OUT_SET_ES_STATE:
+        case ES_OUT_SET_ES_CAT_POLICY:
+        case ES_OUT_SET_GROUP:
+        case ES_OUT_SET_PCR:
+        case ES_OUT_SET_GROUP_PCR:
+        case ES_OUT_RESET_PCR:
+        case ES_OUT_SET_NEXT_DISPLAY_TIME:
+        case ES_OUT_SET_GROUP_META:
+        case ES_OUT_SET_GROUP_EPG:
+        case ES_OUT_SET_GROUP_EPG_EVENT:
+        case ES_OUT_SET_EPG_TIME:
+        case ES_OUT_DEL_GROUP:
+        case ES_OUT_SET_ES_SCRAMBLED_STATE:
+        case ES_OUT_SET_META:
+            return VLC_SUCCESS;
+
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+/*****************************************************************************
+ * Extraction
+ *****************************************************************************/
+static int Seek( vlc_thumbnailer_t *p_th, mtime_t i_time )
+{
+    demux_t *p_demux = p_th->p_demux;
+    int64_t i_length;
+
+    if( demux_Control( p_demux, DEMUX_SET_TIME, (int64_t)i_time,
+                       false ) == VLC_SUCCESS )
+        return VLC_SUCCESS;
+
+    if( demux_Control( p_demux, DEMUX_GET_LENGTH, &i_length ) == VLC_SUCCESS
+     && i_length > 0 )
+        return demux_Control( p_demux, DEMUX_SET_POSITION,
+                              (double)i_time / i_length, false );
+    return VLC_EGENERIC;
+}
+
+/**
+ * Decodes the keyframe preceding i_time.
+ * The returned picture may be shared with the keyframe cache.
+ */
+static picture_t *Extract( vlc_thumbnailer_t *p_th, mtime_t i_time )
+{
+    if( p_th->p_dec == NULL )
+        return NULL;
+
+    FlushDecoder( p_th );
+    if( Seek( p_th, i_time ) != VLC_SUCCESS )
+    {
+        msg_Warn( p_th, "cannot seek to %"PRId64" us", i_time );
+        return NULL;
+    }
+
+    p_th->i_blocks = 0;
+    for( unsigned i = 0; p_th->p_pic == NULL; i++ )
+    {
+        if( i >= THUMBNAILER_MAX_DEMUX )
+        {
+            msg_Dbg( p_th, "no video after %u demux calls", i );
+            break;
+        }
+        if( demux_Demux( p_th->p_demux ) != VLC_DEMUXER_SUCCESS )
+        {
+            if( p_th->p_dec != NULL )
+                DecodeVideo( p_th, NULL );
+            break;
+        }
+        if( p_th->i_blocks >= THUMBNAILER_MAX_BLOCKS || p_th->p_dec == NULL )
+            break;
+    }
+
+    picture_t *p_pic = p_th->p_pic;
+    p_th->p_pic = NULL;
+    if( p_pic == NULL )
+        msg_Warn( p_th, "no picture decoded at %"PRId64" us", i_time );
+    return p_pic;
+}
+
+/**
+ * Completes the requested format from the decoded one.
+ */
+static void SetupFormat( const video_format_t *p_src, video_format_t *p_fmt )
+{
+    unsigned i_width = p_src->i_visible_width;
+    unsigned i_height = p_src->i_visible_height;
+
+    if( i_width == 0 || i_height == 0 )
+    {
+        i_width = p_src->i_width;
+        i_height = p_src->i_height;
+    }
+
+    /* Display size */
+    if( p_src->i_sar_num >= p_src->i_sar_den )
+        i_width = (uint64_t)i_width * p_src->i_sar_num / p_src->i_sar_den;
+    else
+        i_height = (uint64_t)i_height * p_src->i_sar_den / p_src->i_sar_num;
+
+    if( p_fmt->i_width == 0 && p_fmt->i_height == 0 )
+    {
+        p_fmt->i_width = i_width;
+        p_fmt->i_height = i_height;
+    }
+    else if( p_fmt->i_width == 0 )
+        p_fmt->i_width = (uint64_t)i_width * p_fmt->i_height / i_height;
+    else if( p_fmt->i_height == 0 )
+        p_fmt->i_height = (uint64_t)i_height * p_fmt->i_width / i_width;
+
+    if( p_fmt->i_chroma == 0 )
+        p_fmt->i_chroma = p_src->i_chroma;
+    p_fmt->i_visible_width = p_fmt->i_width;
+    p_fmt->i_visible_height = p_fmt->i_height;
+    p_fmt->i_x_offset = p_fmt->i_y_offset = 0;
+    p_fmt->i_sar_num = p_fmt->i_sar_den = 1;
+}
+
+static video_format_t SourceFormat( const picture_t *p_pic )
+{
+    video_format_t fmt = p_pic->format;
+
+    if( fmt.i_sar_num == 0 || fmt.i_sar_den == 0 )
+        fmt.i_sar_num = fmt.i_sar_den = 1;
+    return fmt;
+}
+
+static picture_t *Convert( vlc_thumbnailer_t *p_th, picture_t *p_pic,
+                           video_format_t *p_fmt )
+{
+    video_format_t fmt_in = SourceFormat( p_pic );
+
+    SetupFormat( &fmt_in, p_fmt );
+    if( p_fmt->i_chroma == fmt_in.i_chroma
+     && p_fmt->i_width == fmt_in.i_visible_width
+     && p_fmt->i_height == fmt_in.i_visible_height )
+    {
+        *p_fmt = fmt_in;
+        return picture_Hold( p_pic );
+    }
+
+    picture_t *p_out = image_Convert( p_th->p_image, p_pic, &fmt_in, p_fmt );
+    if( p_out == NULL )
+        return NULL;
+
+    p_out->date = p_pic->date;
+    *p_fmt = p_out->format;
+    return p_out;
+}
+
+#undef vlc_thumbnailer_Create
+vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t *p_obj,
+                                           input_item_t *p_item )
+{
+    vlc_thumbnailer_t *p_th = vlc_custom_create( p_obj, sizeof( *p_th ),
+                                                 "thumbnailer" );
+    if( unlikely(p_th == NULL) )
+        return NULL;
+
+    /* Favour speed over quality: cheapest scaler, and no decoding of the
+     * frames nothing depends on. The item options can still override. */
+    var_Create( p_th, "swscale-mode", VLC_VAR_INTEGER );
+    var_SetInteger( p_th, "swscale-mode", 0 );
+    var_Create( p_th, "avcodec-hurry-up", VLC_VAR_BOOL );
+    var_SetBool( p_th, "avcodec-hurry-up", true );
+    var_Create( p_th, "avcodec-skip-frame", VLC_VAR_INTEGER );
+    var_SetInteger( p_th, "avcodec-skip-frame", 1 );
+    input_item_ApplyOptions( VLC_OBJECT(p_th), p_item );
+
+    p_th->out.pf_add = EsOutAdd;
+    p_th->out.pf_send = EsOutSend;
+    p_th->out.pf_del = EsOutDel;
+    p_th->out.pf_control = EsOutControl;
+    p_th->out.pf_destroy = NULL;
+    p_th->out.p_sys = &p_th->out_sys;
+    p_th->out_sys.p_thumbnailer = p_th;
+    p_th->owner.p_thumbnailer = p_th;
+    TAB_INIT( p_th->i_es_all, p_th->pp_es_all );
+
+    p_th->p_image = image_HandlerCreate( p_th );
+    if( unlikely(p_th->p_image == NULL) )
+        goto error;
+
+    char *psz_uri = input_item_GetURI( p_item );
+    if( psz_uri == NULL )
+        goto error;
+
+    const char *psz_location = strstr( psz_uri, "://" );
+    psz_location = psz_location != NULL ? psz_location + 3 : psz_uri;
+
+    stream_t *p_stream = vlc_stream_NewURL( p_th, psz_uri );
+    if( p_stream == NULL )
+    {
+        msg_Err( p_th, "cannot open %s", psz_uri );
+        free( psz_uri );
+        goto error;
+    }
+
+    /* Same stream filters as the input: decompression, prefetch... */
+    p_stream = stream_FilterAutoNew( p_stream );
+
+    char *psz_filters = var_InheritString( p_th, "stream-filter" );
+    if( psz_filters != NULL )
+    {
+        p_stream = stream_FilterChainNew( p_stream, psz_filters );
+        free( psz_filters );
+    }
+
+    char *psz_demux = var_InheritString( p_th, "demux" );
+    p_th->p_demux = demux_New( VLC_OBJECT(p_th),
+                               psz_demux != NULL ? psz_demux : "any",
+                               psz_location, p_stream, &p_th->out );
+    free( psz_demux );
+    free( psz_uri );
+    if( p_th->p_demux == NULL )
+    {
+        vlc_stream_Delete( p_stream );
+        goto error;
+    }
+
+    /* Some demuxers only declare their tracks once they have read them */
+    p_th->b_probing = true;
+    for( unsigned i = 0; p_th->p_es == NULL && i < THUMBNAILER_PROBE_DEMUX;
+         i++ )
+        if( demux_Demux( p_th->p_demux ) != VLC_DEMUXER_SUCCESS )
+            break;
+    p_th->b_probing = false;
+
+    if( p_th->p_es == NULL )
+    {
+        msg_Err( p_th, "no decodable video track" );
+        goto error;
+    }
+    return p_th;
+
+error:
+    vlc_thumbnailer_Delete( p_th );
+    return NULL;
+}
+
+void vlc_thumbnailer_Delete( vlc_thumbnailer_t *p_th )
+{
+    if( p_th->p_demux != NULL )
+        demux_Delete( p_th->p_demux );
+    CloseDecoder( p_th );
+    for( int i = 0; i < p_th->i_es_all; i++ )
+        free( p_th->pp_es_all[i] );
+    TAB_CLEAN( p_th->i_es_all, p_th->pp_es_all );
+    if( p_th->p_image != NULL )
+        image_HandlerDelete( p_th->p_image );
+    vlc_object_release( p_th );
+}
+
+mtime_t vlc_thumbnailer_GetLength( vlc_thumbnailer_t *p_th )
+{
+    int64_t i_length;
+
+    if( demux_Control( p_th->p_demux, DEMUX_GET_LENGTH,
+                       &i_length ) != VLC_SUCCESS )
+        return 0;
+    return i_length;
+}
+
+picture_t *vlc_thumbnailer_GetPicture( vlc_thumbnailer_t *p_th, mtime_t i_time,
+                                       video_format_t *p_fmt )
+{
+    picture_t *p_pic = Extract( p_th, i_time );
+    if( p_pic == NULL || p_fmt == NULL )
+        return p_pic;
+
+    picture_t *p_out = Convert( p_th, p_pic, p_fmt );
+    picture_Release( p_pic );
+    return p_out;
+}
+
+block_t *vlc_thumbnailer_GetImage( vlc_thumbnailer_t *p_th, mtime_t i_time,
+                                   vlc_fourcc_t i_codec, unsigned i_width,
+                                   unsigned i_height )
+{
+    picture_t *p_pic = Extract( p_th, i_time );
+    if( p_pic == NULL )
+        return NULL;
+
+    video_format_t fmt_in = SourceFormat( p_pic );
+    video_format_t fmt_out;
+
+    video_format_Init( &fmt_out, i_codec );
+    fmt_out.i_width = i_width;
+    fmt_out.i_height = i_height;
+    SetupFormat( &fmt_in, &fmt_out );
+
+    block_t *p_block = image_Write( p_th->p_image, p_pic, &fmt_in, &fmt_out );
+    if( p_block != NULL )
+        p_block->i_pts = p_block->i_dts = p_pic->date;
+    picture_Release( p_pic );
+    return p_block;
+}
+
+struct storyboard_entry
+{
+    mtime_t  i_time;
+    unsigned i_index;
+};
+
+static int StoryboardCompare( const void *a, const void *b )
+{
+    const struct storyboard_entry *p_a = a, *p_b = b;
+
+    if( p_a->i_time != p_b->i_time )
+        return p_a->i_time < p_b->i_time ? -1 : 1;
+    return 0;
+}
+
+unsigned vlc_thumbnailer_GetStoryboard( vlc_thumbnailer_t *p_th,
+                                        const mtime_t *pi_times,
+                                        unsigned i_count,
+                                        video_format_t *p_fmt,
+                                        picture_t **pp_pictures )
+{
+    struct storyboard_entry *p_entries = malloc( i_count * sizeof( *p_entries ) );
+    unsigned i_done = 0;
+
+    for( unsigned i = 0; i < i_count; i++ )
+        pp_pictures[i] = NULL;
+    if( unlikely(p_entries == NULL) )
+        return 0;
+
+    /* Visit the times in order so that the demuxer moves forward */
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        p_entries[i].i_time = pi_times[i];
+        p_entries[i].i_index = i;
+    }
+    qsort( p_entries, i_count, sizeof( *p_entries ), StoryboardCompare );
+
+    picture_t *p_prev = NULL, *p_prev_out = NULL;
+    video_format_t fmt_out;
+
+    video_format_Init( &fmt_out, 0 );
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        picture_t *p_pic = Extract( p_th, p_entries[i].i_time );
+        if( p_pic == NULL )
+            continue;
+
+        picture_t *p_out;
+        if( p_pic == p_prev && p_prev_out != NULL )
+            /* Same keyframe as the previous time: share the picture */
+            p_out = picture_Hold( p_prev_out );
+        else if( p_fmt != NULL )
+        {
+            video_format_t fmt = *p_fmt;
+
+            p_out = Convert( p_th, p_pic, &fmt );
+            if( p_out != NULL )
+                fmt_out = fmt;
+        }
+        else
+            p_out = picture_Hold( p_pic );
+
+        if( p_prev != NULL )
+            picture_Release( p_prev );
+        p_prev = p_pic;
+        if( p_prev_out != NULL )
+            picture_Release( p_prev_out );
+        p_prev_out = p_out != NULL ? picture_Hold( p_out ) : NULL;
+
+        if( p_out == NULL )
+            continue;
+        pp_pictures[p_entries[i].i_index] = p_out;
+        i_done++;
+    }
+
+    if( p_prev != NULL )
+        picture_Release( p_prev );
+    if( p_prev_out != NULL )
+        picture_Release( p_prev_out );
+    free( p_entries );
+
+    if( p_fmt != NULL && i_done > 0 )
+        *p_fmt = fmt_out;
+    return i_done;
+}
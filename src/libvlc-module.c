@@ -85,6 +85,13 @@ static const char *const ppsz_snap_formats[] =
     "This is the verbosity level (0=only errors and " \
     "standard messages, 1=warnings, 2=debug).")
 
+#define LOG_ASYNC_TEXT N_("Asynchronous logging")
+#define LOG_ASYNC_LONGTEXT N_( \
+    "Log messages are queued by the emitting threads and written by a " \
+    "background thread, so that logging does not slow real-time threads " \
+    "down. Messages above the verbosity level are discarded, and messages " \
+    "are dropped (and counted) if a thread emits them too fast.")
+
 #define OPEN_TEXT N_("Default stream")
 #define OPEN_LONGTEXT N_( \
     "This stream will always be opened at VLC startup." )
@@ -530,6 +537,13 @@ static const char *const ppsz_pos_descriptions[] =
     "This defines the maximum input delay jitter that the synchronization " \
     "algorithms should try to compensate (in milliseconds)." )
 
+#define DECODER_BATCH_DELAY_TEXT N_("Decoder wake-up delay")
+#define DECODER_BATCH_DELAY_LONGTEXT N_( \
+    "Maximum time (in milliseconds) a decoder waits for more data before " \
+    "waking up. Decoding a few small packets at once saves CPU with high " \
+    "packet rate streams, at the expense of latency. 0 wakes up the " \
+    "decoder for every packet.")
+
 #define NETSYNC_TEXT N_("Network synchronisation" )
 #define NETSYNC_LONGTEXT N_( "This allows you to remotely " \
         "synchronise clocks for server and client. The detailed settings " \
@@ -643,6 +657,12 @@ static const char *const ppsz_prefres[] = {
 #define INPUT_FAST_SEEK_LONGTEXT N_( \
     "Favor speed over precision while seeking" )
 
+#define INPUT_TRICKPLAY_RATE_TEXT N_("Keyframe-only playback speed")
+#define INPUT_TRICKPLAY_RATE_LONGTEXT N_( \
+    "Above this playback speed, only the video keyframes are decoded and " \
+    "the audio is muted. Demuxers with an index skip directly from " \
+    "keyframe to keyframe (0 disables)." )
+
 #define INPUT_RATE_TEXT N_("Playback speed")
 #define INPUT_RATE_LONGTEXT N_( \
     "This defines the playback speed (nominal speed is 1.0)." )
@@ -1115,6 +1135,26 @@ static const char *const ppsz_prefres[] = {
 #define PREPARSE_TIMEOUT_LONGTEXT N_( \
     "Maximum time allowed to preparse a file" )
 
+#define PREPARSE_THREADS_TEXT N_( "Preparsing threads" )
+#define PREPARSE_THREADS_LONGTEXT N_( \
+    "Maximum number of files preparsed concurrently." )
+
+#define PREPARSE_CACHE_TEXT N_( "Cache preparsed meta data" )
+#define PREPARSE_CACHE_LONGTEXT N_( \
+    "Store the duration, tracks and meta data of preparsed local files " \
+    "on disk, so that they are not opened again as long as they are not " \
+    "modified." )
+
+#define PREPARSE_CACHE_SIZE_TEXT N_( "Preparsed meta data cache size" )
+#define PREPARSE_CACHE_SIZE_LONGTEXT N_( \
+    "Maximum number of files kept in the preparsed meta data cache. " \
+    "The oldest entries are removed first." )
+
+#define FETCH_ART_THREADS_TEXT N_( "Art fetching threads" )
+#define FETCH_ART_THREADS_LONGTEXT N_( \
+    "Maximum number of items whose meta data and art are fetched " \
+    "concurrently." )
+
 #define METADATA_NETWORK_TEXT N_( "Allow metadata network access" )
 
 #define SD_TEXT N_( "Services discovery modules")
@@ -1730,6 +1770,10 @@ vlc_module_begin ()
     add_bool( "input-fast-seek", false,
               INPUT_FAST_SEEK_TEXT, INPUT_FAST_SEEK_LONGTEXT, false )
         change_safe ()
+    add_float( "input-trickplay-rate", 4.,
+               INPUT_TRICKPLAY_RATE_TEXT, INPUT_TRICKPLAY_RATE_LONGTEXT, true )
+        change_float_range( 0., 64. )
+        change_safe ()
     add_float( "rate", 1.,
                INPUT_RATE_TEXT, INPUT_RATE_LONGTEXT, false )
 
@@ -1864,6 +1908,10 @@ vlc_module_begin ()
     add_integer( "clock-jitter", 5 * CLOCK_FREQ/1000, CLOCK_JITTER_TEXT,
               CLOCK_JITTER_LONGTEXT, true )
         change_safe()
+    add_integer( "decoder-batch-delay", 0, DECODER_BATCH_DELAY_TEXT,
+                 DECODER_BATCH_DELAY_LONGTEXT, true )
+        change_integer_range( 0, 1000 )
+        change_safe()
 
     add_bool( "network-synchronisation", false, NETSYNC_TEXT,
               NETSYNC_LONGTEXT, true )
@@ -2058,6 +2106,20 @@ vlc_module_begin ()
     add_integer( "preparse-timeout", 5000, PREPARSE_TIMEOUT_TEXT,
                  PREPARSE_TIMEOUT_LONGTEXT, false )
 
+    add_integer_with_range( "preparse-threads", 1, 1, 32,
+                            PREPARSE_THREADS_TEXT,
+                            PREPARSE_THREADS_LONGTEXT, true )
+
+    add_bool( "preparse-cache", false, PREPARSE_CACHE_TEXT,
+              PREPARSE_CACHE_LONGTEXT, true )
+    add_integer_with_range( "preparse-cache-size", 10000, 1, 1000000,
+                            PREPARSE_CACHE_SIZE_TEXT,
+                            PREPARSE_CACHE_SIZE_LONGTEXT, true )
+
+    add_integer_with_range( "fetch-art-threads", 1, 1, 32,
+                            FETCH_ART_THREADS_TEXT,
+                            FETCH_ART_THREADS_LONGTEXT, true )
+
     add_obsolete_integer( "album-art" )
     add_bool( "metadata-network-access", false, METADATA_NETWORK_TEXT,
                  METADATA_NETWORK_TEXT, false )
@@ -2073,6 +2135,7 @@ vlc_module_begin ()
                  false )
         change_short('v')
         change_volatile ()
+    add_bool( "log-async", false, LOG_ASYNC_TEXT, LOG_ASYNC_LONGTEXT, true )
     add_obsolete_string( "verbose-objects" ) /* since 2.1.0 */
 #if !defined(_WIN32) && !defined(__OS2__)
     add_bool( "daemon", 0, DAEMON_TEXT, DAEMON_LONGTEXT, true )
@@ -0,0 +1,350 @@
+/*****************************************************************************
+ * background_worker.c: pool of threads processing queued tasks
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_arrays.h>
+#include <vlc_interrupt.h>
+
+#include "libvlc.h"
+#include "background_worker.h"
+
+/* How long an idle thread waits for a new task before exiting */
+#define BG_WORKER_LINGER (CLOCK_FREQ / 2)
+
+struct bg_task
+{
+    struct bg_task *p_prev;
+    struct bg_task *p_next;
+    void *entity;
+    void *id;
+    int timeout;
+    int priority;
+};
+
+/* State of a task being processed by a worker thread */
+struct bg_running
+{
+    void *id;
+    vlc_interrupt_t *interrupt;
+    bool b_cancel;
+};
+
+struct background_worker
+{
+    void *owner;
+    struct background_worker_config conf;
+
+    vlc_mutex_t lock;
+    vlc_cond_t queue_wait;  /**< signaled when a task is queued */
+    vlc_cond_t probe_wait;  /**< broadcast when running tasks must be probed */
+    vlc_cond_t exit_wait;   /**< signaled when a thread exits */
+
+    struct bg_task *p_head;
+    struct bg_task *p_tail;
+    size_t i_queued;
+
+    vlc_array_t running;    /**< struct bg_running * */
+    unsigned i_threads;
+    unsigned i_idle;
+    bool b_closing;
+};
+
+static void *Thread( void * );
+
+/*****************************************************************************
+ * Queue helpers (called with the lock held)
+ *****************************************************************************/
+static void QueueInsert( struct background_worker *worker,
+                         struct bg_task *task )
+{
+    /* Pushes usually come with the same priority: start from the tail so
+     * that appending stays cheap with large queues. */
+    struct bg_task *prev = worker->p_tail;
+    while( prev != NULL && prev->priority < task->priority )
+        prev = prev->p_prev;
+
+    worker->i_queued++;
+    task->p_prev = prev;
+    task->p_next = prev != NULL ? prev->p_next : worker->p_head;
+    if( task->p_next != NULL )
+        task->p_next->p_prev = task;
+    else
+        worker->p_tail = task;
+    if( prev != NULL )
+        prev->p_next = task;
+    else
+        worker->p_head = task;
+}
+
+static void QueueRemove( struct background_worker *worker,
+                         struct bg_task *task )
+{
+    worker->i_queued--;
+    if( task->p_prev != NULL )
+        task->p_prev->p_next = task->p_next;
+    else
+        worker->p_head = task->p_next;
+    if( task->p_next != NULL )
+        task->p_next->p_prev = task->p_prev;
+    else
+        worker->p_tail = task->p_prev;
+}
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+struct background_worker *background_worker_New( void *owner,
+    const struct background_worker_config *conf )
+{
+    struct background_worker *worker = malloc( sizeof(*worker) );
+    if( unlikely(worker == NULL) )
+        return NULL;
+
+    assert( conf->pf_release != NULL && conf->pf_start != NULL );
+    assert( (conf->pf_probe == NULL) == (conf->pf_stop == NULL) );
+
+    worker->owner = owner;
+    worker->conf = *conf;
+    if( worker->conf.max_threads == 0 )
+        worker->conf.max_threads = 1;
+
+    vlc_mutex_init( &worker->lock );
+    vlc_cond_init( &worker->queue_wait );
+    vlc_cond_init( &worker->probe_wait );
+    vlc_cond_init( &worker->exit_wait );
+
+    worker->p_head = worker->p_tail = NULL;
+    worker->i_queued = 0;
+    vlc_array_init( &worker->running );
+    worker->i_threads = 0;
+    worker->i_idle = 0;
+    worker->b_closing = false;
+
+    return worker;
+}
+
+int background_worker_Push( struct background_worker *worker, void *entity,
+                            void *id, int timeout, int priority )
+{
+    struct bg_task *task = malloc( sizeof(*task) );
+    if( unlikely(task == NULL) )
+        return VLC_ENOMEM;
+
+    task->entity = entity;
+    task->id = id;
+    task->timeout = timeout < 0 ? worker->conf.default_timeout : timeout;
+    task->priority = priority;
+
+    vlc_mutex_lock( &worker->lock );
+    if( unlikely(worker->b_closing) )
+    {
+        vlc_mutex_unlock( &worker->lock );
+        free( task );
+        return VLC_EGENERIC;
+    }
+    QueueInsert( worker, task );
+
+    vlc_cond_signal( &worker->queue_wait );
+    if( worker->i_queued > worker->i_idle
+     && worker->i_threads < worker->conf.max_threads )
+    {
+        if( vlc_clone_detach( NULL, Thread, worker,
+                              VLC_THREAD_PRIORITY_LOW ) == 0 )
+            worker->i_threads++;
+        else if( worker->i_threads == 0 )
+        {
+            QueueRemove( worker, task );
+            vlc_mutex_unlock( &worker->lock );
+            free( task );
+            return VLC_EGENERIC;
+        }
+    }
+    vlc_mutex_unlock( &worker->lock );
+    return VLC_SUCCESS;
+}
+
+void background_worker_Cancel( struct background_worker *worker, void *id )
+{
+    struct bg_task *cancelled = NULL;
+
+    vlc_mutex_lock( &worker->lock );
+    for( struct bg_task *task = worker->p_head, *next; task != NULL;
+         task = next )
+    {
+        next = task->p_next;
+        if( id == NULL || task->id == id )
+        {
+            QueueRemove( worker, task );
+            task->p_next = cancelled;
+            cancelled = task;
+        }
+    }
+
+    for( int i = 0; i < vlc_array_count( &worker->running ); ++i )
+    {
+        struct bg_running *run = vlc_array_item_at_index( &worker->running, i );
+        if( id == NULL || run->id == id )
+        {
+            run->b_cancel = true;
+            vlc_interrupt_kill( run->interrupt );
+        }
+    }
+    vlc_cond_broadcast( &worker->probe_wait );
+    vlc_mutex_unlock( &worker->lock );
+
+    while( cancelled != NULL )
+    {
+        struct bg_task *next = cancelled->p_next;
+        worker->conf.pf_release( cancelled->entity );
+        free( cancelled );
+        cancelled = next;
+    }
+}
+
+void background_worker_RequestProbe( struct background_worker *worker )
+{
+    vlc_mutex_lock( &worker->lock );
+    vlc_cond_broadcast( &worker->probe_wait );
+    vlc_mutex_unlock( &worker->lock );
+}
+
+void background_worker_Delete( struct background_worker *worker )
+{
+    vlc_mutex_lock( &worker->lock );
+    worker->b_closing = true;
+    vlc_cond_broadcast( &worker->queue_wait );
+    vlc_mutex_unlock( &worker->lock );
+
+    background_worker_Cancel( worker, NULL );
+
+    vlc_mutex_lock( &worker->lock );
+    while( worker->i_threads > 0 )
+        vlc_cond_wait( &worker->exit_wait, &worker->lock );
+    vlc_mutex_unlock( &worker->lock );
+
+    assert( worker->p_head == NULL );
+    assert( vlc_array_count( &worker->running ) == 0 );
+    vlc_array_clear( &worker->running );
+
+    vlc_cond_destroy( &worker->exit_wait );
+    vlc_cond_destroy( &worker->probe_wait );
+    vlc_cond_destroy( &worker->queue_wait );
+    vlc_mutex_destroy( &worker->lock );
+    free( worker );
+}
+
+/*****************************************************************************
+ * Privates functions
+ *****************************************************************************/
+
+/**
+ * Waits for a running task to end, to time out or to be cancelled.
+ * Called with the lock held.
+ */
+static void WaitTask( struct background_worker *worker,
+                      struct bg_running *run, void *handle, int timeout )
+{
+    mtime_t deadline = timeout > 0 ? mdate() + timeout * INT64_C(1000) : 0;
+
+    while( !run->b_cancel
+        && !worker->conf.pf_probe( worker->owner, handle ) )
+    {
+        if( deadline == 0 )
+            vlc_cond_wait( &worker->probe_wait, &worker->lock );
+        else if( vlc_cond_timedwait( &worker->probe_wait, &worker->lock,
+                                     deadline ) )
+            break; /* timeout */
+    }
+}
+
+static void *Thread( void *data )
+{
+    struct background_worker *worker = data;
+
+    vlc_mutex_lock( &worker->lock );
+    for( ;; )
+    {
+        if( worker->p_head == NULL && !worker->b_closing )
+        {
+            mtime_t deadline = mdate() + BG_WORKER_LINGER;
+
+            worker->i_idle++;
+            while( worker->p_head == NULL && !worker->b_closing )
+                if( vlc_cond_timedwait( &worker->queue_wait, &worker->lock,
+                                        deadline ) )
+                    break;
+            worker->i_idle--;
+        }
+
+        struct bg_task *task = worker->p_head;
+        if( task == NULL || worker->b_closing )
+            break;
+        QueueRemove( worker, task );
+
+        struct bg_running run = {
+            .id = task->id,
+            .interrupt = vlc_interrupt_create(),
+            .b_cancel = false,
+        };
+        if( unlikely(run.interrupt == NULL) )
+        {
+            vlc_mutex_unlock( &worker->lock );
+            worker->conf.pf_release( task->entity );
+            free( task );
+            vlc_mutex_lock( &worker->lock );
+            continue;
+        }
+        vlc_array_append( &worker->running, &run );
+        vlc_mutex_unlock( &worker->lock );
+
+        vlc_interrupt_set( run.interrupt );
+
+        void *handle;
+        if( worker->conf.pf_start( worker->owner, task->entity,
+                                   &handle ) == VLC_SUCCESS
+         && worker->conf.pf_probe != NULL )
+        {
+            vlc_mutex_lock( &worker->lock );
+            WaitTask( worker, &run, handle, task->timeout );
+            vlc_mutex_unlock( &worker->lock );
+
+            worker->conf.pf_stop( worker->owner, handle );
+        }
+
+        vlc_interrupt_set( NULL );
+        worker->conf.pf_release( task->entity );
+        free( task );
+
+        vlc_mutex_lock( &worker->lock );
+        vlc_array_remove( &worker->running,
+                          vlc_array_index_of_item( &worker->running, &run ) );
+        vlc_interrupt_destroy( run.interrupt );
+    }
+
+    worker->i_threads--;
+    vlc_cond_signal( &worker->exit_wait );
+    vlc_mutex_unlock( &worker->lock );
+    return NULL;
+}
@@ -0,0 +1,134 @@
+/*****************************************************************************
+ * background_worker.h: pool of threads processing queued tasks
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef LIBVLC_BACKGROUND_WORKER_H
+#define LIBVLC_BACKGROUND_WORKER_H 1
+
+/**
+ * Background worker opaque structure.
+ *
+ * A background worker processes pushed entities on a bounded pool of low
+ * priority threads. Threads are spawned on demand and exit when the queue
+ * has been idle for a while.
+ */
+struct background_worker;
+
+struct background_worker_config {
+    /**
+     * Default timeout (in milliseconds) of a task, used when the task is
+     * pushed with a negative timeout. 0 means no timeout.
+     */
+    int default_timeout;
+
+    /**
+     * Maximum number of tasks processed concurrently (at least 1).
+     */
+    unsigned max_threads;
+
+    /**
+     * Release an entity
+     *
+     * Called once for each entity successfully pushed, when the worker is
+     * done with it (processed, cancelled or flushed).
+     */
+    void( *pf_release )( void *entity );
+
+    /**
+     * Start a new task
+     *
+     * Called from a worker thread, with the thread interruption context set.
+     * If \ref pf_probe is NULL, the task is processed synchronously and is
+     * considered finished on return.
+     *
+     * \param owner the owner passed to background_worker_New()
+     * \param entity the entity to process
+     * \param out [out] opaque handle of the running task
+     * \return VLC_SUCCESS if the task was started
+     */
+    int( *pf_start )( void *owner, void *entity, void **out );
+
+    /**
+     * Probe a running task
+     *
+     * Called with the worker lock held: it must not block. The owner shall
+     * call background_worker_RequestProbe() whenever the state of a task
+     * may have changed.
+     *
+     * \return 0 while the task is still running, non-zero when it ended
+     */
+    int( *pf_probe )( void *owner, void *handle );
+
+    /**
+     * Stop a task
+     *
+     * Called once the task ended, timed out or was cancelled. The handle
+     * shall be released.
+     */
+    void( *pf_stop )( void *owner, void *handle );
+};
+
+/**
+ * Creates a background worker
+ *
+ * \param owner opaque pointer passed to the callbacks
+ * \param conf configuration (copied)
+ */
+struct background_worker *background_worker_New( void *owner,
+    const struct background_worker_config *conf );
+
+/**
+ * Pushes an entity to be processed
+ *
+ * Entities are processed in decreasing priority order, then in the order
+ * they were pushed.
+ *
+ * \param entity the entity, released with pf_release once processed
+ * \param id request id, that can be used with background_worker_Cancel()
+ * \param timeout timeout in milliseconds: -1 for the default timeout, 0 for
+ * no timeout
+ * \param priority priority of the request
+ * \return VLC_SUCCESS, or an error if the entity was not queued (and not
+ * released)
+ */
+int background_worker_Push( struct background_worker *, void *entity,
+                            void *id, int timeout, int priority );
+
+/**
+ * Cancels pending and running tasks matching an id
+ *
+ * \param id request id, or NULL to cancel all requests
+ */
+void background_worker_Cancel( struct background_worker *, void *id );
+
+/**
+ * Wakes up the worker threads waiting on running tasks, so that they call
+ * pf_probe again.
+ */
+void background_worker_RequestProbe( struct background_worker * );
+
+/**
+ * Deletes a background worker
+ *
+ * Pending entities are released and running tasks are cancelled; the
+ * function returns once all worker threads have exited.
+ */
+void background_worker_Delete( struct background_worker * );
+
+#endif
@@ -41,8 +41,11 @@
 #include <vlc_interface.h>
 #include <vlc_charset.h>
 #include <vlc_modules.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
+typedef struct vlc_log_async_t vlc_log_async_t;
+
 struct vlc_logger_t
 {
     VLC_COMMON_MEMBERS
@@ -50,8 +53,15 @@ struct vlc_logger_t
     vlc_log_cb log;
     void *sys;
     module_t *module;
+    atomic_uintptr_t async; /**< asynchronous logging, or 0 */
+    atomic_uint async_users; /**< threads pushing to async */
+    vlc_mutex_t async_lock;
+    vlc_cond_t async_wait; /**< signaled when async_users drops to 0 */
 };
 
+static void vlc_LogAsyncPush(vlc_log_async_t *, int, const vlc_log_t *,
+                             const char *, va_list);
+
 static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
                               const vlc_log_t *item, const char *format,
                               va_list ap)
@@ -61,9 +71,27 @@ static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
 
     assert(logger != NULL);
     canc = vlc_savecancel();
-    vlc_rwlock_rdlock(&logger->lock);
-    logger->log(logger->sys, type, item, format, ap);
-    vlc_rwlock_unlock(&logger->lock);
+
+    /* The asynchronous pipeline is not protected by the logger lock: it
+     * cannot be stopped while a thread is registered as pushing to it. */
+    atomic_fetch_add(&logger->async_users, 1);
+    vlc_log_async_t *async = (vlc_log_async_t *)atomic_load(&logger->async);
+    if (async != NULL)
+        vlc_LogAsyncPush(async, type, item, format, ap);
+    if (atomic_fetch_sub(&logger->async_users, 1) == 1
+     && atomic_load(&logger->async) == 0)
+    {   /* The pipeline is being stopped and waits for us */
+        vlc_mutex_lock(&logger->async_lock);
+        vlc_cond_signal(&logger->async_wait);
+        vlc_mutex_unlock(&logger->async_lock);
+    }
+
+    if (async == NULL)
+    {
+        vlc_rwlock_rdlock(&logger->lock);
+        logger->log(logger->sys, type, item, format, ap);
+        vlc_rwlock_unlock(&logger->lock);
+    }
     vlc_restorecancel(canc);
 }
 
@@ -292,6 +320,362 @@ static void vlc_vaLogDiscard(void *d, int type, const vlc_log_t *item,
     (void) d; (void) type; (void) item; (void) format; (void) ap;
 }
 
+/*
+ * Asynchronous logging
+ *
+ * Each emitting thread renders its messages into its own single-producer
+ * single-consumer ring of records, without locking nor blocking. Messages
+ * above the highest verbosity that the log callback may output are discarded
+ * before being formatted; the callback filters the others as it would
+ * synchronously. A background thread drains the rings to the logger callback. If a ring is
+ * full, the message is dropped and counted.
+ */
+#define LOG_RING_SIZE 128 /* records per thread, power of two */
+#define LOG_TEXT_SIZE 256 /* inline storage, longer messages are allocated */
+#define LOG_DRAIN_PERIOD (CLOCK_FREQ / 20)
+
+typedef struct
+{
+    int type;
+    vlc_log_t meta; /* module and header point into the text storage */
+    char *text; /**< formatted message, in buf or allocated */
+    char buf[LOG_TEXT_SIZE]; /* module, header and text, nul-separated */
+} vlc_log_record_t;
+
+typedef struct vlc_log_ring_t
+{
+    struct vlc_log_ring_t *next;
+    atomic_uint head; /**< next record to write (producer) */
+    atomic_uint tail; /**< next record to read (consumer) */
+    atomic_bool dead; /**< the producer thread exited */
+    vlc_log_record_t records[LOG_RING_SIZE];
+} vlc_log_ring_t;
+
+struct vlc_log_async_t
+{
+    vlc_logger_t *logger;
+    atomic_int verbosity; /**< highest message type to keep */
+    vlc_threadvar_t key; /**< ring of the calling thread */
+
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    vlc_log_ring_t *rings;
+    bool exit;
+    vlc_thread_t thread;
+
+    atomic_ulong dropped;
+    unsigned long reported;
+};
+
+/**
+ * Formats a message into a record, in the inline storage if it fits.
+ * \return 0 on success, -1 on error
+ */
+static int vlc_LogRecordFormat(vlc_log_record_t *rec, const vlc_log_t *item,
+                               const char *format, va_list ap)
+{
+    size_t modlen = strlen(item->psz_module) + 1;
+    size_t hdrlen = (item->psz_header != NULL)
+                  ? strlen(item->psz_header) + 1 : 0;
+    size_t offset = modlen + hdrlen;
+    char *buf = rec->buf;
+    int len = -1;
+    va_list aq;
+
+    if (offset < sizeof (rec->buf))
+    {
+        va_copy(aq, ap);
+        len = vsnprintf(rec->buf + offset, sizeof (rec->buf) - offset,
+                        format, aq);
+        va_end(aq);
+        if (len < 0)
+            return -1;
+    }
+
+    if (len < 0 || offset + len >= sizeof (rec->buf))
+    {   /* Too long for the record */
+        if (len < 0)
+        {
+            va_copy(aq, ap);
+            len = vsnprintf(NULL, 0, format, aq);
+            va_end(aq);
+            if (len < 0)
+                return -1;
+        }
+
+        buf = malloc(offset + len + 1);
+        if (unlikely(buf == NULL))
+            return -1;
+        vsnprintf(buf + offset, len + 1, format, ap);
+    }
+
+    memcpy(buf, item->psz_module, modlen);
+    if (hdrlen > 0)
+        memcpy(buf + modlen, item->psz_header, hdrlen);
+
+    rec->meta = *item;
+    rec->meta.psz_module = buf;
+    rec->meta.psz_header = (hdrlen > 0) ? buf + modlen : NULL;
+    rec->text = buf + offset;
+    return 0;
+}
+
+static void vlc_LogRecordClean(vlc_log_record_t *rec)
+{
+    if (rec->meta.psz_module != rec->buf)
+        free((char *)rec->meta.psz_module);
+}
+
+static void vlc_LogAsyncPush(vlc_log_async_t *async, int type,
+                             const vlc_log_t *item, const char *format,
+                             va_list ap)
+{
+    /* Filter before doing anything else */
+    if (type > atomic_load_explicit(&async->verbosity, memory_order_relaxed))
+        return;
+
+    vlc_log_ring_t *ring = vlc_threadvar_get(async->key);
+    if (unlikely(ring == NULL))
+    {   /* First message from this thread */
+        ring = malloc(sizeof (*ring));
+        if (unlikely(ring == NULL))
+        {
+            atomic_fetch_add(&async->dropped, 1);
+            return;
+        }
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->dead, false);
+        vlc_threadvar_set(async->key, ring);
+
+        vlc_mutex_lock(&async->lock);
+        ring->next = async->rings;
+        async->rings = ring;
+        vlc_mutex_unlock(&async->lock);
+    }
+
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_SIZE)
+    {
+        atomic_fetch_add(&async->dropped, 1);
+        return;
+    }
+
+    vlc_log_record_t *rec = &ring->records[head % LOG_RING_SIZE];
+
+    rec->type = type;
+    if (vlc_LogRecordFormat(rec, item, format, ap))
+    {
+        atomic_fetch_add(&async->dropped, 1);
+        return;
+    }
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    /* Do not wait for the next period if the ring fills up */
+    if (head - tail == LOG_RING_SIZE / 2)
+        vlc_cond_signal(&async->wait);
+}
+
+static void vlc_LogAsyncOutput(vlc_logger_t *logger, int type,
+                               const vlc_log_t *meta, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    vlc_rwlock_rdlock(&logger->lock);
+    logger->log(logger->sys, type, meta, format, ap);
+    vlc_rwlock_unlock(&logger->lock);
+    va_end(ap);
+}
+
+/**
+ * Writes the queued messages to the logger.
+ * Only called from the background thread, or once it was joined.
+ */
+static void vlc_LogAsyncDrain(vlc_log_async_t *async)
+{
+    vlc_logger_t *logger = async->logger;
+
+    /* Rings are prepended by producers, and only removed here: the rings
+     * following the snapshotted head cannot change under our feet. */
+    vlc_mutex_lock(&async->lock);
+    vlc_log_ring_t *ring = async->rings;
+    vlc_mutex_unlock(&async->lock);
+
+    while (ring != NULL)
+    {
+        vlc_log_ring_t *next = ring->next;
+        unsigned tail = atomic_load_explicit(&ring->tail,
+                                             memory_order_relaxed);
+        bool dead = atomic_load_explicit(&ring->dead, memory_order_acquire);
+        unsigned head = atomic_load_explicit(&ring->head,
+                                             memory_order_acquire);
+
+        for (; tail != head; tail++)
+        {
+            vlc_log_record_t *rec = &ring->records[tail % LOG_RING_SIZE];
+
+            vlc_LogAsyncOutput(logger, rec->type, &rec->meta, "%s",
+                               rec->text);
+            vlc_LogRecordClean(rec);
+            atomic_store_explicit(&ring->tail, tail + 1,
+                                  memory_order_release);
+        }
+
+        if (dead)
+        {   /* The thread exited after its last message: forget the ring */
+            vlc_mutex_lock(&async->lock);
+            vlc_log_ring_t **pp = &async->rings;
+            while (*pp != ring)
+                pp = &(*pp)->next;
+            *pp = next;
+            vlc_mutex_unlock(&async->lock);
+            free(ring);
+        }
+        ring = next;
+    }
+
+    unsigned long dropped = atomic_load(&async->dropped);
+    if (dropped != async->reported)
+    {
+        vlc_log_t meta = {
+            .i_object_id = (uintptr_t)logger,
+            .psz_object_type = "logger",
+            .psz_module = "core",
+            .tid = vlc_thread_id(),
+        };
+
+        vlc_LogAsyncOutput(logger, VLC_MSG_WARN, &meta,
+                           "%lu log message(s) dropped (%lu in total)",
+                           dropped - async->reported, dropped);
+        async->reported = dropped;
+    }
+}
+
+static void *vlc_LogAsyncThread(void *data)
+{
+    vlc_log_async_t *async = data;
+
+    vlc_mutex_lock(&async->lock);
+    while (!async->exit)
+    {
+        mutex_cleanup_push(&async->lock);
+        vlc_cond_timedwait(&async->wait, &async->lock,
+                           mdate() + LOG_DRAIN_PERIOD);
+        vlc_cleanup_pop();
+        vlc_mutex_unlock(&async->lock);
+
+        int canc = vlc_savecancel();
+        vlc_LogAsyncDrain(async);
+        vlc_restorecancel(canc);
+        vlc_mutex_lock(&async->lock);
+    }
+    vlc_mutex_unlock(&async->lock);
+    return NULL;
+}
+
+static void vlc_LogAsyncRingExit(void *data)
+{
+    vlc_log_ring_t *ring = data;
+
+    atomic_store_explicit(&ring->dead, true, memory_order_release);
+}
+
+/**
+ * Returns the highest message type that the log callback may output.
+ * Logger modules filter on the verbosity options; an application callback
+ * gets every message.
+ * Called with the logger lock held.
+ */
+static int vlc_LogVerbosity(vlc_logger_t *logger)
+{
+    if (logger->log == vlc_vaLogDiscard)
+        return VLC_MSG_INFO - 1;
+    if (logger->module == NULL)
+        return VLC_MSG_DBG;
+
+    const char *name = module_get_object(logger->module);
+    int verbose;
+
+    if (!strcmp(name, "console") || !strcmp(name, "android"))
+    {
+        const char *str = getenv("VLC_VERBOSE");
+
+        verbose = var_InheritInteger(logger, "verbose");
+        if (str != NULL)
+            verbose = __MAX(verbose, atoi(str));
+    }
+    else if (!strcmp(name, "file"))
+    {
+        verbose = var_InheritInteger(logger, "log-verbose");
+        if (verbose == -1)
+            verbose = var_InheritInteger(logger, "verbose");
+    }
+    else /* syslog, journal: filtered by the log system */
+        return VLC_MSG_DBG;
+
+    return (verbose >= 0) ? __MIN(verbose + VLC_MSG_ERR, VLC_MSG_DBG)
+                          : VLC_MSG_INFO - 1;
+}
+
+static vlc_log_async_t *vlc_LogAsyncStart(vlc_logger_t *logger)
+{
+    vlc_log_async_t *async = malloc(sizeof (*async));
+    if (unlikely(async == NULL))
+        return NULL;
+
+    async->logger = logger;
+    vlc_rwlock_rdlock(&logger->lock);
+    atomic_init(&async->verbosity, vlc_LogVerbosity(logger));
+    vlc_rwlock_unlock(&logger->lock);
+    if (vlc_threadvar_create(&async->key, vlc_LogAsyncRingExit))
+    {
+        free(async);
+        return NULL;
+    }
+    vlc_mutex_init(&async->lock);
+    vlc_cond_init(&async->wait);
+    async->rings = NULL;
+    async->exit = false;
+    atomic_init(&async->dropped, 0);
+    async->reported = 0;
+
+    if (vlc_clone(&async->thread, vlc_LogAsyncThread, async,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        vlc_cond_destroy(&async->wait);
+        vlc_mutex_destroy(&async->lock);
+        vlc_threadvar_delete(&async->key);
+        free(async);
+        return NULL;
+    }
+    return async;
+}
+
+static void vlc_LogAsyncStop(vlc_log_async_t *async)
+{
+    vlc_mutex_lock(&async->lock);
+    async->exit = true;
+    vlc_cond_signal(&async->wait);
+    vlc_mutex_unlock(&async->lock);
+    vlc_join(async->thread, NULL);
+
+    /* Flush the last messages */
+    vlc_LogAsyncDrain(async);
+
+    vlc_threadvar_delete(&async->key);
+    for (vlc_log_ring_t *ring = async->rings, *next; ring != NULL; ring = next)
+    {
+        next = ring->next;
+        free(ring);
+    }
+    vlc_cond_destroy(&async->wait);
+    vlc_mutex_destroy(&async->lock);
+    free(async);
+}
+
 static int vlc_logger_load(void *func, va_list ap)
 {
     vlc_log_cb (*activate)(vlc_object_t *, void **) = func;
@@ -330,6 +714,10 @@ int vlc_LogPreinit(libvlc_int_t *vlc)
         return -1;
 
     vlc_rwlock_init(&logger->lock);
+    atomic_init(&logger->async, 0);
+    atomic_init(&logger->async_users, 0);
+    vlc_mutex_init(&logger->async_lock);
+    vlc_cond_init(&logger->async_wait);
 
     if (vlc_LogEarlyOpen(logger))
     {
@@ -379,6 +767,15 @@ int vlc_LogInit(libvlc_int_t *vlc)
     if (early_sys != NULL)
         vlc_LogEarlyClose(logger, early_sys);
 
+    if (var_InheritBool(vlc, "log-async"))
+    {
+        vlc_log_async_t *async = vlc_LogAsyncStart(logger);
+
+        atomic_store(&logger->async, (uintptr_t)async);
+        if (async == NULL)
+            msg_Err(vlc, "cannot start asynchronous logging");
+    }
+
     return 0;
 }
 
@@ -407,6 +804,10 @@ void vlc_LogSet(libvlc_int_t *vlc, vlc_log_cb cb, void *opaque)
     logger->log = cb;
     logger->sys = opaque;
     logger->module = NULL;
+
+    vlc_log_async_t *async = (vlc_log_async_t *)atomic_load(&logger->async);
+    if (async != NULL)
+        atomic_store(&async->verbosity, vlc_LogVerbosity(logger));
     vlc_rwlock_unlock(&logger->lock);
 
     if (module != NULL)
@@ -426,6 +827,18 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
     if (unlikely(logger == NULL))
         return;
 
+    vlc_log_async_t *async =
+        (vlc_log_async_t *)atomic_exchange(&logger->async, 0);
+    if (async != NULL)
+    {
+        /* Wait for the threads still pushing to the pipeline */
+        vlc_mutex_lock(&logger->async_lock);
+        while (atomic_load(&logger->async_users) > 0)
+            vlc_cond_wait(&logger->async_wait, &logger->async_lock);
+        vlc_mutex_unlock(&logger->async_lock);
+        vlc_LogAsyncStop(async);
+    }
+
     if (logger->module != NULL)
         vlc_module_unload(logger->module, vlc_logger_unload, logger->sys);
     else
@@ -436,6 +849,8 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
         vlc_LogEarlyClose(logger, logger->sys);
     }
 
+    vlc_cond_destroy(&logger->async_wait);
+    vlc_mutex_destroy(&logger->async_lock);
     vlc_rwlock_destroy(&logger->lock);
     vlc_object_release(logger);
     libvlc_priv(vlc)->logger = NULL;
@@ -280,6 +280,63 @@ picture_t *picture_New( vlc_fourcc_t i_chroma, int i_width, int i_height, int i_
     return picture_NewFromFormat( &fmt );
 }
 
+static void picture_DestroyView( picture_t *p_picture )
+{
+    picture_priv_t *priv = (picture_priv_t *)p_picture;
+
+    picture_Release( priv->gc.opaque );
+    free( p_picture );
+}
+
+picture_t *picture_NewView( picture_t *p_src, const video_format_t *p_fmt,
+                            unsigned i_x, unsigned i_y )
+{
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( p_src->format.i_chroma );
+    if( p_dsc == NULL || p_dsc->plane_count == 0
+     || p_fmt->i_chroma != p_src->format.i_chroma )
+        return NULL;
+
+    assert( i_x + p_fmt->i_visible_width <= p_src->format.i_width );
+    assert( i_y + p_fmt->i_visible_height <= p_src->format.i_height );
+
+    picture_resource_t res = {
+        .p_sys = NULL,
+        .pf_destroy = picture_DestroyView,
+    };
+
+    for( int i = 0; i < p_src->i_planes; i++ )
+    {
+        const plane_t *p = &p_src->p[i];
+        const unsigned i_plane_x = i_x * p_dsc->p[i].w.num / p_dsc->p[i].w.den;
+        const unsigned i_plane_y = i_y * p_dsc->p[i].h.num / p_dsc->p[i].h.den;
+
+        if( i_plane_y >= (unsigned)p->i_lines )
+            return NULL;
+
+        res.p[i].p_pixels = p->p_pixels + i_plane_y * p->i_pitch
+                          + i_plane_x * p->i_pixel_pitch;
+        res.p[i].i_lines  = p->i_lines - i_plane_y;
+        res.p[i].i_pitch  = p->i_pitch;
+    }
+
+    picture_t *p_picture = picture_NewFromResource( p_fmt, &res );
+    if( unlikely(p_picture == NULL) )
+        return NULL;
+
+    picture_priv_t *priv = (picture_priv_t *)p_picture;
+    priv->gc.opaque = picture_Hold( p_src );
+    picture_CopyProperties( p_picture, p_src );
+    return p_picture;
+}
+
+bool picture_IsView( const picture_t *p_picture )
+{
+    const picture_priv_t *priv = (const picture_priv_t *)p_picture;
+
+    return priv->gc.destroy == picture_DestroyView;
+}
+
 /*****************************************************************************
  *
  *****************************************************************************/
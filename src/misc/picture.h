@@ -31,3 +31,9 @@ typedef struct
         void *opaque;
     } gc;
 } picture_priv_t;
+
+/**
+ * Checks whether a picture shares the pixels of another picture, i.e. if it
+ * was created with picture_NewView().
+ */
+bool picture_IsView(const picture_t *);
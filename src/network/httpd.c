@@ -148,6 +148,7 @@ struct httpd_client_t
     int     fd;
 
     bool    b_stream_mode;
+    bool    b_chunked;      /* answer body sent with chunked transfer coding */
     uint8_t i_state;
 
     mtime_t i_activity_date;
@@ -1201,6 +1202,7 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
+    cl->b_chunked = false;
 
     httpd_MsgInit(&cl->query);
     httpd_MsgInit(&cl->answer);
@@ -1580,6 +1582,39 @@ static void httpd_ClientRecv(httpd_client_t *cl)
         cl->i_activity_timeout = 0;
 }
 
+/* Frames the pending body of a chunked answer. The callback tells that the
+ * body is complete by resetting i_body_offset, the last chunk is then
+ * appended. */
+static void httpd_ClientChunk(httpd_client_t *cl)
+{
+    httpd_message_t *answer = &cl->answer;
+    bool b_last = answer->i_body_offset == 0;
+
+    if (!cl->b_chunked || (answer->i_body <= 0 && !b_last))
+        return;
+
+    /* hexadecimal size, two CRLF and the last chunk */
+    uint8_t *p_body = xmalloc(__MAX(answer->i_body, 0) + 8 + 4 + 5);
+    int i_body = 0;
+
+    if (answer->i_body > 0) {
+        i_body = sprintf((char *)p_body, "%x\r\n", answer->i_body);
+        memcpy(&p_body[i_body], answer->p_body, answer->i_body);
+        i_body += answer->i_body;
+        memcpy(&p_body[i_body], "\r\n", 2);
+        i_body += 2;
+    }
+    if (b_last) {
+        memcpy(&p_body[i_body], "0\r\n\r\n", 5);
+        i_body += 5;
+        cl->b_chunked = false;
+    }
+
+    free(answer->p_body);
+    answer->p_body = p_body;
+    answer->i_body = i_body;
+}
+
 static void httpd_ClientSend(httpd_client_t *cl)
 {
     int i_len;
@@ -1631,6 +1666,7 @@ static void httpd_ClientSend(httpd_client_t *cl)
 
                 cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
                                           &cl->answer, &cl->query);
+                httpd_ClientChunk(cl);
             }
 
             if (cl->answer.i_body > 0) {
@@ -1865,6 +1901,15 @@ static void httpdLoop(httpd_host_t *host)
                             else
                                 cl->i_buffer = -1;
 
+                            /* a chunked answer is streamed until the callback
+                             * resets the body offset */
+                            const char *psz_te = httpd_MsgGet(answer, "Transfer-Encoding");
+                            if (psz_te && !strcasecmp(psz_te, "chunked")) {
+                                cl->b_stream_mode = true;
+                                cl->b_chunked = true;
+                                httpd_ClientChunk(cl);
+                            }
+
                             /* only one url can answer */
                             answer = NULL;
                             if (!cl->url)
@@ -1908,6 +1953,8 @@ static void httpdLoop(httpd_host_t *host)
                     bool b_query = false;
 
                     cl->url = NULL;
+                    cl->b_stream_mode = false;
+                    cl->b_chunked = false;
                     if (psz_connection) {
                         b_connection = (strcasecmp(psz_connection, "Close") == 0);
                         b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
@@ -1956,6 +2003,7 @@ static void httpdLoop(httpd_host_t *host)
                 cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
                         &cl->answer, &cl->query);
                 if (cl->answer.i_type != HTTPD_MSG_NONE) {
+                    httpd_ClientChunk(cl);
                     /* we have new data, so re-enter send mode */
                     cl->i_buffer      = 0;
                     cl->p_buffer      = cl->answer.p_body;
@@ -37,6 +37,7 @@
 #include <vlc_interrupt.h>
 
 #include "libvlc.h"
+#include "misc/background_worker.h"
 #include "art.h"
 #include "fetcher.h"
 #include "input/input_interface.h"
@@ -67,25 +68,21 @@ struct fetcher_entry_t
 {
     input_item_t    *p_item;
     input_item_meta_request_option_t i_options;
-    fetcher_entry_t *p_next;
+    fetcher_pass_t   e_pass;
 };
 
 struct playlist_fetcher_t
 {
     vlc_object_t   *object;
-    vlc_mutex_t     lock;
-    vlc_cond_t      wait;
-    bool            b_live;
-    vlc_interrupt_t *interrupt;
-
-    fetcher_entry_t *p_waiting_head[PASS_COUNT];
-    fetcher_entry_t *p_waiting_tail[PASS_COUNT];
+    vlc_mutex_t     lock; /**< protects albums */
+    struct background_worker *worker;
 
     DECL_ARRAY(playlist_album_t) albums;
     meta_fetcher_scope_t e_scope;
 };
 
-static void *Thread( void * );
+static void ReleaseEntry( void * );
+static int  StartFetch( void *, void *, void ** );
 
 
 /*****************************************************************************
@@ -97,90 +94,69 @@ playlist_fetcher_t *playlist_fetcher_New( vlc_object_t *parent )
     if( !p_fetcher )
         return NULL;
 
-    p_fetcher->interrupt = vlc_interrupt_create();
-    if( unlikely(p_fetcher->interrupt == NULL) )
+    struct background_worker_config conf = {
+        .default_timeout = 0,
+        .max_threads = __MAX( var_InheritInteger( parent, "fetch-art-threads" ), 1 ),
+        .pf_release = ReleaseEntry,
+        .pf_start = StartFetch,
+        .pf_probe = NULL,
+        .pf_stop = NULL,
+    };
+
+    p_fetcher->worker = background_worker_New( p_fetcher, &conf );
+    if( unlikely(p_fetcher->worker == NULL) )
     {
         free( p_fetcher );
         return NULL;
     }
     p_fetcher->object = parent;
     vlc_mutex_init( &p_fetcher->lock );
-    vlc_cond_init( &p_fetcher->wait );
-    p_fetcher->b_live = false;
 
     if( var_InheritBool( parent, "metadata-network-access" ) )
         p_fetcher->e_scope = FETCHER_SCOPE_ANY;
     else
         p_fetcher->e_scope = FETCHER_SCOPE_LOCAL;
 
-    memset( p_fetcher->p_waiting_head, 0, PASS_COUNT * sizeof(fetcher_entry_t *) );
-    memset( p_fetcher->p_waiting_tail, 0, PASS_COUNT * sizeof(fetcher_entry_t *) );
-
     ARRAY_INIT( p_fetcher->albums );
 
     return p_fetcher;
 }
 
-void playlist_fetcher_Push( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
-                            input_item_meta_request_option_t i_options )
+static void PushEntry( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
+                       input_item_meta_request_option_t i_options,
+                       fetcher_pass_t e_pass )
 {
     fetcher_entry_t *p_entry = malloc( sizeof(fetcher_entry_t) );
     if ( !p_entry ) return;
 
     vlc_gc_incref( p_item );
     p_entry->p_item = p_item;
-    p_entry->p_next = NULL;
     p_entry->i_options = i_options;
-    vlc_mutex_lock( &p_fetcher->lock );
-    /* Append last */
-    if ( p_fetcher->p_waiting_head[PASS1_LOCAL] )
-        p_fetcher->p_waiting_tail[PASS1_LOCAL]->p_next = p_entry;
-    else
-        p_fetcher->p_waiting_head[PASS1_LOCAL] = p_entry;
-    p_fetcher->p_waiting_tail[PASS1_LOCAL] = p_entry;
+    p_entry->e_pass = e_pass;
 
-    if( !p_fetcher->b_live )
+    /* Network lookups are only done once all local ones are done */
+    if( background_worker_Push( p_fetcher->worker, p_entry, NULL, -1,
+                                PASS_COUNT - e_pass ) )
     {
-        assert( p_fetcher->p_waiting_head[PASS1_LOCAL] );
-        if( vlc_clone_detach( NULL, Thread, p_fetcher,
-                              VLC_THREAD_PRIORITY_LOW ) )
-            msg_Err( p_fetcher->object,
-                     "cannot spawn secondary preparse thread" );
-        else
-            p_fetcher->b_live = true;
+        msg_Err( p_fetcher->object,
+                 "cannot spawn secondary preparse thread" );
+        ReleaseEntry( p_entry );
     }
-    vlc_mutex_unlock( &p_fetcher->lock );
 }
 
-void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
+void playlist_fetcher_Push( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
+                            input_item_meta_request_option_t i_options )
 {
-    fetcher_entry_t *p_next;
-
-    vlc_interrupt_kill(p_fetcher->interrupt);
-
-    vlc_mutex_lock( &p_fetcher->lock );
-    /* Remove any left-over item, the fetcher will exit */
-    for ( int i_queue=0; i_queue<PASS_COUNT; i_queue++ )
-    {
-        while( p_fetcher->p_waiting_head[i_queue] )
-        {
-            p_next = p_fetcher->p_waiting_head[i_queue]->p_next;
-            vlc_gc_decref( p_fetcher->p_waiting_head[i_queue]->p_item );
-            free( p_fetcher->p_waiting_head[i_queue] );
-            p_fetcher->p_waiting_head[i_queue] = p_next;
-        }
-        p_fetcher->p_waiting_head[i_queue] = NULL;
-    }
+    PushEntry( p_fetcher, p_item, i_options, PASS1_LOCAL );
+}
 
-    while( p_fetcher->b_live )
-        vlc_cond_wait( &p_fetcher->wait, &p_fetcher->lock );
-    vlc_mutex_unlock( &p_fetcher->lock );
+void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
+{
+    /* Remove any left-over item and interrupt running fetches */
+    background_worker_Delete( p_fetcher->worker );
 
-    vlc_cond_destroy( &p_fetcher->wait );
     vlc_mutex_destroy( &p_fetcher->lock );
 
-    vlc_interrupt_destroy( p_fetcher->interrupt );
-
     playlist_album_t album;
     FOREACH_ARRAY( album, p_fetcher->albums )
         free( album.psz_album );
@@ -203,11 +179,11 @@ void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
  *   1 : Art found, need to download
  *  -X : Error/not found
  */
-static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
+static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
+                    meta_fetcher_scope_t e_scope )
 {
     int i_ret;
 
-    playlist_album_t *p_album = NULL;
     char *psz_artist = input_item_GetArtist( p_item );
     char *psz_album = input_item_GetAlbum( p_item );
     char *psz_title = input_item_GetTitle( p_item );
@@ -222,36 +198,46 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     /* If we already checked this album in this session, skip */
     if( psz_artist && psz_album )
     {
+        int i_found = -1;
+        char *psz_album_arturl = NULL;
+
+        vlc_mutex_lock( &p_fetcher->lock );
         FOREACH_ARRAY( playlist_album_t album, p_fetcher->albums )
             if( !strcmp( album.psz_artist, psz_artist ) &&
                 !strcmp( album.psz_album, psz_album ) )
             {
-                msg_Dbg( p_fetcher->object,
-                         " %s - %s has already been searched",
-                         psz_artist, psz_album );
-                /* TODO-fenrir if we cache art filename too, we can go faster */
-                free( psz_artist );
-                free( psz_album );
                 if( album.b_found )
                 {
-                    if( !strncmp( album.psz_arturl, "file://", 7 ) )
-                        input_item_SetArtURL( p_item, album.psz_arturl );
-                    else /* Actually get URL from cache */
-                        playlist_FindArtInCache( p_item );
-                    return 0;
+                    i_found = 1;
+                    if( album.psz_arturl )
+                        psz_album_arturl = strdup( album.psz_arturl );
                 }
-                else if ( album.e_scope >= p_fetcher->e_scope )
-                {
-                    return VLC_EGENERIC;
-                }
-                msg_Dbg( p_fetcher->object,
-                         " will search at higher scope, if possible" );
-                p_album = &p_fetcher->albums.p_elems[fe_idx];
-
-                psz_artist = psz_album = NULL;
+                else if ( album.e_scope >= e_scope )
+                    i_found = 0;
                 break;
             }
         FOREACH_END();
+        vlc_mutex_unlock( &p_fetcher->lock );
+
+        if( i_found >= 0 )
+        {
+            msg_Dbg( p_fetcher->object,
+                     " %s - %s has already been searched",
+                     psz_artist, psz_album );
+            /* TODO-fenrir if we cache art filename too, we can go faster */
+            free( psz_artist );
+            free( psz_album );
+            if( i_found == 0 )
+                return VLC_EGENERIC;
+
+            if( psz_album_arturl
+             && !strncmp( psz_album_arturl, "file://", 7 ) )
+                input_item_SetArtURL( p_item, psz_album_arturl );
+            else /* Actually get URL from cache */
+                playlist_FindArtInCache( p_item );
+            free( psz_album_arturl );
+            return 0;
+        }
     }
 
     free( psz_artist );
@@ -307,7 +293,7 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
         module_t *p_module;
 
         p_finder->p_item = p_item;
-        p_finder->e_scope = p_fetcher->e_scope;
+        p_finder->e_scope = e_scope;
 
         p_module = module_need( p_finder, "art finder", NULL, false );
         if( p_module )
@@ -325,9 +311,24 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     /* Record this album */
     if( psz_artist && psz_album )
     {
+        playlist_album_t *p_album = NULL;
+
+        vlc_mutex_lock( &p_fetcher->lock );
+        for( int i = 0; i < p_fetcher->albums.i_size; i++ )
+        {
+            playlist_album_t *album = &p_fetcher->albums.p_elems[i];
+            if( !strcmp( album->psz_artist, psz_artist ) &&
+                !strcmp( album->psz_album, psz_album ) )
+            {
+                p_album = album;
+                break;
+            }
+        }
+
         if ( p_album )
         {
-            p_album->e_scope = p_fetcher->e_scope;
+            /* Searched again at a higher scope */
+            p_album->e_scope = e_scope;
             free( p_album->psz_arturl );
             p_album->psz_arturl = input_item_GetArtURL( p_item );
             p_album->b_found = (i_ret == VLC_EGENERIC ? false : true );
@@ -341,9 +342,10 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
             a.psz_album = psz_album;
             a.psz_arturl = input_item_GetArtURL( p_item );
             a.b_found = (i_ret == VLC_EGENERIC ? false : true );
-            a.e_scope = p_fetcher->e_scope;
+            a.e_scope = e_scope;
             ARRAY_APPEND( p_fetcher->albums, a );
         }
+        vlc_mutex_unlock( &p_fetcher->lock );
     }
     else
     {
@@ -427,14 +429,15 @@ error:
  * connections, and gather information upon the playing media.
  * (even artwork).
  */
-static void FetchMeta( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
+static void FetchMeta( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
+                       meta_fetcher_scope_t e_scope )
 {
     meta_fetcher_t *p_finder =
         vlc_custom_create( p_fetcher->object, sizeof( *p_finder ), "art finder" );
     if ( !p_finder )
         return;
 
-    p_finder->e_scope = p_fetcher->e_scope;
+    p_finder->e_scope = e_scope;
     p_finder->p_item = p_item;
 
     module_t *p_module = module_need( p_finder, "meta fetcher", NULL, false );
@@ -444,132 +447,98 @@ static void FetchMeta( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     vlc_object_release( p_finder );
 }
 
-static void *Thread( void *p_data )
+static void ReleaseEntry( void *data )
 {
-    playlist_fetcher_t *p_fetcher = p_data;
-    vlc_object_t *obj = p_fetcher->object;
-    fetcher_pass_t e_pass = PASS1_LOCAL;
+    fetcher_entry_t *p_entry = data;
 
-    vlc_interrupt_set(p_fetcher->interrupt);
+    vlc_gc_decref( p_entry->p_item );
+    free( p_entry );
+}
 
-    for( ;; )
-    {
-        fetcher_entry_t *p_entry = NULL;
+static int StartFetch( void *owner, void *entity, void **out )
+{
+    playlist_fetcher_t *p_fetcher = owner;
+    fetcher_entry_t *p_entry = entity;
+    vlc_object_t *obj = p_fetcher->object;
+    fetcher_pass_t e_pass = p_entry->e_pass;
+    meta_fetcher_scope_t e_scope = p_fetcher->e_scope;
+
+    /* scope override */
+    switch ( p_entry->i_options ) {
+    case META_REQUEST_OPTION_SCOPE_ANY:
+        e_scope = FETCHER_SCOPE_ANY;
+        break;
+    case META_REQUEST_OPTION_SCOPE_LOCAL:
+        e_scope = FETCHER_SCOPE_LOCAL;
+        break;
+    case META_REQUEST_OPTION_SCOPE_NETWORK:
+        e_scope = FETCHER_SCOPE_NETWORK;
+        break;
+    case META_REQUEST_OPTION_NONE:
+    default:
+        break;
+    }
+    /* Triggers "meta fetcher", eventually fetch meta on the network.
+     * They are identical to "meta reader" expect that may actually
+     * takes time. That's why they are running here.
+     * The result of this fetch is not cached. */
 
-        vlc_mutex_lock( &p_fetcher->lock );
-        for ( int i=0; i<PASS_COUNT; i++ )
-        {
-            if ( p_fetcher->p_waiting_head[i] )
-            {
-                e_pass = i;
-                break;
-            }
-        }
+    int i_ret = -1;
 
-        if( p_fetcher->p_waiting_head[e_pass] )
-        {
-            p_entry = p_fetcher->p_waiting_head[e_pass];
-            p_fetcher->p_waiting_head[e_pass] = p_entry->p_next;
-            if ( p_entry->p_next == NULL )
-                p_fetcher->p_waiting_tail[e_pass] = NULL;
-            p_entry->p_next = NULL;
-        }
-        else
+    if( e_pass == PASS1_LOCAL && ( e_scope & FETCHER_SCOPE_LOCAL ) )
+    {
+        /* only fetch from local */
+        e_scope = FETCHER_SCOPE_LOCAL;
+    }
+    else if( e_pass == PASS2_NETWORK && ( e_scope & FETCHER_SCOPE_NETWORK ) )
+    {
+        /* only fetch from network */
+        e_scope = FETCHER_SCOPE_NETWORK;
+    }
+    else
+        e_scope = 0;
+    if ( e_scope & FETCHER_SCOPE_ANY )
+    {
+        FetchMeta( p_fetcher, p_entry->p_item, e_scope );
+        i_ret = FindArt( p_fetcher, p_entry->p_item, e_scope );
+        switch( i_ret )
         {
-            vlc_interrupt_set( NULL );
-            p_fetcher->b_live = false;
-            vlc_cond_signal( &p_fetcher->wait );
-        }
-        vlc_mutex_unlock( &p_fetcher->lock );
-
-        if( !p_entry )
-            break;
-
-        meta_fetcher_scope_t e_prev_scope = p_fetcher->e_scope;
-
-        /* scope override */
-        switch ( p_entry->i_options ) {
-        case META_REQUEST_OPTION_SCOPE_ANY:
-            p_fetcher->e_scope = FETCHER_SCOPE_ANY;
-            break;
-        case META_REQUEST_OPTION_SCOPE_LOCAL:
-            p_fetcher->e_scope = FETCHER_SCOPE_LOCAL;
-            break;
-        case META_REQUEST_OPTION_SCOPE_NETWORK:
-            p_fetcher->e_scope = FETCHER_SCOPE_NETWORK;
+        case 1: /* Found, need to dl */
+            i_ret = DownloadArt( p_fetcher, p_entry->p_item );
             break;
-        case META_REQUEST_OPTION_NONE:
-        default:
+        case 0: /* Is in cache */
+            i_ret = VLC_SUCCESS;
+            //ft
+        default:// error
             break;
         }
-        /* Triggers "meta fetcher", eventually fetch meta on the network.
-         * They are identical to "meta reader" expect that may actually
-         * takes time. That's why they are running here.
-         * The result of this fetch is not cached. */
-
-        int i_ret = -1;
-
-        if( e_pass == PASS1_LOCAL && ( p_fetcher->e_scope & FETCHER_SCOPE_LOCAL ) )
-        {
-            /* only fetch from local */
-            p_fetcher->e_scope = FETCHER_SCOPE_LOCAL;
-        }
-        else if( e_pass == PASS2_NETWORK && ( p_fetcher->e_scope & FETCHER_SCOPE_NETWORK ) )
-        {
-            /* only fetch from network */
-            p_fetcher->e_scope = FETCHER_SCOPE_NETWORK;
-        }
-        else
-            p_fetcher->e_scope = 0;
-        if ( p_fetcher->e_scope & FETCHER_SCOPE_ANY )
-        {
-            FetchMeta( p_fetcher, p_entry->p_item );
-            i_ret = FindArt( p_fetcher, p_entry->p_item );
-            switch( i_ret )
-            {
-            case 1: /* Found, need to dl */
-                i_ret = DownloadArt( p_fetcher, p_entry->p_item );
-                break;
-            case 0: /* Is in cache */
-                i_ret = VLC_SUCCESS;
-                //ft
-            default:// error
-                break;
-            }
-        }
+    }
 
-        p_fetcher->e_scope = e_prev_scope;
+    /* */
+    if ( i_ret != VLC_SUCCESS && (e_pass != PASS2_NETWORK) && !vlc_killed() )
+    {
+        /* Move our entry to next pass queue */
+        PushEntry( p_fetcher, p_entry->p_item, p_entry->i_options,
+                   e_pass + 1 );
+    }
+    else
+    {
         /* */
-        if ( i_ret != VLC_SUCCESS && (e_pass != PASS2_NETWORK) )
+        char *psz_name = input_item_GetName( p_entry->p_item );
+        if( i_ret == VLC_SUCCESS ) /* Art is now in cache */
         {
-            /* Move our entry to next pass queue */
-            vlc_mutex_lock( &p_fetcher->lock );
-            if ( p_fetcher->p_waiting_head[e_pass + 1] )
-                p_fetcher->p_waiting_tail[e_pass + 1]->p_next = p_entry;
-            else
-                p_fetcher->p_waiting_head[e_pass + 1] = p_entry;
-            p_fetcher->p_waiting_tail[e_pass + 1] = p_entry;
-            vlc_mutex_unlock( &p_fetcher->lock );
+            msg_Dbg( obj, "found art for %s in cache", psz_name );
+            input_item_SetArtFetched( p_entry->p_item, true );
+            var_SetAddress( obj, "item-change", p_entry->p_item );
         }
         else
         {
-            /* */
-            char *psz_name = input_item_GetName( p_entry->p_item );
-            if( i_ret == VLC_SUCCESS ) /* Art is now in cache */
-            {
-                msg_Dbg( obj, "found art for %s in cache", psz_name );
-                input_item_SetArtFetched( p_entry->p_item, true );
-                var_SetAddress( obj, "item-change", p_entry->p_item );
-            }
-            else
-            {
-                msg_Dbg( obj, "art not found for %s", psz_name );
-                input_item_SetArtNotFound( p_entry->p_item, true );
-            }
-            free( psz_name );
-            vlc_gc_decref( p_entry->p_item );
-            free( p_entry );
+            msg_Dbg( obj, "art not found for %s", psz_name );
+            input_item_SetArtNotFound( p_entry->p_item, true );
         }
+        free( psz_name );
     }
-    return NULL;
+
+    *out = NULL;
+    return VLC_SUCCESS;
 }
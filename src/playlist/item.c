@@ -212,6 +212,9 @@ static void input_item_changed( const vlc_event_t * p_event,
 {
     playlist_t *p_playlist = user_data;
 
+    if( p_event->type == vlc_InputItemMetaChanged
+     || p_event->type == vlc_InputItemNameChanged )
+        playlist_SearchIndexChanged( p_playlist, p_event->p_obj );
     var_SetAddress( p_playlist, "item-change", p_event->p_obj );
 }
 
@@ -303,6 +306,7 @@ playlist_item_t *playlist_ItemNewFromInput( playlist_t *p_playlist,
                       input_item_changed, p_playlist );
     vlc_event_attach( p_em, vlc_InputItemErrorWhenReadingChanged,
                       input_item_changed, p_playlist );
+    playlist_SearchIndexChanged( p_playlist, p_input );
 
     return p_item;
 
@@ -341,6 +345,7 @@ void playlist_ItemRelease( playlist_t *p_playlist, playlist_item_t *p_item )
     vlc_event_detach( p_em, vlc_InputItemErrorWhenReadingChanged,
                       input_item_changed, p_playlist );
 
+    playlist_SearchIndexRemove( p_playlist, p_item );
     vlc_gc_decref( p_item->p_input );
 
     tdelete( p_item, &p->input_tree, playlist_ItemCmpInput );
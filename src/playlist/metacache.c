@@ -0,0 +1,616 @@
+/*****************************************************************************
+ * metacache.c: preparsed meta data cache
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_input_item.h>
+#include <vlc_meta.h>
+#include <vlc_fs.h>
+#include <vlc_url.h>
+#include <vlc_md5.h>
+
+#include "input/item.h"
+#include "metacache.h"
+
+/* Cache entries are stored as one binary file per item, in host byte order:
+ *  - magic and version,
+ *  - modification time and size of the file when it was preparsed,
+ *  - MRL (to detect hash collisions),
+ *  - duration, meta data (including extra meta) and ES formats.
+ */
+static const char meta_cache_magic[8] = "VLCmeta";
+#define META_CACHE_VERSION 1
+#define META_CACHE_MAX_STRING (1 << 20)
+#define META_CACHE_MAX_COUNT  4096
+
+/*****************************************************************************
+ * Cache entry location
+ *****************************************************************************/
+static char *MetaCacheKey( input_item_t *p_item )
+{
+    struct md5_s md5;
+
+    InitMD5( &md5 );
+    vlc_mutex_lock( &p_item->lock );
+    AddMD5( &md5, p_item->psz_uri, strlen( p_item->psz_uri ) );
+    for( int i = 0; i < p_item->i_options; i++ )
+    {
+        AddMD5( &md5, "\n", 1 );
+        AddMD5( &md5, p_item->ppsz_options[i],
+                strlen( p_item->ppsz_options[i] ) );
+    }
+    vlc_mutex_unlock( &p_item->lock );
+    EndMD5( &md5 );
+
+    return psz_md5_hash( &md5 );
+}
+
+static void MetaCacheCreateDir( char *psz_dir )
+{
+    for( char *psz = strchr( psz_dir + 1, DIR_SEP_CHAR ); psz != NULL;
+         psz = strchr( psz + 1, DIR_SEP_CHAR ) )
+    {
+        *psz = '\0';
+        vlc_mkdir( psz_dir, 0700 );
+        *psz = DIR_SEP_CHAR;
+    }
+    vlc_mkdir( psz_dir, 0700 );
+}
+
+static char *MetaCacheRoot( void )
+{
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_root;
+
+    if( unlikely(psz_cachedir == NULL) )
+        return NULL;
+    if( asprintf( &psz_root, "%s" DIR_SEP "meta", psz_cachedir ) == -1 )
+        psz_root = NULL;
+    free( psz_cachedir );
+    return psz_root;
+}
+
+static char *MetaCacheDir( const char *psz_key, bool b_create )
+{
+    char *psz_root = MetaCacheRoot();
+    char *psz_dir;
+
+    if( unlikely(psz_root == NULL) )
+        return NULL;
+
+    /* Spread the entries over 256 directories */
+    if( asprintf( &psz_dir, "%s" DIR_SEP "%.2s", psz_root, psz_key ) == -1 )
+        psz_dir = NULL;
+    free( psz_root );
+
+    if( b_create && psz_dir != NULL )
+        MetaCacheCreateDir( psz_dir );
+    return psz_dir;
+}
+
+/**
+ * Returns the local path of the item and its modification time and size.
+ */
+static char *MetaCacheStat( input_item_t *p_item, int64_t *pi_mtime,
+                            int64_t *pi_size )
+{
+    char *psz_uri = input_item_GetURI( p_item );
+    if( psz_uri == NULL )
+        return NULL;
+
+    char *psz_path = NULL;
+    struct stat st;
+
+    if( !strncasecmp( psz_uri, "file://", 7 ) )
+        psz_path = vlc_uri2path( psz_uri );
+    free( psz_uri );
+
+    if( psz_path == NULL )
+        return NULL;
+    if( vlc_stat( psz_path, &st ) || !S_ISREG( st.st_mode ) )
+    {
+        free( psz_path );
+        return NULL;
+    }
+    *pi_mtime = st.st_mtime;
+    *pi_size = st.st_size;
+    return psz_path;
+}
+
+/*****************************************************************************
+ * Serialization helpers
+ *****************************************************************************/
+static bool WriteU32( FILE *f, uint32_t i_val )
+{
+    return fwrite( &i_val, sizeof(i_val), 1, f ) == 1;
+}
+
+static bool WriteI64( FILE *f, int64_t i_val )
+{
+    return fwrite( &i_val, sizeof(i_val), 1, f ) == 1;
+}
+
+static bool WriteString( FILE *f, const char *psz )
+{
+    size_t i_len = psz != NULL ? strlen( psz ) + 1 : 0;
+
+    return WriteU32( f, i_len )
+        && fwrite( psz, 1, i_len, f ) == i_len;
+}
+
+static bool ReadU32( FILE *f, uint32_t *pi_val )
+{
+    return fread( pi_val, sizeof(*pi_val), 1, f ) == 1;
+}
+
+static bool ReadI64( FILE *f, int64_t *pi_val )
+{
+    return fread( pi_val, sizeof(*pi_val), 1, f ) == 1;
+}
+
+static bool ReadString( FILE *f, char **ppsz )
+{
+    uint32_t i_len;
+
+    *ppsz = NULL;
+    if( !ReadU32( f, &i_len ) || i_len > META_CACHE_MAX_STRING )
+        return false;
+    if( i_len == 0 )
+        return true;
+
+    char *psz = malloc( i_len );
+    if( unlikely(psz == NULL) )
+        return false;
+    if( fread( psz, 1, i_len, f ) != i_len || psz[i_len - 1] != '\0' )
+    {
+        free( psz );
+        return false;
+    }
+    *ppsz = psz;
+    return true;
+}
+
+static bool WriteEs( FILE *f, const es_format_t *fmt )
+{
+    return WriteU32( f, fmt->i_cat )
+        && WriteU32( f, fmt->i_codec )
+        && WriteU32( f, fmt->i_original_fourcc )
+        && WriteU32( f, fmt->i_id )
+        && WriteU32( f, fmt->i_group )
+        && WriteU32( f, fmt->i_priority )
+        && WriteString( f, fmt->psz_language )
+        && WriteString( f, fmt->psz_description )
+        && WriteU32( f, fmt->i_bitrate )
+        && WriteU32( f, fmt->i_profile )
+        && WriteU32( f, fmt->i_level )
+        && WriteU32( f, fmt->audio.i_rate )
+        && WriteU32( f, fmt->audio.i_physical_channels )
+        && WriteU32( f, fmt->audio.i_original_channels )
+        && WriteU32( f, fmt->audio.i_channels )
+        && WriteU32( f, fmt->audio.i_bitspersample )
+        && WriteU32( f, fmt->video.i_width )
+        && WriteU32( f, fmt->video.i_height )
+        && WriteU32( f, fmt->video.i_visible_width )
+        && WriteU32( f, fmt->video.i_visible_height )
+        && WriteU32( f, fmt->video.i_sar_num )
+        && WriteU32( f, fmt->video.i_sar_den )
+        && WriteU32( f, fmt->video.i_frame_rate )
+        && WriteU32( f, fmt->video.i_frame_rate_base )
+        && WriteU32( f, fmt->video.orientation )
+        && WriteString( f, fmt->subs.psz_encoding );
+}
+
+static bool ReadEs( FILE *f, es_format_t *fmt )
+{
+    uint32_t v[23];
+
+    es_format_Init( fmt, UNKNOWN_ES, 0 );
+
+    bool b_ok = ReadU32( f, &v[0] ) && ReadU32( f, &v[1] )
+             && ReadU32( f, &v[2] ) && ReadU32( f, &v[3] )
+             && ReadU32( f, &v[4] ) && ReadU32( f, &v[5] )
+             && ReadString( f, &fmt->psz_language )
+             && ReadString( f, &fmt->psz_description );
+    for( unsigned i = 6; b_ok && i < ARRAY_SIZE(v); i++ )
+        b_ok = ReadU32( f, &v[i] );
+    if( b_ok )
+        b_ok = ReadString( f, &fmt->subs.psz_encoding );
+    if( !b_ok || v[0] > NAV_ES )
+    {
+        es_format_Clean( fmt );
+        return false;
+    }
+
+    fmt->i_cat = v[0];
+    fmt->i_codec = v[1];
+    fmt->i_original_fourcc = v[2];
+    fmt->i_id = (int32_t)v[3];
+    fmt->i_group = (int32_t)v[4];
+    fmt->i_priority = (int32_t)v[5];
+    fmt->i_bitrate = v[6];
+    fmt->i_profile = (int32_t)v[7];
+    fmt->i_level = (int32_t)v[8];
+    fmt->audio.i_format = fmt->i_codec;
+    fmt->audio.i_rate = v[9];
+    fmt->audio.i_physical_channels = v[10];
+    fmt->audio.i_original_channels = v[11];
+    fmt->audio.i_channels = v[12];
+    fmt->audio.i_bitspersample = v[13];
+    fmt->video.i_chroma = fmt->i_cat == VIDEO_ES ? fmt->i_codec : 0;
+    fmt->video.i_width = v[14];
+    fmt->video.i_height = v[15];
+    fmt->video.i_visible_width = v[16];
+    fmt->video.i_visible_height = v[17];
+    fmt->video.i_sar_num = v[18];
+    fmt->video.i_sar_den = v[19];
+    fmt->video.i_frame_rate = v[20];
+    fmt->video.i_frame_rate_base = v[21];
+    fmt->video.orientation = v[22] <= ORIENT_RIGHT_BOTTOM ? v[22] : ORIENT_NORMAL;
+    return true;
+}
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+int playlist_SaveMetaToCache( vlc_object_t *obj, input_item_t *p_item )
+{
+    int64_t i_mtime, i_size;
+    char *psz_path = MetaCacheStat( p_item, &i_mtime, &i_size );
+    if( psz_path == NULL )
+        return VLC_EGENERIC;
+    free( psz_path );
+
+    char *psz_key = MetaCacheKey( p_item );
+    if( unlikely(psz_key == NULL) )
+        return VLC_ENOMEM;
+
+    char *psz_dir = MetaCacheDir( psz_key, true );
+    char *psz_file, *psz_tmp;
+    if( psz_dir == NULL
+     || asprintf( &psz_file, "%s" DIR_SEP "%s", psz_dir, psz_key ) == -1 )
+    {
+        free( psz_dir );
+        free( psz_key );
+        return VLC_ENOMEM;
+    }
+    free( psz_key );
+    if( asprintf( &psz_tmp, "%s.XXXXXX", psz_file ) == -1 )
+    {
+        free( psz_dir );
+        free( psz_file );
+        return VLC_ENOMEM;
+    }
+    free( psz_dir );
+
+    int fd = vlc_mkstemp( psz_tmp );
+    FILE *f = fd != -1 ? fdopen( fd, "wb" ) : NULL;
+    if( f == NULL )
+    {
+        msg_Dbg( obj, "cannot create %s: %s", psz_tmp,
+                 vlc_strerror_c(errno) );
+        if( fd != -1 )
+        {
+            vlc_close( fd );
+            vlc_unlink( psz_tmp );
+        }
+        free( psz_tmp );
+        free( psz_file );
+        return VLC_EGENERIC;
+    }
+
+    vlc_mutex_lock( &p_item->lock );
+    vlc_meta_t *p_meta = p_item->p_meta;
+    bool b_ok = fwrite( meta_cache_magic, sizeof(meta_cache_magic), 1, f ) == 1
+             && WriteU32( f, META_CACHE_VERSION )
+             && WriteI64( f, i_mtime )
+             && WriteI64( f, i_size )
+             && WriteString( f, p_item->psz_uri )
+             && WriteI64( f, p_item->i_duration );
+
+    for( int i = 0; b_ok && i < VLC_META_TYPE_COUNT; i++ )
+    {
+        const char *psz_val = p_meta ? vlc_meta_Get( p_meta, i ) : NULL;
+
+        /* Attachments are not available without the demuxer */
+        if( i == vlc_meta_ArtworkURL && psz_val != NULL
+         && !strncmp( psz_val, "attachment://", 13 ) )
+            psz_val = NULL;
+        b_ok = WriteString( f, psz_val );
+    }
+
+    char **ppsz_extras = p_meta ? vlc_meta_CopyExtraNames( p_meta ) : NULL;
+    uint32_t i_extras = 0;
+    while( ppsz_extras != NULL && ppsz_extras[i_extras] != NULL )
+        i_extras++;
+    b_ok = b_ok && WriteU32( f, i_extras );
+    for( uint32_t i = 0; i < i_extras; i++ )
+    {
+        b_ok = b_ok && WriteString( f, ppsz_extras[i] )
+                    && WriteString( f, vlc_meta_GetExtra( p_meta,
+                                                          ppsz_extras[i] ) );
+        free( ppsz_extras[i] );
+    }
+    free( ppsz_extras );
+
+    b_ok = b_ok && WriteU32( f, p_item->i_es );
+    for( int i = 0; b_ok && i < p_item->i_es; i++ )
+        b_ok = WriteEs( f, p_item->es[i] );
+    vlc_mutex_unlock( &p_item->lock );
+
+    if( fclose( f ) )
+        b_ok = false;
+
+    if( b_ok && vlc_rename( psz_tmp, psz_file ) == 0 )
+        msg_Dbg( obj, "meta data cached to %s", psz_file );
+    else
+    {
+        msg_Warn( obj, "cannot write meta cache %s: %s", psz_file,
+                  vlc_strerror_c(errno) );
+        vlc_unlink( psz_tmp );
+        b_ok = false;
+    }
+    free( psz_tmp );
+    free( psz_file );
+    return b_ok ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+int playlist_FindMetaInCache( vlc_object_t *obj, input_item_t *p_item )
+{
+    int64_t i_mtime, i_size;
+    char *psz_path = MetaCacheStat( p_item, &i_mtime, &i_size );
+    if( psz_path == NULL )
+        return VLC_EGENERIC;
+    free( psz_path );
+
+    char *psz_key = MetaCacheKey( p_item );
+    if( unlikely(psz_key == NULL) )
+        return VLC_ENOMEM;
+
+    char *psz_dir = MetaCacheDir( psz_key, false );
+    char *psz_file;
+    if( psz_dir == NULL
+     || asprintf( &psz_file, "%s" DIR_SEP "%s", psz_dir, psz_key ) == -1 )
+        psz_file = NULL;
+    free( psz_dir );
+    free( psz_key );
+    if( psz_file == NULL )
+        return VLC_ENOMEM;
+
+    FILE *f = vlc_fopen( psz_file, "rb" );
+    if( f == NULL )
+    {
+        free( psz_file );
+        return VLC_EGENERIC;
+    }
+
+    /* Parse the whole entry before touching the item */
+    char magic[sizeof(meta_cache_magic)];
+    uint32_t i_version, i_count;
+    int64_t i_cached_mtime, i_cached_size, i_duration;
+    char *psz_uri = NULL;
+    vlc_meta_t *p_meta = vlc_meta_New();
+    es_format_t *p_es = NULL;
+    uint32_t i_es = 0;
+
+    bool b_ok = p_meta != NULL
+             && fread( magic, sizeof(magic), 1, f ) == 1
+             && !memcmp( magic, meta_cache_magic, sizeof(magic) )
+             && ReadU32( f, &i_version ) && i_version == META_CACHE_VERSION
+             && ReadI64( f, &i_cached_mtime ) && i_cached_mtime == i_mtime
+             && ReadI64( f, &i_cached_size ) && i_cached_size == i_size
+             && ReadString( f, &psz_uri ) && psz_uri != NULL
+             && ReadI64( f, &i_duration );
+
+    if( b_ok )
+    {
+        char *psz_item_uri = input_item_GetURI( p_item );
+        b_ok = psz_item_uri != NULL && !strcmp( psz_uri, psz_item_uri );
+        free( psz_item_uri );
+    }
+    free( psz_uri );
+
+    for( int i = 0; b_ok && i < VLC_META_TYPE_COUNT; i++ )
+    {
+        char *psz_val;
+        b_ok = ReadString( f, &psz_val );
+        if( psz_val != NULL )
+            vlc_meta_Set( p_meta, i, psz_val );
+        free( psz_val );
+    }
+
+    b_ok = b_ok && ReadU32( f, &i_count ) && i_count <= META_CACHE_MAX_COUNT;
+    for( uint32_t i = 0; b_ok && i < i_count; i++ )
+    {
+        char *psz_name, *psz_val = NULL;
+        b_ok = ReadString( f, &psz_name ) && psz_name != NULL
+            && ReadString( f, &psz_val ) && psz_val != NULL;
+        if( b_ok )
+            vlc_meta_AddExtra( p_meta, psz_name, psz_val );
+        free( psz_name );
+        free( psz_val );
+    }
+
+    b_ok = b_ok && ReadU32( f, &i_count ) && i_count <= META_CACHE_MAX_COUNT;
+    if( b_ok && i_count > 0 )
+    {
+        p_es = calloc( i_count, sizeof(*p_es) );
+        b_ok = p_es != NULL;
+    }
+    for( ; b_ok && i_es < i_count; i_es++ )
+        b_ok = ReadEs( f, &p_es[i_es] );
+    fclose( f );
+
+    if( b_ok )
+    {
+        msg_Dbg( obj, "meta data found in cache %s", psz_file );
+
+        input_item_SetDuration( p_item, i_duration );
+        for( uint32_t i = 0; i < i_es; i++ )
+            input_item_UpdateTracksInfo( p_item, &p_es[i] );
+        for( int i = 0; i < VLC_META_TYPE_COUNT; i++ )
+        {
+            const char *psz_val = vlc_meta_Get( p_meta, i );
+            if( psz_val != NULL )
+                input_item_SetMeta( p_item, i, psz_val );
+        }
+
+        char **ppsz_extras = vlc_meta_CopyExtraNames( p_meta );
+        vlc_mutex_lock( &p_item->lock );
+        if( p_item->p_meta == NULL )
+            p_item->p_meta = vlc_meta_New();
+        for( int i = 0; ppsz_extras != NULL && ppsz_extras[i] != NULL; i++ )
+        {
+            if( p_item->p_meta != NULL )
+                vlc_meta_AddExtra( p_item->p_meta, ppsz_extras[i],
+                                   vlc_meta_GetExtra( p_meta,
+                                                      ppsz_extras[i] ) );
+            free( ppsz_extras[i] );
+        }
+        vlc_mutex_unlock( &p_item->lock );
+        free( ppsz_extras );
+    }
+
+    for( uint32_t i = 0; i < i_es; i++ )
+        es_format_Clean( &p_es[i] );
+    free( p_es );
+    if( p_meta != NULL )
+        vlc_meta_Delete( p_meta );
+    free( psz_file );
+    return b_ok ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+/*****************************************************************************
+ * Pruning
+ *****************************************************************************/
+typedef struct
+{
+    int64_t i_mtime;
+    char   *psz_path;
+} meta_cache_entry_t;
+
+static int MetaCacheEntryCompare( const void *a, const void *b )
+{
+    const meta_cache_entry_t *p_a = a, *p_b = b;
+
+    if( p_a->i_mtime != p_b->i_mtime )
+        return p_a->i_mtime < p_b->i_mtime ? -1 : 1;
+    return 0;
+}
+
+/**
+ * Appends the regular files of a cache directory to the entry list.
+ */
+static void MetaCacheList( const char *psz_dir, meta_cache_entry_t **pp_entries,
+                           size_t *pi_entries, size_t *pi_alloc )
+{
+    DIR *p_dir = vlc_opendir( psz_dir );
+    const char *psz_name;
+
+    if( p_dir == NULL )
+        return;
+
+    while( (psz_name = vlc_readdir( p_dir )) != NULL )
+    {
+        char *psz_path;
+        struct stat st;
+
+        if( psz_name[0] == '.'
+         || asprintf( &psz_path, "%s" DIR_SEP "%s", psz_dir, psz_name ) == -1 )
+            continue;
+        if( vlc_stat( psz_path, &st ) || !S_ISREG( st.st_mode ) )
+        {
+            free( psz_path );
+            continue;
+        }
+
+        if( *pi_entries == *pi_alloc )
+        {
+            size_t i_alloc = *pi_alloc ? 2 * *pi_alloc : 256;
+            meta_cache_entry_t *p_realloc =
+                realloc( *pp_entries, i_alloc * sizeof(**pp_entries) );
+            if( unlikely(p_realloc == NULL) )
+            {
+                free( psz_path );
+                break;
+            }
+            *pp_entries = p_realloc;
+            *pi_alloc = i_alloc;
+        }
+        (*pp_entries)[*pi_entries].i_mtime = st.st_mtime;
+        (*pp_entries)[*pi_entries].psz_path = psz_path;
+        (*pi_entries)++;
+    }
+    closedir( p_dir );
+}
+
+unsigned playlist_PruneMetaCache( vlc_object_t *obj, unsigned i_max )
+{
+    char *psz_root = MetaCacheRoot();
+    if( unlikely(psz_root == NULL) )
+        return 0;
+
+    DIR *p_root = vlc_opendir( psz_root );
+    if( p_root == NULL )
+    {
+        free( psz_root );
+        return 0;
+    }
+
+    meta_cache_entry_t *p_entries = NULL;
+    size_t i_entries = 0, i_alloc = 0;
+    const char *psz_sub;
+
+    while( (psz_sub = vlc_readdir( p_root )) != NULL )
+    {
+        char *psz_dir;
+
+        if( psz_sub[0] == '.'
+         || asprintf( &psz_dir, "%s" DIR_SEP "%s", psz_root, psz_sub ) == -1 )
+            continue;
+        MetaCacheList( psz_dir, &p_entries, &i_entries, &i_alloc );
+        free( psz_dir );
+    }
+    closedir( p_root );
+    free( psz_root );
+
+    /* Entries are written once per preparse: the oldest written go first */
+    unsigned i_removed = 0;
+    if( i_entries > i_max )
+    {
+        qsort( p_entries, i_entries, sizeof(*p_entries),
+               MetaCacheEntryCompare );
+        for( size_t i = 0; i < i_entries - i_max; i++ )
+            if( vlc_unlink( p_entries[i].psz_path ) == 0 )
+                i_removed++;
+        msg_Dbg( obj, "removed %u old entries from the meta cache",
+                 i_removed );
+    }
+
+    for( size_t i = 0; i < i_entries; i++ )
+        free( p_entries[i].psz_path );
+    free( p_entries );
+    return i_removed;
+}
@@ -0,0 +1,50 @@
+/*****************************************************************************
+ * metacache.h: preparsed meta data cache
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef _PLAYLIST_METACACHE_H
+#define _PLAYLIST_METACACHE_H 1
+
+#include <vlc_input_item.h>
+
+/**
+ * Fills an input item from the meta data cache.
+ *
+ * The cache is keyed by the item MRL and options, and an entry is only valid
+ * if the modification time and size of the local file did not change since
+ * it was stored. Duration, ES formats and meta data are restored.
+ *
+ * \return VLC_SUCCESS if the item was found in the cache, an error otherwise
+ */
+int playlist_FindMetaInCache( vlc_object_t *, input_item_t * );
+
+/**
+ * Stores the preparsed data of a local file input item in the cache.
+ */
+int playlist_SaveMetaToCache( vlc_object_t *, input_item_t * );
+
+/**
+ * Removes the oldest entries of the cache so that it holds no more than
+ * i_max entries.
+ *
+ * \return the number of entries removed
+ */
+unsigned playlist_PruneMetaCache( vlc_object_t *, unsigned i_max );
+
+#endif
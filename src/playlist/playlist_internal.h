@@ -52,6 +52,7 @@ typedef struct playlist_private_t
     void *input_tree; /**< Search tree for input item
                            to playlist item mapping */
     void *id_tree; /**< Search tree for item ID to item mapping */
+    struct playlist_search_index *p_search; /**< Live search index */
 
     vlc_sd_internal_t   **pp_sds;
     int                   i_sds;   /**< Number of service discovery modules */
@@ -132,6 +133,12 @@ playlist_item_t *playlist_ItemFindFromInputAndRoot( playlist_t *p_playlist,
 
 void playlist_ItemRelease( playlist_t *, playlist_item_t * );
 
+/* Live search index */
+void playlist_SearchIndexInit( playlist_t * );
+void playlist_SearchIndexClean( playlist_t * );
+void playlist_SearchIndexChanged( playlist_t *, input_item_t * );
+void playlist_SearchIndexRemove( playlist_t *, playlist_item_t * );
+
 void ResetCurrentlyPlaying( playlist_t *p_playlist, playlist_item_t *p_cur );
 void ResyncCurrentIndex( playlist_t *p_playlist, playlist_item_t *p_cur );
 
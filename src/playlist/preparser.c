@@ -28,8 +28,11 @@
 #include <assert.h>
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 
+#include "misc/background_worker.h"
 #include "fetcher.h"
+#include "metacache.h"
 #include "preparser.h"
 #include "input/input_interface.h"
 
@@ -42,32 +45,41 @@ struct preparser_entry_t
 {
     input_item_t    *p_item;
     input_item_meta_request_option_t i_options;
-    void            *id;
-    mtime_t          timeout;
 };
 
+/* A running preparse request */
+typedef struct
+{
+    playlist_preparser_t *preparser;
+    preparser_entry_t *p_entry;
+    input_thread_t    *input;
+    atomic_bool        b_stopped;
+    bool               b_subitems;
+    int                status;     /**< preparse status, or -1 if none */
+} preparser_task_t;
+
+/* Requests with an id (libvlc media parsing) are handled before anonymous
+ * ones (playlist auto-preparsing) */
+#define PRIORITY_ANONYMOUS 0
+#define PRIORITY_REQUEST   1
+
+/* Saves to the meta cache between two checks of its size */
+#define CACHE_PRUNE_INTERVAL 256
+
 struct playlist_preparser_t
 {
     vlc_object_t        *object;
     playlist_fetcher_t  *p_fetcher;
-    mtime_t              default_timeout;
-
-    void                *input_id;
-    enum {
-        INPUT_RUNNING,
-        INPUT_STOPPED,
-        INPUT_CANCELED,
-    } input_state;
-
-    vlc_mutex_t     lock;
-    vlc_cond_t      wait;
-    vlc_cond_t      thread_wait;
-    bool            b_live;
-    preparser_entry_t  **pp_waiting;
-    size_t          i_waiting;
+    struct background_worker *worker;
+    bool                 b_cache;
+    unsigned             i_cache_size;
+    atomic_uint          i_cache_saves;
 };
 
-static void *Thread( void * );
+static void ReleaseEntry( void * );
+static int  StartPreparse( void *, void *, void ** );
+static int  ProbePreparse( void *, void * );
+static void StopPreparse( void *, void * );
 
 /*****************************************************************************
  * Public functions
@@ -78,21 +90,31 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t *parent )
     if( !p_preparser )
         return NULL;
 
-    p_preparser->input_id = NULL;
-    p_preparser->input_state = INPUT_RUNNING;
+    struct background_worker_config conf = {
+        .default_timeout = var_InheritInteger( parent, "preparse-timeout" ),
+        .max_threads = __MAX( var_InheritInteger( parent, "preparse-threads" ), 1 ),
+        .pf_release = ReleaseEntry,
+        .pf_start = StartPreparse,
+        .pf_probe = ProbePreparse,
+        .pf_stop = StopPreparse,
+    };
+
+    p_preparser->worker = background_worker_New( p_preparser, &conf );
+    if( unlikely(p_preparser->worker == NULL) )
+    {
+        free( p_preparser );
+        return NULL;
+    }
+
     p_preparser->object = parent;
-    p_preparser->default_timeout = var_InheritInteger( parent, "preparse-timeout" );
+    p_preparser->b_cache = var_InheritBool( parent, "preparse-cache" );
+    p_preparser->i_cache_size =
+        __MAX( var_InheritInteger( parent, "preparse-cache-size" ), 1 );
+    atomic_init( &p_preparser->i_cache_saves, 0 );
     p_preparser->p_fetcher = playlist_fetcher_New( parent );
     if( unlikely(p_preparser->p_fetcher == NULL) )
         msg_Err( parent, "cannot create fetcher" );
 
-    vlc_mutex_init( &p_preparser->lock );
-    vlc_cond_init( &p_preparser->wait );
-    vlc_cond_init( &p_preparser->thread_wait );
-    p_preparser->b_live = false;
-    p_preparser->i_waiting = 0;
-    p_preparser->pp_waiting = NULL;
-
     return p_preparser;
 }
 
@@ -106,22 +128,15 @@ void playlist_preparser_Push( playlist_preparser_t *p_preparser, input_item_t *p
         return;
     p_entry->p_item = p_item;
     p_entry->i_options = i_options;
-    p_entry->id = id;
-    p_entry->timeout = (timeout < 0 ? p_preparser->default_timeout : timeout) * 1000;
     vlc_gc_incref( p_entry->p_item );
 
-    vlc_mutex_lock( &p_preparser->lock );
-    INSERT_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting,
-                 p_preparser->i_waiting, p_entry );
-    if( !p_preparser->b_live )
+    if( background_worker_Push( p_preparser->worker, p_entry, id, timeout,
+                                id != NULL ? PRIORITY_REQUEST
+                                           : PRIORITY_ANONYMOUS ) )
     {
-        if( vlc_clone_detach( NULL, Thread, p_preparser,
-                              VLC_THREAD_PRIORITY_LOW ) )
-            msg_Warn( p_preparser->object, "cannot spawn pre-parser thread" );
-        else
-            p_preparser->b_live = true;
+        msg_Warn( p_preparser->object, "cannot spawn pre-parser thread" );
+        ReleaseEntry( p_entry );
     }
-    vlc_mutex_unlock( &p_preparser->lock );
 }
 
 void playlist_preparser_fetcher_Push( playlist_preparser_t *p_preparser,
@@ -134,52 +149,13 @@ void playlist_preparser_fetcher_Push( playlist_preparser_t *p_preparser,
 void playlist_preparser_Cancel( playlist_preparser_t *p_preparser, void *id )
 {
     assert( id != NULL );
-    vlc_mutex_lock( &p_preparser->lock );
-
-    /* Remove entries that match with the id */
-    for( int i = p_preparser->i_waiting - 1; i >= 0; --i )
-    {
-        preparser_entry_t *p_entry = p_preparser->pp_waiting[i];
-        if( p_entry->id == id )
-        {
-            vlc_gc_decref( p_entry->p_item );
-            free( p_entry );
-            REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, i );
-        }
-    }
-
-    /* Stop the input_thread reading the item (if any) */
-    if( p_preparser->input_id == id )
-    {
-        p_preparser->input_state = INPUT_CANCELED;
-        vlc_cond_signal( &p_preparser->thread_wait );
-    }
-    vlc_mutex_unlock( &p_preparser->lock );
+    background_worker_Cancel( p_preparser->worker, id );
 }
 
 void playlist_preparser_Delete( playlist_preparser_t *p_preparser )
 {
-    vlc_mutex_lock( &p_preparser->lock );
-    /* Remove pending item to speed up preparser thread exit */
-    while( p_preparser->i_waiting > 0 )
-    {
-        preparser_entry_t *p_entry = p_preparser->pp_waiting[0];
-        vlc_gc_decref( p_entry->p_item );
-        free( p_entry );
-        REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, 0 );
-    }
-
-    p_preparser->input_state = INPUT_CANCELED;
-    vlc_cond_signal( &p_preparser->thread_wait );
-
-    while( p_preparser->b_live )
-        vlc_cond_wait( &p_preparser->wait, &p_preparser->lock );
-    vlc_mutex_unlock( &p_preparser->lock );
-
-    /* Destroy the item preparser */
-    vlc_cond_destroy( &p_preparser->thread_wait );
-    vlc_cond_destroy( &p_preparser->wait );
-    vlc_mutex_destroy( &p_preparser->lock );
+    /* Pending items are released and running inputs are stopped */
+    background_worker_Delete( p_preparser->worker );
 
     if( p_preparser->p_fetcher != NULL )
         playlist_fetcher_Delete( p_preparser->p_fetcher );
@@ -190,102 +166,37 @@ void playlist_preparser_Delete( playlist_preparser_t *p_preparser )
  * Privates functions
  *****************************************************************************/
 
+static void ReleaseEntry( void *data )
+{
+    preparser_entry_t *p_entry = data;
+
+    vlc_gc_decref( p_entry->p_item );
+    free( p_entry );
+}
+
 static int InputEvent( vlc_object_t *obj, const char *varname,
                        vlc_value_t old, vlc_value_t cur, void *data )
 {
-    playlist_preparser_t *preparser = data;
+    preparser_task_t *task = data;
     int event = cur.i_int;
 
     if( event == INPUT_EVENT_DEAD )
     {
-        vlc_mutex_lock( &preparser->lock );
-
-        preparser->input_state = INPUT_STOPPED;
-        vlc_cond_signal( &preparser->thread_wait );
-
-        vlc_mutex_unlock( &preparser->lock );
+        atomic_store( &task->b_stopped, true );
+        background_worker_RequestProbe( task->preparser->worker );
     }
 
     (void) obj; (void) varname; (void) old;
     return VLC_SUCCESS;
 }
 
-/**
- * This function preparses an item when needed.
- */
-static void Preparse( playlist_preparser_t *preparser,
-                      preparser_entry_t *p_entry )
+static void SubItemTreeAdded( const vlc_event_t *p_event, void *data )
 {
-    input_item_t *p_item = p_entry->p_item;
-
-    vlc_mutex_lock( &p_item->lock );
-    int i_type = p_item->i_type;
-    bool b_net = p_item->b_net;
-    vlc_mutex_unlock( &p_item->lock );
-
-    bool b_preparse = false;
-    switch (i_type) {
-    case ITEM_TYPE_FILE:
-    case ITEM_TYPE_DIRECTORY:
-    case ITEM_TYPE_PLAYLIST:
-    case ITEM_TYPE_NODE:
-        if( !b_net || p_entry->i_options & META_REQUEST_OPTION_SCOPE_NETWORK )
-            b_preparse = true;
-        break;
-    }
-
-    /* Do not preparse if it is already done (like by playing it) */
-    if( b_preparse && !input_item_IsPreparsed( p_item ) )
-    {
-        int status;
-        input_thread_t *input = input_CreatePreparser( preparser->object, p_item );
-        if( input == NULL )
-        {
-            input_item_SignalPreparseEnded( p_item, ITEM_PREPARSE_FAILED );
-            return;
-        }
-
-        var_AddCallback( input, "intf-event", InputEvent, preparser );
-        if( input_Start( input ) == VLC_SUCCESS )
-        {
-            vlc_mutex_lock( &preparser->lock );
-
-            if( p_entry->timeout > 0 )
-            {
-                mtime_t deadline = mdate() + p_entry->timeout;
-                while( preparser->input_state == INPUT_RUNNING )
-                {
-                    if( vlc_cond_timedwait( &preparser->thread_wait,
-                                            &preparser->lock, deadline ) )
-                        preparser->input_state = INPUT_CANCELED; /* timeout */
-                }
-            }
-            else
-            {
-                while( preparser->input_state == INPUT_RUNNING )
-                    vlc_cond_wait( &preparser->thread_wait, &preparser->lock );
-            }
-            assert( preparser->input_state == INPUT_STOPPED
-                 || preparser->input_state == INPUT_CANCELED );
-            status = preparser->input_state == INPUT_STOPPED ?
-                     ITEM_PREPARSE_DONE : ITEM_PREPARSE_TIMEOUT;
-
-            vlc_mutex_unlock( &preparser->lock );
-        }
-        else
-            status = ITEM_PREPARSE_FAILED;
-
-        var_DelCallback( input, "intf-event", InputEvent, preparser );
-        if( status == ITEM_PREPARSE_TIMEOUT )
-            input_Stop( input );
-        input_Close( input );
+    preparser_task_t *task = data;
 
-        var_SetAddress( preparser->object, "item-change", p_item );
-        input_item_SetPreparsed( p_item, true );
-        input_item_SignalPreparseEnded( p_item, status );
-    }
-    else if (!b_preparse)
-        input_item_SignalPreparseEnded( p_item, ITEM_PREPARSE_SKIPPED );
+    /* Playlists and directories are not cached */
+    task->b_subitems = true;
+    (void) p_event;
 }
 
 /**
@@ -330,42 +241,130 @@ static void Art( playlist_preparser_t *p_preparser, input_item_t *p_item )
 }
 
 /**
- * This function does the preparsing and issues the art fetching requests
+ * This function starts preparsing an item when needed.
  */
-static void *Thread( void *data )
+static int StartPreparse( void *owner, void *entity, void **out )
 {
-    playlist_preparser_t *p_preparser = data;
+    playlist_preparser_t *preparser = owner;
+    preparser_entry_t *p_entry = entity;
+    input_item_t *p_item = p_entry->p_item;
+
+    preparser_task_t *task = malloc( sizeof(*task) );
+    if( unlikely(task == NULL) )
+        return VLC_ENOMEM;
+
+    task->preparser = preparser;
+    task->p_entry = p_entry;
+    task->input = NULL;
+    atomic_init( &task->b_stopped, true );
+    task->b_subitems = false;
+    task->status = -1;
+    *out = task;
+
+    vlc_mutex_lock( &p_item->lock );
+    int i_type = p_item->i_type;
+    bool b_net = p_item->b_net;
+    vlc_mutex_unlock( &p_item->lock );
+
+    bool b_preparse = false;
+    switch (i_type) {
+    case ITEM_TYPE_FILE:
+    case ITEM_TYPE_DIRECTORY:
+    case ITEM_TYPE_PLAYLIST:
+    case ITEM_TYPE_NODE:
+        if( !b_net || p_entry->i_options & META_REQUEST_OPTION_SCOPE_NETWORK )
+            b_preparse = true;
+        break;
+    }
 
-    for( ;; )
+    if( !b_preparse )
     {
-        preparser_entry_t *p_entry;
+        task->status = ITEM_PREPARSE_SKIPPED;
+        return VLC_SUCCESS;
+    }
 
-        vlc_mutex_lock( &p_preparser->lock );
-        /* */
-        p_preparser->input_state = INPUT_RUNNING;
-        if( p_preparser->i_waiting > 0 )
-        {
-            p_entry = p_preparser->pp_waiting[0];
-            p_preparser->input_id = p_entry->id;
-            REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, 0 );
-        }
-        else
-        {
-            p_preparser->b_live = false;
-            p_preparser->input_id = NULL;
-            vlc_cond_signal( &p_preparser->wait );
-            vlc_mutex_unlock( &p_preparser->lock );
-            break;
-        }
-        vlc_mutex_unlock( &p_preparser->lock );
-        assert( p_entry );
+    /* Do not preparse if it is already done (like by playing it) */
+    if( input_item_IsPreparsed( p_item ) )
+        return VLC_SUCCESS;
 
-        Preparse( p_preparser, p_entry );
+    /* Do not open the file again if its meta data are in the cache */
+    if( preparser->b_cache && i_type == ITEM_TYPE_FILE
+     && playlist_FindMetaInCache( preparser->object, p_item ) == VLC_SUCCESS )
+    {
+        task->status = ITEM_PREPARSE_DONE;
+        return VLC_SUCCESS;
+    }
 
-        Art( p_preparser, p_entry->p_item );
-        vlc_gc_decref( p_entry->p_item );
-        free( p_entry );
+    task->input = input_CreatePreparser( preparser->object, p_item );
+    if( task->input == NULL )
+    {
+        task->status = ITEM_PREPARSE_FAILED;
+        return VLC_SUCCESS;
+    }
+
+    atomic_store( &task->b_stopped, false );
+    vlc_event_attach( &p_item->event_manager, vlc_InputItemSubItemTreeAdded,
+                      SubItemTreeAdded, task );
+    var_AddCallback( task->input, "intf-event", InputEvent, task );
+    if( input_Start( task->input ) == VLC_SUCCESS )
+        task->status = ITEM_PREPARSE_DONE;
+    else
+    {
+        atomic_store( &task->b_stopped, true );
+        task->status = ITEM_PREPARSE_FAILED;
     }
-    return NULL;
+    return VLC_SUCCESS;
 }
 
+static int ProbePreparse( void *owner, void *handle )
+{
+    preparser_task_t *task = handle;
+
+    (void) owner;
+    return atomic_load( &task->b_stopped );
+}
+
+/**
+ * This function ends the preparsing of an item, either because the input
+ * stopped, or because it timed out or was cancelled.
+ */
+static void StopPreparse( void *owner, void *handle )
+{
+    playlist_preparser_t *preparser = owner;
+    preparser_task_t *task = handle;
+    input_item_t *p_item = task->p_entry->p_item;
+
+    if( task->input != NULL )
+    {
+        var_DelCallback( task->input, "intf-event", InputEvent, task );
+        if( !atomic_load( &task->b_stopped ) )
+        {
+            task->status = ITEM_PREPARSE_TIMEOUT;
+            input_Stop( task->input );
+        }
+        input_Close( task->input );
+        vlc_event_detach( &p_item->event_manager,
+                          vlc_InputItemSubItemTreeAdded,
+                          SubItemTreeAdded, task );
+
+        if( preparser->b_cache && task->status == ITEM_PREPARSE_DONE
+         && !task->b_subitems
+         && playlist_SaveMetaToCache( preparser->object,
+                                      p_item ) == VLC_SUCCESS
+         && atomic_fetch_add( &preparser->i_cache_saves,
+                              1 ) % CACHE_PRUNE_INTERVAL == 0 )
+            playlist_PruneMetaCache( preparser->object,
+                                     preparser->i_cache_size );
+    }
+
+    if( task->input != NULL || task->status == ITEM_PREPARSE_DONE )
+    {
+        var_SetAddress( preparser->object, "item-change", p_item );
+        input_item_SetPreparsed( p_item, true );
+    }
+    if( task->status != -1 )
+        input_item_SignalPreparseEnded( p_item, task->status );
+
+    Art( preparser, p_item );
+    free( task );
+}
@@ -24,6 +24,7 @@
 # include "config.h"
 #endif
 #include <assert.h>
+#include <wctype.h>
 
 #include <vlc_common.h>
 #include <vlc_playlist.h>
@@ -34,6 +35,540 @@
  * Item search functions
  ***************************************************************************/
 
+/***************************************************************************
+ * Search index
+ ***************************************************************************/
+
+/* The search index keeps, for each playlist item, the case-folded title (or
+ * name), album and artist the live search matches against, and an inverted
+ * index of their byte trigrams. Trigrams are hashed to a fixed number of
+ * posting lists: collisions and stale postings only add candidates, which
+ * are always checked against the folded key.
+ *
+ * Keys are (re)computed lazily, at search time, for the items added or whose
+ * meta data changed since the previous search. */
+#define SEARCH_GRAM_BITS    16
+#define SEARCH_GRAM_BUCKETS (1 << SEARCH_GRAM_BITS)
+
+typedef struct search_entry_t search_entry_t;
+
+struct search_entry_t
+{
+    search_entry_t  *p_next;    /**< hash chain */
+    playlist_item_t *p_item;
+    char            *psz_key;   /**< folded title, album and artist */
+    unsigned         i_grams;   /**< number of postings of this entry */
+    unsigned         i_stamp;   /**< last search that checked this entry */
+    bool             b_match;
+};
+
+typedef DECL_ARRAY(int) search_ids_t;
+
+struct playlist_search_index
+{
+    vlc_mutex_t      lock;       /**< protects the dirty inputs only */
+    DECL_ARRAY(input_item_t *) dirty;
+    bool             b_active;   /**< the live search was used */
+
+    search_entry_t **pp_buckets; /**< entries by item ID */
+    size_t           i_buckets;
+    size_t           i_entries;
+
+    search_ids_t    *p_postings; /**< item IDs by trigram hash */
+    size_t           i_postings;
+    size_t           i_stale;    /**< postings of removed or updated keys */
+
+    unsigned         i_generation; /**< bumped whenever a key changes */
+    unsigned         i_stamp;
+
+    char            *psz_last;     /**< folded previous search */
+    unsigned         i_last_generation;
+    search_ids_t     matches;      /**< items matching the previous search */
+};
+
+/**
+ * Case-folds an UTF-8 string, the way vlc_strcasestr() compares characters.
+ */
+static char *SearchFold( const char *psz )
+{
+    size_t i_len = strlen( psz );
+    /* towlower() never needs more than 4 bytes per code point */
+    char *psz_fold = malloc( 4 * i_len + 1 ), *out = psz_fold;
+    if( unlikely(psz_fold == NULL) )
+        return NULL;
+
+    while( *psz )
+    {
+        uint32_t cp;
+        size_t i_char = vlc_towc( psz, &cp );
+
+        if( unlikely(i_char == (size_t)-1) )
+        {   /* Invalid sequence: keep the byte as is */
+            *(out++) = *(psz++);
+            continue;
+        }
+        psz += i_char;
+        cp = towlower( cp );
+
+        if( cp < 0x80 )
+            *(out++) = cp;
+        else if( cp < 0x800 )
+        {
+            *(out++) = 0xC0 | (cp >> 6);
+            *(out++) = 0x80 | (cp & 0x3F);
+        }
+        else if( cp < 0x10000 )
+        {
+            *(out++) = 0xE0 | (cp >> 12);
+            *(out++) = 0x80 | ((cp >> 6) & 0x3F);
+            *(out++) = 0x80 | (cp & 0x3F);
+        }
+        else
+        {
+            *(out++) = 0xF0 | (cp >> 18);
+            *(out++) = 0x80 | ((cp >> 12) & 0x3F);
+            *(out++) = 0x80 | ((cp >> 6) & 0x3F);
+            *(out++) = 0x80 | (cp & 0x3F);
+        }
+    }
+    *out = '\0';
+    return psz_fold;
+}
+
+/**
+ * Builds the folded key of a playlist item, from the same meta data as the
+ * live search: title (or name), album and artist.
+ */
+static char *SearchItemKey( playlist_item_t *p_item )
+{
+    input_item_t *p_input = p_item->p_input;
+    char *psz_raw;
+    int i_ret;
+
+    vlc_mutex_lock( &p_input->lock );
+    if( p_input->p_meta )
+    {
+        const char *psz_title = vlc_meta_Get( p_input->p_meta, vlc_meta_Title );
+        if( !psz_title )
+            psz_title = p_input->psz_name;
+        const char *psz_album = vlc_meta_Get( p_input->p_meta, vlc_meta_Album );
+        const char *psz_artist = vlc_meta_Get( p_input->p_meta, vlc_meta_Artist );
+
+        /* Fields are separated so that no match spans two of them */
+        i_ret = asprintf( &psz_raw, "%s\n%s\n%s",
+                          psz_title ? psz_title : "",
+                          psz_album ? psz_album : "",
+                          psz_artist ? psz_artist : "" );
+    }
+    else
+        i_ret = asprintf( &psz_raw, "%s",
+                          p_input->psz_name ? p_input->psz_name : "" );
+    vlc_mutex_unlock( &p_input->lock );
+
+    if( i_ret == -1 )
+        return NULL;
+
+    char *psz_key = SearchFold( psz_raw );
+    free( psz_raw );
+    return psz_key;
+}
+
+static inline unsigned SearchGramHash( const char *psz )
+{
+    uint32_t i_gram = ((uint8_t)psz[0] << 16) | ((uint8_t)psz[1] << 8)
+                    | (uint8_t)psz[2];
+    return (i_gram * 2654435761u) >> (32 - SEARCH_GRAM_BITS);
+}
+
+static inline size_t SearchIdHash( struct playlist_search_index *p_index,
+                                   int i_id )
+{
+    return ((unsigned)i_id * 2654435761u) & (p_index->i_buckets - 1);
+}
+
+static search_entry_t *SearchEntryGet( struct playlist_search_index *p_index,
+                                       int i_id )
+{
+    if( p_index->i_buckets == 0 )
+        return NULL;
+
+    search_entry_t *p_entry = p_index->pp_buckets[SearchIdHash( p_index, i_id )];
+    while( p_entry != NULL && p_entry->p_item->i_id != i_id )
+        p_entry = p_entry->p_next;
+    return p_entry;
+}
+
+static void SearchEntryInsert( struct playlist_search_index *p_index,
+                               search_entry_t *p_entry )
+{
+    if( p_index->i_entries >= p_index->i_buckets )
+    {   /* Grow the table */
+        size_t i_buckets = p_index->i_buckets ? 2 * p_index->i_buckets : 1024;
+        search_entry_t **pp_buckets = calloc( i_buckets, sizeof(*pp_buckets) );
+
+        if( likely(pp_buckets != NULL) )
+        {
+            size_t i_old = p_index->i_buckets;
+            search_entry_t **pp_old = p_index->pp_buckets;
+
+            p_index->pp_buckets = pp_buckets;
+            p_index->i_buckets = i_buckets;
+            for( size_t i = 0; i < i_old; i++ )
+                for( search_entry_t *e = pp_old[i], *next; e != NULL; e = next )
+                {
+                    size_t h = SearchIdHash( p_index, e->p_item->i_id );
+                    next = e->p_next;
+                    e->p_next = pp_buckets[h];
+                    pp_buckets[h] = e;
+                }
+            free( pp_old );
+        }
+        else if( p_index->i_buckets == 0 )
+            abort();
+    }
+
+    size_t h = SearchIdHash( p_index, p_entry->p_item->i_id );
+    p_entry->p_next = p_index->pp_buckets[h];
+    p_index->pp_buckets[h] = p_entry;
+    p_index->i_entries++;
+}
+
+static void SearchEntryAddPostings( struct playlist_search_index *p_index,
+                                    search_entry_t *p_entry )
+{
+    size_t i_len = strlen( p_entry->psz_key );
+
+    p_entry->i_grams = 0;
+    for( size_t i = 0; i + 3 <= i_len; i++ )
+    {
+        search_ids_t *p_ids = &p_index->p_postings[SearchGramHash( &p_entry->psz_key[i] )];
+
+        /* Keys usually repeat few trigrams: only skip direct duplicates */
+        if( p_ids->i_size > 0
+         && p_ids->p_elems[p_ids->i_size - 1] == p_entry->p_item->i_id )
+            continue;
+        ARRAY_APPEND( (*p_ids), p_entry->p_item->i_id );
+        p_entry->i_grams++;
+    }
+    p_index->i_postings += p_entry->i_grams;
+}
+
+/**
+ * Rebuilds the posting lists once they mostly refer to stale keys.
+ */
+static void SearchIndexCompact( struct playlist_search_index *p_index )
+{
+    if( p_index->i_stale < 1024 || p_index->i_stale < p_index->i_postings / 2 )
+        return;
+
+    for( size_t i = 0; i < SEARCH_GRAM_BUCKETS; i++ )
+        p_index->p_postings[i].i_size = 0;
+    p_index->i_postings = 0;
+    p_index->i_stale = 0;
+
+    for( size_t i = 0; i < p_index->i_buckets; i++ )
+        for( search_entry_t *e = p_index->pp_buckets[i]; e != NULL; e = e->p_next )
+            SearchEntryAddPostings( p_index, e );
+}
+
+/**
+ * (Re)computes the key of an item.
+ */
+static void SearchIndexItem( struct playlist_search_index *p_index,
+                             playlist_item_t *p_item )
+{
+    char *psz_key = SearchItemKey( p_item );
+    if( unlikely(psz_key == NULL) )
+        return;
+
+    search_entry_t *p_entry = SearchEntryGet( p_index, p_item->i_id );
+    if( p_entry != NULL )
+    {
+        assert( p_entry->p_item == p_item );
+        if( !strcmp( p_entry->psz_key, psz_key ) )
+        {
+            free( psz_key );
+            return;
+        }
+        free( p_entry->psz_key );
+        p_index->i_stale += p_entry->i_grams;
+    }
+    else
+    {
+        p_entry = malloc( sizeof(*p_entry) );
+        if( unlikely(p_entry == NULL) )
+        {
+            free( psz_key );
+            return;
+        }
+        p_entry->p_item = p_item;
+        p_entry->i_stamp = p_index->i_stamp;
+        p_entry->b_match = false;
+        SearchEntryInsert( p_index, p_entry );
+    }
+    p_entry->psz_key = psz_key;
+    SearchEntryAddPostings( p_index, p_entry );
+    p_index->i_generation++;
+}
+
+static void SearchIndexNode( struct playlist_search_index *p_index,
+                             playlist_item_t *p_node )
+{
+    for( int i = 0; i < p_node->i_children; i++ )
+    {
+        playlist_item_t *p_item = p_node->pp_children[i];
+
+        SearchIndexItem( p_index, p_item );
+        if( p_item->i_children >= 0 )
+            SearchIndexNode( p_index, p_item );
+    }
+}
+
+/**
+ * (Re)computes the keys of the items added or changed since the last search.
+ * Called with the playlist lock held.
+ */
+static void SearchIndexUpdate( playlist_t *p_playlist )
+{
+    struct playlist_search_index *p_index = pl_priv(p_playlist)->p_search;
+    DECL_ARRAY(input_item_t *) dirty;
+
+    if( p_index->p_postings == NULL )
+    {   /* First search: index the whole playlist */
+        p_index->p_postings = calloc( SEARCH_GRAM_BUCKETS,
+                                      sizeof(*p_index->p_postings) );
+        if( unlikely(p_index->p_postings == NULL) )
+            abort();
+
+        vlc_mutex_lock( &p_index->lock );
+        p_index->b_active = true;
+        vlc_mutex_unlock( &p_index->lock );
+
+        SearchIndexNode( p_index, p_playlist->p_root );
+    }
+
+    vlc_mutex_lock( &p_index->lock );
+    dirty.i_alloc = p_index->dirty.i_alloc;
+    dirty.i_size = p_index->dirty.i_size;
+    dirty.p_elems = p_index->dirty.p_elems;
+    ARRAY_INIT( p_index->dirty );
+    vlc_mutex_unlock( &p_index->lock );
+
+    for( int i = 0; i < dirty.i_size; i++ )
+    {
+        /* The item may have been removed since */
+        playlist_item_t *p_item =
+            playlist_ItemGetByInput( p_playlist, dirty.p_elems[i] );
+        if( p_item != NULL )
+            SearchIndexItem( p_index, p_item );
+    }
+    ARRAY_RESET( dirty );
+
+    SearchIndexCompact( p_index );
+}
+
+void playlist_SearchIndexInit( playlist_t *p_playlist )
+{
+    struct playlist_search_index *p_index = malloc( sizeof(*p_index) );
+
+    /* Without index, the live search scans the whole tree */
+    pl_priv(p_playlist)->p_search = p_index;
+    if( unlikely(p_index == NULL) )
+        return;
+
+    vlc_mutex_init( &p_index->lock );
+    ARRAY_INIT( p_index->dirty );
+    p_index->b_active = false;
+    p_index->pp_buckets = NULL;
+    p_index->i_buckets = 0;
+    p_index->i_entries = 0;
+    p_index->p_postings = NULL;
+    p_index->i_postings = 0;
+    p_index->i_stale = 0;
+    p_index->i_generation = 0;
+    p_index->i_stamp = 0;
+    p_index->psz_last = NULL;
+    p_index->i_last_generation = 0;
+    ARRAY_INIT( p_index->matches );
+}
+
+void playlist_SearchIndexClean( playlist_t *p_playlist )
+{
+    struct playlist_search_index *p_index = pl_priv(p_playlist)->p_search;
+    if( p_index == NULL )
+        return;
+
+    for( size_t i = 0; i < p_index->i_buckets; i++ )
+        for( search_entry_t *e = p_index->pp_buckets[i], *next; e != NULL; e = next )
+        {
+            next = e->p_next;
+            free( e->psz_key );
+            free( e );
+        }
+    free( p_index->pp_buckets );
+
+    if( p_index->p_postings != NULL )
+        for( size_t i = 0; i < SEARCH_GRAM_BUCKETS; i++ )
+            ARRAY_RESET( p_index->p_postings[i] );
+    free( p_index->p_postings );
+
+    free( p_index->psz_last );
+    ARRAY_RESET( p_index->matches );
+    ARRAY_RESET( p_index->dirty );
+    vlc_mutex_destroy( &p_index->lock );
+    free( p_index );
+    pl_priv(p_playlist)->p_search = NULL;
+}
+
+void playlist_SearchIndexChanged( playlist_t *p_playlist,
+                                  input_item_t *p_input )
+{
+    struct playlist_search_index *p_index = pl_priv(p_playlist)->p_search;
+    if( p_index == NULL )
+        return;
+
+    vlc_mutex_lock( &p_index->lock );
+    /* Until the first search, the index is built from the whole tree */
+    if( p_index->b_active && ( p_index->dirty.i_size == 0
+     || p_index->dirty.p_elems[p_index->dirty.i_size - 1] != p_input ) )
+        ARRAY_APPEND( p_index->dirty, p_input );
+    vlc_mutex_unlock( &p_index->lock );
+}
+
+void playlist_SearchIndexRemove( playlist_t *p_playlist,
+                                 playlist_item_t *p_item )
+{
+    struct playlist_search_index *p_index = pl_priv(p_playlist)->p_search;
+
+    PL_ASSERT_LOCKED;
+    if( p_index == NULL || p_index->i_buckets == 0 )
+        return;
+
+    search_entry_t **pp = &p_index->pp_buckets[SearchIdHash( p_index, p_item->i_id )];
+    while( *pp != NULL && (*pp)->p_item != p_item )
+        pp = &(*pp)->p_next;
+    if( *pp == NULL )
+        return;
+
+    search_entry_t *p_entry = *pp;
+    *pp = p_entry->p_next;
+    p_index->i_entries--;
+    p_index->i_stale += p_entry->i_grams;
+    p_index->i_generation++;
+    free( p_entry->psz_key );
+    free( p_entry );
+}
+
+/**
+ * Checks one candidate against the folded search string.
+ */
+static void SearchCheck( struct playlist_search_index *p_index,
+                         search_entry_t *p_entry, const char *psz_fold )
+{
+    if( p_entry->i_stamp == p_index->i_stamp )
+        return; /* already checked (duplicate posting) */
+    p_entry->i_stamp = p_index->i_stamp;
+    p_entry->b_match = strstr( p_entry->psz_key, psz_fold ) != NULL;
+    if( p_entry->b_match )
+        ARRAY_APPEND( p_index->matches, p_entry->p_item->i_id );
+}
+
+/**
+ * Finds the items matching a search string, using the previous results when
+ * the search string was only refined, or the rarest trigram otherwise.
+ */
+static void SearchIndexQuery( struct playlist_search_index *p_index,
+                              const char *psz_fold )
+{
+    size_t i_len = strlen( psz_fold );
+    search_ids_t previous;
+    search_ids_t *p_candidates = NULL;
+
+    /* Refined search (i.e. typing more characters): only the previous
+     * matches can match */
+    if( p_index->psz_last != NULL
+     && p_index->i_last_generation == p_index->i_generation
+     && strstr( psz_fold, p_index->psz_last ) != NULL )
+        p_candidates = &previous;
+
+    previous = p_index->matches;
+    ARRAY_INIT( p_index->matches );
+    if( ++p_index->i_stamp == 0 )
+        p_index->i_stamp = 1;
+
+    if( p_candidates == NULL && i_len >= 3 )
+    {
+        for( size_t i = 0; i + 3 <= i_len; i++ )
+        {
+            search_ids_t *p_ids = &p_index->p_postings[SearchGramHash( &psz_fold[i] )];
+            if( p_candidates == NULL || p_ids->i_size < p_candidates->i_size )
+                p_candidates = p_ids;
+        }
+    }
+
+    if( p_candidates != NULL )
+    {
+        for( int i = 0; i < p_candidates->i_size; i++ )
+        {
+            search_entry_t *p_entry =
+                SearchEntryGet( p_index, p_candidates->p_elems[i] );
+            if( p_entry != NULL )
+                SearchCheck( p_index, p_entry, psz_fold );
+        }
+    }
+    else
+    {
+        for( size_t i = 0; i < p_index->i_buckets; i++ )
+            for( search_entry_t *e = p_index->pp_buckets[i]; e != NULL; e = e->p_next )
+                SearchCheck( p_index, e, psz_fold );
+    }
+    ARRAY_RESET( previous );
+
+    free( p_index->psz_last );
+    p_index->psz_last = strdup( psz_fold );
+    p_index->i_last_generation = p_index->i_generation;
+}
+
+/**
+ * Enable/Disable items in the playlist according to the results of the
+ * last query of the index
+ * @param p_root: the current root item
+ * @return true if an item match
+ */
+static bool playlist_LiveSearchUpdateIndexed( struct playlist_search_index *p_index,
+                                              playlist_item_t *p_root,
+                                              bool b_recursive )
+{
+    bool b_match = false;
+    for( int i = 0 ; i < p_root->i_children ; i ++ )
+    {
+        bool b_enable = false;
+        playlist_item_t *p_item = p_root->pp_children[i];
+        // Go recursively if there are some children
+        if( b_recursive && p_item->i_children >= 0 &&
+            playlist_LiveSearchUpdateIndexed( p_index, p_item, true ) )
+        {
+            b_enable = true;
+        }
+
+        if( !b_enable )
+        {
+            search_entry_t *p_entry = SearchEntryGet( p_index, p_item->i_id );
+            b_enable = p_entry != NULL && p_entry->p_item == p_item
+                    && p_entry->i_stamp == p_index->i_stamp
+                    && p_entry->b_match;
+        }
+
+        if( b_enable )
+            p_item->i_flags &= ~PLAYLIST_DBL_FLAG;
+        else
+            p_item->i_flags |= PLAYLIST_DBL_FLAG;
+
+        b_match |= b_enable;
+   }
+   return b_match;
+}
+
 /***************************************************************************
  * Live search handling
  ***************************************************************************/
@@ -121,7 +656,18 @@ int playlist_LiveSearchUpdate( playlist_t *p_playlist, playlist_item_t *p_root,
 {
     PL_ASSERT_LOCKED;
     pl_priv(p_playlist)->b_reset_currently_playing = true;
-    if( *psz_string )
+    struct playlist_search_index *p_index = pl_priv(p_playlist)->p_search;
+    char *psz_fold = NULL;
+
+    if( *psz_string && p_index != NULL
+     && (psz_fold = SearchFold( psz_string )) != NULL )
+    {
+        SearchIndexUpdate( p_playlist );
+        SearchIndexQuery( p_index, psz_fold );
+        playlist_LiveSearchUpdateIndexed( p_index, p_root, b_recursive );
+        free( psz_fold );
+    }
+    else if( *psz_string )
         playlist_LiveSearchUpdateInternal( p_root, psz_string, b_recursive );
     else
         playlist_LiveSearchClean( p_root );
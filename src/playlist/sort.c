@@ -26,6 +26,8 @@
 # include "config.h"
 #endif
 
+#include <ctype.h>
+
 #include <vlc_common.h>
 #include <vlc_rand.h>
 #define  VLC_INTERNAL_PLAYLIST_SORT_FUNCTIONS
@@ -33,77 +35,161 @@
 #include "playlist_internal.h"
 
 
+/* Sort keys */
+
+/* Keys are fetched from the input items once per sort, before sorting
+ * (instead of twice per comparison), and are stored lower-cased so that
+ * plain strcmp() compares them like strcasecmp() would. */
+enum
+{
+    KEY_TITLE, /* title, or name if there is no title */
+    KEY_URI,
+    KEY_ALBUM,
+    KEY_ARTIST,
+    KEY_DATE,
+    KEY_DESCRIPTION,
+    KEY_GENRE,
+    KEY_RATING,
+    KEY_TRACK_NUMBER,
+    KEY_DISC_NUMBER,
+    KEY_DURATION,
+    KEY_COUNT
+};
+
+static const vlc_meta_type_t key_meta[KEY_COUNT] =
+{
+    [KEY_ALBUM]        = vlc_meta_Album,
+    [KEY_ARTIST]       = vlc_meta_Artist,
+    [KEY_DATE]         = vlc_meta_Date,
+    [KEY_DESCRIPTION]  = vlc_meta_Description,
+    [KEY_GENRE]        = vlc_meta_Genre,
+    [KEY_RATING]       = vlc_meta_Rating,
+    [KEY_TRACK_NUMBER] = vlc_meta_TrackNumber,
+    [KEY_DISC_NUMBER]  = vlc_meta_DiscNumber,
+};
+
+typedef struct
+{
+    playlist_item_t *p_item;
+    char *ppsz_key[KEY_COUNT];  /**< lower-cased keys, NULL if missing */
+    int   pi_key[KEY_COUNT];    /**< integer values of the keys */
+    mtime_t i_duration;
+} sort_entry_t;
+
+static void sort_entry_Load( sort_entry_t *p_entry, unsigned i_key )
+{
+    input_item_t *p_input = p_entry->p_item->p_input;
+    char *psz;
+
+    switch( i_key )
+    {
+        case KEY_TITLE:
+            psz = input_item_GetTitleFbName( p_input );
+            break;
+        case KEY_URI:
+            psz = input_item_GetURI( p_input );
+            break;
+        case KEY_DURATION:
+            p_entry->i_duration = input_item_GetDuration( p_input );
+            return;
+        default:
+            psz = input_item_GetMeta( p_input, key_meta[i_key] );
+            break;
+    }
+
+    p_entry->ppsz_key[i_key] = psz;
+    p_entry->pi_key[i_key] = psz ? atoi( psz ) : 0;
+    for( ; psz != NULL && *psz; psz++ )
+        *psz = tolower( (unsigned char)*psz );
+}
+
+static inline const char *sort_entry_Key( const sort_entry_t *p_entry,
+                                          unsigned i_key )
+{
+    return p_entry->ppsz_key[i_key];
+}
+
+static void sort_entry_Clean( sort_entry_t *p_entry )
+{
+    for( unsigned i = 0; i < KEY_COUNT; i++ )
+        free( p_entry->ppsz_key[i] );
+}
+
 /* General comparison functions */
 /**
- * Compare two items using their title or name
+ * Compare two items using one of their string keys
  * @param first: the first item
  * @param second: the second item
+ * @param i_key: the key to compare
  * @return -1, 0 or 1 like strcmp
  */
-static inline int meta_strcasecmp_title( const playlist_item_t *first,
-                              const playlist_item_t *second )
+static inline int key_strcasecmp( const sort_entry_t *first,
+                                  const sort_entry_t *second, unsigned i_key )
 {
-    int i_ret;
-    char *psz_first = input_item_GetTitleFbName( first->p_input );
-    char *psz_second = input_item_GetTitleFbName( second->p_input );
+    const char *psz_first = sort_entry_Key( first, i_key );
+    const char *psz_second = sort_entry_Key( second, i_key );
 
     if( psz_first && psz_second )
-        i_ret = strcasecmp( psz_first, psz_second );
+        return strcmp( psz_first, psz_second );
     else if( !psz_first && psz_second )
-        i_ret = 1;
+        return 1;
     else if( psz_first && !psz_second )
-        i_ret = -1;
+        return -1;
     else
-        i_ret = 0;
-    free( psz_first );
-    free( psz_second );
+        return 0;
+}
 
-    return i_ret;
+/**
+ * Compare two items using their title or name
+ * @param first: the first item
+ * @param second: the second item
+ * @return -1, 0 or 1 like strcmp
+ */
+static inline int meta_strcasecmp_title( const sort_entry_t *first,
+                                         const sort_entry_t *second )
+{
+    return key_strcasecmp( first, second, KEY_TITLE );
 }
 
 /**
  * Compare two intems according to the given meta type
  * @param first: the first item
  * @param second: the second item
- * @param meta: the meta type to use to sort the items
+ * @param i_key: the meta key to use to sort the items
  * @param b_integer: true if the meta are integers
  * @return -1, 0 or 1 like strcmp
  */
-static inline int meta_sort( const playlist_item_t *first,
-                             const playlist_item_t *second,
-                             vlc_meta_type_t meta, bool b_integer )
+static inline int meta_sort( const sort_entry_t *first,
+                             const sort_entry_t *second,
+                             unsigned i_key, bool b_integer )
 {
-    int i_ret;
-    char *psz_first = input_item_GetMeta( first->p_input, meta );
-    char *psz_second = input_item_GetMeta( second->p_input, meta );
+    int i_first = first->p_item->i_children;
+    int i_second = second->p_item->i_children;
 
     /* Nodes go first */
-    if( first->i_children == -1 && second->i_children >= 0 )
-        i_ret = 1;
-    else if( first->i_children >= 0 && second->i_children == -1 )
-       i_ret = -1;
+    if( i_first == -1 && i_second >= 0 )
+        return 1;
+    else if( i_first >= 0 && i_second == -1 )
+       return -1;
     /* Both are nodes, sort by name */
-    else if( first->i_children >= 0 && second->i_children >= 0 )
-        i_ret = meta_strcasecmp_title( first, second );
+    else if( i_first >= 0 && i_second >= 0 )
+        return meta_strcasecmp_title( first, second );
+
+    const char *psz_first = sort_entry_Key( first, i_key );
+    const char *psz_second = sort_entry_Key( second, i_key );
+
     /* Both are items */
-    else if( !psz_first && psz_second )
-        i_ret = 1;
+    if( !psz_first && psz_second )
+        return 1;
     else if( psz_first && !psz_second )
-        i_ret = -1;
+        return -1;
     /* No meta, sort by name */
     else if( !psz_first && !psz_second )
-        i_ret = meta_strcasecmp_title( first, second );
+        return meta_strcasecmp_title( first, second );
+    else if( b_integer )
+        return first->pi_key[i_key] - second->pi_key[i_key];
     else
-    {
-        if( b_integer )
-            i_ret = atoi( psz_first ) - atoi( psz_second );
-        else
-            i_ret = strcasecmp( psz_first, psz_second );
-    }
-
-    free( psz_first );
-    free( psz_second );
-    return i_ret;
+        return strcmp( psz_first, psz_second );
 }
 
 /* Comparison functions */
@@ -124,20 +210,71 @@ static inline sortfn_t find_sorting_fn( unsigned i_mode, unsigned i_type )
     return sorting_fns[i_mode][i_type];
 }
 
+/* Keys read by the comparison function of each SORT_* mode. Nodes and items
+ * without the meta are compared by title, hence KEY_TITLE almost everywhere.
+ */
+#define KEY( k ) (1 << KEY_##k)
+static const unsigned sorting_keys[NUM_SORT_FNS] =
+{
+    [SORT_ID]                = 0,
+    [SORT_TITLE]             = KEY(TITLE),
+    [SORT_TITLE_NODES_FIRST] = KEY(TITLE),
+    [SORT_ARTIST]            = KEY(ARTIST) | KEY(DATE) | KEY(ALBUM)
+                             | KEY(TRACK_NUMBER) | KEY(TITLE),
+    [SORT_GENRE]             = KEY(GENRE) | KEY(TITLE),
+    [SORT_DURATION]          = KEY(DURATION),
+    [SORT_TITLE_NUMERIC]     = KEY(TITLE),
+    [SORT_ALBUM]             = KEY(ALBUM) | KEY(TRACK_NUMBER) | KEY(TITLE),
+    [SORT_TRACK_NUMBER]      = KEY(TRACK_NUMBER) | KEY(TITLE),
+    [SORT_DESCRIPTION]       = KEY(DESCRIPTION) | KEY(TITLE),
+    [SORT_RATING]            = KEY(RATING) | KEY(TITLE),
+    [SORT_URI]               = KEY(URI),
+    [SORT_DISC_NUMBER]       = KEY(DISC_NUMBER) | KEY(TITLE),
+    [SORT_DATE]              = KEY(DATE) | KEY(ALBUM) | KEY(TRACK_NUMBER)
+                             | KEY(TITLE),
+};
+#undef KEY
+
 /**
- * Sort an array of items recursively
+ * Sort an array of items
  * @param i_items: number of items
  * @param pp_items: the array of items
  * @param p_sortfn: the sorting function
- * @return nothing
+ * @param i_keys: bit mask of the keys read by the sorting function
+ * @return VLC_SUCCESS on success
  */
 static inline
-void playlist_ItemArraySort( unsigned i_items, playlist_item_t **pp_items,
-                             sortfn_t p_sortfn )
+int playlist_ItemArraySort( unsigned i_items, playlist_item_t **pp_items,
+                            sortfn_t p_sortfn, unsigned i_keys )
 {
     if( p_sortfn )
     {
-        qsort( pp_items, i_items, sizeof( pp_items[0] ), p_sortfn );
+        if( i_items < 2 )
+            return VLC_SUCCESS;
+
+        sort_entry_t *p_entries = malloc( i_items * sizeof( *p_entries ) );
+        if( unlikely(p_entries == NULL) )
+            return VLC_ENOMEM;
+
+        for( unsigned i = 0; i < i_items; i++ )
+        {
+            p_entries[i].p_item = pp_items[i];
+            for( unsigned j = 0; j < KEY_COUNT; j++ )
+            {
+                p_entries[i].ppsz_key[j] = NULL;
+                if( i_keys & (1 << j) )
+                    sort_entry_Load( &p_entries[i], j );
+            }
+        }
+
+        qsort( p_entries, i_items, sizeof( p_entries[0] ), p_sortfn );
+
+        for( unsigned i = 0; i < i_items; i++ )
+        {
+            pp_items[i] = p_entries[i].p_item;
+            sort_entry_Clean( &p_entries[i] );
+        }
+        free( p_entries );
     }
     else /* Randomise */
     {
@@ -153,6 +290,7 @@ void playlist_ItemArraySort( unsigned i_items, playlist_item_t **pp_items,
             pp_items[i_new] = p_temp;
         }
     }
+    return VLC_SUCCESS;
 }
 
 
@@ -162,19 +300,22 @@ void playlist_ItemArraySort( unsigned i_items, playlist_item_t **pp_items,
  * @param p_playlist the playlist
  * @param p_node the node to sort
  * @param p_sortfn the sorting function
+ * @param i_keys bit mask of the keys read by the sorting function
  * @return VLC_SUCCESS on success
  */
 static int recursiveNodeSort( playlist_t *p_playlist, playlist_item_t *p_node,
-                              sortfn_t p_sortfn )
+                              sortfn_t p_sortfn, unsigned i_keys )
 {
     int i;
-    playlist_ItemArraySort(p_node->i_children,p_node->pp_children,p_sortfn);
+    if( playlist_ItemArraySort( p_node->i_children, p_node->pp_children,
+                                p_sortfn, i_keys ) )
+        return VLC_ENOMEM;
     for( i = 0 ; i< p_node->i_children; i++ )
     {
-        if( p_node->pp_children[i]->i_children != -1 )
-        {
-            recursiveNodeSort( p_playlist, p_node->pp_children[i], p_sortfn );
-        }
+        if( p_node->pp_children[i]->i_children != -1 &&
+            recursiveNodeSort( p_playlist, p_node->pp_children[i], p_sortfn,
+                               i_keys ) )
+            return VLC_ENOMEM;
     }
     return VLC_SUCCESS;
 }
@@ -199,13 +340,15 @@ int playlist_RecursiveNodeSort( playlist_t *p_playlist, playlist_item_t *p_node,
     pl_priv(p_playlist)->b_reset_currently_playing = true;
 
     /* Do the real job recursively */
-    return recursiveNodeSort(p_playlist,p_node,find_sorting_fn(i_mode,i_type));
+    sortfn_t p_sortfn = find_sorting_fn( i_mode, i_type );
+    return recursiveNodeSort( p_playlist, p_node, p_sortfn,
+                              p_sortfn ? sorting_keys[i_mode] : 0 );
 }
 
 
 /* This is the stuff the sorting functions are made of. The proto_##
  * functions are wrapped in cmp_a_## and cmp_d_## functions that do
- * void * to const playlist_item_t * casting and dereferencing and
+ * void * to const sort_entry_t * casting and dereferencing and
  * cmp_d_## inverts the result, too. proto_## are static inline,
  * cmp_[ad]_## are merely static as they're the target of pointers.
  *
@@ -214,21 +357,21 @@ int playlist_RecursiveNodeSort( playlist_t *p_playlist, playlist_item_t *p_node,
  */
 
 #define SORTFN( SORT, first, second ) static inline int proto_##SORT \
-	( const playlist_item_t *first, const playlist_item_t *second )
+	( const sort_entry_t *first, const sort_entry_t *second )
 
 SORTFN( SORT_ALBUM, first, second )
 {
-    int i_ret = meta_sort( first, second, vlc_meta_Album, false );
+    int i_ret = meta_sort( first, second, KEY_ALBUM, false );
     /* Items came from the same album: compare the track numbers */
     if( i_ret == 0 )
-        i_ret = meta_sort( first, second, vlc_meta_TrackNumber, true );
+        i_ret = meta_sort( first, second, KEY_TRACK_NUMBER, true );
 
     return i_ret;
 }
 
 SORTFN( SORT_DATE, first, second )
 {
-    int i_ret = meta_sort( first, second, vlc_meta_Date, true );
+    int i_ret = meta_sort( first, second, KEY_DATE, true );
     /* Items came from the same date: compare the albums */
     if( i_ret == 0 )
         i_ret = proto_SORT_ALBUM( first, second );
@@ -238,7 +381,7 @@ SORTFN( SORT_DATE, first, second )
 
 SORTFN( SORT_ARTIST, first, second )
 {
-    int i_ret = meta_sort( first, second, vlc_meta_Artist, false );
+    int i_ret = meta_sort( first, second, KEY_ARTIST, false );
     /* Items came from the same artist: compare the dates */
     if( i_ret == 0 )
         i_ret = proto_SORT_DATE( first, second );
@@ -248,13 +391,13 @@ SORTFN( SORT_ARTIST, first, second )
 
 SORTFN( SORT_DESCRIPTION, first, second )
 {
-    return meta_sort( first, second, vlc_meta_Description, false );
+    return meta_sort( first, second, KEY_DESCRIPTION, false );
 }
 
 SORTFN( SORT_DURATION, first, second )
 {
-    mtime_t time1 = input_item_GetDuration( first->p_input );
-    mtime_t time2 = input_item_GetDuration( second->p_input );
+    mtime_t time1 = first->i_duration;
+    mtime_t time2 = second->i_duration;
     int i_ret = time1 > time2 ? 1 :
                     ( time1 == time2 ? 0 : -1 );
     return i_ret;
@@ -262,17 +405,17 @@ SORTFN( SORT_DURATION, first, second )
 
 SORTFN( SORT_GENRE, first, second )
 {
-    return meta_sort( first, second, vlc_meta_Genre, false );
+    return meta_sort( first, second, KEY_GENRE, false );
 }
 
 SORTFN( SORT_ID, first, second )
 {
-    return first->i_id - second->i_id;
+    return first->p_item->i_id - second->p_item->i_id;
 }
 
 SORTFN( SORT_RATING, first, second )
 {
-    return meta_sort( first, second, vlc_meta_Rating, true );
+    return meta_sort( first, second, KEY_RATING, true );
 }
 
 SORTFN( SORT_TITLE, first, second )
@@ -283,10 +426,10 @@ SORTFN( SORT_TITLE, first, second )
 SORTFN( SORT_TITLE_NODES_FIRST, first, second )
 {
     /* If first is a node but not second */
-    if( first->i_children == -1 && second->i_children >= 0 )
+    if( first->p_item->i_children == -1 && second->p_item->i_children >= 0 )
         return -1;
     /* If second is a node but not first */
-    else if( first->i_children >= 0 && second->i_children == -1 )
+    else if( first->p_item->i_children >= 0 && second->p_item->i_children == -1 )
         return 1;
     /* Both are nodes or both are not nodes */
     else
@@ -295,52 +438,32 @@ SORTFN( SORT_TITLE_NODES_FIRST, first, second )
 
 SORTFN( SORT_TITLE_NUMERIC, first, second )
 {
-    int i_ret;
-    char *psz_first = input_item_GetTitleFbName( first->p_input );
-    char *psz_second = input_item_GetTitleFbName( second->p_input );
+    const char *psz_first = sort_entry_Key( first, KEY_TITLE );
+    const char *psz_second = sort_entry_Key( second, KEY_TITLE );
 
     if( psz_first && psz_second )
-        i_ret = atoi( psz_first ) - atoi( psz_second );
+        return first->pi_key[KEY_TITLE] - second->pi_key[KEY_TITLE];
     else if( !psz_first && psz_second )
-        i_ret = 1;
+        return 1;
     else if( psz_first && !psz_second )
-        i_ret = -1;
+        return -1;
     else
-        i_ret = 0;
-
-    free( psz_first );
-    free( psz_second );
-    return i_ret;
+        return 0;
 }
 
 SORTFN( SORT_TRACK_NUMBER, first, second )
 {
-    return meta_sort( first, second, vlc_meta_TrackNumber, true );
+    return meta_sort( first, second, KEY_TRACK_NUMBER, true );
 }
 
 SORTFN( SORT_DISC_NUMBER, first, second )
 {
-  return meta_sort( first, second, vlc_meta_DiscNumber, true );
+  return meta_sort( first, second, KEY_DISC_NUMBER, true );
 }
 
 SORTFN( SORT_URI, first, second )
 {
-    int i_ret;
-    char *psz_first = input_item_GetURI( first->p_input );
-    char *psz_second = input_item_GetURI( second->p_input );
-
-    if( psz_first && psz_second )
-        i_ret = strcasecmp( psz_first, psz_second );
-    else if( !psz_first && psz_second )
-        i_ret = 1;
-    else if( psz_first && !psz_second )
-        i_ret = -1;
-    else
-        i_ret = 0;
-
-    free( psz_first );
-    free( psz_second );
-    return i_ret;
+    return key_strcasecmp( first, second, KEY_URI );
 }
 
 #undef  SORTFN
@@ -355,11 +478,11 @@ SORTFN( SORT_URI, first, second )
 
 #define DEF( s ) \
 	static int cmp_a_##s(const void *l,const void *r) \
-	{ return proto_##s(*(const playlist_item_t *const *)l, \
-                           *(const playlist_item_t *const *)r); } \
+	{ return proto_##s((const sort_entry_t *)l, \
+                           (const sort_entry_t *)r); } \
 	static int cmp_d_##s(const void *l,const void *r) \
-	{ return -1*proto_##s(*(const playlist_item_t * const *)l, \
-                              *(const playlist_item_t * const *)r); }
+	{ return -1*proto_##s((const sort_entry_t *)l, \
+                              (const sort_entry_t *)r); }
 
 	VLC_DEFINE_SORT_FUNCTIONS
 
@@ -42,6 +42,7 @@
 
 #include "display.h"
 #include "window.h"
+#include "../misc/picture.h"
 
 #include "event.h"
 
@@ -95,6 +96,7 @@ static vout_display_t *vout_display_New(vlc_object_t *obj,
     vd->info.has_pictures_invalid = false;
     vd->info.needs_event_thread = false;
     vd->info.subpicture_chromas = NULL;
+    vd->info.has_foreign_pictures = false;
 
     vd->cfg = cfg;
     vd->pool = NULL;
@@ -1442,6 +1444,21 @@ static picture_pool_t *SplitterPool(vout_display_t *vd, unsigned count)
         sys->pool = picture_pool_NewFromFormat(&vd->fmt, count);
     return sys->pool;
 }
+/* Copies a picture shared by the splitter into a display picture.
+ * The display holds on to the previous pictures while they are shown, so the
+ * pool is sized like the one of the video output core (see
+ * VoutDisplayNewPicture()). */
+static picture_t *SplitterPictureImport(vout_display_t *vd, picture_t *picture)
+{
+    picture_pool_t *pool = vout_display_Pool(vd, 3);
+    picture_t *direct = pool ? picture_pool_Get(pool) : NULL;
+
+    if (direct)
+        picture_Copy(direct, picture);
+    picture_Release(picture);
+    return direct;
+}
+
 static void SplitterPrepare(vout_display_t *vd,
                             picture_t *picture,
                             subpicture_t *subpicture)
@@ -1461,6 +1478,10 @@ static void SplitterPrepare(vout_display_t *vd,
     for (int i = 0; i < sys->count; i++) {
         if (vout_IsDisplayFiltered(sys->display[i]))
             sys->picture[i] = vout_FilterDisplay(sys->display[i], sys->picture[i]);
+        else if (sys->picture[i] && picture_IsView(sys->picture[i])
+              && !sys->display[i]->info.has_foreign_pictures)
+            sys->picture[i] = SplitterPictureImport(sys->display[i],
+                                                    sys->picture[i]);
         if (sys->picture[i])
             vout_display_Prepare(sys->display[i], sys->picture[i], NULL);
     }
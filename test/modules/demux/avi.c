@@ -0,0 +1,344 @@
+/*****************************************************************************
+ * avi.c: AVI demuxer keyframe-only trick play tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_stream.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAMES    100
+#define GOP       10                /* frames per group of pictures */
+#define INTERVAL  (CLOCK_FREQ / 25) /* between frames */
+#define RATE      8000              /* audio bytes (samples) per second */
+#define AUDIO     (RATE / 25)       /* audio bytes per frame */
+
+/* File builder */
+
+static uint8_t file[64 * 1024];
+static size_t file_size;
+
+static void put(const void *data, size_t size)
+{
+    assert(file_size + size <= sizeof (file));
+    memcpy(file + file_size, data, size);
+    file_size += size;
+}
+
+static void put_fcc(const char *fcc)
+{
+    put(fcc, 4);
+}
+
+static void put_le16(uint16_t val)
+{
+    uint8_t buf[2];
+    SetWLE(buf, val);
+    put(buf, 2);
+}
+
+static void put_le32(uint32_t val)
+{
+    uint8_t buf[4];
+    SetDWLE(buf, val);
+    put(buf, 4);
+}
+
+/* Starts a chunk, or a list if type is not NULL, and returns its offset */
+static size_t begin(const char *fcc, const char *type)
+{
+    size_t offset = file_size;
+
+    put_fcc(fcc);
+    put_le32(0);
+    if (type != NULL)
+        put_fcc(type);
+    return offset;
+}
+
+static void end(size_t offset)
+{
+    SetDWLE(file + offset + 4, file_size - offset - 8);
+    if (file_size & 1)
+        put("", 1);
+}
+
+static void put_strh(const char *type, const char *handler, uint32_t scale,
+                     uint32_t rate, uint32_t length, uint32_t sample_size)
+{
+    size_t chunk = begin("strh", NULL);
+    put_fcc(type);
+    put_fcc(handler);
+    put_le32(0); /* flags */
+    put_le32(0); /* priority, language */
+    put_le32(0); /* initial frames */
+    put_le32(scale);
+    put_le32(rate);
+    put_le32(0); /* start */
+    put_le32(length);
+    put_le32(0); /* suggested buffer size */
+    put_le32(-1); /* quality */
+    put_le32(sample_size);
+    put_le32(0); /* frame */
+    put_le32(0);
+    end(chunk);
+}
+
+/* MJPEG video with a keyframe every GOP frames, and 8-bits PCM audio. Each
+ * video chunk contains the frame number. */
+static void build_file(void)
+{
+    uint32_t positions[2 * FRAMES];
+    size_t riff, list, strl, chunk, movi;
+
+    file_size = 0;
+    riff = begin("RIFF", "AVI ");
+
+    list = begin("LIST", "hdrl");
+    chunk = begin("avih", NULL);
+    put_le32(INTERVAL);
+    put_le32(0); /* max bytes per second */
+    put_le32(0); /* padding */
+    put_le32(0x10); /* AVIF_HASINDEX */
+    put_le32(FRAMES);
+    put_le32(0); /* initial frames */
+    put_le32(2); /* streams */
+    put_le32(0); /* suggested buffer size */
+    put_le32(16); /* width */
+    put_le32(16); /* height */
+    for (unsigned i = 0; i < 4; i++)
+        put_le32(0);
+    end(chunk);
+
+    strl = begin("LIST", "strl");
+    put_strh("vids", "MJPG", 1, 25, FRAMES, 0);
+    chunk = begin("strf", NULL);
+    put_le32(40);
+    put_le32(16); /* width */
+    put_le32(16); /* height */
+    put_le16(1); /* planes */
+    put_le16(24); /* bit count */
+    put_fcc("MJPG");
+    for (unsigned i = 0; i < 5; i++)
+        put_le32(0);
+    end(chunk);
+    end(strl);
+
+    strl = begin("LIST", "strl");
+    put_strh("auds", "\0\0\0\0", 1, RATE, FRAMES * AUDIO, 1);
+    chunk = begin("strf", NULL);
+    put_le16(1); /* PCM */
+    put_le16(1); /* channels */
+    put_le32(RATE);
+    put_le32(RATE); /* bytes per second */
+    put_le16(1); /* block align */
+    put_le16(8); /* bits per sample */
+    put_le16(0);
+    end(chunk);
+    end(strl);
+    end(list);
+
+    movi = begin("LIST", "movi");
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        uint8_t audio[AUDIO];
+
+        positions[2 * i] = file_size;
+        chunk = begin("00dc", NULL);
+        put_le32(i);
+        end(chunk);
+
+        positions[2 * i + 1] = file_size;
+        chunk = begin("01wb", NULL);
+        memset(audio, 0x80, sizeof (audio));
+        put(audio, sizeof (audio));
+        end(chunk);
+    }
+    end(movi);
+
+    /* Offsets relative to the movi list type */
+    chunk = begin("idx1", NULL);
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        put_fcc("00dc");
+        put_le32((i % GOP) == 0 ? 0x10 /* AVIIF_KEYFRAME */ : 0);
+        put_le32(positions[2 * i] - (movi + 8));
+        put_le32(4);
+
+        put_fcc("01wb");
+        put_le32(0x10);
+        put_le32(positions[2 * i + 1] - (movi + 8));
+        put_le32(AUDIO);
+    }
+    end(chunk);
+    end(riff);
+}
+
+/* Mock ES output: records the video frames and counts the audio blocks */
+
+struct es_out_id_t
+{
+    int i_cat;
+};
+
+struct es_out_sys_t
+{
+    es_out_id_t video, audio;
+    unsigned    frames[FRAMES];
+    unsigned    frame_count;
+    unsigned    audio_count;
+    bool        keyframes_only; /* every video block is typed as intra */
+};
+
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    es_out_sys_t *sys = out->p_sys;
+
+    if (fmt->i_cat == VIDEO_ES)
+    {
+        assert(fmt->i_codec == VLC_CODEC_MJPG);
+        return &sys->video;
+    }
+    assert(fmt->i_cat == AUDIO_ES);
+    return &sys->audio;
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    es_out_sys_t *sys = out->p_sys;
+
+    if (id->i_cat == VIDEO_ES)
+    {
+        assert(block->i_buffer == 4);
+        assert(sys->frame_count < FRAMES);
+        sys->frames[sys->frame_count++] = GetDWLE(block->p_buffer);
+        if (!(block->i_flags & BLOCK_FLAG_TYPE_I))
+            sys->keyframes_only = false;
+    }
+    else
+        sys->audio_count++;
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel(es_out_t *out, es_out_id_t *id)
+{
+    (void) out; (void) id;
+}
+
+static int EsOutControl(es_out_t *out, int query, va_list args)
+{
+    (void) out;
+
+    switch (query)
+    {
+        case ES_OUT_GET_ES_STATE:
+            (void) va_arg(args, es_out_id_t *);
+            *va_arg(args, bool *) = true;
+            return VLC_SUCCESS;
+        case ES_OUT_SET_PCR:
+        case ES_OUT_SET_NEXT_DISPLAY_TIME:
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static void reset(es_out_sys_t *sys)
+{
+    sys->frame_count = sys->audio_count = 0;
+    sys->keyframes_only = true;
+}
+
+int main(void)
+{
+    static const char *const args[] = { "-v" };
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    build_file();
+
+    es_out_sys_t sys = { .video = { VIDEO_ES }, .audio = { AUDIO_ES } };
+    es_out_t out = {
+        .pf_add = EsOutAdd,
+        .pf_send = EsOutSend,
+        .pf_del = EsOutDel,
+        .pf_control = EsOutControl,
+        .p_sys = &sys,
+    };
+
+    stream_t *s = vlc_stream_MemoryNew(obj, file, file_size, true);
+    assert(s != NULL);
+    demux_t *demux = demux_New(obj, "avi", "", s, &out);
+    assert(demux != NULL);
+
+    /* Keyframes at least 1 s apart, from the start: 0, 1.2, 2.4, 3.6 s */
+    const int64_t stride = CLOCK_FREQ;
+    reset(&sys);
+    assert(demux_Control(demux, DEMUX_SET_KEYFRAME_STRIDE, stride) == 0);
+    while (demux_Demux(demux) == VLC_DEMUXER_SUCCESS)
+        ;
+    assert(sys.frame_count == 4);
+    assert(sys.audio_count == 0);
+    assert(sys.keyframes_only);
+    for (unsigned i = 0; i < sys.frame_count; i++)
+        assert(sys.frames[i] == 3 * GOP * i);
+
+    /* Normal demuxing resumes from the last keyframe, with the audio */
+    reset(&sys);
+    assert(demux_Control(demux, DEMUX_SET_KEYFRAME_STRIDE, INT64_C(0)) == 0);
+    while (demux_Demux(demux) == VLC_DEMUXER_SUCCESS)
+        ;
+    assert(sys.frame_count == GOP);
+    for (unsigned i = 0; i < sys.frame_count; i++)
+        assert(sys.frames[i] == FRAMES - GOP + i);
+    assert(sys.audio_count > 0);
+    assert(!sys.keyframes_only);
+
+    /* A shorter stride than the group of pictures gives every keyframe */
+    reset(&sys);
+    assert(demux_Control(demux, DEMUX_SET_TIME, INT64_C(0), true) == 0);
+    assert(demux_Control(demux, DEMUX_SET_KEYFRAME_STRIDE, INTERVAL) == 0);
+    while (demux_Demux(demux) == VLC_DEMUXER_SUCCESS)
+        ;
+    assert(sys.frame_count == FRAMES / GOP);
+    for (unsigned i = 0; i < sys.frame_count; i++)
+        assert(sys.frames[i] == GOP * i);
+    assert(sys.audio_count == 0);
+
+    demux_Delete(demux); /* deletes the stream */
+    libvlc_release(vlc);
+    return 0;
+}
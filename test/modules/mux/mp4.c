@@ -0,0 +1,227 @@
+/*****************************************************************************
+ * mp4.c: MP4 muxer "Fast Start" tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include <vlc_common.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static vlc_sem_t ended;
+
+static void on_end(const libvlc_event_t *event, void *data)
+{
+    (void) event; (void) data;
+    vlc_sem_post(&ended);
+}
+
+/* MPEG-1 Layer II, 128 kb/s, 48 kHz, stereo: 24 ms per frame */
+#define FRAME_SIZE 384
+
+/* Writes an elementary stream of silent frames, every other one padded if
+ * requested so that the sample sizes table does not collapse */
+static void write_es(const char *path, unsigned frames, bool padding)
+{
+    uint8_t frame[FRAME_SIZE + 1] = { 0xFF, 0xFD, 0x84, 0x00 };
+    FILE *stream = fopen(path, "wb");
+
+    assert(stream != NULL);
+    for (unsigned i = 0; i < frames; i++)
+    {
+        bool padded = padding && (i & 1);
+
+        frame[2] = padded ? 0x86 : 0x84;
+        assert(fwrite(frame, FRAME_SIZE + padded, 1, stream) == 1);
+    }
+    fclose(stream);
+}
+
+/* Remuxes the elementary stream, and returns the output file */
+static uint8_t *remux(libvlc_instance_t *vlc, const char *in, const char *path,
+                      const char *options, size_t *size)
+{
+    char *opt;
+    libvlc_media_t *media = libvlc_media_new_path(vlc, in);
+    assert(media != NULL);
+
+    assert(asprintf(&opt, ":sout=#std{access=file,"
+                    "mux=mp4{faststart,%s},dst=%s}",
+                    options, path) >= 0);
+    libvlc_media_add_option(media, opt);
+    free(opt);
+
+    libvlc_media_player_t *mp = libvlc_media_player_new_from_media(media);
+    assert(mp != NULL);
+    libvlc_media_release(media);
+
+    libvlc_event_manager_t *em = libvlc_media_player_event_manager(mp);
+    assert(!libvlc_event_attach(em, libvlc_MediaPlayerEndReached, on_end,
+                                NULL));
+    assert(libvlc_media_player_play(mp) == 0);
+    vlc_sem_wait(&ended);
+    libvlc_media_player_stop(mp); /* closes the muxer */
+    libvlc_media_player_release(mp);
+
+    FILE *stream = fopen(path, "rb");
+    assert(stream != NULL);
+    assert(fseek(stream, 0, SEEK_END) == 0);
+    *size = ftell(stream);
+    rewind(stream);
+
+    uint8_t *buf = malloc(*size);
+    assert(buf != NULL);
+    assert(fread(buf, 1, *size, stream) == *size);
+    fclose(stream);
+    unlink(path);
+    return buf;
+}
+
+/* Finds a box among the children of a box, or at the top level */
+static const uint8_t *find_box(const uint8_t *p, size_t size, const char *type,
+                               size_t *box_size)
+{
+    while (size >= 8)
+    {
+        size_t len = GetDWBE(p);
+
+        assert(len >= 8 && len <= size);
+        if (!memcmp(p + 4, type, 4))
+        {
+            *box_size = len;
+            return p;
+        }
+        p += len;
+        size -= len;
+    }
+    return NULL;
+}
+
+static const uint8_t *find_path(const uint8_t *p, size_t size,
+                                const char *const *path, size_t *box_size)
+{
+    for (size_t len = size; *path != NULL; path++)
+    {
+        p = find_box(p, size, *path, &len);
+        assert(p != NULL);
+        *box_size = len;
+        p += 8;
+        size = len - 8;
+    }
+    return p - 8;
+}
+
+/* Checks the box layout, and that the first chunk is the first frame */
+static void check_file(const uint8_t *buf, size_t size,
+                       const char *const *layout)
+{
+    static const char *const stco[] = {
+        "moov", "trak", "mdia", "minf", "stbl", "stco", NULL };
+    const uint8_t *p = buf;
+    size_t len = size;
+
+    for (; *layout != NULL; layout++)
+    {
+        assert(len >= 8);
+        assert(!memcmp(p + 4, *layout, 4));
+        p += GetDWBE(p);
+        len = size - (p - buf);
+    }
+    assert(len == 0);
+
+    const uint8_t *box = find_path(buf, size, stco, &len);
+    assert(len >= 20 && GetDWBE(box + 12) > 0);
+
+    uint32_t offset = GetDWBE(box + 16);
+    assert(offset + 2 <= size);
+    assert(buf[offset] == 0xFF && buf[offset + 1] == 0xFD);
+}
+
+int main(void)
+{
+    static const char *const args[] = { "-v", "--no-sout-all" };
+    char in[] = "/tmp/vlc-mp4-XXXXXX.mp2", path[] = "/tmp/vlc-mp4-XXXXXX";
+    uint8_t *buf;
+    size_t size, box_size;
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+    alarm(10);
+    vlc_sem_init(&ended, 0);
+
+    int fd = mkstemps(in, 4);
+    assert(fd != -1);
+    close(fd);
+    fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+
+    /* Without reserved space, the media data is moved after the moov */
+    static const char *const moved[] = {
+        "ftyp", "moov", "wide", "mdat", NULL };
+    write_es(in, 100, false);
+    buf = remux(vlc, in, path, "moov-reserve=0", &size);
+    check_file(buf, size, moved);
+    free(buf);
+
+    /* Nor by default, without an expected duration */
+    buf = remux(vlc, in, path, "duration=0", &size);
+    check_file(buf, size, moved);
+    free(buf);
+
+    /* The moov is written in place, the rest of the space is left free */
+    static const char *const reserved[] = {
+        "ftyp", "moov", "free", "wide", "mdat", NULL };
+    buf = remux(vlc, in, path, "moov-reserve=64", &size);
+    check_file(buf, size, reserved);
+    assert(find_box(buf, size, "ftyp", &box_size) == buf);
+    assert(!memcmp(buf + box_size + 64 * 1024 + 4, "wide", 4));
+    assert(find_box(buf, size, "moov", &box_size) != NULL);
+    assert(box_size < 64 * 1024);
+    free(buf);
+
+    /* Space estimated from the track and the expected duration */
+    buf = remux(vlc, in, path, "duration=3", &size);
+    check_file(buf, size, reserved);
+    free(buf);
+
+    /* Reserved space too small: the media data is moved by the difference */
+    write_es(in, 1000, true);
+    buf = remux(vlc, in, path, "moov-reserve=1", &size);
+    check_file(buf, size, moved);
+    assert(find_box(buf, size, "moov", &box_size) != NULL);
+    assert(box_size > 1024);
+    free(buf);
+
+    libvlc_release(vlc);
+    vlc_sem_destroy(&ended);
+    unlink(in);
+    return 0;
+}
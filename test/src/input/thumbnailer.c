@@ -0,0 +1,228 @@
+/*****************************************************************************
+ * thumbnailer.c: Thumbnailer API tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_image.h>
+#include <vlc_thumbnailer.h>
+#include <vlc_url.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define WIDTH  64
+#define HEIGHT 48
+#define FPS    25
+#define FRAMES (2 * FPS)
+
+/* Luma of a frame, telling which frame a picture comes from */
+#define LUMA(frame) (16 + 4 * (frame))
+
+/* Writes a raw YUV 4:2:0 video, every frame being a keyframe */
+static void write_y4m(const char *path)
+{
+    static uint8_t frame[WIDTH * HEIGHT * 3 / 2];
+    FILE *stream = fopen(path, "wb");
+
+    assert(stream != NULL);
+    fprintf(stream, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n",
+            WIDTH, HEIGHT, FPS);
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        memset(frame, LUMA(i), WIDTH * HEIGHT);
+        memset(frame + WIDTH * HEIGHT, 128, WIDTH * HEIGHT / 2);
+        fputs("FRAME\n", stream);
+        assert(fwrite(frame, sizeof (frame), 1, stream) == 1);
+    }
+    fclose(stream);
+}
+
+/* Returns the frame of a decoded I420 picture */
+static unsigned frame_of(const picture_t *pic)
+{
+    const plane_t *y = &pic->p[0];
+    unsigned luma = y->p_pixels[(y->i_visible_lines / 2) * y->i_pitch
+                                + y->i_visible_pitch / 2];
+
+    assert(luma >= LUMA(0) && (luma - LUMA(0)) % 4 == 0);
+    return (luma - LUMA(0)) / 4;
+}
+
+static void test_picture(vlc_thumbnailer_t *th)
+{
+    video_format_t fmt;
+    picture_t *pic;
+
+    /* Decoded picture */
+    pic = vlc_thumbnailer_GetPicture(th, CLOCK_FREQ, NULL);
+    assert(pic != NULL);
+    assert(pic->format.i_chroma == VLC_CODEC_I420);
+    assert(pic->format.i_visible_width == WIDTH);
+    assert(pic->format.i_visible_height == HEIGHT);
+    assert(frame_of(pic) == FPS);
+    picture_Release(pic);
+
+    /* Scaled down, the height deduced from the aspect ratio */
+    video_format_Init(&fmt, 0);
+    fmt.i_width = WIDTH / 2;
+    pic = vlc_thumbnailer_GetPicture(th, CLOCK_FREQ / 2, &fmt);
+    assert(pic != NULL);
+    assert(fmt.i_chroma == VLC_CODEC_I420);
+    assert(fmt.i_visible_width == WIDTH / 2);
+    assert(fmt.i_visible_height == HEIGHT / 2);
+    assert(frame_of(pic) == FPS / 2);
+    picture_Release(pic);
+
+    /* Converted to another chroma */
+    video_format_Init(&fmt, VLC_CODEC_YUYV);
+    pic = vlc_thumbnailer_GetPicture(th, 0, &fmt);
+    assert(pic != NULL);
+    assert(fmt.i_chroma == VLC_CODEC_YUYV);
+    assert(fmt.i_width == WIDTH && fmt.i_height == HEIGHT);
+    picture_Release(pic);
+
+    /* Past the end */
+    assert(vlc_thumbnailer_GetPicture(th, 100 * CLOCK_FREQ, NULL) == NULL);
+}
+
+/* The JPEG encoder takes full range pictures: decode those, at the original
+ * size, so that no conversion is needed */
+static void test_image(vlc_object_t *obj, const char *uri)
+{
+    input_item_t *item = input_item_New(uri, NULL);
+    assert(item != NULL);
+    input_item_AddOption(item, ":rawvid-fps=25", VLC_INPUT_OPTION_TRUSTED);
+    input_item_AddOption(item, ":rawvid-chroma=J420",
+                         VLC_INPUT_OPTION_TRUSTED);
+
+    vlc_thumbnailer_t *th = vlc_thumbnailer_Create(obj, item);
+    assert(th != NULL);
+
+    block_t *block = vlc_thumbnailer_GetImage(th, CLOCK_FREQ, VLC_CODEC_JPEG,
+                                              0, 0);
+    assert(block != NULL);
+    assert(block->i_buffer > 4);
+    assert(block->p_buffer[0] == 0xFF && block->p_buffer[1] == 0xD8);
+    vlc_thumbnailer_Delete(th);
+    input_item_Release(item);
+
+    /* Read it back */
+    image_handler_t *image = image_HandlerCreate(obj);
+    video_format_t fmt_in, fmt_out;
+
+    assert(image != NULL);
+    video_format_Init(&fmt_in, VLC_CODEC_JPEG);
+    video_format_Init(&fmt_out, 0);
+    picture_t *pic = image_Read(image, block, &fmt_in, &fmt_out);
+    assert(pic != NULL);
+    assert(fmt_out.i_width == WIDTH);
+    assert(fmt_out.i_height == HEIGHT);
+    picture_Release(pic);
+    image_HandlerDelete(image);
+}
+
+static void test_storyboard(vlc_thumbnailer_t *th)
+{
+    /* Unsorted, with a repeated time and one past the end */
+    const mtime_t times[] = {
+        3 * CLOCK_FREQ / 2, CLOCK_FREQ / 5, 100 * CLOCK_FREQ,
+        3 * CLOCK_FREQ / 2, CLOCK_FREQ,
+    };
+    const unsigned frames[] = { 3 * FPS / 2, FPS / 5, 0, 3 * FPS / 2, FPS };
+    picture_t *pics[ARRAY_SIZE(times)];
+    video_format_t fmt;
+
+    video_format_Init(&fmt, 0);
+    fmt.i_height = HEIGHT / 2;
+    assert(vlc_thumbnailer_GetStoryboard(th, times, ARRAY_SIZE(times), &fmt,
+                                         pics) == ARRAY_SIZE(times) - 1);
+    assert(fmt.i_chroma == VLC_CODEC_I420);
+    assert(fmt.i_visible_width == WIDTH / 2);
+    assert(fmt.i_visible_height == HEIGHT / 2);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(times); i++)
+    {
+        if (times[i] > FRAMES * CLOCK_FREQ / FPS)
+        {
+            assert(pics[i] == NULL);
+            continue;
+        }
+        assert(pics[i] != NULL);
+        assert(pics[i]->format.i_visible_width == WIDTH / 2);
+        assert(frame_of(pics[i]) == frames[i]);
+    }
+
+    for (unsigned i = 0; i < ARRAY_SIZE(times); i++)
+        if (pics[i] != NULL)
+            picture_Release(pics[i]);
+}
+
+int main(void)
+{
+    static const char *const args[] = { "-v" };
+    char path[] = "/tmp/vlc-thumbnailer-XXXXXX.y4m";
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+    alarm(10);
+
+    int fd = mkstemps(path, 4);
+    assert(fd != -1);
+    close(fd);
+    write_y4m(path);
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    char *uri = vlc_path2uri(path, NULL);
+    assert(uri != NULL);
+    input_item_t *item = input_item_New(uri, NULL);
+    assert(item != NULL);
+    /* The demuxer needs the rate as an option, the item options apply */
+    input_item_AddOption(item, ":rawvid-fps=25", VLC_INPUT_OPTION_TRUSTED);
+
+    vlc_thumbnailer_t *th = vlc_thumbnailer_Create(obj, item);
+    assert(th != NULL);
+    /* Estimated from the file size, the frame headers included */
+    mtime_t length = vlc_thumbnailer_GetLength(th);
+    assert(length >= FRAMES * CLOCK_FREQ / FPS);
+    assert(length < (FRAMES + 1) * CLOCK_FREQ / FPS);
+
+    test_picture(th);
+    test_storyboard(th);
+    vlc_thumbnailer_Delete(th);
+    input_item_Release(item);
+
+    test_image(obj, uri);
+    free(uri);
+    libvlc_release(vlc);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,240 @@
+/*****************************************************************************
+ * httpd.c: Test for the built-in HTTP server
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_httpd.h>
+#include <vlc_network.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+
+static const char *const pieces[] = { "Hello ", "chunked ", "world!" };
+
+struct httpd_callback_sys_t
+{
+    unsigned calls;
+    bool     b_waited;
+};
+
+static void answer_init(httpd_message_t *answer)
+{
+    answer->i_proto = HTTPD_PROTO_HTTP;
+    answer->i_version = 1;
+    answer->i_type = HTTPD_MSG_ANSWER;
+}
+
+/* Streams the pieces one by one, with the body offset one past the index of
+ * the next piece, and once without any data */
+static int ChunkedCallback(httpd_callback_sys_t *sys, httpd_client_t *cl,
+                           httpd_message_t *answer,
+                           const httpd_message_t *query)
+{
+    (void) cl; (void) query;
+    sys->calls++;
+
+    if (answer->i_body_offset > 0)
+    {
+        size_t i = answer->i_body_offset - 1;
+
+        assert(i < ARRAY_SIZE(pieces));
+        if (i == 1 && !sys->b_waited)
+        {
+            sys->b_waited = true;
+            return VLC_EGENERIC; /* not there yet */
+        }
+
+        answer_init(answer);
+        answer->p_body = (uint8_t *)strdup(pieces[i]);
+        assert(answer->p_body != NULL);
+        answer->i_body = strlen(pieces[i]);
+        if (i + 1 == ARRAY_SIZE(pieces))
+            answer->i_body_offset = 0;
+        else
+            answer->i_body_offset++;
+        return VLC_SUCCESS;
+    }
+
+    answer_init(answer);
+    answer->i_status = 200;
+    httpd_MsgAdd(answer, "Content-Type", "text/plain");
+    httpd_MsgAdd(answer, "Transfer-Encoding", "chunked");
+    answer->i_body_offset = 1;
+    return VLC_SUCCESS;
+}
+
+static int PlainCallback(httpd_callback_sys_t *sys, httpd_client_t *cl,
+                         httpd_message_t *answer, const httpd_message_t *query)
+{
+    (void) cl; (void) query;
+    sys->calls++;
+
+    answer_init(answer);
+    answer->i_status = 200;
+    httpd_MsgAdd(answer, "Content-Length", "5");
+    answer->p_body = (uint8_t *)strdup("plain");
+    assert(answer->p_body != NULL);
+    answer->i_body = 5;
+    return VLC_SUCCESS;
+}
+
+/* Receives more data at the end of the buffer */
+static void recv_more(int fd, char *buf, size_t *len, size_t size)
+{
+    struct pollfd ufd = { .fd = fd, .events = POLLIN };
+    assert(poll(&ufd, 1, 5000) == 1);
+
+    assert(*len + 1 < size);
+    ssize_t val = recv(fd, buf + *len, size - *len - 1, 0);
+    assert(val > 0);
+    *len += val;
+    buf[*len] = '\0';
+}
+
+/* Receives until the buffer contains the needle after from, and returns the
+ * end of the needle */
+static char *recv_until(int fd, char *buf, size_t *len, size_t size,
+                        const char *from, const char *needle)
+{
+    char *p;
+
+    while ((p = strstr(from, needle)) == NULL)
+        recv_more(fd, buf, len, size);
+    return p + strlen(needle);
+}
+
+static void test_chunked(int fd)
+{
+    const char req[] = "GET /chunked HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    char buf[4096] = "", body[64] = "";
+    size_t len = 0;
+
+    assert(send(fd, req, strlen(req), 0) == (ssize_t)strlen(req));
+
+    char *p = recv_until(fd, buf, &len, sizeof (buf), buf, "\r\n\r\n");
+    assert(!strncmp(buf, "HTTP/1.1 200 ", 13));
+    assert(strstr(buf, "\r\nTransfer-Encoding: chunked\r\n") != NULL);
+    assert(strstr(buf, "\r\nContent-Length:") == NULL);
+
+    /* Decode the chunks up to the last one */
+    for (;;)
+    {
+        char *data = recv_until(fd, buf, &len, sizeof (buf), p, "\r\n");
+        unsigned long size = strtoul(p, NULL, 16);
+
+        if (size == 0)
+        {
+            p = recv_until(fd, buf, &len, sizeof (buf), data, "\r\n");
+            assert(p == data + 2); /* no trailer */
+            break;
+        }
+
+        while ((size_t)(buf + len - data) < size + 2)
+            recv_more(fd, buf, &len, sizeof (buf));
+        assert(!memcmp(data + size, "\r\n", 2));
+        assert(strlen(body) + size < sizeof (body));
+        strncat(body, data, size);
+        p = data + size + 2;
+    }
+
+    assert(!strcmp(body, "Hello chunked world!"));
+    assert(p == buf + len); /* nothing after the last chunk */
+}
+
+static void test_plain(int fd)
+{
+    const char req[] = "GET /plain HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    char buf[4096] = "";
+    size_t len = 0;
+
+    assert(send(fd, req, strlen(req), 0) == (ssize_t)strlen(req));
+
+    char *p = recv_until(fd, buf, &len, sizeof (buf), buf, "\r\n\r\n");
+    assert(!strncmp(buf, "HTTP/1.1 200 ", 13));
+    assert(strstr(buf, "\r\nContent-Length: 5\r\n") != NULL);
+    assert(strstr(buf, "Transfer-Encoding") == NULL);
+    assert(recv_until(fd, buf, &len, sizeof (buf), p, "plain") == buf + len);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    const char *argv[] = { "--http-host=127.0.0.1", "" };
+    char port[32];
+    libvlc_instance_t *vlc = NULL;
+    httpd_host_t *host = NULL;
+    unsigned i_port = 0;
+
+    /* Find a free port */
+    for (unsigned i = 0; i < 100 && host == NULL; i++)
+    {
+        i_port = 20000 + (getpid() + 7919 * i) % 40000;
+        snprintf(port, sizeof (port), "--http-port=%u", i_port);
+        argv[1] = port;
+
+        if (vlc != NULL)
+            libvlc_release(vlc);
+        vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+        assert(vlc != NULL);
+        host = vlc_http_HostNew(VLC_OBJECT(vlc->p_libvlc_int));
+    }
+    assert(host != NULL);
+
+    struct httpd_callback_sys_t chunked = { 0, false }, plain = { 0, false };
+    httpd_url_t *url_chunked = httpd_UrlNew(host, "/chunked", NULL, NULL);
+    httpd_url_t *url_plain = httpd_UrlNew(host, "/plain", NULL, NULL);
+    assert(url_chunked != NULL && url_plain != NULL);
+    httpd_UrlCatch(url_chunked, HTTPD_MSG_GET, ChunkedCallback, &chunked);
+    httpd_UrlCatch(url_plain, HTTPD_MSG_GET, PlainCallback, &plain);
+
+    int fd = net_ConnectTCP(vlc->p_libvlc_int, "127.0.0.1", i_port);
+    assert(fd != -1);
+
+    /* Chunked answer, then a plain one on the same connection */
+    test_chunked(fd);
+    assert(chunked.b_waited);
+    assert(chunked.calls >= 1 + ARRAY_SIZE(pieces) + 1);
+    test_plain(fd);
+    assert(plain.calls == 1);
+
+    /* Again, once the connection left stream mode */
+    chunked.b_waited = false;
+    test_chunked(fd);
+    test_plain(fd);
+    net_Close(fd);
+
+    httpd_UrlDelete(url_plain);
+    httpd_UrlDelete(url_chunked);
+    httpd_HostDelete(host);
+    libvlc_release(vlc);
+    return 0;
+}